@@ -151,6 +151,15 @@ SOURCES += \
     src/main.cpp \
     src/opl/generator.cpp \
     src/opl/generator_realtime.cpp \
+    src/opl/generator_midi.cpp \
+    src/opl/midi_sequencer.cpp \
+    src/opl/realtime_stats.cpp \
+    src/opl/latency_tuner.cpp \
+    src/opl/voice_allocator.cpp \
+    src/opl/offline_renderer.cpp \
+    src/opl/bank_renderer.cpp \
+    src/audio/audio_file_writer.cpp \
+    src/midi/midi_file.cpp \
     src/opl/realtime/ring_buffer.cpp \
     src/piano.cpp \
     src/opl/measurer.cpp \
@@ -162,7 +171,9 @@ SOURCES += \
     src/opl/chips/dosbox/dbopl.cpp \
     src/FileFormats/wopl/wopl_file.c \
     src/opl/chips/nuked_opl3_v174.cpp \
-    src/opl/chips/nuked/nukedopl3_174.c
+    src/opl/chips/nuked/nukedopl3_174.c \
+    src/opl/chips/nuked_opl3_simd.cpp \
+    src/opl/chips/nuked/nukedopl3_simd.c
 
 HEADERS += \
     src/FileFormats/format_smaf_importer.h \
@@ -195,6 +206,7 @@ HEADERS += \
     src/FileFormats/format_wohlstand_opl3.h \
     src/FileFormats/format_flatbuffer_opl3.h \
     src/FileFormats/ymf262_to_wopi.h \
+    src/FileFormats/opl_reg_stream.h \
     src/formats_sup.h \
     src/importer.h \
     src/audio_config.h \
@@ -203,15 +215,28 @@ HEADERS += \
     src/ins_names_data.h \
     src/main.h \
     src/opl/generator.h \
+    src/opl/constexpr_math.h \
     src/opl/generator_realtime.h \
+    src/opl/generator_midi.h \
+    src/opl/midi_sequencer.h \
+    src/opl/realtime_stats.h \
+    src/opl/latency_tuner.h \
+    src/opl/opl_freq.h \
+    src/opl/voice_allocator.h \
+    src/opl/offline_renderer.h \
+    src/opl/bank_renderer.h \
+    src/audio/audio_file_writer.h \
+    src/midi/midi_file.h \
     src/opl/nukedopl3.h \
     src/opl/realtime/ring_buffer.h \
     src/opl/realtime/ring_buffer.tcc \
     src/piano.h \
     src/version.h \
     src/opl/measurer.h \
+    src/opl/chip_snapshot.h \
     src/opl/chips/opl_chip_base.h \
     src/opl/chips/opl_chip_base.tcc \
+    src/opl/chips/common/sinc_resampler.hpp \
     src/opl/chips/dosbox_opl3.h \
     src/opl/chips/java_opl3.h \
     src/opl/chips/nuked_opl3.h \
@@ -223,7 +248,9 @@ HEADERS += \
     src/opl/chips/dosbox/dbopl.h \
     src/FileFormats/wopl/wopl_file.h \
     src/opl/chips/nuked_opl3_v174.h \
-    src/opl/chips/nuked/nukedopl3_174.h
+    src/opl/chips/nuked/nukedopl3_174.h \
+    src/opl/chips/nuked_opl3_simd.h \
+    src/opl/chips/nuked/nukedopl3_simd.h
 
 FORMS += \
     src/bank_editor.ui \
@@ -17,6 +17,7 @@
  */
 
 #include "format_dro_importer.h"
+#include "opl_reg_stream.h"
 #include "ymf262_to_wopi.h"
 #include "../common.h"
 
@@ -39,7 +40,65 @@ bool DRO_Importer::detect(const QString &filePath, char* magic)
     return !memcmp(magic, "DBRAWOPL", 8);
 }
 
+namespace {
+
+// Collects the instruments out of the register writes
+class DroInstrumentCatcher : public OplRegStreamSink
+{
+public:
+    DroInstrumentCatcher()
+    {
+        m_chip[1].shareInstruments(m_chip[0]);
+    }
+
+    void passReg(unsigned chip, uint16_t addr, uint8_t val) override
+    {
+        m_chip[chip & 1].passReg(addr, val);
+    }
+
+    void passDelay(uint32_t amount, uint32_t rate) override
+    {
+        Q_UNUSED(amount);
+        Q_UNUSED(rate);
+        analyze();
+    }
+
+    void analyze()
+    {
+        for(unsigned c = 0; c < 2; ++c)
+            m_chip[c].doAnalyzeState();
+    }
+
+    const QList<FmBank::Instrument> &caughtInstruments()
+    {
+        return m_chip[0].caughtInstruments();
+    }
+
+private:
+    RawYmf262ToWopi m_chip[2];
+};
+
+} // namespace
+
 FfmtErrCode DRO_Importer::loadFile(QString filePath, FmBank &bank)
+{
+    DroInstrumentCatcher catcher;
+    FfmtErrCode err = loadRegisters(filePath, catcher);
+    if(err != FfmtErrCode::ERR_OK)
+        return err;
+
+    catcher.analyze();
+
+    bank.reset();
+    bank.Ins_Melodic_box.clear();
+    for(const FmBank::Instrument &ins : catcher.caughtInstruments())
+        bank.Ins_Melodic_box.push_back(ins);
+    bank.Ins_Melodic = bank.Ins_Melodic_box.data();
+
+    return FfmtErrCode::ERR_OK;
+}
+
+FfmtErrCode DRO_Importer::loadRegisters(const QString &filePath, OplRegStreamSink &sink)
 {
     QFile file(filePath);
     if(!file.open(QIODevice::ReadOnly))
@@ -55,10 +114,10 @@ FfmtErrCode DRO_Importer::loadFile(QString filePath, FmBank &bank)
         return FfmtErrCode::ERR_BADFORMAT;
 
     if(majorVersion < 2)
-        return loadFileV1(file, bank);
+        return loadFileV1(file, sink);
 
     if(majorVersion == 2 && minorVersion == 0)
-        return loadFileV2(file, bank);
+        return loadFileV2(file, sink);
 
     return FfmtErrCode::ERR_BADFORMAT;
 }
@@ -95,7 +154,7 @@ enum OplMode
     OplMode3
 };
 
-FfmtErrCode DRO_Importer::loadFileV1(QFile &file, FmBank &bank)
+FfmtErrCode DRO_Importer::loadFileV1(QFile &file, OplRegStreamSink &sink)
 {
     uint32_t lengthMs;
     uint32_t lengthBytes;
@@ -114,14 +173,6 @@ FfmtErrCode DRO_Importer::loadFileV1(QFile &file, FmBank &bank)
     if(oplMode > 2)
         return FfmtErrCode::ERR_BADFORMAT;
 
-    RawYmf262ToWopi chip[2];
-    unsigned nchip = 1;
-    if(oplMode == OplMode2x2)
-    {
-        nchip = 2;
-        chip[1].shareInstruments(chip[0]);
-    }
-
     unsigned chipSelect = 0;
 
     for(uint32_t i = 0; i < lengthBytes;)
@@ -143,11 +194,10 @@ FfmtErrCode DRO_Importer::loadFileV1(QFile &file, FmBank &bank)
             return FfmtErrCode::ERR_BADFORMAT;
         i += ndata;
 
-        if(reg == 0 || reg == 1) // short delay/long delay
-        {
-            for (unsigned c = 0; c < nchip; ++c)
-                chip[c].doAnalyzeState();
-        }
+        if(reg == 0) // short delay
+            sink.passDelay(data[0] + 1u, 1000);
+        else if(reg == 1) // long delay
+            sink.passDelay((data[0] | (data[1] << 8)) + 1u, 1000);
         else if(reg == 2) // select low chip
             chipSelect = 0;
         else if(reg == 3) // select high chip
@@ -161,30 +211,21 @@ FfmtErrCode DRO_Importer::loadFileV1(QFile &file, FmBank &bank)
             }
 
             if(chipSelect == 0)
-                chip[0].passReg(reg, data[0]);
+                sink.passReg(0, reg, data[0]);
             else
             {
                 if(oplMode == OplMode2x2)
-                    chip[1].passReg(reg, data[0]);
+                    sink.passReg(1, reg, data[0]);
                 else if(oplMode == OplMode3)
-                    chip[0].passReg(reg | 0x100u, data[0]);
+                    sink.passReg(0, reg | 0x100u, data[0]);
             }
         }
     }
 
-    for (unsigned c = 0; c < nchip; ++c)
-        chip[c].doAnalyzeState();
-
-    bank.reset();
-    bank.Ins_Melodic_box.clear();
-    for(const FmBank::Instrument &ins : chip[0].caughtInstruments())
-        bank.Ins_Melodic_box.push_back(ins);
-    bank.Ins_Melodic = bank.Ins_Melodic_box.data();
-
     return FfmtErrCode::ERR_OK;
 }
 
-FfmtErrCode DRO_Importer::loadFileV2(QFile &file, FmBank &bank)
+FfmtErrCode DRO_Importer::loadFileV2(QFile &file, OplRegStreamSink &sink)
 {
     uint32_t lengthPairs;
     uint32_t lengthMs;
@@ -213,25 +254,16 @@ FfmtErrCode DRO_Importer::loadFileV2(QFile &file, FmBank &bank)
     if(hardwareType > 2)
         return FfmtErrCode::ERR_BADFORMAT;
 
-    RawYmf262ToWopi chip[2];
-    unsigned nchip = 1;
-    if(hardwareType == OplMode2x2)
-    {
-        nchip = 2;
-        chip[1].shareInstruments(chip[0]);
-    }
-
     for(uint32_t i = 0; i < lengthPairs; ++i)
     {
         uint8_t data[2];
         if(file.read((char *)data, 2) != 2)
             return FfmtErrCode::ERR_BADFORMAT;
 
-        if(data[0] == shortDelayCode || data[0] == longDelayCode)
-        {
-            for (unsigned c = 0; c < nchip; ++c)
-                chip[c].doAnalyzeState();
-        }
+        if(data[0] == shortDelayCode)
+            sink.passDelay(data[1] + 1u, 1000);
+        else if(data[0] == longDelayCode)
+            sink.passDelay((data[1] + 1u) << 8, 1000);
         else
         {
             unsigned chipSelect = data[0] >> 7;
@@ -244,22 +276,13 @@ FfmtErrCode DRO_Importer::loadFileV2(QFile &file, FmBank &bank)
             uint8_t val = data[1];
 
             if(chipSelect && hardwareType == OplMode2x2)
-                chip[1].passReg(reg, val);
+                sink.passReg(1, reg, val);
             else if(chipSelect && hardwareType == OplMode3)
-                chip[0].passReg(reg | 0x100u, val);
+                sink.passReg(0, reg | 0x100u, val);
             else if(!chipSelect)
-                chip[0].passReg(reg, val);
+                sink.passReg(0, reg, val);
         }
     }
 
-    for (unsigned c = 0; c < nchip; ++c)
-        chip[c].doAnalyzeState();
-
-    bank.reset();
-    bank.Ins_Melodic_box.clear();
-    for(const FmBank::Instrument &ins : chip[0].caughtInstruments())
-        bank.Ins_Melodic_box.push_back(ins);
-    bank.Ins_Melodic = bank.Ins_Melodic_box.data();
-
     return FfmtErrCode::ERR_OK;
 }
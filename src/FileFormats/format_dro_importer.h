@@ -21,6 +21,7 @@
 
 #include "ffmt_base.h"
 class QFile;
+class OplRegStreamSink;
 
 /**
  * @brief Import FM instruments from DOSBox Raw OPL format
@@ -36,9 +37,17 @@ public:
     QString     formatExtensionMask() const override;
     BankFormats formatId() const override;
 
+    /**
+     * @brief Replays the register writes of the file
+     * @param filePath Path to the DRO file
+     * @param sink Receiver of the writes; chip 1 is the second chip of dual OPL2
+     * @return Error code
+     */
+    static FfmtErrCode loadRegisters(const QString &filePath, OplRegStreamSink &sink);
+
 private:
-    FfmtErrCode loadFileV1(QFile &file, FmBank &bank);
-    FfmtErrCode loadFileV2(QFile &file, FmBank &bank);
+    static FfmtErrCode loadFileV1(QFile &file, OplRegStreamSink &sink);
+    static FfmtErrCode loadFileV2(QFile &file, OplRegStreamSink &sink);
 };
 
 #endif // FORMAT_DRO_IMPORTER_H
@@ -17,6 +17,7 @@
  */
 
 #include "format_vgm_import.h"
+#include "opl_reg_stream.h"
 #include "ymf262_to_wopi.h"
 #include "../common.h"
 
@@ -55,7 +56,65 @@ bool VGM_Importer::detect(const QString &filePath, char *magic)
     return false;
 }
 
+namespace {
+
+// Collects the instruments out of the register writes
+class VgmInstrumentCatcher : public OplRegStreamSink
+{
+public:
+    VgmInstrumentCatcher()
+    {
+        m_opl3.shareInstruments(m_opl2);
+    }
+
+    void passReg(unsigned chip, uint16_t addr, uint8_t val) override
+    {
+        if(chip == 0)
+            m_opl2.passReg(addr, val);
+        else
+            m_opl3.passReg(addr, val);
+    }
+
+    void passDelay(uint32_t amount, uint32_t rate) override
+    {
+        Q_UNUSED(amount);
+        Q_UNUSED(rate);
+        m_opl2.doAnalyzeState();
+        m_opl3.doAnalyzeState();
+    }
+
+    const QList<FmBank::Instrument> &caughtInstruments()
+    {
+        return m_opl2.caughtInstruments();
+    }
+
+private:
+    RawYmf262ToWopi m_opl2;
+    RawYmf262ToWopi m_opl3;
+};
+
+} // namespace
+
 FfmtErrCode VGM_Importer::loadFile(QString filePath, FmBank &bank)
+{
+    bank.reset();
+
+    VgmInstrumentCatcher catcher;
+    FfmtErrCode err = loadRegisters(filePath, catcher);
+    if(err != FfmtErrCode::ERR_OK)
+        return err;
+
+    bank.Ins_Melodic_box.clear();
+    const QList<FmBank::Instrument> &insts = catcher.caughtInstruments();
+    bank.Ins_Melodic_box.reserve(insts.size());
+    for(const FmBank::Instrument &inst : insts)
+        bank.Ins_Melodic_box.push_back(inst);
+    bank.Ins_Melodic = bank.Ins_Melodic_box.data();
+
+    return FfmtErrCode::ERR_OK;
+}
+
+FfmtErrCode VGM_Importer::loadRegisters(const QString &filePath, OplRegStreamSink &sink)
 {
     QFile file(filePath);
     if(!file.open(QIODevice::ReadOnly))
@@ -68,7 +127,7 @@ FfmtErrCode VGM_Importer::loadFile(QString filePath, FmBank &bank)
     if(memcmp(magic_vgm, magic, 4) == 0)
     {
         file.seek(0);
-        return load(file, bank);
+        return load(file, sink);
     }
 
     file.close();
@@ -92,22 +151,17 @@ FfmtErrCode VGM_Importer::loadFile(QString filePath, FmBank &bank)
         gzclose(vgz);
 
         buffer.open(QIODevice::ReadOnly);
-        return load(buffer, bank);
+        return load(buffer, sink);
     }
 
     return FfmtErrCode::ERR_BADFORMAT;
 }
 
-FfmtErrCode VGM_Importer::load(QIODevice &file, FmBank &bank)
+FfmtErrCode VGM_Importer::load(QIODevice &file, OplRegStreamSink &sink)
 {
-    RawYmf262ToWopi pseudoOpl2;
-    RawYmf262ToWopi pseudoOpl3;
-    pseudoOpl3.shareInstruments(pseudoOpl2);
-
     char    magic[4];
     uint8_t numb[4];
 
-    bank.reset();
     if(file.read(magic, 4) != 4)
         return FfmtErrCode::ERR_BADFORMAT;
 
@@ -131,8 +185,6 @@ FfmtErrCode VGM_Importer::load(QIODevice &file, FmBank &bank)
     }
     file.seek(0x34 + data_offset);
 
-    bank.Ins_Melodic_box.clear();
-
     uint32_t pcm_offset = 0;
     bool end = false;
     while(!end && !file.atEnd())
@@ -158,7 +210,7 @@ FfmtErrCode VGM_Importer::load(QIODevice &file, FmBank &bank)
         case 0x5a: // YM3812, write value dd to register aa
             file.read(char_p(&reg), 1);
             file.read(char_p(&val), 1);
-            pseudoOpl2.passReg(reg, val);
+            sink.passReg(0, reg, val);
             break;
 
         case 0x5e:   // YMF262 port 0, write value dd to register aa
@@ -167,7 +219,7 @@ FfmtErrCode VGM_Importer::load(QIODevice &file, FmBank &bank)
             file.read(char_p(&val), 1);
             uint16_t regopl3 = reg;
             if(cmd == 0x5f) regopl3 |= 0x100u;
-            pseudoOpl3.passReg(regopl3, val);
+            sink.passReg(1, regopl3, val);
             break;
         }
 
@@ -189,12 +241,22 @@ FfmtErrCode VGM_Importer::load(QIODevice &file, FmBank &bank)
         case 0x7C:
         case 0x7D:
         case 0x7E:
-        case 0x7F:
+        case 0x7F: {
+            uint32_t wait;
             if(cmd == 0x61)
-                file.seek(file.pos() + 2);
-            pseudoOpl2.doAnalyzeState();
-            pseudoOpl3.doAnalyzeState();
+            {
+                file.read(char_p(numb), 2);
+                wait = numb[0] | (numb[1] << 8);
+            }
+            else if(cmd == 0x62)
+                wait = 735;
+            else if(cmd == 0x63)
+                wait = 882;
+            else
+                wait = (cmd & 0x0F) + 1;
+            sink.passDelay(wait, 44100);
             break;
+        }
 
         case 0x66://End of sound data
             end = 1;
@@ -213,12 +275,6 @@ FfmtErrCode VGM_Importer::load(QIODevice &file, FmBank &bank)
         }
     }
 
-    const QList<FmBank::Instrument> &insts = pseudoOpl2.caughtInstruments();
-    bank.Ins_Melodic_box.reserve(insts.size());
-    for(const FmBank::Instrument &inst : insts)
-        bank.Ins_Melodic_box.push_back(inst);
-    bank.Ins_Melodic = bank.Ins_Melodic_box.data();
-
     return FfmtErrCode::ERR_OK;
 }
 
@@ -22,6 +22,7 @@
 #include "ffmt_base.h"
 
 class QIODevice;
+class OplRegStreamSink;
 
 /**
  * @brief Import from VGM files
@@ -37,8 +38,16 @@ public:
     QString     formatExtensionMask() const override;
     BankFormats formatId() const override;
 
+    /**
+     * @brief Replays the register writes of the file
+     * @param filePath Path to the VGM or VGZ file
+     * @param sink Receiver of the writes; chip 0 is YM3812, chip 1 is YMF262
+     * @return Error code
+     */
+    static FfmtErrCode loadRegisters(const QString &filePath, OplRegStreamSink &sink);
+
 private:
-    FfmtErrCode load(QIODevice &file, FmBank &bank);
+    static FfmtErrCode load(QIODevice &file, OplRegStreamSink &sink);
 };
 
 #endif // VGM_IMPORT_H
@@ -0,0 +1,46 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPL_REG_STREAM_H
+#define OPL_REG_STREAM_H
+
+#include <stdint.h>
+
+/**
+ * @brief Receiver of the register writes of an OPL log file (VGM, DRO)
+ */
+class OplRegStreamSink
+{
+public:
+    virtual ~OplRegStreamSink() {}
+
+    /**
+     * @brief Write of a register
+     * @param chip Index of the chip, as defined by the log format
+     * @param addr Register address, bit 8 selects the second bank of OPL3
+     * @param val Register value
+     */
+    virtual void passReg(unsigned chip, uint16_t addr, uint8_t val) = 0;
+
+    /**
+     * @brief Pause between the writes, of `amount / rate` seconds
+     */
+    virtual void passDelay(uint32_t amount, uint32_t rate) = 0;
+};
+
+#endif // OPL_REG_STREAM_H
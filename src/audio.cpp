@@ -32,10 +32,10 @@ void BankEditor::initAudio()
     qDebug() << "Init audioOut...";
     m_audioOut = new AudioOutDefault(m_audioLatency * 1e-3, m_audioDevice.toStdString(), m_audioDriver.toStdString(), this);
     qDebug() << "Init Generator...";
-    std::shared_ptr<Generator> generator(
-        new Generator(uint32_t(m_audioOut->sampleRate()), m_currentChip));
+    std::unique_ptr<Generator> generator(
+        new Generator(uint32_t(m_audioOut->sampleRate()), m_currentChip, m_chipCount));
     qDebug() << "Init Rt-Generator...";
-    RealtimeGenerator *rtgenerator = new RealtimeGenerator(generator, this);
+    RealtimeGenerator *rtgenerator = new RealtimeGenerator(std::move(generator), m_realtimeSetup, this);
     qDebug() << "Seting pointer of RT Generator...";
     m_generator = rtgenerator;
 
@@ -74,6 +74,7 @@ void BankEditor::initAudio()
     connect(ui->deepVibrato,  SIGNAL(toggled(bool)), m_generator,  SLOT(ctl_changeDeepVibrato(bool)));
     connect(ui->deepTremolo,  SIGNAL(toggled(bool)), m_generator,  SLOT(ctl_changeDeepTremolo(bool)));
     connect(ui->volumeModel,  SIGNAL(currentIndexChanged(int)), m_generator,  SLOT(ctl_changeVolumeModel(int)));
+    m_generator->ctl_changeStealPolicy(m_stealPolicy);
     //Generator's debug info
     connect(m_generator, SIGNAL(debugInfo(QString)), ui->debugBox, SLOT(setText(QString)));
     //Key pressed on piano bar
@@ -94,6 +95,9 @@ void BankEditor::initAudio()
     m_importer->connect(m_importer->ui->testNote,  SIGNAL(pressed()),  m_generator,  SLOT(ctl_playNote()));
     m_importer->connect(m_importer->ui->testNote,  SIGNAL(released()), m_generator,  SLOT(ctl_stopNote()));
 
+    if(m_audioAutoLatency)
+        tuneAudioLatency();
+
     qDebug() << "Trying to start audio... (with dereferencing of RtGenerator!)";
     //Start generator!
     m_audioOut->start(*rtgenerator);
@@ -84,28 +84,84 @@ AudioOutRt::AudioOutRt(double latency, const std::string &device_name, const std
         sampleRate = 44100;
     }
 
-    RtAudio::StreamParameters streamParam;
-    streamParam.deviceId = outputDeviceId;
-    streamParam.nChannels = 2;
+    m_streamParam.deviceId = outputDeviceId;
+    m_streamParam.nChannels = 2;
+    m_sampleRate = sampleRate;
 
+    // render in float unless the device takes 16-bit integers, but not floats
+    m_format = RTAUDIO_FLOAT32;
+    if((deviceInfo.nativeFormats & RTAUDIO_SINT16) && !(deviceInfo.nativeFormats & RTAUDIO_FLOAT32))
+        m_format = RTAUDIO_SINT16;
+    qDebug() << "Sample format" << ((m_format == RTAUDIO_FLOAT32) ? "float32" : "int16");
+
+    openStream(latency);
+}
+
+bool AudioOutRt::openStream(double latency)
+{
     RtAudio::StreamOptions streamOpts;
     streamOpts.flags = RTAUDIO_ALSA_USE_DEFAULT;
     streamOpts.streamName = QCoreApplication::applicationName().toStdString();
 
-    unsigned bufferSize = std::ceil(latency * sampleRate);
+    unsigned bufferSize = std::ceil(latency * m_sampleRate);
     qDebug() << "Desired latency" << latency;
     qDebug() << "Buffer size" << bufferSize;
 
-    audioOut->openStream(
-        &streamParam, nullptr, RTAUDIO_SINT16, sampleRate, &bufferSize,
-        &process, this, &streamOpts, &errorCallback);
+    try {
+        m_audioOut->openStream(
+            &m_streamParam, nullptr, m_format, m_sampleRate, &bufferSize,
+            &process, this, &streamOpts, &errorCallback);
+    }
+    catch (RtAudioError &error) {
+        qWarning() << "Failed to open the audio stream:" << error.what();
+        m_lastError = error.what();
+        return false;
+    }
+
+    // the driver may have chosen another size
+    m_bufferSize = bufferSize;
+    qDebug() << "Buffer size obtained" << bufferSize;
+    return true;
 }
 
 unsigned AudioOutRt::sampleRate() const
 {
+    if(!m_audioOut->isStreamOpen())
+        return m_sampleRate;
     return m_audioOut->getStreamSampleRate();
 }
 
+double AudioOutRt::latency() const
+{
+    return double(m_bufferSize) / m_sampleRate;
+}
+
+bool AudioOutRt::setLatency(double latency)
+{
+    RtAudio *audioOut = m_audioOut.get();
+    const bool running = audioOut->isStreamRunning();
+    const bool wasOpen = audioOut->isStreamOpen();
+    const double previous = this->latency();
+    if(running)
+        audioOut->stopStream();
+    if(wasOpen)
+        audioOut->closeStream();
+
+    bool applied = openStream(latency);
+    if(!applied)
+    {
+        // Keep the sound going with the buffer size it had
+        const std::string error = m_lastError;
+        if(!wasOpen || !openStream(previous))
+            return false;
+        m_lastError = error;
+    }
+
+    if(running)
+        audioOut->startStream();
+    return applied;
+}
+
 void AudioOutRt::start(IRealtimeProcess &rt)
 {
     qDebug() << "Trying to start stream...";
@@ -151,11 +207,16 @@ std::vector<std::string> AudioOutRt::listDrivers()
     return drivers;
 }
 
-int AudioOutRt::process(void *outputbuffer, void *, unsigned nframes, double, RtAudioStreamStatus, void *userdata)
+int AudioOutRt::process(void *outputbuffer, void *, unsigned nframes, double, RtAudioStreamStatus status, void *userdata)
 {
     AudioOutRt *self = (AudioOutRt *)userdata;
     IRealtimeProcess &rt = *self->m_rt;
-    rt.rt_generate((int16_t *)outputbuffer, nframes);
+    if(status & RTAUDIO_OUTPUT_UNDERFLOW)
+        rt.rt_underflow();
+    if(self->m_format == RTAUDIO_FLOAT32)
+        rt.rt_generateFloat((float *)outputbuffer, nframes);
+    else
+        rt.rt_generate((int16_t *)outputbuffer, nframes);
     return 0;
 }
 
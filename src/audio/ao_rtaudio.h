@@ -30,6 +30,18 @@ public:
                         const std::string &driver_name = std::string(),
                         QObject *parent = nullptr);
     unsigned sampleRate() const;
+    //! Latency of the stream, in seconds
+    double latency() const;
+    /**
+     * @brief Opens the stream again with another buffer size
+     * A running stream is stopped and started again with the new size.
+     * If the new size is refused, the stream is opened again with the
+     * previous one.
+     * @return The new size was applied, otherwise see lastError()
+     */
+    bool setLatency(double latency);
+    //! Message of the last failure to open the stream
+    const std::string &lastError() const { return m_lastError; }
     void start(IRealtimeProcess &rt);
     void stop();
     std::vector<std::string> listCompatibleDevices();
@@ -38,6 +50,12 @@ private:
     static int process(void *outputbuffer, void *, unsigned nframes, double, RtAudioStreamStatus, void *userdata);
     static void errorCallback(RtAudioError::Type type, const std::string &errorText);
     static bool isCompatibleDevice(const RtAudio::DeviceInfo &info);
+    bool openStream(double latency);
     IRealtimeProcess *m_rt = nullptr;
+    RtAudioFormat m_format = RTAUDIO_SINT16;
+    RtAudio::StreamParameters m_streamParam;
+    unsigned m_sampleRate = 44100;
+    unsigned m_bufferSize = 0;
+    std::string m_lastError;
     std::unique_ptr<RtAudio> m_audioOut;
 };
@@ -0,0 +1,84 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIO_FILE_WRITER_H
+#define AUDIO_FILE_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <QFile>
+#include <QString>
+
+/**
+ * @brief Writes interleaved stereo 16-bit audio into a file
+ *
+ * The sizes in the headers are only known at the end, they get written
+ * by close(). A file which was not closed is incomplete.
+ */
+class AudioFileWriter
+{
+public:
+    enum Format
+    {
+        //! RIFF WAVE, PCM
+        FORMAT_WAV = 0,
+        //! FLAC, lossless, built-in encoder with fixed predictors
+        FORMAT_FLAC,
+        FORMAT_END
+    };
+
+    static std::unique_ptr<AudioFileWriter> create(Format format);
+
+    /**
+     * @brief Format by the extension of the file name
+     * @return false if the extension is not one of a known format
+     */
+    static bool formatFromFileName(const QString &fileName, Format &format);
+    static const char *formatExtension(Format format);
+
+    virtual ~AudioFileWriter();
+
+    bool open(const QString &path, uint32_t sampleRate);
+    bool write(const int16_t *frames, size_t nframes);
+    bool close();
+
+    uint64_t framesWritten() const
+        { return m_frames; }
+    const QString &errorString() const
+        { return m_error; }
+
+protected:
+    AudioFileWriter();
+
+    //! Writes the header with the sizes unknown yet
+    virtual bool beginStream() = 0;
+    virtual bool writeFrames(const int16_t *frames, size_t nframes) = 0;
+    //! Writes the pending data and fills the sizes in the header
+    virtual bool endStream() = 0;
+
+    bool writeBytes(const void *data, size_t size);
+    bool writeBytesAt(int64_t pos, const void *data, size_t size);
+
+    QFile       m_file;
+    uint32_t    m_rate = 44100;
+    uint64_t    m_frames = 0;
+    QString     m_error;
+};
+
+#endif // AUDIO_FILE_WRITER_H
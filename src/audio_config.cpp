@@ -34,6 +34,7 @@ AudioConfigDialog::AudioConfigDialog(AudioOutRt *audioOut, QWidget *parent)
     m_ui->ctlLatency->setRange(
         BankEditor::audioMinimumLatency, BankEditor::audioMaximumLatency);
     m_ui->ctlLatencyEdit->setText(QString::number(m_ui->ctlLatency->value()));
+    m_ui->ctlChipCount->setRange(1, MAX_OPLGEN_CHIPS);
 
     adjustSize();
     setFixedSize(size());
@@ -53,6 +54,17 @@ void AudioConfigDialog::setLatency(double lat)
     m_ui->ctlLatency->setValue(lat);
 }
 
+bool AudioConfigDialog::autoLatency() const
+{
+    return m_ui->ctlAutoLatency->isChecked();
+}
+
+void AudioConfigDialog::setAutoLatency(bool enabled)
+{
+    m_ui->ctlAutoLatency->setChecked(enabled);
+    on_ctlAutoLatency_toggled(enabled);
+}
+
 QString AudioConfigDialog::deviceName() const
 {
     return m_ui->ctlDeviceNameEdit->text();
@@ -73,6 +85,26 @@ void AudioConfigDialog::setDriverName(const QString &driverName)
     m_ui->ctlDriverNameEdit->setText(driverName);
 }
 
+unsigned AudioConfigDialog::chipCount() const
+{
+    return (unsigned)m_ui->ctlChipCount->value();
+}
+
+void AudioConfigDialog::setChipCount(unsigned count)
+{
+    m_ui->ctlChipCount->setValue((int)count);
+}
+
+int AudioConfigDialog::stealPolicy() const
+{
+    return m_ui->ctlStealPolicy->currentIndex();
+}
+
+void AudioConfigDialog::setStealPolicy(int policy)
+{
+    m_ui->ctlStealPolicy->setCurrentIndex(policy);
+}
+
 void AudioConfigDialog::on_ctlLatency_valueChanged(int value)
 {
     m_ui->ctlLatencyEdit->setText(QString::number(value));
@@ -84,6 +116,12 @@ void AudioConfigDialog::on_ctlLatencyEdit_editingFinished()
     m_ui->ctlLatencyEdit->setText(QString::number(m_ui->ctlLatency->value()));
 }
 
+void AudioConfigDialog::on_ctlAutoLatency_toggled(bool checked)
+{
+    m_ui->ctlLatency->setEnabled(!checked);
+    m_ui->ctlLatencyEdit->setEnabled(!checked);
+}
+
 void AudioConfigDialog::on_btnChooseDevice_clicked()
 {
     QToolButton *button = m_ui->btnChooseDevice;
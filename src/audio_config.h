@@ -35,12 +35,21 @@ public:
     double latency() const;
     void setLatency(double lat);
 
+    bool autoLatency() const;
+    void setAutoLatency(bool enabled);
+
     QString deviceName() const;
     void setDeviceName(const QString &deviceName);
 
     QString driverName() const;
     void setDriverName(const QString &driverName);
 
+    unsigned chipCount() const;
+    void setChipCount(unsigned count);
+
+    int stealPolicy() const;
+    void setStealPolicy(int policy);
+
 private:
     AudioOutRt *m_audioOut = nullptr;
     std::unique_ptr<Ui::AudioConfigDialog> m_ui;
@@ -48,6 +57,7 @@ private:
 private slots:
     void on_ctlLatency_valueChanged(int value);
     void on_ctlLatencyEdit_editingFinished();
+    void on_ctlAutoLatency_toggled(bool checked);
     void on_btnChooseDevice_clicked();
     void on_btnChooseDriver_clicked();
 };
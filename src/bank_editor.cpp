@@ -25,6 +25,9 @@
 #include <QMimeData>
 #include <QClipboard>
 #include <QActionGroup>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
 #include <QtDebug>
 
 #include "importer.h"
@@ -37,6 +40,10 @@
 #include "hardware.h"
 #include "ins_names.h"
 #include "main.h"
+#include "opl/bank_renderer.h"
+#include "opl/latency_tuner.h"
+#include "opl/midi_sequencer.h"
+#include "midi/midi_file.h"
 #if defined(ENABLE_PLOTS)
 #include "delay_analysis.h"
 #endif
@@ -127,11 +134,13 @@ BankEditor::BankEditor(QWidget *parent) :
     m_measurer = new Measurer(this);
     connect(ui->actionImport, SIGNAL(triggered()), m_importer, SLOT(show()));
     connect(ui->actionEmulatorNuked, SIGNAL(triggered()), this, SLOT(toggleEmulator()));
+    connect(ui->actionEmulatorNukedSIMD, SIGNAL(triggered()), this, SLOT(toggleEmulator()));
     connect(ui->actionEmulatorDosBox, SIGNAL(triggered()), this, SLOT(toggleEmulator()));
     connect(ui->actionEmulatorOpal, SIGNAL(triggered()), this, SLOT(toggleEmulator()));
     connect(ui->actionEmulatorJava, SIGNAL(triggered()), this, SLOT(toggleEmulator()));
     connect(ui->actionWin9xOPLProxy, SIGNAL(triggered()), this, SLOT(toggleEmulator()));
     connect(ui->actionSerialPortOPL, SIGNAL(triggered()), this, SLOT(toggleEmulator()));
+    connect(&m_latencyTuner, SIGNAL(finished()), this, SLOT(applyTunedLatency()));
 
 #ifdef ENABLE_HW_OPL_PROXY
     m_proxyOpl = &Generator::oplProxy();
@@ -195,6 +204,7 @@ BankEditor::BankEditor(QWidget *parent) :
 
 BankEditor::~BankEditor()
 {
+    m_latencyTuner.waitForFinished();
     if (m_audioOut)
         m_audioOut->stop();
     delete m_audioOut;
@@ -236,8 +246,13 @@ void BankEditor::loadSettings()
     }
     m_language = setup.value("language").toString();
     m_audioLatency = setup.value("audio-latency", audioDefaultLatency).toDouble();
+    m_audioAutoLatency = setup.value("audio-auto-latency", false).toBool();
     m_audioDevice = setup.value("audio-device", QString()).toString();
     m_audioDriver = setup.value("audio-driver", QString()).toString();
+    m_chipCount = setup.value("chip-count", 1u).toUInt();
+    m_stealPolicy = setup.value("voice-steal-policy", 0).toInt();
+    m_realtimeSetup.controlCapacity = setup.value("realtime-control-queue", m_realtimeSetup.controlCapacity).toUInt();
+    m_realtimeSetup.midiCapacity = setup.value("realtime-midi-queue", m_realtimeSetup.midiCapacity).toUInt();
 
 #ifdef ENABLE_HW_OPL_PROXY
     m_proxyOplAddress = setup.value("hw-opl-address", 0x388).toUInt();
@@ -264,7 +279,19 @@ void BankEditor::loadSettings()
     else if (m_audioLatency > audioMaximumLatency)
         m_audioLatency = audioMaximumLatency;
 
+    if(m_chipCount < 1)
+        m_chipCount = 1;
+    else if(m_chipCount > MAX_OPLGEN_CHIPS)
+        m_chipCount = MAX_OPLGEN_CHIPS;
+
+    if(m_stealPolicy < 0 || m_stealPolicy >= VoiceAllocator::STEAL_END)
+        m_stealPolicy = VoiceAllocator::STEAL_OLDEST;
+
+    m_realtimeSetup.controlCapacity = qBound<unsigned>(realtimeMinimumQueue, m_realtimeSetup.controlCapacity, realtimeMaximumQueue);
+    m_realtimeSetup.midiCapacity = qBound<unsigned>(realtimeMinimumQueue, m_realtimeSetup.midiCapacity, realtimeMaximumQueue);
+
     ui->actionEmulatorNuked->setChecked(false);
+    ui->actionEmulatorNukedSIMD->setChecked(false);
     ui->actionEmulatorDosBox->setChecked(false);
     ui->actionEmulatorOpal->setChecked(false);
     ui->actionEmulatorJava->setChecked(false);
@@ -277,6 +304,9 @@ void BankEditor::loadSettings()
     case Generator::CHIP_Nuked:
         ui->actionEmulatorNuked->setChecked(true);
         break;
+    case Generator::CHIP_NukedSIMD:
+        ui->actionEmulatorNukedSIMD->setChecked(true);
+        break;
     case Generator::CHIP_DosBox:
         ui->actionEmulatorDosBox->setChecked(true);
         break;
@@ -322,8 +352,13 @@ void BankEditor::saveSettings()
     setup.setValue("chip-emulator", (int)m_currentChip);
     setup.setValue("language", m_language);
     setup.setValue("audio-latency", m_audioLatency);
+    setup.setValue("audio-auto-latency", m_audioAutoLatency);
     setup.setValue("audio-device", m_audioDevice);
     setup.setValue("audio-driver", m_audioDriver);
+    setup.setValue("chip-count", m_chipCount);
+    setup.setValue("voice-steal-policy", m_stealPolicy);
+    setup.setValue("realtime-control-queue", m_realtimeSetup.controlCapacity);
+    setup.setValue("realtime-midi-queue", m_realtimeSetup.midiCapacity);
 
 #ifdef ENABLE_HW_OPL_PROXY
     setup.setValue("hw-opl-address", m_proxyOplAddress);
@@ -862,6 +897,140 @@ void BankEditor::on_actionSaveInstrument_triggered()
     saveInstFileAs();
 }
 
+void BankEditor::on_actionExportAudio_triggered()
+{
+    QStringList formats;
+    formats << tr("WAV (*.wav)") << tr("FLAC (*.flac)");
+    bool ok = false;
+    QString format = QInputDialog::getItem(this, tr("Export bank audio"),
+                                           tr("Every instrument gets rendered into its own file.\n"
+                                              "Audio format:"),
+                                           formats, 0, false, &ok);
+    if(!ok)
+        return;
+
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Export bank audio into"), m_recentPath);
+    if(dir.isEmpty())
+        return;
+
+    BankRenderer::Setup setup;
+    setup.chip = m_currentChip;
+    setup.format = (formats.indexOf(format) == 1) ? AudioFileWriter::FORMAT_FLAC : AudioFileWriter::FORMAT_WAV;
+    BankRenderer::applyBankSetup(m_bank, setup);
+
+    QVector<BankRenderer::Task> tasks = BankRenderer::makeTasks(m_bank, dir, setup);
+    if(tasks.isEmpty())
+    {
+        QMessageBox::information(this, tr("Nothing to export"), tr("All instruments of the bank are blank."));
+        return;
+    }
+
+    QProgressDialog progressBox(this);
+    progressBox.setWindowModality(Qt::WindowModal);
+    progressBox.setWindowTitle(tr("Export bank audio"));
+    progressBox.setLabelText(tr("Rendering %1 instruments...").arg(tasks.size()));
+
+    QFutureWatcher<void> watcher;
+    watcher.connect(&progressBox, SIGNAL(canceled()), &watcher, SLOT(cancel()));
+    watcher.connect(&watcher, SIGNAL(progressRangeChanged(int,int)), &progressBox, SLOT(setRange(int,int)));
+    watcher.connect(&watcher, SIGNAL(progressValueChanged(int)), &progressBox, SLOT(setValue(int)));
+    watcher.connect(&watcher, SIGNAL(finished()), &progressBox, SLOT(accept()));
+
+    watcher.setFuture(BankRenderer::start(tasks));
+
+    progressBox.exec();
+    watcher.waitForFinished();
+
+    if(watcher.isCanceled())
+    {
+        statusBar()->showMessage(tr("Export of the bank audio was canceled!"), 5000);
+        return;
+    }
+
+    QStringList errors;
+    for(const BankRenderer::Task &task : tasks)
+    {
+        if(!task.ok)
+            errors << QString("%1: %2").arg(QDir::toNativeSeparators(task.path)).arg(task.error);
+    }
+
+    if(!errors.isEmpty())
+    {
+        QMessageBox::warning(this, tr("Export bank audio"),
+                             tr("%1 of %2 files could not be written:\n%3")
+                             .arg(errors.size()).arg(tasks.size()).arg(errors.mid(0, 10).join("\n")));
+        return;
+    }
+
+    statusBar()->showMessage(tr("%1 audio files have been exported!").arg(tasks.size()), 5000);
+}
+
+void BankEditor::on_actionPlayMidiFile_triggered(bool checked)
+{
+    if(!m_generator)
+        return;
+
+    if(!checked)
+    {
+        m_generator->ctl_stopSong();
+        return;
+    }
+
+    QString fileToOpen = QFileDialog::getOpenFileName(this, tr("Play MIDI file"), m_recentPath,
+                                                      tr("MIDI files (*.mid *.midi *.smf *.kar);;All files (*.*)"),
+                                                      nullptr, FILE_OPEN_DIALOG_OPTIONS);
+    if(fileToOpen.isEmpty())
+    {
+        ui->actionPlayMidiFile->setChecked(false);
+        return;
+    }
+
+    MidiFile midi;
+    QString error;
+    if(!midi.load(fileToOpen, &error))
+    {
+        ui->actionPlayMidiFile->setChecked(false);
+        QMessageBox::warning(this, tr("Can't play the MIDI file"), error);
+        return;
+    }
+
+    std::unique_ptr<MidiSequencer> song(new MidiSequencer(midi, uint32_t(m_audioOut->sampleRate())));
+    // Percussion plays the notes of its key on the drum channel
+    if(ui->percussion->isChecked())
+    {
+        song->setChannelMask(MidiSequencer::DrumChannels);
+        song->setKeyFilter(m_recentNum % 128);
+    }
+    m_generator->ctl_playSong(std::move(song));
+    statusBar()->showMessage(tr("Playing %1").arg(QFileInfo(fileToOpen).fileName()), 5000);
+}
+
+void BankEditor::on_actionSaveAudioStats_triggered()
+{
+    if(!m_generator)
+        return;
+
+    QString fileToSave = QFileDialog::getSaveFileName(this, tr("Save audio statistics"), m_recentPath,
+                                                      tr("CSV files (*.csv)"),
+                                                      nullptr, FILE_OPEN_DIALOG_OPTIONS);
+    if(fileToSave.isEmpty())
+        return;
+
+    QString error;
+    if(!m_generator->ctl_saveStats(fileToSave, &error))
+    {
+        QMessageBox::warning(this, tr("Can't save the audio statistics"), error);
+        return;
+    }
+    statusBar()->showMessage(tr("Audio statistics have been saved!"), 5000);
+}
+
+void BankEditor::on_actionResetAudioStats_triggered()
+{
+    if(m_generator)
+        m_generator->ctl_resetStats();
+}
+
 void BankEditor::on_actionExit_triggered()
 {
     this->close();
@@ -1138,6 +1307,7 @@ void BankEditor::toggleEmulator()
 {
     QObject *menuItem = sender();
     ui->actionEmulatorNuked->setChecked(false);
+    ui->actionEmulatorNukedSIMD->setChecked(false);
     ui->actionEmulatorDosBox->setChecked(false);
     ui->actionEmulatorOpal->setChecked(false);
     ui->actionEmulatorJava->setChecked(false);
@@ -1151,6 +1321,13 @@ void BankEditor::toggleEmulator()
         m_generator->ctl_switchChip(m_currentChip);
     }
     else
+    if(menuItem == ui->actionEmulatorNukedSIMD)
+    {
+        ui->actionEmulatorNukedSIMD->setChecked(true);
+        m_currentChip = Generator::CHIP_NukedSIMD;
+        m_generator->ctl_switchChip(m_currentChip);
+    }
+    else
     if(menuItem == ui->actionEmulatorDosBox)
     {
         ui->actionEmulatorDosBox->setChecked(true);
@@ -1185,6 +1362,9 @@ void BankEditor::toggleEmulator()
         m_currentChip = Generator::CHIP_SerialPort;
         m_generator->ctl_switchChip(m_currentChip);
     }
+
+    if(m_audioAutoLatency)
+        tuneAudioLatency();
 }
 
 
@@ -1422,14 +1602,92 @@ void BankEditor::on_actionAudioConfig_triggered()
 {
     AudioConfigDialog dlg(m_audioOut, this);
     dlg.setLatency(m_audioLatency);
+    dlg.setAutoLatency(m_audioAutoLatency);
     dlg.setDeviceName(m_audioDevice);
     dlg.setDriverName(m_audioDriver);
+    dlg.setChipCount(m_chipCount);
+    dlg.setStealPolicy(m_stealPolicy);
     if(dlg.exec() == QDialog::Accepted)
     {
+        const double oldLatency = m_audioLatency;
+        const bool oldAutoLatency = m_audioAutoLatency;
         m_audioLatency = dlg.latency();
+        m_audioAutoLatency = dlg.autoLatency();
         m_audioDevice = dlg.deviceName();
         m_audioDriver = dlg.driverName();
+        m_chipCount = dlg.chipCount();
+        m_stealPolicy = dlg.stealPolicy();
+        m_generator->ctl_changeStealPolicy(m_stealPolicy);
+
+        if(m_audioAutoLatency)
+            tuneAudioLatency(!oldAutoLatency);
+        else if(oldAutoLatency || m_audioLatency != oldLatency)
+            setAudioLatency(m_audioLatency * 1e-3);
+    }
+}
+
+void BankEditor::tuneAudioLatency(bool force)
+{
+    // The measure takes a fraction of a second, only worth it for a new setup
+    if(!force && m_tunedChip == m_currentChip && m_tunedChipCount == m_chipCount)
+        return;
+    m_tunedChip = m_currentChip;
+    m_tunedChipCount = m_chipCount;
+
+    // One measure at a time, the new setup gets its turn after this one
+    if(m_latencyTuner.isRunning())
+    {
+        m_latencyRetune = true;
+        return;
     }
+    m_latencyRetune = false;
+
+    LatencyTuner::Setup setup;
+    setup.rate = m_audioOut->sampleRate();
+    setup.chip = m_currentChip;
+    setup.chipCount = m_chipCount;
+    setup.minLatency = audioMinimumLatency * 1e-3;
+    setup.maxLatency = audioMaximumLatency * 1e-3;
+    m_latencyTuner.setFuture(QtConcurrent::run(&LatencyTuner::tune, setup));
+}
+
+void BankEditor::applyTunedLatency()
+{
+    // Switched to a fixed latency meanwhile
+    if(!m_audioAutoLatency)
+    {
+        m_latencyRetune = false;
+        return;
+    }
+
+    if(m_latencyRetune)
+    {
+        tuneAudioLatency(true);
+        return;
+    }
+
+    const double latency = m_latencyTuner.result();
+
+    // The driver rounds the buffer size, only reopen the stream when the
+    // buffer is too short, or much longer than needed
+    const double current = m_audioOut->latency();
+    if((latency > current || latency < current * 0.75) && !setAudioLatency(latency))
+    {
+        m_tunedChipCount = 0; // Try again on the next change
+        return;
+    }
+
+    statusBar()->showMessage(tr("Audio latency: %1 ms").arg(m_audioOut->latency() * 1e3, 0, 'f', 1), 5000);
+}
+
+bool BankEditor::setAudioLatency(double latency)
+{
+    if(m_audioOut->setLatency(latency))
+        return true;
+
+    statusBar()->showMessage(tr("Failed to change the audio latency: %1")
+                             .arg(QString::fromStdString(m_audioOut->lastError())), 10000);
+    return false;
 }
 
 #if defined(ENABLE_HW_OPL_PROXY) || defined(ENABLE_HW_OPL_SERIAL_PORT)
@@ -1459,26 +1717,31 @@ void BankEditor::on_actionHardware_OPL_triggered()
 
     bool mustReinitialize = false;
 
-#if defined(ENABLE_HW_OPL_PROXY)
-    if(supportsChangeAddress)
     {
-        unsigned newAddress = dlg->oplAddress();
-        if(newAddress != m_proxyOplAddress)
+        // The audio thread may be playing on the hardware
+        QMutexLocker hardwareLock(&Generator::hardwareMutex());
+
+#if defined(ENABLE_HW_OPL_PROXY)
+        if(supportsChangeAddress)
         {
-            proxy.setOplAddress(newAddress);
-            m_proxyOplAddress = newAddress;
-            mustReinitialize = true;
+            unsigned newAddress = dlg->oplAddress();
+            if(newAddress != m_proxyOplAddress)
+            {
+                proxy.setOplAddress(newAddress);
+                m_proxyOplAddress = newAddress;
+                mustReinitialize = true;
+            }
         }
-    }
 #endif
 
 #if defined(ENABLE_HW_OPL_SERIAL_PORT)
-    m_serialPortName = dlg->serialPortName();
-    m_serialPortBaudRate = dlg->serialBaudRate();
-    m_serialPortProtocol = dlg->serialProtocol();
-    serial.connectPort(m_serialPortName, m_serialPortBaudRate, m_serialPortProtocol);
-    mustReinitialize = true;
+        m_serialPortName = dlg->serialPortName();
+        m_serialPortBaudRate = dlg->serialBaudRate();
+        m_serialPortProtocol = dlg->serialProtocol();
+        serial.connectPort(m_serialPortName, m_serialPortBaudRate, m_serialPortProtocol);
+        mustReinitialize = true;
 #endif
+    }
 
     if(mustReinitialize)
     {
@@ -20,6 +20,7 @@
 #define BANK_EDITOR_H
 
 #include <QTimer>
+#include <QFutureWatcher>
 #include <QMainWindow>
 #include <QList>
 #include <QListWidgetItem>
@@ -70,10 +71,25 @@ private:
     Generator::OPL_Chips m_currentChip;
     //! Audio latency (ms)
     double m_audioLatency;
+    //! Pick the latency from the cost of the emulator, instead of m_audioLatency
+    bool m_audioAutoLatency;
+    //! Emulator and number of chips the latency was last tuned for
+    Generator::OPL_Chips m_tunedChip = Generator::CHIP_END;
+    unsigned m_tunedChipCount = 0;
+    //! Latency measured off the GUI thread
+    QFutureWatcher<double> m_latencyTuner;
+    //! The setup changed during the measure, its result is outdated
+    bool m_latencyRetune = false;
     //! Name of the audio device
     QString m_audioDevice;
     //! Name of the audio driver
     QString m_audioDriver;
+    //! Number of emulated chips
+    unsigned m_chipCount;
+    //! Choice of the note replaced when all voices are busy
+    int m_stealPolicy;
+    //! Capacities of the queues to the audio thread
+    RealtimeGenerator::Setup m_realtimeSetup;
 
 public:
     //! Audio latency constants (ms)
@@ -84,6 +100,13 @@ public:
         audioMaximumLatency = 100,
     };
 
+    //! Capacity limits of the realtime queues (bytes)
+    enum
+    {
+        realtimeMinimumQueue = 1024,
+        realtimeMaximumQueue = 1024 * 1024,
+    };
+
 private:
     //! Currently loaded FM bank
     FmBank              m_bank;
@@ -146,6 +169,20 @@ private:
      */
     void initAudio();
 
+    /*!
+     * \brief Measures the current emulator in the background, then reopens
+     *        the audio output with the latency picked for it
+     * \param force Measure again even if the emulator and the number of chips are unchanged
+     */
+    void tuneAudioLatency(bool force = false);
+
+    /*!
+     * \brief Changes the latency of the audio output, reports a failure in the status bar
+     * \param latency Latency in seconds
+     * \return The latency was applied
+     */
+    bool setAudioLatency(double latency);
+
     #ifdef ENABLE_MIDI
     /*!
      * \brief Updates the available choices of MIDI inputs
@@ -343,6 +380,11 @@ private slots:
      */
     void toggleEmulator();
 
+    /**
+     * @brief Applies the latency picked by the last measure of the emulator
+     */
+    void applyTunedLatency();
+
     /**
      * @brief Clear all buffers and begin a new bank
      */
@@ -363,6 +405,22 @@ private slots:
      * @brief Save current instrument into the file
      */
     void on_actionSaveInstrument_triggered();
+    /**
+     * @brief Render every instrument of the bank into audio files
+     */
+    void on_actionExportAudio_triggered();
+    /**
+     * @brief Play a MIDI file with the current instrument, or stop playing it
+     */
+    void on_actionPlayMidiFile_triggered(bool checked);
+    /**
+     * @brief Save the timing statistics of the audio blocks into a CSV file
+     */
+    void on_actionSaveAudioStats_triggered();
+    /**
+     * @brief Forget the timing statistics of the audio blocks
+     */
+    void on_actionResetAudioStats_triggered();
     /**
      * @brief Exit from the program
      */
@@ -0,0 +1,320 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "midi_file.h"
+#include <QFile>
+#include <QObject>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+//! Event of a track, before the tempo map is applied
+struct TrackEvent
+{
+    uint64_t tick;
+    //! Microseconds per quarter note, for the tempo events
+    uint32_t tempo;
+    bool isTempo;
+    uint8_t data[3];
+    uint8_t size;
+};
+
+bool tickEarlier(const TrackEvent &a, const TrackEvent &b)
+{
+    return a.tick < b.tick;
+}
+
+class ByteReader
+{
+public:
+    ByteReader(const uint8_t *data, size_t size) :
+        m_data(data), m_size(size)
+    {}
+
+    bool atEnd() const
+        { return m_pos >= m_size; }
+    size_t left() const
+        { return m_size - m_pos; }
+
+    bool byte(uint8_t &out)
+    {
+        if(m_pos >= m_size)
+            return false;
+        out = m_data[m_pos++];
+        return true;
+    }
+
+    bool skip(size_t count)
+    {
+        if(count > left())
+            return false;
+        m_pos += count;
+        return true;
+    }
+
+    //! Variable length quantity, at most 4 bytes
+    bool vlq(uint32_t &out)
+    {
+        out = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            uint8_t b;
+            if(!byte(b))
+                return false;
+            out = (out << 7) | (b & 0x7f);
+            if(!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    const uint8_t *current() const
+        { return m_data + m_pos; }
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+};
+
+uint32_t readBE(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for(int i = 0; i < bytes; ++i)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+bool parseTrack(ByteReader &in, std::vector<TrackEvent> &events, uint64_t &endTick)
+{
+    uint64_t tick = 0;
+    uint8_t status = 0;
+
+    while(!in.atEnd())
+    {
+        uint32_t delta;
+        if(!in.vlq(delta))
+            return false;
+        tick += delta;
+
+        uint8_t b;
+        if(!in.byte(b))
+            return false;
+
+        if(b == 0xF0 || b == 0xF7)
+        {
+            // System exclusive, not used by the generator
+            uint32_t len;
+            if(!in.vlq(len) || !in.skip(len))
+                return false;
+            status = 0;
+            continue;
+        }
+
+        if(b == 0xFF)
+        {
+            uint8_t type;
+            uint32_t len;
+            if(!in.byte(type) || !in.vlq(len) || len > in.left())
+                return false;
+            if(type == 0x51 && len == 3)
+            {
+                TrackEvent e = TrackEvent();
+                e.tick = tick;
+                e.tempo = readBE(in.current(), 3);
+                e.isTempo = true;
+                if(e.tempo > 0)
+                    events.push_back(e);
+            }
+            in.skip(len);
+            if(type == 0x2F) // End of track
+                break;
+            continue;
+        }
+
+        TrackEvent e = TrackEvent();
+        e.tick = tick;
+        if(b & 0x80)
+        {
+            // System common and realtime messages don't belong to a file
+            if(b >= 0xF0)
+                return false;
+            status = b;
+            if(!in.byte(e.data[1]))
+                return false;
+        }
+        else
+        {
+            // Running status
+            if(status == 0)
+                return false;
+            e.data[1] = b;
+        }
+        e.data[0] = status;
+
+        switch(status >> 4)
+        {
+        case 0xC: // Program change
+        case 0xD: // Channel pressure
+            e.size = 2;
+            break;
+        default:
+            if(!in.byte(e.data[2]))
+                return false;
+            e.size = 3;
+            break;
+        }
+        events.push_back(e);
+    }
+
+    endTick = tick;
+    return true;
+}
+
+} // namespace
+
+bool MidiFile::load(const QString &path, QString *error)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        if(error)
+            *error = QObject::tr("Could not open the file: %1").arg(file.errorString());
+        return false;
+    }
+    return parse(file.readAll(), error);
+}
+
+bool MidiFile::parse(const QByteArray &data, QString *error)
+{
+    m_events.clear();
+    m_duration = 0;
+    m_format = 0;
+    m_tracks = 0;
+
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data.constData());
+    const size_t size = static_cast<size_t>(data.size());
+
+    if(size < 14 || memcmp(bytes, "MThd", 4) != 0 || readBE(bytes + 4, 4) < 6)
+    {
+        if(error)
+            *error = QObject::tr("This is not a Standard MIDI File.");
+        return false;
+    }
+
+    const int format = static_cast<int>(readBE(bytes + 8, 2));
+    const int tracks = static_cast<int>(readBE(bytes + 10, 2));
+    const uint32_t division = readBE(bytes + 12, 2);
+    if(format > 1)
+    {
+        if(error)
+            *error = QObject::tr("MIDI files of type %1 are not supported.").arg(format);
+        return false;
+    }
+    if(division == 0 || ((division & 0x8000) && (division & 0xFF) == 0))
+    {
+        if(error)
+            *error = QObject::tr("The MIDI file has no time division.");
+        return false;
+    }
+
+    std::vector<TrackEvent> events;
+    uint64_t endTick = 0;
+    int tracksRead = 0;
+    size_t pos = 8 + readBE(bytes + 4, 4);
+    while(tracksRead < tracks && pos + 8 <= size)
+    {
+        const uint8_t *chunk = bytes + pos;
+        // The length of the last chunk is often wrong, read what is there
+        const size_t length = std::min<size_t>(readBE(chunk + 4, 4), size - pos - 8);
+        pos += 8 + length;
+        if(memcmp(chunk, "MTrk", 4) != 0)
+            continue;
+
+        ByteReader in(chunk + 8, length);
+        uint64_t trackEnd = 0;
+        if(!parseTrack(in, events, trackEnd))
+        {
+            if(error)
+                *error = QObject::tr("Track %1 of the MIDI file is damaged.").arg(tracksRead + 1);
+            return false;
+        }
+        endTick = std::max(endTick, trackEnd);
+        ++tracksRead;
+    }
+
+    if(tracksRead == 0)
+    {
+        if(error)
+            *error = QObject::tr("The MIDI file has no tracks.");
+        return false;
+    }
+
+    // The tracks were appended one after another, a stable sort
+    // keeps the tempo of the first track ahead of the notes at the same tick
+    std::stable_sort(events.begin(), events.end(), tickEarlier);
+
+    if(division & 0x8000)
+    {
+        // SMPTE: frames per second and ticks per frame, the tempo is ignored
+        int fps = -static_cast<int8_t>(division >> 8);
+        const double framesPerSecond = (fps == 29) ? 30000.0 / 1001.0 : fps;
+        const double tickUs = 1e6 / (framesPerSecond * (division & 0xFF));
+        for(const TrackEvent &e : events)
+        {
+            if(e.isTempo)
+                continue;
+            Event out;
+            out.time = static_cast<uint64_t>(e.tick * tickUs);
+            std::copy(e.data, e.data + 3, out.data);
+            out.size = e.size;
+            m_events.push_back(out);
+        }
+        m_duration = static_cast<uint64_t>(endTick * tickUs);
+    }
+    else
+    {
+        // Ticks per quarter note, 120 BPM until the first tempo event
+        uint32_t tempo = 500000;
+        uint64_t segmentTick = 0;
+        uint64_t segmentUs = 0;
+        for(const TrackEvent &e : events)
+        {
+            const uint64_t time = segmentUs + (e.tick - segmentTick) * tempo / division;
+            if(e.isTempo)
+            {
+                segmentTick = e.tick;
+                segmentUs = time;
+                tempo = e.tempo;
+                continue;
+            }
+            Event out;
+            out.time = time;
+            std::copy(e.data, e.data + 3, out.data);
+            out.size = e.size;
+            m_events.push_back(out);
+        }
+        m_duration = segmentUs + (endTick - segmentTick) * tempo / division;
+    }
+
+    m_format = format;
+    m_tracks = tracksRead;
+    return true;
+}
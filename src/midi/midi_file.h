@@ -0,0 +1,67 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDI_FILE_H
+#define MIDI_FILE_H
+
+#include <stdint.h>
+#include <vector>
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @brief Standard MIDI File of type 0 or 1, flattened into one list of events
+ *
+ * The tracks are merged and the tempo map is applied while loading, so the
+ * events carry their absolute time. Only the channel messages are kept,
+ * system exclusive and meta events other than the tempo are dropped.
+ */
+class MidiFile
+{
+public:
+    struct Event
+    {
+        //! Time from the start, in microseconds
+        uint64_t time = 0;
+        //! Channel message, with the running status resolved
+        uint8_t data[3] = {0, 0, 0};
+        uint8_t size = 0;
+    };
+
+    bool load(const QString &path, QString *error = nullptr);
+    bool parse(const QByteArray &data, QString *error = nullptr);
+
+    //! Events sorted by time, the order within a track is kept
+    const std::vector<Event> &events() const
+        { return m_events; }
+    //! Time of the end of the longest track, in microseconds
+    uint64_t duration() const
+        { return m_duration; }
+    int format() const
+        { return m_format; }
+    int trackCount() const
+        { return m_tracks; }
+
+private:
+    std::vector<Event> m_events;
+    uint64_t m_duration = 0;
+    int m_format = 0;
+    int m_tracks = 0;
+};
+
+#endif // MIDI_FILE_H
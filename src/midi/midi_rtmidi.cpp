@@ -19,6 +19,7 @@
 #include "midi_rtmidi.h"
 #include "../opl/generator_realtime.h"
 #include <QCoreApplication>
+#include <algorithm>
 
 MidiInRt::MidiInRt(IRealtimeMIDI &rt, QObject *parent)
     : QObject(parent), m_rt(rt)
@@ -42,6 +43,7 @@ bool MidiInRt::open(unsigned port)
     RtMidiIn *midiin = lazyInstance();
     m_midiin->closePort();
     m_errorSignaled = false;
+    m_lastTime = 0;
     midiin->openPort(port, defaultPortName().toStdString());
     return !m_errorSignaled;
 }
@@ -51,6 +53,7 @@ bool MidiInRt::openVirtual()
     RtMidiIn *midiin = lazyInstance();
     m_midiin->closePort();
     m_errorSignaled = false;
+    m_lastTime = 0;
     midiin->openVirtualPort(defaultPortName().toStdString());
     return !m_errorSignaled;
 }
@@ -128,8 +131,19 @@ RtMidiIn *MidiInRt::lazyInstance()
 void MidiInRt::onReceive(double timeStamp, std::vector<unsigned char> *message, void *userData)
 {
     MidiInRt *self = static_cast<MidiInRt *>(userData);
-    (void)timeStamp;
-    self->m_rt.midi_event(message->data(), message->size());
+
+    // RtMidi gives the delay from the previous message in seconds, taken
+    // by the driver; chain them on the MIDI clock so a burst delivered late
+    // keeps its spacing, but never drift far from the time of arrival
+    const int64_t now = IRealtimeMIDI::midi_clock();
+    const int64_t maxDrift = 20000000;
+    int64_t time = now;
+    if(self->m_lastTime != 0)
+        time = self->m_lastTime + static_cast<int64_t>(timeStamp * 1e9);
+    time = std::max(now - maxDrift, std::min(time, now));
+    self->m_lastTime = time;
+
+    self->m_rt.midi_event(message->data(), message->size(), time);
 }
 
 void MidiInRt::onError(RtMidiError::Type type, const std::string &errorText, void *userData)
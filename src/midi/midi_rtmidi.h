@@ -23,6 +23,7 @@
 #include <QObject>
 #include <QVector>
 #include <RtMidi.h>
+#include <stdint.h>
 
 class IRealtimeMIDI;
 
@@ -51,6 +52,8 @@ private:
     bool m_errorSignaled = false;
     RtMidiError::Type m_errorCode = RtMidiError::UNSPECIFIED;
     QString m_errorText;
+    //! MIDI clock of the last message received, 0 before the first
+    int64_t m_lastTime = 0;
     RtMidiIn *lazyInstance();
     static void onReceive(double timeStamp, std::vector<unsigned char> *message, void *userData);
     static void onError(RtMidiError::Type type, const std::string &errorText, void *userData);
@@ -0,0 +1,107 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bank_renderer.h"
+#include "offline_renderer.h"
+#include "midi_sequencer.h"
+#include <QDir>
+#include <QtConcurrent/QtConcurrent>
+#include <cstring>
+
+void BankRenderer::applyBankSetup(const FmBank &bank, Setup &setup)
+{
+    setup.deepTremolo = bank.deep_tremolo;
+    setup.deepVibrato = bank.deep_vibrato;
+    setup.volumeModel = bank.volume_model;
+}
+
+static bool isBlank(const FmBank::Instrument &ins)
+{
+    FmBank::Instrument copy = ins;
+    copy.is_blank = false;
+    const FmBank::Instrument blank = FmBank::emptyInst();
+    return memcmp(&copy, &blank, sizeof(FmBank::Instrument)) == 0;
+}
+
+QString BankRenderer::fileName(const FmBank::Instrument &instrument, bool isDrum, int index,
+                               AudioFileWriter::Format format)
+{
+    QString name = QString::fromUtf8(instrument.name).trimmed();
+    for(QChar &c : name)
+    {
+        if(c.unicode() >= 128 || (!c.isLetterOrNumber() && c != '-'))
+            c = '_';
+    }
+
+    QString file = QString("%1_%2").arg(isDrum ? "percussion" : "melodic").arg(index, 3, 10, QChar('0'));
+    if(!name.isEmpty())
+        file += "_" + name;
+    return file + "." + AudioFileWriter::formatExtension(format);
+}
+
+QVector<BankRenderer::Task> BankRenderer::makeTasks(const FmBank &bank, const QString &directory, const Setup &setup)
+{
+    QVector<Task> tasks;
+    const QDir dir(directory);
+    for(int drums = 0; drums < 2; ++drums)
+    {
+        const QVector<FmBank::Instrument> &box = drums ? bank.Ins_Percussion_box : bank.Ins_Melodic_box;
+        for(int i = 0; i < box.size(); ++i)
+        {
+            if(isBlank(box[i]))
+                continue;
+            Task task;
+            task.instrument = box[i];
+            task.isDrum = (drums != 0);
+            // Percussion plays the key it is mapped to, unless it has a fixed note
+            task.note = drums ? (i % 128) : setup.note;
+            task.path = dir.filePath(fileName(box[i], task.isDrum, i, setup.format));
+            task.setup = &setup;
+            tasks.push_back(task);
+        }
+    }
+    return tasks;
+}
+
+void BankRenderer::renderTask(Task &task)
+{
+    const Setup &setup = *task.setup;
+    OfflineRenderer renderer(setup.rate, setup.chip);
+    renderer.setBankSetup(setup.deepTremolo, setup.deepVibrato, setup.volumeModel);
+
+    if(setup.song)
+    {
+        MidiSequencer song(*setup.song, setup.rate);
+        if(task.isDrum)
+        {
+            song.setChannelMask(MidiSequencer::DrumChannels);
+            song.setKeyFilter(task.note);
+        }
+        task.ok = renderer.renderSongToFile(task.instrument, task.isDrum, song, task.path, &task.error);
+        return;
+    }
+
+    const OfflineRenderer::Script script =
+        OfflineRenderer::noteScript(task.note, setup.holdMs, setup.releaseMs, setup.velocity);
+    task.ok = renderer.renderToFile(task.instrument, task.isDrum, script, task.path, &task.error);
+}
+
+QFuture<void> BankRenderer::start(QVector<Task> &tasks)
+{
+    return QtConcurrent::map(tasks, &BankRenderer::renderTask);
+}
@@ -0,0 +1,102 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BANK_RENDERER_H
+#define BANK_RENDERER_H
+
+#include <stdint.h>
+#include <QFuture>
+#include <QString>
+#include <QVector>
+
+#include "generator.h"
+#include "../audio/audio_file_writer.h"
+
+class MidiFile;
+
+/**
+ * @brief Renders every instrument of a bank into its own audio file
+ *
+ * The instruments are rendered in parallel by QtConcurrent::map, every
+ * task has an offline renderer of its own, so the workers share no chip.
+ * Progress and cancellation go through the QFuture, by a QFutureWatcher
+ * in the GUI or by polling from the command line.
+ */
+class BankRenderer
+{
+public:
+    struct Setup
+    {
+        uint32_t rate = 44100;
+        Generator::OPL_Chips chip = Generator::CHIP_Nuked;
+        AudioFileWriter::Format format = AudioFileWriter::FORMAT_WAV;
+        //! Key of the melodic notes, percussion plays the key of the instrument
+        int note = 60;
+        int velocity = 127;
+        uint32_t holdMs = 1000;
+        uint32_t releaseMs = 1000;
+        bool deepTremolo = false;
+        bool deepVibrato = false;
+        int volumeModel = Generator::VOLUME_Generic;
+        /**
+         * Song played instead of the single note, must stay alive until the
+         * tasks are done. Melodic instruments play all channels but the 10th,
+         * percussion plays the notes of its key on the 10th channel.
+         */
+        const MidiFile *song = nullptr;
+    };
+
+    struct Task
+    {
+        FmBank::Instrument instrument;
+        bool isDrum = false;
+        int note = 60;
+        QString path;
+        const Setup *setup = nullptr;
+        bool ok = false;
+        QString error;
+    };
+
+    /**
+     * @brief Takes the global parameters of the bank into the setup
+     */
+    static void applyBankSetup(const FmBank &bank, Setup &setup);
+
+    /**
+     * @brief Tasks for all non-blank instruments of the bank
+     * The files are named after the kind, the index and the name of the instrument.
+     * @param setup Used by the tasks, must stay alive until they are done
+     */
+    static QVector<Task> makeTasks(const FmBank &bank, const QString &directory, const Setup &setup);
+
+    /**
+     * @brief Starts rendering on the global thread pool
+     * The tasks must stay alive until the future finishes.
+     */
+    static QFuture<void> start(QVector<Task> &tasks);
+
+    /**
+     * @brief Renders one task, in the calling thread
+     */
+    static void renderTask(Task &task);
+
+    static QString fileName(const FmBank::Instrument &instrument, bool isDrum, int index,
+                            AudioFileWriter::Format format);
+};
+
+#endif // BANK_RENDERER_H
@@ -0,0 +1,72 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHIP_SNAPSHOT_H
+#define CHIP_SNAPSHOT_H
+
+#include "chips/opl_chip_base.h"
+#include <memory>
+
+// Saved state of an emulator, to start several runs from the same point
+struct ChipSnapshot
+{
+    std::unique_ptr<char[]> m_data;
+    bool m_valid = false;
+
+    void save(OPLChipBase *chip)
+    {
+        size_t size = chip->stateSize();
+        m_valid = false;
+        if(size == 0)
+            return; // Not supported by the emulator
+        m_data.reset(new char[size]);
+        m_valid = chip->saveState(m_data.get());
+    }
+
+    bool restore(OPLChipBase *chip) const
+    {
+        return m_valid && chip->restoreState(m_data.get());
+    }
+};
+
+/**
+ * @brief Sets the rate of the chip and brings it to the state every
+ * measurement starts from
+ * @param initState Post-init state to restore, if known
+ * @return The state was restored, without writing the registers
+ */
+static inline bool ResetChipForMeasure(OPLChipBase *chip, const ChipSnapshot *initState, uint32_t rate)
+{
+    // The snapshot is only accepted by a chip running at its rate
+    chip->setRate(rate);
+    if(initState && initState->restore(chip))
+        return true;
+
+    static const short initdata[(2 + 3 + 2 + 2) * 2] =
+    {
+        0x004, 96, 0x004, 128,      // Pulse timer
+        0x105, 0, 0x105, 1, 0x105, 0, // Pulse OPL3 enable, leave disabled
+        0x001, 32, 0x0BD, 0         // Enable wave & melodic
+    };
+
+    for(unsigned a = 0; a < 18; a += 2)
+        chip->writeReg((uint16_t)initdata[a], (uint8_t)initdata[a + 1]);
+    return false;
+}
+
+#endif // CHIP_SNAPSHOT_H
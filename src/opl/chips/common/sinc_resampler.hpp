@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2017-2022 Vitaly Novichkov (Wohlstand)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SINC_RESAMPLER_HPP
+#define SINC_RESAMPLER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SINC_RESAMPLER_SSE
+#endif
+
+/*
+    Stereo polyphase resampler with a Kaiser-windowed sinc kernel.
+
+    Input frames are pushed in blocks and kept as float history, one array
+    per channel; every output frame is a dot product of `taps` history frames
+    with a kernel row interpolated between the two nearest of `phases` rows.
+    The output lags the input by `taps / 2` frames.
+ */
+class SincResampler
+{
+public:
+    enum
+    {
+        maxTaps = 48,
+        phases = 256,
+        // history capacity, enough for the largest native block and a kernel
+        capacity = 512 + maxTaps
+    };
+
+    SincResampler()
+        : m_taps(0),
+          m_table(NULL),
+          m_fill(0),
+          m_pos(0),
+          m_frac(0),
+          m_step(0)
+    {}
+
+    ~SincResampler()
+    {
+        delete[] m_table;
+    }
+
+    /**
+     * @brief Builds the kernel for the given conversion
+     * @param inRate Rate of the pushed frames
+     * @param outRate Rate of the pulled frames
+     * @param taps Kernel length, multiple of 4 and not above maxTaps
+     */
+    void setup(uint32_t inRate, uint32_t outRate, unsigned taps)
+    {
+        if(!m_table)
+            m_table = new float[(phases + 1) * maxTaps];
+        m_taps = taps;
+        m_step = ((uint64_t)inRate << 32) / outRate;
+
+        // cutoff in cycles per input frame, below the lower of both Nyquists
+        double rolloff = (taps >= 48) ? 0.92 : 0.80;
+        double beta = (taps >= 48) ? 8.0 : 6.0;
+        double fc = 0.5 * rolloff;
+        if(outRate < inRate)
+            fc *= (double)outRate / inRate;
+
+        const double pi = 3.14159265358979323846;
+        const double half = taps / 2.0;
+        const double i0beta = besselI0(beta);
+        for(unsigned p = 0; p <= phases; ++p)
+        {
+            float *row = m_table + p * taps;
+            double sum = 0.0;
+            for(unsigned k = 0; k < taps; ++k)
+            {
+                double x = half - 1.0 + (double)p / phases - k;
+                double r = x / half;
+                double w = (r * r < 1.0) ? besselI0(beta * sqrt(1.0 - r * r)) / i0beta : 0.0;
+                double s = (x == 0.0) ? 1.0 : sin(2.0 * pi * fc * x) / (2.0 * pi * fc * x);
+                row[k] = (float)(s * w);
+                sum += s * w;
+            }
+            // unity gain at DC for every phase
+            for(unsigned k = 0; k < taps; ++k)
+                row[k] = (float)(row[k] / sum);
+        }
+        reset();
+    }
+
+    void reset()
+    {
+        memset(m_history, 0, sizeof(m_history));
+        // start with a kernel worth of silence, so output begins at once
+        m_fill = m_taps;
+        m_pos = 0;
+        m_frac = 0;
+    }
+
+    /**
+     * @brief Number of input frames to push before the given count of output frames can be pulled
+     */
+    size_t inputNeeded(size_t frames) const
+    {
+        if(frames == 0)
+            return 0;
+        uint64_t last = m_pos + (((uint64_t)m_frac + (uint64_t)(frames - 1) * m_step) >> 32);
+        uint64_t total = last + m_taps;
+        return (total > m_fill) ? (size_t)(total - m_fill) : 0;
+    }
+
+    /**
+     * @brief Number of input frames the history is able to take
+     */
+    size_t space() const
+    {
+        // at low output rates, the position may step past the end of history
+        return (m_fill > m_pos) ? capacity - (m_fill - m_pos) : (size_t)capacity;
+    }
+
+    /**
+     * @brief Appends interleaved stereo frames, at most space()
+     * @param input Interleaved frames
+     * @param frames Count of frames
+     * @param scale Amplitude factor applied on the way in
+     */
+    void push(const int16_t *input, size_t frames, float scale)
+    {
+        if(m_pos > m_fill)
+        {
+            // frames the output stepped over are never read, drop them
+            size_t skip = m_pos - m_fill;
+            skip = (skip < frames) ? skip : frames;
+            input += 2 * skip;
+            frames -= skip;
+            m_pos -= skip;
+        }
+        if(m_fill + frames > (size_t)capacity)
+        {
+            size_t keep = m_fill - m_pos;
+            memmove(m_history[0], m_history[0] + m_pos, keep * sizeof(float));
+            memmove(m_history[1], m_history[1] + m_pos, keep * sizeof(float));
+            m_fill = keep;
+            m_pos = 0;
+        }
+        float *left = m_history[0] + m_fill;
+        float *right = m_history[1] + m_fill;
+        for(size_t i = 0; i < frames; ++i)
+        {
+            left[i] = scale * (float)input[2 * i];
+            right[i] = scale * (float)input[2 * i + 1];
+        }
+        m_fill += frames;
+    }
+
+    /**
+     * @brief Renders output frames out of the history pushed so far
+     * @param output Interleaved output frames
+     * @param frames Count of frames wanted
+     * @return Count of frames written
+     */
+    size_t pull(int32_t *output, size_t frames)
+    {
+        const unsigned taps = m_taps;
+        const float *table = m_table;
+        size_t pos = m_pos;
+        uint32_t frac = m_frac;
+        size_t done = 0;
+
+        for(; done < frames && pos + taps <= m_fill; ++done)
+        {
+            const float *c0 = table + (frac >> 24) * taps;
+            const float *c1 = c0 + taps;
+            const float f = (float)(frac & 0xFFFFFF) * (1.0f / 16777216.0f);
+            const float *left = m_history[0] + pos;
+            const float *right = m_history[1] + pos;
+#if defined(SINC_RESAMPLER_SSE)
+            const __m128 vf = _mm_set1_ps(f);
+            __m128 accl = _mm_setzero_ps();
+            __m128 accr = _mm_setzero_ps();
+            for(unsigned k = 0; k < taps; k += 4)
+            {
+                __m128 a = _mm_loadu_ps(c0 + k);
+                __m128 b = _mm_loadu_ps(c1 + k);
+                __m128 c = _mm_add_ps(a, _mm_mul_ps(vf, _mm_sub_ps(b, a)));
+                accl = _mm_add_ps(accl, _mm_mul_ps(c, _mm_loadu_ps(left + k)));
+                accr = _mm_add_ps(accr, _mm_mul_ps(c, _mm_loadu_ps(right + k)));
+            }
+            // horizontal sums of both accumulators at once
+            __m128 lo = _mm_unpacklo_ps(accl, accr);
+            __m128 hi = _mm_unpackhi_ps(accl, accr);
+            __m128 s = _mm_add_ps(lo, hi);
+            s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+            // the rounding of the scalar path, not the one of the MXCSR
+            output[0] = roundToInt(_mm_cvtss_f32(s));
+            output[1] = roundToInt(_mm_cvtss_f32(_mm_shuffle_ps(s, s, 1)));
+#else
+            // four partial sums added in the order of the SSE path, so that
+            // both builds give the same samples
+            float suml[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            float sumr[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for(unsigned k = 0; k < taps; ++k)
+            {
+                float c = c0[k] + f * (c1[k] - c0[k]);
+                suml[k & 3] += c * left[k];
+                sumr[k & 3] += c * right[k];
+            }
+            output[0] = roundToInt((suml[0] + suml[2]) + (suml[1] + suml[3]));
+            output[1] = roundToInt((sumr[0] + sumr[2]) + (sumr[1] + sumr[3]));
+#endif
+            output += 2;
+            uint64_t next = (uint64_t)frac + m_step;
+            pos += (size_t)(next >> 32);
+            frac = (uint32_t)next;
+        }
+
+        m_pos = pos;
+        m_frac = frac;
+        return done;
+    }
+
+private:
+    SincResampler(const SincResampler &);
+    SincResampler &operator=(const SincResampler &);
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for(int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static int32_t roundToInt(float x)
+    {
+        return (x >= 0.0f) ? (int32_t)(x + 0.5f) : -(int32_t)(0.5f - x);
+    }
+
+    unsigned m_taps;
+    // (phases + 1) rows of `taps` coefficients
+    float *m_table;
+    float m_history[2][capacity];
+    size_t m_fill;
+    size_t m_pos;
+    // position between history frames m_pos and m_pos + 1, 32-bit fraction
+    uint32_t m_frac;
+    uint64_t m_step;
+};
+
+#endif // SINC_RESAMPLER_HPP
@@ -1296,6 +1296,31 @@ void Chip::GenerateBlock3( Bitu total, Bit32s* output  ) {
 	}
 }
 
+bool Chip::Silent() const {
+	//Percussion channels have no early out
+	if ( regBD & 0x20 )
+		return false;
+	const Bitu count = opl3Active ? 18 : 9;
+	for ( Bitu i = 0; i < count; i++ ) {
+		if ( !chan[i].op[0].Silent() || !chan[i].op[1].Silent() )
+			return false;
+	}
+	return true;
+}
+
+void Chip::Skip( Bitu total ) {
+	//Every synth handler takes its early out without touching the output,
+	//this only keeps the LFO and the state of the channels in step
+	Channel* last = chan + ( opl3Active ? 18 : 9 );
+	while ( total > 0 ) {
+		Bit32u samples = ForwardLFO( static_cast<Bit32u>(total) );
+		for( Channel* ch = chan; ch < last; ) {
+			ch = (ch->*(ch->synthHandler))( this, samples, 0 );
+		}
+		total -= samples;
+	}
+}
+
 void Chip::GenerateBlock3_Mix( Bitu total, Bit32s* output  ) {
 	while ( total > 0 ) {
 		Bit32u samples = ForwardLFO( static_cast<Bit32u>(total) );
@@ -1703,6 +1728,16 @@ void Handler::GenerateArr(Bit16s *out, Bitu *samples)
 		out[i] = static_cast<Bit16s>(DBOPL_CLAMP(out32[i], INT16_MIN, INT16_MAX));
 }
 
+bool Handler::Silent() const
+{
+	return chip.Silent();
+}
+
+void Handler::Skip(Bitu samples)
+{
+	chip.Skip(samples);
+}
+
 void Handler::GenerateArrMix(Bit32s *out, Bitu *samples)
 {
 	if(GCC_UNLIKELY(*samples > 512))
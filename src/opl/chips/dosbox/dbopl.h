@@ -269,6 +269,10 @@ struct Chip {
 	//Update the synth handlers in all channels
 	void UpdateSynths();
 	void Generate( Bit32u samples );
+	//Check if the generated channels are all silent, and percussion is off
+	bool Silent() const;
+	//Advance the clocks by an amount of samples while silent
+	void Skip( Bitu samples );
 	void Setup( Bit32u r );
 
 	Chip();
@@ -283,6 +287,8 @@ struct Handler {
 	void GenerateArr(Bit16s *out, Bitu *samples);
 	void GenerateArrMix(Bit32s *out, Bitu *samples);
 	void GenerateArrMix(Bit16s *out, Bitu *samples);
+	bool Silent() const;
+	void Skip( Bitu samples );
 	void Init( Bitu rate );
 };
 
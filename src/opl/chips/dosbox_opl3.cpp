@@ -22,18 +22,77 @@
 #include "dosbox/dbopl.h"
 #include <new>
 #include <cstdlib>
+#include <cstring>
 #include <assert.h>
 
+/*
+ * DBOPL takes its decisions once per rendered block: a channel whose carrier
+ * is silent skips the whole block without moving its modulator on. Where the
+ * blocks start then changes the sound, so they are kept on a fixed grid of
+ * native frames, only split by the register writes. The frames up to the
+ * next grid point are rendered ahead, and a write landing in between renders
+ * again from the start of that segment to the frame it is due at.
+ */
+static const size_t gridFrames = 256;
+
+struct DosBoxChip
+{
+    //! The chip at the end of the rendered segment
+    DBOPL::Handler chip;
+    //! The chip at the start of the rendered segment
+    DBOPL::Handler segmentStart;
+    int16_t segment[2 * gridFrames];
+    //! Frames rendered in the segment
+    uint32_t fill;
+    //! Frames of the segment already output
+    uint32_t pos;
+    //! Position on the grid
+    uint32_t clock;
+
+    void init(uint32_t rate)
+    {
+        chip.~Handler();
+        new(&chip) DBOPL::Handler;
+        chip.Init(rate);
+        fill = 0;
+        pos = 0;
+        clock = 0;
+    }
+
+    //! Brings the chip back to the frame about to be output
+    void rewind()
+    {
+        if(pos < fill)
+        {
+            std::memcpy(&chip, &segmentStart, sizeof(DBOPL::Handler));
+            Bitu frames = pos;
+            if(frames > 0)
+                chip.GenerateArr(segment, &frames);
+        }
+        fill = 0;
+        pos = 0;
+    }
+
+    void render()
+    {
+        std::memcpy(&segmentStart, &chip, sizeof(DBOPL::Handler));
+        Bitu frames = gridFrames - clock % gridFrames;
+        chip.GenerateArr(segment, &frames);
+        fill = (uint32_t)frames;
+        pos = 0;
+    }
+};
+
 DosBoxOPL3::DosBoxOPL3() :
-    OPLChipBaseBufferedT(),
-    m_chip(new DBOPL::Handler)
+    OPLChipBaseT(),
+    m_chip(new DosBoxChip)
 {
     reset();
 }
 
 DosBoxOPL3::~DosBoxOPL3()
 {
-    DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
+    DosBoxChip *chip_r = reinterpret_cast<DosBoxChip*>(m_chip);
     delete chip_r;
 }
 
@@ -44,39 +103,85 @@ void DosBoxOPL3::globalPreInit()
 
 void DosBoxOPL3::setRate(uint32_t rate)
 {
-    OPLChipBaseBufferedT::setRate(rate);
-    DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
-    chip_r->~Handler();
-    new(chip_r) DBOPL::Handler;
-    chip_r->Init(effectiveRate());
+    OPLChipBaseT::setRate(rate);
+    DosBoxChip *chip_r = reinterpret_cast<DosBoxChip*>(m_chip);
+    chip_r->init(effectiveRate());
 }
 
 void DosBoxOPL3::reset()
 {
-    OPLChipBaseBufferedT::reset();
-    DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
-    chip_r->~Handler();
-    new(chip_r) DBOPL::Handler;
-    chip_r->Init(effectiveRate());
+    OPLChipBaseT::reset();
+    DosBoxChip *chip_r = reinterpret_cast<DosBoxChip*>(m_chip);
+    chip_r->init(effectiveRate());
 }
 
 void DosBoxOPL3::writeReg(uint16_t addr, uint8_t data)
 {
-    DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
-    chip_r->WriteReg(static_cast<Bit32u>(addr), data);
+    DosBoxChip *chip_r = reinterpret_cast<DosBoxChip*>(m_chip);
+    chip_r->rewind();
+    chip_r->chip.WriteReg(static_cast<Bit32u>(addr), data);
 }
 
 void DosBoxOPL3::writePan(uint16_t addr, uint8_t data)
 {
-    DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
-    chip_r->WritePan(static_cast<Bit32u>(addr), data);
+    DosBoxChip *chip_r = reinterpret_cast<DosBoxChip*>(m_chip);
+    chip_r->rewind();
+    chip_r->chip.WritePan(static_cast<Bit32u>(addr), data);
+}
+
+void DosBoxOPL3::nativeGenerate(int16_t *frame)
+{
+    nativeGenerateN(frame, 1);
 }
 
 void DosBoxOPL3::nativeGenerateN(int16_t *output, size_t frames)
 {
-    DBOPL::Handler *chip_r = reinterpret_cast<DBOPL::Handler*>(m_chip);
-    Bitu frames_i = frames;
-    chip_r->GenerateArr(output, &frames_i);
+    DosBoxChip *chip_r = reinterpret_cast<DosBoxChip*>(m_chip);
+    while(frames > 0)
+    {
+        if(chip_r->pos == chip_r->fill)
+            chip_r->render();
+        size_t count = chip_r->fill - chip_r->pos;
+        count = (count < frames) ? count : frames;
+        std::memcpy(output, chip_r->segment + 2 * chip_r->pos, 2 * count * sizeof(int16_t));
+        chip_r->pos += (uint32_t)count;
+        chip_r->clock += (uint32_t)count;
+        output += 2 * count;
+        frames -= count;
+    }
+}
+
+bool DosBoxOPL3::nativeIsIdle() const
+{
+    // frames rendered ahead are output first
+    const DosBoxChip *chip_r = reinterpret_cast<const DosBoxChip*>(m_chip);
+    return chip_r->pos == chip_r->fill && chip_r->chip.Silent();
+}
+
+void DosBoxOPL3::nativeSkip(size_t frames)
+{
+    // while silent, skipping leaves the chip as rendering would
+    DosBoxChip *chip_r = reinterpret_cast<DosBoxChip*>(m_chip);
+    chip_r->chip.Skip(frames);
+    chip_r->fill = 0;
+    chip_r->pos = 0;
+    chip_r->clock += (uint32_t)frames;
+}
+
+size_t DosBoxOPL3::nativeStateSize() const
+{
+    return sizeof(DosBoxChip);
+}
+
+void DosBoxOPL3::nativeSaveState(void *state) const
+{
+    // the handlers only point to static tables, a plain copy is enough
+    std::memcpy(state, m_chip, sizeof(DosBoxChip));
+}
+
+void DosBoxOPL3::nativeRestoreState(const void *state)
+{
+    std::memcpy(m_chip, state, sizeof(DosBoxChip));
 }
 
 const char *DosBoxOPL3::emulatorName()
@@ -89,6 +89,7 @@ static inline double StripIntPart(double num)
 
 class Channel 
 {
+	friend class OPL3; /* libADLMIDI: state snapshots */
 protected:
 	double feedback[2];
 	
@@ -538,6 +539,32 @@ namespace EnvelopeGeneratorData
 	};
 }
 
+/* libADLMIDI: state snapshots */
+struct ChannelStateStruct
+{
+	double feedback[2];
+	int fnuml, fnumh, kon, block, fb, cha, chb, cnt;
+	double leftPan, rightPan;
+};
+
+struct OPL3StateStruct
+{
+	// 36 operators, 4 rhythm operators and the 2 of the bass drum
+	enum { NumOperators = 2 * 18 + 6 };
+	// 18 2-op, 6 4-op, the disabled and 3 rhythm channels
+	enum { NumChannels = 2 * 9 + 2 * 3 + 4 };
+
+	uint8_t registers[0x200];
+	int nts, dam, dvb, ryt, bd, sd, tom, tc, hh, _new, connectionsel;
+	int vibratoIndex, tremoloIndex;
+	// the arrays of the chip, as indices to the lists of the objects, 0xFF for none
+	uint8_t operatorSlots[2][0x20];
+	uint8_t channelSlots[2][9];
+	ChannelStateStruct channels[NumChannels];
+	// operators have no pointers, these are bitwise copies
+	unsigned char operators[NumOperators][sizeof(Operator)];
+};
+
 class OPL3
 {
 public:
@@ -612,6 +639,17 @@ public:
 	void WriteReg(int reg, int v);
 	void Update(float *buffer, int length);
 	void SetPanning(int c, float left, float right);
+
+	/* libADLMIDI: silence detection */
+	bool IsIdle() const;
+	void Skip(int length);
+
+	/* libADLMIDI: state snapshots, the shared noise generator is not part of them */
+	static size_t StateSize() { return sizeof(OPL3StateStruct); }
+	void SaveState(void *state) const;
+	void RestoreState(const void *state);
+private:
+	void GetStateObjects(Operator **ops, Channel **chans) const;
 };
 
 OperatorDataStruct *OPL3::OperatorData;
@@ -1897,4 +1935,134 @@ void OPL3::SetPanning(int c, float left, float right)
 	}
 }
 
+/* libADLMIDI: silence detection */
+bool OPL3::IsIdle() const
+{
+	// Rhythm channels have no early out
+	if (ryt)
+		return false;
+	// With every operator off, each channel returns 0 without changing its state
+	for (int array = 0; array < (_new + 1); array++)
+		for (int i = 0; i < 0x20; i++)
+			if (operators[array][i] != NULL &&
+				operators[array][i]->envelopeGenerator.stage != EnvelopeGenerator::OFF)
+				return false;
+	return true;
+}
+
+void OPL3::Skip(int length)
+{
+	vibratoIndex = (vibratoIndex + length) & (OPL3DataStruct::vibratoTableLength - 1);
+	tremoloIndex = (tremoloIndex + length) % OPL3DataStruct::tremoloTableLength;
+}
+
+/* libADLMIDI: state snapshots */
+void OPL3::GetStateObjects(Operator **ops, Channel **chans) const
+{
+	OPL3 *self = const_cast<OPL3 *>(this);
+	int o = 0, c = 0;
+	for (int array = 0; array < 2; array++)
+	{
+		for (int i = 0; i < 9; i++)
+		{
+			ops[o++] = channels2op[array][i]->op1;
+			ops[o++] = channels2op[array][i]->op2;
+			chans[c++] = channels2op[array][i];
+		}
+		for (int i = 0; i < 3; i++)
+			chans[c++] = channels4op[array][i];
+	}
+	ops[o++] = &self->highHatOperator;
+	ops[o++] = &self->snareDrumOperator;
+	ops[o++] = &self->tomTomOperator;
+	ops[o++] = &self->topCymbalOperator;
+	ops[o++] = bassDrumChannel.op1;
+	ops[o++] = bassDrumChannel.op2;
+	chans[c++] = &self->disabledChannel;
+	chans[c++] = &self->bassDrumChannel;
+	chans[c++] = &self->highHatSnareDrumChannel;
+	chans[c++] = &self->tomTomTopCymbalChannel;
+}
+
+void OPL3::SaveState(void *state) const
+{
+	OPL3StateStruct *s = static_cast<OPL3StateStruct *>(state);
+	Operator *ops[OPL3StateStruct::NumOperators];
+	Channel *chans[OPL3StateStruct::NumChannels];
+	GetStateObjects(ops, chans);
+
+	memcpy(s->registers, registers, sizeof(registers));
+	s->nts = nts; s->dam = dam; s->dvb = dvb; s->ryt = ryt;
+	s->bd = bd; s->sd = sd; s->tom = tom; s->tc = tc; s->hh = hh;
+	s->_new = _new; s->connectionsel = connectionsel;
+	s->vibratoIndex = vibratoIndex; s->tremoloIndex = tremoloIndex;
+
+	for (int array = 0; array < 2; array++)
+	{
+		for (int i = 0; i < 0x20; i++)
+		{
+			uint8_t slot = 0xFF;
+			for (int n = 0; operators[array][i] && n < OPL3StateStruct::NumOperators; n++)
+				if (ops[n] == operators[array][i]) { slot = (uint8_t)n; break; }
+			s->operatorSlots[array][i] = slot;
+		}
+		for (int i = 0; i < 9; i++)
+		{
+			uint8_t slot = 0xFF;
+			for (int n = 0; n < OPL3StateStruct::NumChannels; n++)
+				if (chans[n] == channels[array][i]) { slot = (uint8_t)n; break; }
+			s->channelSlots[array][i] = slot;
+		}
+	}
+
+	for (int n = 0; n < OPL3StateStruct::NumChannels; n++)
+	{
+		const Channel *ch = chans[n];
+		ChannelStateStruct &cs = s->channels[n];
+		cs.feedback[0] = ch->feedback[0]; cs.feedback[1] = ch->feedback[1];
+		cs.fnuml = ch->fnuml; cs.fnumh = ch->fnumh; cs.kon = ch->kon; cs.block = ch->block;
+		cs.fb = ch->fb; cs.cha = ch->cha; cs.chb = ch->chb; cs.cnt = ch->cnt;
+		cs.leftPan = ch->leftPan; cs.rightPan = ch->rightPan;
+	}
+	for (int n = 0; n < OPL3StateStruct::NumOperators; n++)
+		memcpy(s->operators[n], ops[n], sizeof(Operator));
+}
+
+void OPL3::RestoreState(const void *state)
+{
+	const OPL3StateStruct *s = static_cast<const OPL3StateStruct *>(state);
+	Operator *ops[OPL3StateStruct::NumOperators];
+	Channel *chans[OPL3StateStruct::NumChannels];
+	GetStateObjects(ops, chans);
+
+	memcpy(registers, s->registers, sizeof(registers));
+	nts = s->nts; dam = s->dam; dvb = s->dvb; ryt = s->ryt;
+	bd = s->bd; sd = s->sd; tom = s->tom; tc = s->tc; hh = s->hh;
+	_new = s->_new; connectionsel = s->connectionsel;
+	vibratoIndex = s->vibratoIndex; tremoloIndex = s->tremoloIndex;
+
+	for (int array = 0; array < 2; array++)
+	{
+		for (int i = 0; i < 0x20; i++)
+		{
+			uint8_t slot = s->operatorSlots[array][i];
+			operators[array][i] = (slot != 0xFF) ? ops[slot] : NULL;
+		}
+		for (int i = 0; i < 9; i++)
+			channels[array][i] = chans[s->channelSlots[array][i]];
+	}
+
+	for (int n = 0; n < OPL3StateStruct::NumChannels; n++)
+	{
+		Channel *ch = chans[n];
+		const ChannelStateStruct &cs = s->channels[n];
+		ch->feedback[0] = cs.feedback[0]; ch->feedback[1] = cs.feedback[1];
+		ch->fnuml = cs.fnuml; ch->fnumh = cs.fnumh; ch->kon = cs.kon; ch->block = cs.block;
+		ch->fb = cs.fb; ch->cha = cs.cha; ch->chb = cs.chb; ch->cnt = cs.cnt;
+		ch->leftPan = cs.leftPan; ch->rightPan = cs.rightPan;
+	}
+	for (int n = 0; n < OPL3StateStruct::NumOperators; n++)
+		memcpy(ops[n], s->operators[n], sizeof(Operator));
+}
+
 } // JavaOPL
@@ -29,7 +29,7 @@
 #endif
 
 JavaOPL3::JavaOPL3() :
-    OPLChipBaseBufferedT(),
+    OPLChipBaseT(),
     m_chip(new ADL_JavaOPL3::OPL3(true))
 {
     reset();
@@ -43,7 +43,7 @@ JavaOPL3::~JavaOPL3()
 
 void JavaOPL3::setRate(uint32_t rate)
 {
-    OPLChipBaseBufferedT::setRate(rate);
+    OPLChipBaseT::setRate(rate);
     ADL_JavaOPL3::OPL3 *chip_r = reinterpret_cast<ADL_JavaOPL3::OPL3 *>(m_chip);
     chip_r->Reset();
 
@@ -54,7 +54,7 @@ void JavaOPL3::setRate(uint32_t rate)
 
 void JavaOPL3::reset()
 {
-    OPLChipBaseBufferedT::reset();
+    OPLChipBaseT::reset();
     ADL_JavaOPL3::OPL3 *chip_r = reinterpret_cast<ADL_JavaOPL3::OPL3 *>(m_chip);
     chip_r->Reset();
 }
@@ -78,6 +78,11 @@ void JavaOPL3::writePan(uint16_t addr, uint8_t data)
     chip_r->SetPanning(channel, cosf(phase), sinf(phase));
 }
 
+void JavaOPL3::nativeGenerate(int16_t *frame)
+{
+    nativeGenerateN(frame, 1);
+}
+
 void JavaOPL3::nativeGenerateN(int16_t *output, size_t frames)
 {
     ADL_JavaOPL3::OPL3 *chip_r = reinterpret_cast<ADL_JavaOPL3::OPL3 *>(m_chip);
@@ -106,6 +111,35 @@ void JavaOPL3::nativeGenerateN(int16_t *output, size_t frames)
     }
 }
 
+bool JavaOPL3::nativeIsIdle() const
+{
+    const ADL_JavaOPL3::OPL3 *chip_r = reinterpret_cast<const ADL_JavaOPL3::OPL3 *>(m_chip);
+    return chip_r->IsIdle();
+}
+
+void JavaOPL3::nativeSkip(size_t frames)
+{
+    ADL_JavaOPL3::OPL3 *chip_r = reinterpret_cast<ADL_JavaOPL3::OPL3 *>(m_chip);
+    chip_r->Skip((int)frames);
+}
+
+size_t JavaOPL3::nativeStateSize() const
+{
+    return ADL_JavaOPL3::OPL3::StateSize();
+}
+
+void JavaOPL3::nativeSaveState(void *state) const
+{
+    const ADL_JavaOPL3::OPL3 *chip_r = reinterpret_cast<const ADL_JavaOPL3::OPL3 *>(m_chip);
+    chip_r->SaveState(state);
+}
+
+void JavaOPL3::nativeRestoreState(const void *state)
+{
+    ADL_JavaOPL3::OPL3 *chip_r = reinterpret_cast<ADL_JavaOPL3::OPL3 *>(m_chip);
+    chip_r->RestoreState(state);
+}
+
 const char *JavaOPL3::emulatorName()
 {
     return "Java 1.0.6 OPL3";
@@ -23,7 +23,7 @@
 
 #include "opl_chip_base.h"
 
-class JavaOPL3 final : public OPLChipBaseBufferedT<JavaOPL3>
+class JavaOPL3 final : public OPLChipBaseT<JavaOPL3>
 {
     void *m_chip;
 public:
@@ -37,7 +37,13 @@ public:
     void writePan(uint16_t addr, uint8_t data) override;
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
+    void nativeGenerate(int16_t *frame) override;
     void nativeGenerateN(int16_t *output, size_t frames) override;
+    bool nativeIsIdle() const;
+    void nativeSkip(size_t frames);
+    size_t nativeStateSize() const;
+    void nativeSaveState(void *state) const;
+    void nativeRestoreState(const void *state);
     const char *emulatorName() override;
     ChipType chipType() override;
 };
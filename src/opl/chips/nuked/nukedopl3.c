@@ -1274,12 +1274,69 @@ static Bit16s OPL3_ClipSample(Bit32s sample)
     return (Bit16s)sample;
 }
 
+static void OPL3_ClockTimers(opl3_chip *chip)
+{
+    Bit8u shift = 0;
+
+    if ((chip->timer & 0x3f) == 0x3f)
+    {
+        chip->tremolopos = (chip->tremolopos + 1) % 210;
+    }
+    if (chip->tremolopos < 105)
+    {
+        chip->tremolo = chip->tremolopos >> chip->tremoloshift;
+    }
+    else
+    {
+        chip->tremolo = (210 - chip->tremolopos) >> chip->tremoloshift;
+    }
+
+    if ((chip->timer & 0x3ff) == 0x3ff)
+    {
+        chip->vibpos = (chip->vibpos + 1) & 7;
+    }
+
+    chip->timer++;
+
+    chip->eg_add = 0;
+    if (chip->eg_timer)
+    {
+        while (shift < 36 && ((chip->eg_timer >> shift) & 1) == 0)
+        {
+            shift++;
+        }
+        if (shift > 12)
+        {
+            chip->eg_add = 0;
+        }
+        else
+        {
+            chip->eg_add = shift + 1;
+        }
+    }
+
+    if (chip->eg_timerrem || chip->eg_state)
+    {
+        if (chip->eg_timer == 0xfffffffffULL)
+        {
+            chip->eg_timer = 0;
+            chip->eg_timerrem = 1;
+        }
+        else
+        {
+            chip->eg_timer++;
+            chip->eg_timerrem = 0;
+        }
+    }
+
+    chip->eg_state ^= 1;
+}
+
 void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
 {
     Bit8u ii;
     Bit8u jj;
     Bit16s accm;
-    Bit8u shift = 0;
 
     buf[1] = OPL3_ClipSample(chip->mixbuff[1]);
 
@@ -1339,71 +1396,112 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
         OPL3_SlotGenerate(&chip->slot[ii]);
     }
 
-    if ((chip->timer & 0x3f) == 0x3f)
-    {
-        chip->tremolopos = (chip->tremolopos + 1) % 210;
-    }
-    if (chip->tremolopos < 105)
+    OPL3_ClockTimers(chip);
+
+    while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
     {
-        chip->tremolo = chip->tremolopos >> chip->tremoloshift;
+        if (!(chip->writebuf[chip->writebuf_cur].reg & 0x200))
+        {
+            break;
+        }
+        chip->writebuf[chip->writebuf_cur].reg &= 0x1ff;
+        OPL3_WriteReg(chip, chip->writebuf[chip->writebuf_cur].reg,
+                      chip->writebuf[chip->writebuf_cur].data);
+        chip->writebuf_cur = (chip->writebuf_cur + 1) % OPL_WRITEBUF_SIZE;
     }
-    else
+    chip->writebuf_samplecnt++;
+}
+
+/*
+ * Idle chip
+ *
+ * Once an envelope is off, the operator outputs 0 or -1 by the sign of its
+ * phase. A channel adding at most one such operator, at a pan below full
+ * volume, puts nothing into the mix: the chip outputs digital silence, but
+ * phases, feedback and noise still have to move on for the next notes.
+ */
+
+int OPL3_IsIdle(const opl3_chip *chip)
+{
+    Bit8u ii;
+    Bit8u jj;
+    Bit32u count;
+
+    if ((chip->rhy & 0x20) || chip->mixbuff[1] != 0)
     {
-        chip->tremolo = (210 - chip->tremolopos) >> chip->tremoloshift;
+        return 0;
     }
-
-    if ((chip->timer & 0x3ff) == 0x3ff)
+    if (chip->writebuf[chip->writebuf_cur].reg & 0x200)
     {
-        chip->vibpos = (chip->vibpos + 1) & 7;
+        return 0;
     }
-
-    chip->timer++;
-
-    chip->eg_add = 0;
-    if (chip->eg_timer)
+    for (ii = 0; ii < 36; ii++)
     {
-        while (shift < 36 && ((chip->eg_timer >> shift) & 1) == 0)
+        const opl3_slot *slot = &chip->slot[ii];
+        if (slot->key || slot->eg_gen != envelope_gen_num_release
+            || slot->eg_rout != 0x1ff || (Bit16u)(slot->out + 1) > 1)
         {
-            shift++;
+            return 0;
         }
-        if (shift > 12)
+    }
+    for (ii = 0; ii < 18; ii++)
+    {
+        const opl3_channel *channel = &chip->channel[ii];
+        count = 0;
+        for (jj = 0; jj < 4; jj++)
         {
-            chip->eg_add = 0;
+            if (channel->out[jj] != &chip->zeromod)
+            {
+                count++;
+            }
         }
-        else
+        if ((channel->cha && count * channel->chl >= 65535)
+            || (channel->chb && count * channel->chr >= 65535))
         {
-            chip->eg_add = shift + 1;
+            return 0;
         }
     }
+    return 1;
+}
 
-    if (chip->eg_timerrem || chip->eg_state)
+static void OPL3_SlotGenerateIdle(opl3_slot *slot)
+{
+#if OPL_FAST_WAVEGEN
+    Bit16u phase = slot->pg_phase_out + *slot->mod;
+    slot->eg_out = 0x1ff << 3;
+    if (phase & slot->maskzero)
     {
-        if (chip->eg_timer == 0xfffffffffULL)
-        {
-            chip->eg_timer = 0;
-            chip->eg_timerrem = 1;
-        }
-        else
-        {
-            chip->eg_timer++;
-            chip->eg_timerrem = 0;
-        }
+        slot->out = 0;
+    }
+    else
+    {
+        slot->out = (Bit16s)((Bit32s)((Bit32u)phase << slot->signpos) >> 31);
     }
+#else
+    slot->eg_out = slot->eg_rout + (slot->reg_tl << 2)
+                 + (slot->eg_ksl >> kslshift[slot->reg_ksl]) + *slot->trem;
+    OPL3_SlotGenerate(slot);
+#endif
+}
 
-    chip->eg_state ^= 1;
+void OPL3_Skip(opl3_chip *chip, Bit32u numsamples)
+{
+    Bit8u ii;
 
-    while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+    while (numsamples > 0)
     {
-        if (!(chip->writebuf[chip->writebuf_cur].reg & 0x200))
+        for (ii = 0; ii < 36; ii++)
         {
-            break;
+            OPL3_SlotCalcFB(&chip->slot[ii]);
+            OPL3_PhaseGenerate(&chip->slot[ii]);
+            OPL3_SlotGenerateIdle(&chip->slot[ii]);
         }
-        chip->writebuf[chip->writebuf_cur].reg &= 0x1ff;
-        OPL3_WriteReg(chip, chip->writebuf[chip->writebuf_cur].reg,
-                      chip->writebuf[chip->writebuf_cur].data);
-        chip->writebuf_cur = (chip->writebuf_cur + 1) % OPL_WRITEBUF_SIZE;
+        OPL3_ClockTimers(chip);
+        chip->writebuf_samplecnt++;
+        numsamples--;
     }
-    chip->writebuf_samplecnt++;
+    chip->mixbuff[0] = 0;
+    chip->mixbuff[1] = 0;
 }
 
 void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf)
@@ -166,6 +166,8 @@ void OPL3_WriteRegBuffered(opl3_chip *chip, Bit16u reg, Bit8u v);
 void OPL3_WritePan(opl3_chip *chip, Bit16u reg, Bit8u v);
 void OPL3_GenerateStream(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples);
 void OPL3_GenerateStreamMix(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples);
+int OPL3_IsIdle(const opl3_chip *chip);
+void OPL3_Skip(opl3_chip *chip, Bit32u numsamples);
 
 #ifdef __cplusplus
 }
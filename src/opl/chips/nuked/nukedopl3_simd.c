@@ -0,0 +1,1662 @@
+/*
+ * Copyright (C) 2013-2018 Alexey Khokholov (Nuke.YKT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ *  Nuked OPL3 emulator, structure-of-arrays variant.
+ *  Thanks:
+ *      MAME Development Team(Jarek Burczynski, Tatsuyuki Satoh):
+ *          Feedback and Rhythm part calculation information.
+ *      forums.submarine.org.uk(carbon14, opl3):
+ *          Tremolo and phase generator calculation information.
+ *      OPLx decapsulated(Matthew Gambrell, Olli Niemitalo):
+ *          OPL2 ROMs.
+ *      siliconpr0n.org(John McMaster, digshadow):
+ *          YMF262 and VRC VII decaps and die shots.
+ *
+ * version: 1.8
+ */
+
+/*
+ * The reference core runs feedback, envelope, phase and waveform for each
+ * slot in turn. None of these stages depends on another slot within the
+ * same sample except:
+ *  - the waveform stage, which reads the output of the modulating slot
+ *    (always a slot with a lower number), and
+ *  - the rhythm mode phase of slots 13, 16 and 17, and the noise
+ *    generator, which is clocked once per slot.
+ * So each stage runs over all slots at once, the waveform stage runs
+ * once per modulation depth, and rhythm phases are patched in between.
+ * The channel mixes are taken half way through the reference slot loop,
+ * the slots not yet processed at that point are read from the previous
+ * sample's outputs.
+ */
+
+#include <string.h>
+#include "nukedopl3_simd.h"
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define OPL3S_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define OPL3S_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#   define OPL3S_INLINE static __inline
+#else
+#   define OPL3S_INLINE static inline
+#endif
+
+/*
+ * Vector primitives over 32-bit lanes
+ */
+
+#if defined(OPL3S_AVX2)
+
+typedef __m256i opl3s_vec;
+#define OPL3S_WIDTH 8
+
+#define v_slli(a, n)    _mm256_slli_epi32(a, n)
+#define v_srli(a, n)    _mm256_srli_epi32(a, n)
+#define v_srai(a, n)    _mm256_srai_epi32(a, n)
+
+OPL3S_INLINE opl3s_vec v_load(const Bit32s *p) { return _mm256_loadu_si256((const __m256i *)p); }
+OPL3S_INLINE void v_store(Bit32s *p, opl3s_vec a) { _mm256_storeu_si256((__m256i *)p, a); }
+OPL3S_INLINE opl3s_vec v_set1(Bit32s x) { return _mm256_set1_epi32(x); }
+OPL3S_INLINE opl3s_vec v_add(opl3s_vec a, opl3s_vec b) { return _mm256_add_epi32(a, b); }
+OPL3S_INLINE opl3s_vec v_and(opl3s_vec a, opl3s_vec b) { return _mm256_and_si256(a, b); }
+OPL3S_INLINE opl3s_vec v_or(opl3s_vec a, opl3s_vec b) { return _mm256_or_si256(a, b); }
+OPL3S_INLINE opl3s_vec v_xor(opl3s_vec a, opl3s_vec b) { return _mm256_xor_si256(a, b); }
+OPL3S_INLINE opl3s_vec v_andnot(opl3s_vec a, opl3s_vec b) { return _mm256_andnot_si256(a, b); }
+OPL3S_INLINE opl3s_vec v_eq(opl3s_vec a, opl3s_vec b) { return _mm256_cmpeq_epi32(a, b); }
+OPL3S_INLINE opl3s_vec v_gt(opl3s_vec a, opl3s_vec b) { return _mm256_cmpgt_epi32(a, b); }
+OPL3S_INLINE int v_any(opl3s_vec m) { return _mm256_movemask_epi8(m) != 0; }
+OPL3S_INLINE opl3s_vec v_srav(opl3s_vec a, opl3s_vec n) { return _mm256_srav_epi32(a, n); }
+OPL3S_INLINE opl3s_vec v_srlv(opl3s_vec a, opl3s_vec n) { return _mm256_srlv_epi32(a, n); }
+OPL3S_INLINE opl3s_vec v_gather(const Bit32s *base, opl3s_vec idx)
+{
+    return _mm256_i32gather_epi32((const int *)base, idx, 4);
+}
+
+#elif defined(OPL3S_SSE2)
+
+typedef __m128i opl3s_vec;
+#define OPL3S_WIDTH 4
+
+#define v_slli(a, n)    _mm_slli_epi32(a, n)
+#define v_srli(a, n)    _mm_srli_epi32(a, n)
+#define v_srai(a, n)    _mm_srai_epi32(a, n)
+
+OPL3S_INLINE opl3s_vec v_load(const Bit32s *p) { return _mm_loadu_si128((const __m128i *)p); }
+OPL3S_INLINE void v_store(Bit32s *p, opl3s_vec a) { _mm_storeu_si128((__m128i *)p, a); }
+OPL3S_INLINE opl3s_vec v_set1(Bit32s x) { return _mm_set1_epi32(x); }
+OPL3S_INLINE opl3s_vec v_add(opl3s_vec a, opl3s_vec b) { return _mm_add_epi32(a, b); }
+OPL3S_INLINE opl3s_vec v_and(opl3s_vec a, opl3s_vec b) { return _mm_and_si128(a, b); }
+OPL3S_INLINE opl3s_vec v_or(opl3s_vec a, opl3s_vec b) { return _mm_or_si128(a, b); }
+OPL3S_INLINE opl3s_vec v_xor(opl3s_vec a, opl3s_vec b) { return _mm_xor_si128(a, b); }
+OPL3S_INLINE opl3s_vec v_andnot(opl3s_vec a, opl3s_vec b) { return _mm_andnot_si128(a, b); }
+OPL3S_INLINE opl3s_vec v_eq(opl3s_vec a, opl3s_vec b) { return _mm_cmpeq_epi32(a, b); }
+OPL3S_INLINE opl3s_vec v_gt(opl3s_vec a, opl3s_vec b) { return _mm_cmpgt_epi32(a, b); }
+OPL3S_INLINE int v_any(opl3s_vec m) { return _mm_movemask_epi8(m) != 0; }
+
+/* SSE2 has neither per-lane shifts nor gathers, do them lane by lane */
+OPL3S_INLINE opl3s_vec v_srav(opl3s_vec a, opl3s_vec n)
+{
+    Bit32s x[4], s[4];
+    v_store(x, a);
+    v_store(s, n);
+    return _mm_set_epi32(x[3] >> s[3], x[2] >> s[2], x[1] >> s[1], x[0] >> s[0]);
+}
+
+OPL3S_INLINE opl3s_vec v_srlv(opl3s_vec a, opl3s_vec n)
+{
+    Bit32s x[4], s[4];
+    v_store(x, a);
+    v_store(s, n);
+    return _mm_set_epi32((Bit32s)((Bit32u)x[3] >> s[3]), (Bit32s)((Bit32u)x[2] >> s[2]),
+                         (Bit32s)((Bit32u)x[1] >> s[1]), (Bit32s)((Bit32u)x[0] >> s[0]));
+}
+
+OPL3S_INLINE opl3s_vec v_gather(const Bit32s *base, opl3s_vec idx)
+{
+    Bit32s i[4];
+    v_store(i, idx);
+    return _mm_set_epi32(base[i[3]], base[i[2]], base[i[1]], base[i[0]]);
+}
+
+#else
+
+typedef Bit32s opl3s_vec;
+#define OPL3S_WIDTH 1
+
+#define v_slli(a, n)    ((Bit32s)((Bit32u)(a) << (n)))
+#define v_srli(a, n)    ((Bit32s)((Bit32u)(a) >> (n)))
+#define v_srai(a, n)    ((a) >> (n))
+
+OPL3S_INLINE opl3s_vec v_load(const Bit32s *p) { return *p; }
+OPL3S_INLINE void v_store(Bit32s *p, opl3s_vec a) { *p = a; }
+OPL3S_INLINE opl3s_vec v_set1(Bit32s x) { return x; }
+OPL3S_INLINE opl3s_vec v_add(opl3s_vec a, opl3s_vec b) { return (Bit32s)((Bit32u)a + (Bit32u)b); }
+OPL3S_INLINE opl3s_vec v_and(opl3s_vec a, opl3s_vec b) { return a & b; }
+OPL3S_INLINE opl3s_vec v_or(opl3s_vec a, opl3s_vec b) { return a | b; }
+OPL3S_INLINE opl3s_vec v_xor(opl3s_vec a, opl3s_vec b) { return a ^ b; }
+OPL3S_INLINE opl3s_vec v_andnot(opl3s_vec a, opl3s_vec b) { return ~a & b; }
+OPL3S_INLINE opl3s_vec v_eq(opl3s_vec a, opl3s_vec b) { return -(Bit32s)(a == b); }
+OPL3S_INLINE opl3s_vec v_gt(opl3s_vec a, opl3s_vec b) { return -(Bit32s)(a > b); }
+OPL3S_INLINE int v_any(opl3s_vec m) { return m != 0; }
+OPL3S_INLINE opl3s_vec v_srav(opl3s_vec a, opl3s_vec n) { return a >> n; }
+OPL3S_INLINE opl3s_vec v_srlv(opl3s_vec a, opl3s_vec n) { return (Bit32s)((Bit32u)a >> n); }
+OPL3S_INLINE opl3s_vec v_gather(const Bit32s *base, opl3s_vec idx) { return base[idx]; }
+
+#endif
+
+OPL3S_INLINE opl3s_vec v_not(opl3s_vec a)
+{
+    return v_xor(a, v_set1(-1));
+}
+
+OPL3S_INLINE opl3s_vec v_sel(opl3s_vec mask, opl3s_vec a, opl3s_vec b)
+{
+    return v_or(v_and(mask, a), v_andnot(mask, b));
+}
+
+/* Channel types */
+
+enum {
+    ch_2op = 0,
+    ch_4op = 1,
+    ch_4op2 = 2,
+    ch_drum = 3
+};
+
+/* Envelope key types */
+
+enum {
+    egk_norm = 0x01,
+    egk_drum = 0x02
+};
+
+enum envelope_gen_num
+{
+    envelope_gen_num_attack = 0,
+    envelope_gen_num_decay = 1,
+    envelope_gen_num_sustain = 2,
+    envelope_gen_num_release = 3
+};
+
+#define OPL3S_NO_PAIR   0xff
+
+/*
+ * logsin table, widened to 32 bits for the gathers
+ */
+
+static const Bit32s logsinrom[512] = {
+    0x859, 0x6c3, 0x607, 0x58b, 0x52e, 0x4e4, 0x4a6, 0x471,
+    0x443, 0x41a, 0x3f5, 0x3d3, 0x3b5, 0x398, 0x37e, 0x365,
+    0x34e, 0x339, 0x324, 0x311, 0x2ff, 0x2ed, 0x2dc, 0x2cd,
+    0x2bd, 0x2af, 0x2a0, 0x293, 0x286, 0x279, 0x26d, 0x261,
+    0x256, 0x24b, 0x240, 0x236, 0x22c, 0x222, 0x218, 0x20f,
+    0x206, 0x1fd, 0x1f5, 0x1ec, 0x1e4, 0x1dc, 0x1d4, 0x1cd,
+    0x1c5, 0x1be, 0x1b7, 0x1b0, 0x1a9, 0x1a2, 0x19b, 0x195,
+    0x18f, 0x188, 0x182, 0x17c, 0x177, 0x171, 0x16b, 0x166,
+    0x160, 0x15b, 0x155, 0x150, 0x14b, 0x146, 0x141, 0x13c,
+    0x137, 0x133, 0x12e, 0x129, 0x125, 0x121, 0x11c, 0x118,
+    0x114, 0x10f, 0x10b, 0x107, 0x103, 0x0ff, 0x0fb, 0x0f8,
+    0x0f4, 0x0f0, 0x0ec, 0x0e9, 0x0e5, 0x0e2, 0x0de, 0x0db,
+    0x0d7, 0x0d4, 0x0d1, 0x0cd, 0x0ca, 0x0c7, 0x0c4, 0x0c1,
+    0x0be, 0x0bb, 0x0b8, 0x0b5, 0x0b2, 0x0af, 0x0ac, 0x0a9,
+    0x0a7, 0x0a4, 0x0a1, 0x09f, 0x09c, 0x099, 0x097, 0x094,
+    0x092, 0x08f, 0x08d, 0x08a, 0x088, 0x086, 0x083, 0x081,
+    0x07f, 0x07d, 0x07a, 0x078, 0x076, 0x074, 0x072, 0x070,
+    0x06e, 0x06c, 0x06a, 0x068, 0x066, 0x064, 0x062, 0x060,
+    0x05e, 0x05c, 0x05b, 0x059, 0x057, 0x055, 0x053, 0x052,
+    0x050, 0x04e, 0x04d, 0x04b, 0x04a, 0x048, 0x046, 0x045,
+    0x043, 0x042, 0x040, 0x03f, 0x03e, 0x03c, 0x03b, 0x039,
+    0x038, 0x037, 0x035, 0x034, 0x033, 0x031, 0x030, 0x02f,
+    0x02e, 0x02d, 0x02b, 0x02a, 0x029, 0x028, 0x027, 0x026,
+    0x025, 0x024, 0x023, 0x022, 0x021, 0x020, 0x01f, 0x01e,
+    0x01d, 0x01c, 0x01b, 0x01a, 0x019, 0x018, 0x017, 0x017,
+    0x016, 0x015, 0x014, 0x014, 0x013, 0x012, 0x011, 0x011,
+    0x010, 0x00f, 0x00f, 0x00e, 0x00d, 0x00d, 0x00c, 0x00c,
+    0x00b, 0x00a, 0x00a, 0x009, 0x009, 0x008, 0x008, 0x007,
+    0x007, 0x007, 0x006, 0x006, 0x005, 0x005, 0x005, 0x004,
+    0x004, 0x004, 0x003, 0x003, 0x003, 0x002, 0x002, 0x002,
+    0x002, 0x001, 0x001, 0x001, 0x001, 0x001, 0x001, 0x001,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x001, 0x001, 0x001, 0x001, 0x001, 0x001, 0x001, 0x002,
+    0x002, 0x002, 0x002, 0x003, 0x003, 0x003, 0x004, 0x004,
+    0x004, 0x005, 0x005, 0x005, 0x006, 0x006, 0x007, 0x007,
+    0x007, 0x008, 0x008, 0x009, 0x009, 0x00a, 0x00a, 0x00b,
+    0x00c, 0x00c, 0x00d, 0x00d, 0x00e, 0x00f, 0x00f, 0x010,
+    0x011, 0x011, 0x012, 0x013, 0x014, 0x014, 0x015, 0x016,
+    0x017, 0x017, 0x018, 0x019, 0x01a, 0x01b, 0x01c, 0x01d,
+    0x01e, 0x01f, 0x020, 0x021, 0x022, 0x023, 0x024, 0x025,
+    0x026, 0x027, 0x028, 0x029, 0x02a, 0x02b, 0x02d, 0x02e,
+    0x02f, 0x030, 0x031, 0x033, 0x034, 0x035, 0x037, 0x038,
+    0x039, 0x03b, 0x03c, 0x03e, 0x03f, 0x040, 0x042, 0x043,
+    0x045, 0x046, 0x048, 0x04a, 0x04b, 0x04d, 0x04e, 0x050,
+    0x052, 0x053, 0x055, 0x057, 0x059, 0x05b, 0x05c, 0x05e,
+    0x060, 0x062, 0x064, 0x066, 0x068, 0x06a, 0x06c, 0x06e,
+    0x070, 0x072, 0x074, 0x076, 0x078, 0x07a, 0x07d, 0x07f,
+    0x081, 0x083, 0x086, 0x088, 0x08a, 0x08d, 0x08f, 0x092,
+    0x094, 0x097, 0x099, 0x09c, 0x09f, 0x0a1, 0x0a4, 0x0a7,
+    0x0a9, 0x0ac, 0x0af, 0x0b2, 0x0b5, 0x0b8, 0x0bb, 0x0be,
+    0x0c1, 0x0c4, 0x0c7, 0x0ca, 0x0cd, 0x0d1, 0x0d4, 0x0d7,
+    0x0db, 0x0de, 0x0e2, 0x0e5, 0x0e9, 0x0ec, 0x0f0, 0x0f4,
+    0x0f8, 0x0fb, 0x0ff, 0x103, 0x107, 0x10b, 0x10f, 0x114,
+    0x118, 0x11c, 0x121, 0x125, 0x129, 0x12e, 0x133, 0x137,
+    0x13c, 0x141, 0x146, 0x14b, 0x150, 0x155, 0x15b, 0x160,
+    0x166, 0x16b, 0x171, 0x177, 0x17c, 0x182, 0x188, 0x18f,
+    0x195, 0x19b, 0x1a2, 0x1a9, 0x1b0, 0x1b7, 0x1be, 0x1c5,
+    0x1cd, 0x1d4, 0x1dc, 0x1e4, 0x1ec, 0x1f5, 0x1fd, 0x206,
+    0x20f, 0x218, 0x222, 0x22c, 0x236, 0x240, 0x24b, 0x256,
+    0x261, 0x26d, 0x279, 0x286, 0x293, 0x2a0, 0x2af, 0x2bd,
+    0x2cd, 0x2dc, 0x2ed, 0x2ff, 0x311, 0x324, 0x339, 0x34e,
+    0x365, 0x37e, 0x398, 0x3b5, 0x3d3, 0x3f5, 0x41a, 0x443,
+    0x471, 0x4a6, 0x4e4, 0x52e, 0x58b, 0x607, 0x6c3, 0x859
+};
+
+/*
+ * exp table
+ */
+
+static const Bit32s exprom[256] = {
+    0xff4, 0xfea, 0xfde, 0xfd4, 0xfc8, 0xfbe, 0xfb4, 0xfa8,
+    0xf9e, 0xf92, 0xf88, 0xf7e, 0xf72, 0xf68, 0xf5c, 0xf52,
+    0xf48, 0xf3e, 0xf32, 0xf28, 0xf1e, 0xf14, 0xf08, 0xefe,
+    0xef4, 0xeea, 0xee0, 0xed4, 0xeca, 0xec0, 0xeb6, 0xeac,
+    0xea2, 0xe98, 0xe8e, 0xe84, 0xe7a, 0xe70, 0xe66, 0xe5c,
+    0xe52, 0xe48, 0xe3e, 0xe34, 0xe2a, 0xe20, 0xe16, 0xe0c,
+    0xe04, 0xdfa, 0xdf0, 0xde6, 0xddc, 0xdd2, 0xdca, 0xdc0,
+    0xdb6, 0xdac, 0xda4, 0xd9a, 0xd90, 0xd88, 0xd7e, 0xd74,
+    0xd6a, 0xd62, 0xd58, 0xd50, 0xd46, 0xd3c, 0xd34, 0xd2a,
+    0xd22, 0xd18, 0xd10, 0xd06, 0xcfe, 0xcf4, 0xcec, 0xce2,
+    0xcda, 0xcd0, 0xcc8, 0xcbe, 0xcb6, 0xcae, 0xca4, 0xc9c,
+    0xc92, 0xc8a, 0xc82, 0xc78, 0xc70, 0xc68, 0xc60, 0xc56,
+    0xc4e, 0xc46, 0xc3c, 0xc34, 0xc2c, 0xc24, 0xc1c, 0xc12,
+    0xc0a, 0xc02, 0xbfa, 0xbf2, 0xbea, 0xbe0, 0xbd8, 0xbd0,
+    0xbc8, 0xbc0, 0xbb8, 0xbb0, 0xba8, 0xba0, 0xb98, 0xb90,
+    0xb88, 0xb80, 0xb78, 0xb70, 0xb68, 0xb60, 0xb58, 0xb50,
+    0xb48, 0xb40, 0xb38, 0xb32, 0xb2a, 0xb22, 0xb1a, 0xb12,
+    0xb0a, 0xb02, 0xafc, 0xaf4, 0xaec, 0xae4, 0xade, 0xad6,
+    0xace, 0xac6, 0xac0, 0xab8, 0xab0, 0xaa8, 0xaa2, 0xa9a,
+    0xa92, 0xa8c, 0xa84, 0xa7c, 0xa76, 0xa6e, 0xa68, 0xa60,
+    0xa58, 0xa52, 0xa4a, 0xa44, 0xa3c, 0xa36, 0xa2e, 0xa28,
+    0xa20, 0xa18, 0xa12, 0xa0c, 0xa04, 0x9fe, 0x9f6, 0x9f0,
+    0x9e8, 0x9e2, 0x9da, 0x9d4, 0x9ce, 0x9c6, 0x9c0, 0x9b8,
+    0x9b2, 0x9ac, 0x9a4, 0x99e, 0x998, 0x990, 0x98a, 0x984,
+    0x97c, 0x976, 0x970, 0x96a, 0x962, 0x95c, 0x956, 0x950,
+    0x948, 0x942, 0x93c, 0x936, 0x930, 0x928, 0x922, 0x91c,
+    0x916, 0x910, 0x90a, 0x904, 0x8fc, 0x8f6, 0x8f0, 0x8ea,
+    0x8e4, 0x8de, 0x8d8, 0x8d2, 0x8cc, 0x8c6, 0x8c0, 0x8ba,
+    0x8b4, 0x8ae, 0x8a8, 0x8a2, 0x89c, 0x896, 0x890, 0x88a,
+    0x884, 0x87e, 0x878, 0x872, 0x86c, 0x866, 0x860, 0x85a,
+    0x854, 0x850, 0x84a, 0x844, 0x83e, 0x838, 0x832, 0x82c,
+    0x828, 0x822, 0x81c, 0x816, 0x810, 0x80c, 0x806, 0x800
+};
+
+/*
+ * freq mult table multiplied by 2
+ *
+ * 1/2, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 12, 12, 15, 15
+ */
+
+static const Bit8u mt[16] = {
+    1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 20, 24, 24, 30, 30
+};
+
+/*
+ * ksl table
+ */
+
+static const Bit8u kslrom[16] = {
+    0, 32, 40, 45, 48, 51, 53, 55, 56, 58, 59, 60, 61, 62, 63, 64
+};
+
+static const Bit8u kslshift[4] = {
+    8, 1, 2, 0
+};
+
+/*
+ * envelope generator constants
+ */
+
+static const Bit8u eg_incstep[4][4] = {
+    { 0, 0, 0, 0 },
+    { 1, 0, 0, 0 },
+    { 1, 0, 1, 0 },
+    { 1, 1, 1, 0 }
+};
+
+/*
+ * address decoding
+ */
+
+static const Bit8s ad_slot[0x20] = {
+    0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1,
+    12, 13, 14, 15, 16, 17, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const Bit8u ch_slot[18] = {
+    0, 1, 2, 6, 7, 8, 12, 13, 14, 18, 19, 20, 24, 25, 26, 30, 31, 32
+};
+
+/*
+ * slot to lane mapping
+ *
+ * First operators of all channels take lanes 0-17 and second operators
+ * lanes 20-37, so that in 2-op mode each waveform pass touches whole
+ * vectors only.
+ */
+
+static const Bit8u slot_lane[OPL3S_SLOTS] = {
+    0, 1, 2, 20, 21, 22, 3, 4, 5, 23, 24, 25,
+    6, 7, 8, 26, 27, 28, 9, 10, 11, 29, 30, 31,
+    12, 13, 14, 32, 33, 34, 15, 16, 17, 35, 36, 37
+};
+
+#define OPL3S_NO_SLOT   0xff
+
+/* Lanes of the rhythm slots 13, 16 and 17 */
+#define OPL3S_LANE_HH   7
+#define OPL3S_LANE_SD   27
+#define OPL3S_LANE_TC   28
+
+static const Bit8u lane_slot[OPL3S_LANES] = {
+    0, 1, 2, 6, 7, 8, 12, 13, 14, 18, 19, 20, 24, 25, 26, 30, 31, 32,
+    OPL3S_NO_SLOT, OPL3S_NO_SLOT,
+    3, 4, 5, 9, 10, 11, 15, 16, 17, 21, 22, 23, 27, 28, 29, 33, 34, 35,
+    OPL3S_NO_SLOT, OPL3S_NO_SLOT
+};
+
+/*
+ * Pan law table
+ */
+
+static const Bit16u panlawtable[] =
+{
+    65535, 65529, 65514, 65489, 65454, 65409, 65354, 65289,
+    65214, 65129, 65034, 64929, 64814, 64689, 64554, 64410,
+    64255, 64091, 63917, 63733, 63540, 63336, 63123, 62901,
+    62668, 62426, 62175, 61914, 61644, 61364, 61075, 60776,
+    60468, 60151, 59825, 59489, 59145, 58791, 58428, 58057,
+    57676, 57287, 56889, 56482, 56067, 55643, 55211, 54770,
+    54320, 53863, 53397, 52923, 52441, 51951, 51453, 50947,
+    50433, 49912, 49383, 48846, 48302, 47750, 47191,
+    46340, /* Center left */
+    46340, /* Center right */
+    45472, 44885, 44291, 43690, 43083, 42469, 41848, 41221,
+    40588, 39948, 39303, 38651, 37994, 37330, 36661, 35986,
+    35306, 34621, 33930, 33234, 32533, 31827, 31116, 30400,
+    29680, 28955, 28225, 27492, 26754, 26012, 25266, 24516,
+    23762, 23005, 22244, 21480, 20713, 19942, 19169, 18392,
+    17613, 16831, 16046, 15259, 14469, 13678, 12884, 12088,
+    11291, 10492, 9691, 8888, 8085, 7280, 6473, 5666,
+    4858, 4050, 3240, 2431, 1620, 810, 0
+};
+
+/*
+ * Derived per-slot values
+ *
+ * Everything the reference core recomputes from the channel on every
+ * sample is cached here and refreshed on the register writes that can
+ * change it.
+ */
+
+static void OPL3S_SlotUpdateKSL(opl3s_chip *chip, Bit8u lane)
+{
+    const opl3s_channel *channel = &chip->channel[chip->lane_channel[lane]];
+    Bit16s ksl = (kslrom[channel->f_num >> 6] << 2)
+               - ((0x08 - channel->block) << 5);
+    if (ksl < 0)
+    {
+        ksl = 0;
+    }
+    chip->eg_ksl[lane] = (Bit8u)ksl;
+    chip->eg_base[lane] = (chip->reg_tl[lane] << 2)
+                        + (chip->eg_ksl[lane] >> kslshift[chip->reg_ksl[lane]]);
+}
+
+/* Envelope rate with the key scale applied, as an index into eg_shift */
+static Bit32s OPL3S_EnvelopeRate(Bit8u ks, Bit32s reg_rate)
+{
+    Bit8u rate;
+    Bit8u rate_hi;
+
+    if (!reg_rate)
+    {
+        return 0;
+    }
+    rate = ks + (reg_rate << 2);
+    rate_hi = rate >> 2;
+    if (rate_hi & 0x10)
+    {
+        rate_hi = 0x0f;
+    }
+    return (rate_hi << 2) | (rate & 0x03);
+}
+
+static void OPL3S_SlotUpdateRates(opl3s_chip *chip, Bit8u lane)
+{
+    const opl3s_channel *channel = &chip->channel[chip->lane_channel[lane]];
+    Bit8u ks = channel->ksv >> ((chip->reg_ksr[lane] ^ 1) << 1);
+    chip->eg_rate_att[lane] = OPL3S_EnvelopeRate(ks, chip->reg_ar[lane]);
+    chip->eg_rate_dec[lane] = OPL3S_EnvelopeRate(ks, chip->reg_dr[lane]);
+    chip->eg_rate_rel[lane] = OPL3S_EnvelopeRate(ks, chip->reg_rr[lane]);
+    chip->eg_rate_sus[lane] = chip->reg_type[lane] ? 0 : chip->eg_rate_rel[lane];
+}
+
+/*
+ * Envelope increment shift for every rate, per state of the global
+ * envelope timer. Rates of zero map to index 0 and never advance.
+ */
+static void OPL3S_EnvelopeInitShifts(opl3s_chip *chip)
+{
+    Bit8u eg_state, eg_add, timer, rate_hi, rate_lo;
+    Bit8u eg_shift, shift;
+    Bit8u rate;
+
+    for (eg_state = 0; eg_state < 2; eg_state++)
+    {
+        for (eg_add = 0; eg_add < 14; eg_add++)
+        {
+            for (timer = 0; timer < 4; timer++)
+            {
+                for (rate = 0; rate < 64; rate++)
+                {
+                    rate_hi = rate >> 2;
+                    rate_lo = rate & 0x03;
+                    eg_shift = rate_hi + eg_add;
+                    shift = 0;
+                    if (rate == 0)
+                    {
+                        shift = 0;
+                    }
+                    else if (rate_hi < 12)
+                    {
+                        if (eg_state)
+                        {
+                            switch (eg_shift)
+                            {
+                            case 12:
+                                shift = 1;
+                                break;
+                            case 13:
+                                shift = (rate_lo >> 1) & 0x01;
+                                break;
+                            case 14:
+                                shift = rate_lo & 0x01;
+                                break;
+                            default:
+                                break;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        shift = (rate_hi & 0x03) + eg_incstep[rate_lo][timer];
+                        if (shift & 0x04)
+                        {
+                            shift = 0x03;
+                        }
+                        if (!shift)
+                        {
+                            shift = eg_state;
+                        }
+                    }
+                    chip->eg_shift[eg_state][eg_add][timer][rate] = shift;
+                }
+            }
+        }
+    }
+}
+
+static void OPL3S_SlotUpdatePhaseInc(opl3s_chip *chip, Bit8u lane)
+{
+    const opl3s_channel *channel = &chip->channel[chip->lane_channel[lane]];
+    Bit16u f_num;
+    Bit32u basefreq;
+
+    f_num = channel->f_num;
+    if (chip->reg_vib[lane])
+    {
+        Bit8s range;
+        Bit8u vibpos;
+
+        range = (f_num >> 7) & 7;
+        vibpos = chip->vibpos;
+
+        if (!(vibpos & 3))
+        {
+            range = 0;
+        }
+        else if (vibpos & 1)
+        {
+            range >>= 1;
+        }
+        range >>= chip->vibshift;
+
+        if (vibpos & 4)
+        {
+            range = -range;
+        }
+        f_num += range;
+    }
+    basefreq = (f_num << channel->block) >> 1;
+    chip->pg_inc[lane] = (Bit32s)((basefreq * mt[chip->reg_mult[lane]]) >> 1);
+}
+
+static void OPL3S_ChannelUpdateSlots(opl3s_chip *chip, opl3s_channel *channel)
+{
+    Bit8u i;
+    for (i = 0; i < 2; i++)
+    {
+        OPL3S_SlotUpdateKSL(chip, channel->slotz[i]);
+        OPL3S_SlotUpdateRates(chip, channel->slotz[i]);
+        OPL3S_SlotUpdatePhaseInc(chip, channel->slotz[i]);
+    }
+}
+
+static void OPL3S_UpdateVibrato(opl3s_chip *chip)
+{
+    Bit8u lane;
+    for (lane = 0; lane < OPL3S_LANES; lane++)
+    {
+        if (chip->reg_vib[lane])
+        {
+            OPL3S_SlotUpdatePhaseInc(chip, lane);
+        }
+    }
+}
+
+/*
+ * Waveform evaluation order and mixer taps
+ *
+ * A slot is evaluated on the pass after its modulator. Modulators always
+ * have a lower slot number, so one walk in slot order assigns the depths.
+ */
+
+static void OPL3S_UpdateOrder(opl3s_chip *chip)
+{
+    Bit8u slot;
+    Bit8u lane;
+    Bit8u ch;
+    Bit8u i;
+    Bit32s level;
+    Bit32s src;
+
+    for (lane = 0; lane < OPL3S_LANES; lane++)
+    {
+        chip->wave_level[lane] = -1;
+    }
+
+    chip->wave_levels = 1;
+    for (slot = 0; slot < OPL3S_SLOTS; slot++)
+    {
+        lane = slot_lane[slot];
+        src = chip->mod[lane] - OPL3S_BANK_OUT;
+        level = 0;
+        if (src >= 0 && src < OPL3S_LANES)
+        {
+            level = chip->wave_level[src] + 1;
+        }
+        chip->wave_level[lane] = level;
+        if (level + 1 > chip->wave_levels)
+        {
+            chip->wave_levels = (Bit8u)(level + 1);
+        }
+    }
+
+    for (ch = 0; ch < 18; ch++)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            src = chip->channel[ch].out[i];
+            if (src == OPL3S_BANK_ZERO)
+            {
+                chip->mix_l[ch][i] = OPL3S_BANK_ZERO;
+                chip->mix_r[ch][i] = OPL3S_BANK_ZERO;
+                continue;
+            }
+            slot = lane_slot[src];
+            chip->mix_l[ch][i] = (Bit16u)(slot < 15 ? OPL3S_BANK_OUT + src : OPL3S_BANK_PREV + src);
+            chip->mix_r[ch][i] = (Bit16u)(slot < 33 ? OPL3S_BANK_OUT + src : OPL3S_BANK_PREV + src);
+        }
+    }
+
+    chip->order_dirty = 0;
+}
+
+/*
+ * Slot
+ */
+
+static void OPL3S_EnvelopeKeyOn(opl3s_chip *chip, Bit8u lane, Bit8u type)
+{
+    chip->key[lane] |= type;
+}
+
+static void OPL3S_EnvelopeKeyOff(opl3s_chip *chip, Bit8u lane, Bit8u type)
+{
+    chip->key[lane] &= ~type;
+}
+
+static void OPL3S_SlotWrite20(opl3s_chip *chip, Bit8u lane, Bit8u data)
+{
+    chip->trem_mask[lane] = ((data >> 7) & 0x01) ? -1 : 0;
+    chip->reg_vib[lane] = (data >> 6) & 0x01;
+    chip->reg_type[lane] = (data >> 5) & 0x01;
+    chip->reg_ksr[lane] = (data >> 4) & 0x01;
+    chip->reg_mult[lane] = data & 0x0f;
+    OPL3S_SlotUpdateRates(chip, lane);
+    OPL3S_SlotUpdatePhaseInc(chip, lane);
+}
+
+static void OPL3S_SlotWrite40(opl3s_chip *chip, Bit8u lane, Bit8u data)
+{
+    chip->reg_ksl[lane] = (data >> 6) & 0x03;
+    chip->reg_tl[lane] = data & 0x3f;
+    OPL3S_SlotUpdateKSL(chip, lane);
+}
+
+static void OPL3S_SlotWrite60(opl3s_chip *chip, Bit8u lane, Bit8u data)
+{
+    chip->reg_ar[lane] = (data >> 4) & 0x0f;
+    chip->reg_dr[lane] = data & 0x0f;
+    OPL3S_SlotUpdateRates(chip, lane);
+}
+
+static void OPL3S_SlotWrite80(opl3s_chip *chip, Bit8u lane, Bit8u data)
+{
+    chip->reg_sl[lane] = (data >> 4) & 0x0f;
+    if (chip->reg_sl[lane] == 0x0f)
+    {
+        chip->reg_sl[lane] = 0x1f;
+    }
+    chip->reg_rr[lane] = data & 0x0f;
+    OPL3S_SlotUpdateRates(chip, lane);
+}
+
+static void OPL3S_SlotWriteE0(opl3s_chip *chip, Bit8u lane, Bit8u data)
+{
+    chip->reg_wf[lane] = data & 0x07;
+    if (chip->newm == 0x00)
+    {
+        chip->reg_wf[lane] &= 0x03;
+    }
+
+    switch (chip->reg_wf[lane])
+    {
+    case 1:
+    case 4:
+    case 5:
+        chip->maskzero[lane] = 0x200;
+        break;
+    case 3:
+        chip->maskzero[lane] = 0x100;
+        break;
+    default:
+        chip->maskzero[lane] = 0;
+        break;
+    }
+
+    switch (chip->reg_wf[lane])
+    {
+    case 4:
+        chip->signmask[lane] = 0x100;
+        break;
+    case 0:
+    case 6:
+    case 7:
+        chip->signmask[lane] = 0x200;
+        break;
+    default:
+        chip->signmask[lane] = 0;
+        break;
+    }
+
+    switch (chip->reg_wf[lane])
+    {
+    case 4:
+    case 5:
+        chip->phaseshift[lane] = 1;
+        break;
+    case 6:
+        chip->phaseshift[lane] = 16; /* set phase to zero and flag for non-sin wave */
+        break;
+    case 7:
+        chip->phaseshift[lane] = 32; /* no shift, but flag for non-sin wave */
+        break;
+    default:
+        chip->phaseshift[lane] = 0;
+        break;
+    }
+}
+
+/*
+ * Channel
+ */
+
+static void OPL3S_ChannelSetupAlg(opl3s_chip *chip, opl3s_channel *channel);
+
+static void OPL3S_ChannelUpdateRhythm(opl3s_chip *chip, Bit8u data)
+{
+    opl3s_channel *channel6;
+    opl3s_channel *channel7;
+    opl3s_channel *channel8;
+    Bit8u chnum;
+
+    chip->rhy = data & 0x3f;
+    chip->order_dirty = 1;
+    if (chip->rhy & 0x20)
+    {
+        channel6 = &chip->channel[6];
+        channel7 = &chip->channel[7];
+        channel8 = &chip->channel[8];
+        channel6->out[0] = OPL3S_BANK_OUT + channel6->slotz[1];
+        channel6->out[1] = OPL3S_BANK_OUT + channel6->slotz[1];
+        channel6->out[2] = OPL3S_BANK_ZERO;
+        channel6->out[3] = OPL3S_BANK_ZERO;
+        channel7->out[0] = OPL3S_BANK_OUT + channel7->slotz[0];
+        channel7->out[1] = OPL3S_BANK_OUT + channel7->slotz[0];
+        channel7->out[2] = OPL3S_BANK_OUT + channel7->slotz[1];
+        channel7->out[3] = OPL3S_BANK_OUT + channel7->slotz[1];
+        channel8->out[0] = OPL3S_BANK_OUT + channel8->slotz[0];
+        channel8->out[1] = OPL3S_BANK_OUT + channel8->slotz[0];
+        channel8->out[2] = OPL3S_BANK_OUT + channel8->slotz[1];
+        channel8->out[3] = OPL3S_BANK_OUT + channel8->slotz[1];
+        for (chnum = 6; chnum < 9; chnum++)
+        {
+            chip->channel[chnum].chtype = ch_drum;
+        }
+        OPL3S_ChannelSetupAlg(chip, channel6);
+        OPL3S_ChannelSetupAlg(chip, channel7);
+        OPL3S_ChannelSetupAlg(chip, channel8);
+        /* hh */
+        if (chip->rhy & 0x01)
+        {
+            OPL3S_EnvelopeKeyOn(chip, channel7->slotz[0], egk_drum);
+        }
+        else
+        {
+            OPL3S_EnvelopeKeyOff(chip, channel7->slotz[0], egk_drum);
+        }
+        /* tc */
+        if (chip->rhy & 0x02)
+        {
+            OPL3S_EnvelopeKeyOn(chip, channel8->slotz[1], egk_drum);
+        }
+        else
+        {
+            OPL3S_EnvelopeKeyOff(chip, channel8->slotz[1], egk_drum);
+        }
+        /* tom */
+        if (chip->rhy & 0x04)
+        {
+            OPL3S_EnvelopeKeyOn(chip, channel8->slotz[0], egk_drum);
+        }
+        else
+        {
+            OPL3S_EnvelopeKeyOff(chip, channel8->slotz[0], egk_drum);
+        }
+        /* sd */
+        if (chip->rhy & 0x08)
+        {
+            OPL3S_EnvelopeKeyOn(chip, channel7->slotz[1], egk_drum);
+        }
+        else
+        {
+            OPL3S_EnvelopeKeyOff(chip, channel7->slotz[1], egk_drum);
+        }
+        /* bd */
+        if (chip->rhy & 0x10)
+        {
+            OPL3S_EnvelopeKeyOn(chip, channel6->slotz[0], egk_drum);
+            OPL3S_EnvelopeKeyOn(chip, channel6->slotz[1], egk_drum);
+        }
+        else
+        {
+            OPL3S_EnvelopeKeyOff(chip, channel6->slotz[0], egk_drum);
+            OPL3S_EnvelopeKeyOff(chip, channel6->slotz[1], egk_drum);
+        }
+    }
+    else
+    {
+        for (chnum = 6; chnum < 9; chnum++)
+        {
+            chip->channel[chnum].chtype = ch_2op;
+            OPL3S_ChannelSetupAlg(chip, &chip->channel[chnum]);
+            OPL3S_EnvelopeKeyOff(chip, chip->channel[chnum].slotz[0], egk_drum);
+            OPL3S_EnvelopeKeyOff(chip, chip->channel[chnum].slotz[1], egk_drum);
+        }
+    }
+}
+
+static void OPL3S_ChannelWriteA0(opl3s_chip *chip, opl3s_channel *channel, Bit8u data)
+{
+    opl3s_channel *pair;
+    if (chip->newm && channel->chtype == ch_4op2)
+    {
+        return;
+    }
+    channel->f_num = (channel->f_num & 0x300) | data;
+    channel->ksv = (channel->block << 1)
+                 | ((channel->f_num >> (0x09 - chip->nts)) & 0x01);
+    OPL3S_ChannelUpdateSlots(chip, channel);
+    if (chip->newm && channel->chtype == ch_4op)
+    {
+        pair = &chip->channel[channel->pair];
+        pair->f_num = channel->f_num;
+        pair->ksv = channel->ksv;
+        OPL3S_ChannelUpdateSlots(chip, pair);
+    }
+}
+
+static void OPL3S_ChannelWriteB0(opl3s_chip *chip, opl3s_channel *channel, Bit8u data)
+{
+    opl3s_channel *pair;
+    if (chip->newm && channel->chtype == ch_4op2)
+    {
+        return;
+    }
+    channel->f_num = (channel->f_num & 0xff) | ((data & 0x03) << 8);
+    channel->block = (data >> 2) & 0x07;
+    channel->ksv = (channel->block << 1)
+                 | ((channel->f_num >> (0x09 - chip->nts)) & 0x01);
+    OPL3S_ChannelUpdateSlots(chip, channel);
+    if (chip->newm && channel->chtype == ch_4op)
+    {
+        pair = &chip->channel[channel->pair];
+        pair->f_num = channel->f_num;
+        pair->block = channel->block;
+        pair->ksv = channel->ksv;
+        OPL3S_ChannelUpdateSlots(chip, pair);
+    }
+}
+
+static void OPL3S_ChannelSetupAlg(opl3s_chip *chip, opl3s_channel *channel)
+{
+    opl3s_channel *pair;
+    Bit8u s0 = channel->slotz[0];
+    Bit8u s1 = channel->slotz[1];
+    Bit8u p0, p1;
+
+    chip->order_dirty = 1;
+    if (channel->chtype == ch_drum)
+    {
+        if (channel->ch_num == 7 || channel->ch_num == 8)
+        {
+            chip->mod[s0] = OPL3S_BANK_ZERO;
+            chip->mod[s1] = OPL3S_BANK_ZERO;
+            return;
+        }
+        switch (channel->alg & 0x01)
+        {
+        case 0x00:
+            chip->mod[s0] = OPL3S_BANK_FB + s0;
+            chip->mod[s1] = OPL3S_BANK_OUT + s0;
+            break;
+        case 0x01:
+            chip->mod[s0] = OPL3S_BANK_FB + s0;
+            chip->mod[s1] = OPL3S_BANK_ZERO;
+            break;
+        }
+        return;
+    }
+    if (channel->alg & 0x08)
+    {
+        return;
+    }
+    if (channel->alg & 0x04)
+    {
+        pair = &chip->channel[channel->pair];
+        p0 = pair->slotz[0];
+        p1 = pair->slotz[1];
+        pair->out[0] = OPL3S_BANK_ZERO;
+        pair->out[1] = OPL3S_BANK_ZERO;
+        pair->out[2] = OPL3S_BANK_ZERO;
+        pair->out[3] = OPL3S_BANK_ZERO;
+        switch (channel->alg & 0x03)
+        {
+        case 0x00:
+            chip->mod[p0] = OPL3S_BANK_FB + p0;
+            chip->mod[p1] = OPL3S_BANK_OUT + p0;
+            chip->mod[s0] = OPL3S_BANK_OUT + p1;
+            chip->mod[s1] = OPL3S_BANK_OUT + s0;
+            channel->out[0] = OPL3S_BANK_OUT + s1;
+            channel->out[1] = OPL3S_BANK_ZERO;
+            channel->out[2] = OPL3S_BANK_ZERO;
+            channel->out[3] = OPL3S_BANK_ZERO;
+            break;
+        case 0x01:
+            chip->mod[p0] = OPL3S_BANK_FB + p0;
+            chip->mod[p1] = OPL3S_BANK_OUT + p0;
+            chip->mod[s0] = OPL3S_BANK_ZERO;
+            chip->mod[s1] = OPL3S_BANK_OUT + s0;
+            channel->out[0] = OPL3S_BANK_OUT + p1;
+            channel->out[1] = OPL3S_BANK_OUT + s1;
+            channel->out[2] = OPL3S_BANK_ZERO;
+            channel->out[3] = OPL3S_BANK_ZERO;
+            break;
+        case 0x02:
+            chip->mod[p0] = OPL3S_BANK_FB + p0;
+            chip->mod[p1] = OPL3S_BANK_ZERO;
+            chip->mod[s0] = OPL3S_BANK_OUT + p1;
+            chip->mod[s1] = OPL3S_BANK_OUT + s0;
+            channel->out[0] = OPL3S_BANK_OUT + p0;
+            channel->out[1] = OPL3S_BANK_OUT + s1;
+            channel->out[2] = OPL3S_BANK_ZERO;
+            channel->out[3] = OPL3S_BANK_ZERO;
+            break;
+        case 0x03:
+            chip->mod[p0] = OPL3S_BANK_FB + p0;
+            chip->mod[p1] = OPL3S_BANK_ZERO;
+            chip->mod[s0] = OPL3S_BANK_OUT + p1;
+            chip->mod[s1] = OPL3S_BANK_ZERO;
+            channel->out[0] = OPL3S_BANK_OUT + p0;
+            channel->out[1] = OPL3S_BANK_OUT + s0;
+            channel->out[2] = OPL3S_BANK_OUT + s1;
+            channel->out[3] = OPL3S_BANK_ZERO;
+            break;
+        }
+    }
+    else
+    {
+        switch (channel->alg & 0x01)
+        {
+        case 0x00:
+            chip->mod[s0] = OPL3S_BANK_FB + s0;
+            chip->mod[s1] = OPL3S_BANK_OUT + s0;
+            channel->out[0] = OPL3S_BANK_OUT + s1;
+            channel->out[1] = OPL3S_BANK_ZERO;
+            channel->out[2] = OPL3S_BANK_ZERO;
+            channel->out[3] = OPL3S_BANK_ZERO;
+            break;
+        case 0x01:
+            chip->mod[s0] = OPL3S_BANK_FB + s0;
+            chip->mod[s1] = OPL3S_BANK_ZERO;
+            channel->out[0] = OPL3S_BANK_OUT + s0;
+            channel->out[1] = OPL3S_BANK_OUT + s1;
+            channel->out[2] = OPL3S_BANK_ZERO;
+            channel->out[3] = OPL3S_BANK_ZERO;
+            break;
+        }
+    }
+}
+
+static void OPL3S_ChannelWriteC0(opl3s_chip *chip, opl3s_channel *channel, Bit8u data)
+{
+    opl3s_channel *pair = NULL;
+    Bit8u i;
+
+    if (channel->pair != OPL3S_NO_PAIR)
+    {
+        pair = &chip->channel[channel->pair];
+    }
+
+    channel->fb = (data & 0x0e) >> 1;
+    channel->con = data & 0x01;
+    channel->alg = channel->con;
+    for (i = 0; i < 2; i++)
+    {
+        chip->fb_shift[channel->slotz[i]] = channel->fb ? 0x09 - channel->fb : 0;
+        chip->fb_mask[channel->slotz[i]] = channel->fb ? -1 : 0;
+    }
+    if (chip->newm)
+    {
+        if (channel->chtype == ch_4op)
+        {
+            pair->alg = 0x04 | (channel->con << 1) | (pair->con);
+            channel->alg = 0x08;
+            OPL3S_ChannelSetupAlg(chip, pair);
+        }
+        else if (channel->chtype == ch_4op2)
+        {
+            channel->alg = 0x04 | (pair->con << 1) | (channel->con);
+            pair->alg = 0x08;
+            OPL3S_ChannelSetupAlg(chip, channel);
+        }
+        else
+        {
+            OPL3S_ChannelSetupAlg(chip, channel);
+        }
+    }
+    else
+    {
+        OPL3S_ChannelSetupAlg(chip, channel);
+    }
+    if (chip->newm)
+    {
+        channel->cha = ((data >> 4) & 0x01) ? ~0 : 0;
+        channel->chb = ((data >> 5) & 0x01) ? ~0 : 0;
+    }
+    else
+    {
+        channel->cha = channel->chb = (Bit16u)~0;
+    }
+}
+
+static void OPL3S_ChannelKey(opl3s_chip *chip, opl3s_channel *channel, Bit8u on)
+{
+    Bit8u slots[4];
+    Bit8u count = 0;
+    Bit8u i;
+
+    if (chip->newm)
+    {
+        if (channel->chtype == ch_4op)
+        {
+            slots[count++] = channel->slotz[0];
+            slots[count++] = channel->slotz[1];
+            slots[count++] = chip->channel[channel->pair].slotz[0];
+            slots[count++] = chip->channel[channel->pair].slotz[1];
+        }
+        else if (channel->chtype == ch_2op || channel->chtype == ch_drum)
+        {
+            slots[count++] = channel->slotz[0];
+            slots[count++] = channel->slotz[1];
+        }
+    }
+    else
+    {
+        slots[count++] = channel->slotz[0];
+        slots[count++] = channel->slotz[1];
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (on)
+        {
+            OPL3S_EnvelopeKeyOn(chip, slots[i], egk_norm);
+        }
+        else
+        {
+            OPL3S_EnvelopeKeyOff(chip, slots[i], egk_norm);
+        }
+    }
+}
+
+static void OPL3S_ChannelSet4Op(opl3s_chip *chip, Bit8u data)
+{
+    Bit8u bit;
+    Bit8u chnum;
+    for (bit = 0; bit < 6; bit++)
+    {
+        chnum = bit;
+        if (bit >= 3)
+        {
+            chnum += 9 - 3;
+        }
+        if ((data >> bit) & 0x01)
+        {
+            chip->channel[chnum].chtype = ch_4op;
+            chip->channel[chnum + 3].chtype = ch_4op2;
+        }
+        else
+        {
+            chip->channel[chnum].chtype = ch_2op;
+            chip->channel[chnum + 3].chtype = ch_2op;
+        }
+    }
+}
+
+/*
+ * Generation stages
+ */
+
+static void OPL3S_FeedbackStage(opl3s_chip *chip)
+{
+    Bitu i;
+    opl3s_vec out;
+    opl3s_vec prout;
+    opl3s_vec fbmod;
+
+    for (i = 0; i < OPL3S_LANES; i += OPL3S_WIDTH)
+    {
+        out = v_load(&chip->bank[OPL3S_BANK_OUT + i]);
+        prout = v_load(&chip->bank[OPL3S_BANK_PREV + i]);
+        fbmod = v_srav(v_add(prout, out), v_load(&chip->fb_shift[i]));
+        v_store(&chip->bank[OPL3S_BANK_FB + i], v_and(fbmod, v_load(&chip->fb_mask[i])));
+        v_store(&chip->bank[OPL3S_BANK_PREV + i], out);
+    }
+}
+
+static void OPL3S_EnvelopeStage(opl3s_chip *chip)
+{
+    const opl3s_vec zero = v_set1(0);
+    const opl3s_vec one = v_set1(1);
+    const opl3s_vec two = v_set1(2);
+    const opl3s_vec three = v_set1(3);
+    const opl3s_vec rout_max = v_set1(0x1ff);
+    const opl3s_vec tremolo = v_set1(chip->tremolo);
+    const Bit32s *eg_shift = chip->eg_shift[chip->eg_state][chip->eg_add][chip->timer & 0x03];
+    opl3s_vec rout, gen, keyon, out;
+    opl3s_vec is_att, is_dec, reset;
+    opl3s_vec rate, rate_max, shift, shift_pos;
+    opl3s_vec eg_off, rout_zero, sl_hit, new_rout, nrout;
+    opl3s_vec att_inc, att_cond, lin_inc, lin_cond;
+    Bitu i;
+
+    for (i = 0; i < OPL3S_LANES; i += OPL3S_WIDTH)
+    {
+        rout = v_load(&chip->eg_rout[i]);
+        gen = v_load(&chip->eg_gen[i]);
+        keyon = v_not(v_eq(v_load(&chip->key[i]), zero));
+
+        out = v_add(v_add(rout, v_load(&chip->eg_base[i])),
+                    v_and(tremolo, v_load(&chip->trem_mask[i])));
+        out = v_sel(v_gt(out, rout_max), rout_max, out);
+        v_store(&chip->eg_out[i], v_slli(out, 3));
+
+        is_att = v_eq(gen, zero);
+        is_dec = v_eq(gen, one);
+        reset = v_and(keyon, v_eq(gen, three));
+        v_store(&chip->pg_reset[i], reset);
+
+        rate = v_sel(v_eq(gen, two), v_load(&chip->eg_rate_sus[i]), v_load(&chip->eg_rate_rel[i]));
+        rate = v_sel(is_dec, v_load(&chip->eg_rate_dec[i]), rate);
+        rate = v_sel(v_or(is_att, reset), v_load(&chip->eg_rate_att[i]), rate);
+        rate_max = v_gt(rate, v_set1(59));
+        shift = v_gather(eg_shift, rate);
+        shift_pos = v_gt(shift, zero);
+
+        /* Instant attack */
+        new_rout = v_andnot(v_and(reset, rate_max), rout);
+        /* Envelope off */
+        eg_off = v_eq(v_and(rout, v_set1(0x1f8)), v_set1(0x1f8));
+        new_rout = v_sel(v_andnot(v_or(is_att, reset), eg_off), rout_max, new_rout);
+
+        rout_zero = v_eq(rout, zero);
+        sl_hit = v_and(is_dec, v_eq(v_srli(rout, 4), v_load(&chip->reg_sl[i])));
+
+        nrout = v_not(rout);
+        att_inc = v_sel(v_eq(shift, two), v_slli(nrout, 2), v_slli(nrout, 3));
+        att_inc = v_srai(v_sel(v_eq(shift, one), v_slli(nrout, 1), att_inc), 4);
+        att_cond = v_and(v_andnot(v_or(rout_zero, rate_max), is_att), v_and(keyon, shift_pos));
+
+        lin_inc = v_sel(v_eq(shift, one), one, v_sel(v_eq(shift, two), two, v_set1(4)));
+        lin_cond = v_andnot(v_or(v_or(is_att, sl_hit), v_or(eg_off, reset)), shift_pos);
+
+        new_rout = v_add(new_rout, v_or(v_and(att_cond, att_inc), v_and(lin_cond, lin_inc)));
+        v_store(&chip->eg_rout[i], v_and(new_rout, rout_max));
+
+        gen = v_sel(v_and(is_att, rout_zero), one, gen);
+        gen = v_sel(sl_hit, two, gen);
+        gen = v_andnot(reset, gen);
+        gen = v_sel(keyon, gen, three);
+        v_store(&chip->eg_gen[i], gen);
+    }
+}
+
+static void OPL3S_PhaseStage(opl3s_chip *chip)
+{
+    Bitu i;
+    opl3s_vec phase;
+
+    for (i = 0; i < OPL3S_LANES; i += OPL3S_WIDTH)
+    {
+        phase = v_load((const Bit32s *)&chip->pg_phase[i]);
+        v_store(&chip->pg_phase_out[i], v_and(v_srli(phase, 9), v_set1(0xffff)));
+        phase = v_andnot(v_load(&chip->pg_reset[i]), phase);
+        v_store((Bit32s *)&chip->pg_phase[i], v_add(phase, v_load(&chip->pg_inc[i])));
+    }
+}
+
+/* Clocks the noise LFSR by up to 9 steps at once */
+static Bit32u OPL3S_NoiseStep(Bit32u noise, Bit8u steps)
+{
+    Bit32u bits = (noise ^ (noise >> 14)) & ((1u << steps) - 1);
+    return (noise >> steps) | (bits << (23 - steps));
+}
+
+static void OPL3S_RhythmStage(opl3s_chip *chip)
+{
+    Bit32u noise13, noise16;
+    Bit16u phase;
+    Bit8u rm_xor;
+
+    /* The reference core clocks the noise once per slot */
+    noise13 = OPL3S_NoiseStep(OPL3S_NoiseStep(chip->noise, 9), 4);
+    noise16 = OPL3S_NoiseStep(noise13, 3);
+    chip->noise = OPL3S_NoiseStep(OPL3S_NoiseStep(OPL3S_NoiseStep(noise16, 9), 9), 2);
+
+    phase = (Bit16u)chip->pg_phase_out[OPL3S_LANE_HH];
+    chip->rm_hh_bit2 = (phase >> 2) & 1;
+    chip->rm_hh_bit3 = (phase >> 3) & 1;
+    chip->rm_hh_bit7 = (phase >> 7) & 1;
+    chip->rm_hh_bit8 = (phase >> 8) & 1;
+
+    if (!(chip->rhy & 0x20))
+    {
+        return;
+    }
+
+    /* hh, sees the top cymbal bits of the previous sample */
+    rm_xor = (chip->rm_hh_bit2 ^ chip->rm_hh_bit7)
+           | (chip->rm_hh_bit3 ^ chip->rm_tc_bit5)
+           | (chip->rm_tc_bit3 ^ chip->rm_tc_bit5);
+    chip->pg_phase_out[OPL3S_LANE_HH] = rm_xor << 9;
+    if (rm_xor ^ (noise13 & 1))
+    {
+        chip->pg_phase_out[OPL3S_LANE_HH] |= 0xd0;
+    }
+    else
+    {
+        chip->pg_phase_out[OPL3S_LANE_HH] |= 0x34;
+    }
+
+    /* sd */
+    chip->pg_phase_out[OPL3S_LANE_SD] = (chip->rm_hh_bit8 << 9)
+                           | ((chip->rm_hh_bit8 ^ (noise16 & 1)) << 8);
+
+    /* tc */
+    phase = (Bit16u)chip->pg_phase_out[OPL3S_LANE_TC];
+    chip->rm_tc_bit3 = (phase >> 3) & 1;
+    chip->rm_tc_bit5 = (phase >> 5) & 1;
+    rm_xor = (chip->rm_hh_bit2 ^ chip->rm_hh_bit7)
+           | (chip->rm_hh_bit3 ^ chip->rm_tc_bit5)
+           | (chip->rm_tc_bit3 ^ chip->rm_tc_bit5);
+    chip->pg_phase_out[OPL3S_LANE_TC] = (rm_xor << 9) | 0x80;
+}
+
+static void OPL3S_WaveStage(opl3s_chip *chip)
+{
+    const opl3s_vec zero = v_set1(0);
+    const opl3s_vec one = v_set1(1);
+    const opl3s_vec mask16 = v_set1(0xffff);
+    opl3s_vec sel, phase, mute, neg, shift, level, out;
+    Bit32s depth;
+    Bitu i;
+
+    for (depth = 0; depth < chip->wave_levels; depth++)
+    {
+        for (i = 0; i < OPL3S_LANES; i += OPL3S_WIDTH)
+        {
+            sel = v_eq(v_load(&chip->wave_level[i]), v_set1(depth));
+            if (!v_any(sel))
+            {
+                continue;
+            }
+
+            phase = v_add(v_load(&chip->pg_phase_out[i]),
+                          v_gather(chip->bank, v_load(&chip->mod[i])));
+            phase = v_and(phase, mask16);
+
+            /* Fast paths for mute segments */
+            mute = v_not(v_eq(v_and(phase, v_load(&chip->maskzero[i])), zero));
+            neg = v_not(v_eq(v_and(phase, v_load(&chip->signmask[i])), zero));
+
+            shift = v_load(&chip->phaseshift[i]);
+            phase = v_sel(v_eq(shift, one), v_and(v_slli(phase, 1), mask16), phase);
+            phase = v_andnot(v_eq(shift, v_set1(16)), phase);
+
+            level = v_sel(v_gt(v_set1(2), shift),
+                          v_gather(logsinrom, v_and(phase, v_set1(0x1ff))),
+                          v_slli(v_and(v_xor(phase, neg), v_set1(0x3ff)), 3));
+            level = v_add(v_load(&chip->eg_out[i]), level);
+
+            /* The exponent may exceed 31 on the linear waveforms, the
+             * reference build wraps the shift count like x86 does */
+            out = v_srlv(v_gather(exprom, v_and(level, v_set1(0xff))),
+                         v_and(v_srli(level, 8), v_set1(31)));
+            out = v_andnot(mute, v_xor(out, neg));
+
+            v_store(&chip->bank[OPL3S_BANK_OUT + i],
+                    v_sel(sel, out, v_load(&chip->bank[OPL3S_BANK_OUT + i])));
+        }
+    }
+}
+
+static Bit32s OPL3S_Mix(const opl3s_chip *chip, const Bit16u *taps, Bit8u right)
+{
+    const opl3s_channel *channel;
+    Bit32s mix = 0;
+    Bit16s accm;
+    Bit8u ii;
+
+    for (ii = 0; ii < 18; ii++)
+    {
+        channel = &chip->channel[ii];
+        accm = (Bit16s)(chip->bank[taps[0]] + chip->bank[taps[1]]
+                      + chip->bank[taps[2]] + chip->bank[taps[3]]);
+        taps += 4;
+        if (right)
+        {
+            mix += (Bit16s)((accm * channel->chr / 65535) & channel->chb);
+        }
+        else
+        {
+            mix += (Bit16s)((accm * channel->chl / 65535) & channel->cha);
+        }
+    }
+    return mix;
+}
+
+static Bit16s OPL3S_ClipSample(Bit32s sample)
+{
+    if (sample > 32767)
+    {
+        sample = 32767;
+    }
+    else if (sample < -32768)
+    {
+        sample = -32768;
+    }
+    return (Bit16s)sample;
+}
+
+void OPL3S_Generate(opl3s_chip *chip, Bit16s *buf)
+{
+    Bit8u shift = 0;
+    Bit8u vibpos = chip->vibpos;
+
+    if (chip->order_dirty)
+    {
+        OPL3S_UpdateOrder(chip);
+    }
+
+    buf[1] = OPL3S_ClipSample(chip->mixbuff[1]);
+
+    OPL3S_FeedbackStage(chip);
+    OPL3S_EnvelopeStage(chip);
+    OPL3S_PhaseStage(chip);
+    OPL3S_RhythmStage(chip);
+    OPL3S_WaveStage(chip);
+
+    chip->mixbuff[0] = OPL3S_Mix(chip, &chip->mix_l[0][0], 0);
+    buf[0] = OPL3S_ClipSample(chip->mixbuff[0]);
+    chip->mixbuff[1] = OPL3S_Mix(chip, &chip->mix_r[0][0], 1);
+
+    if ((chip->timer & 0x3f) == 0x3f)
+    {
+        chip->tremolopos = (chip->tremolopos + 1) % 210;
+    }
+    if (chip->tremolopos < 105)
+    {
+        chip->tremolo = chip->tremolopos >> chip->tremoloshift;
+    }
+    else
+    {
+        chip->tremolo = (210 - chip->tremolopos) >> chip->tremoloshift;
+    }
+
+    if ((chip->timer & 0x3ff) == 0x3ff)
+    {
+        chip->vibpos = (chip->vibpos + 1) & 7;
+    }
+    if (chip->vibpos != vibpos)
+    {
+        OPL3S_UpdateVibrato(chip);
+    }
+
+    chip->timer++;
+
+    chip->eg_add = 0;
+    if (chip->eg_timer)
+    {
+        while (shift < 36 && ((chip->eg_timer >> shift) & 1) == 0)
+        {
+            shift++;
+        }
+        if (shift > 12)
+        {
+            chip->eg_add = 0;
+        }
+        else
+        {
+            chip->eg_add = shift + 1;
+        }
+    }
+
+    if (chip->eg_timerrem || chip->eg_state)
+    {
+        if (chip->eg_timer == 0xfffffffffULL)
+        {
+            chip->eg_timer = 0;
+            chip->eg_timerrem = 1;
+        }
+        else
+        {
+            chip->eg_timer++;
+            chip->eg_timerrem = 0;
+        }
+    }
+
+    chip->eg_state ^= 1;
+
+    while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+    {
+        if (!(chip->writebuf[chip->writebuf_cur].reg & 0x200))
+        {
+            break;
+        }
+        chip->writebuf[chip->writebuf_cur].reg &= 0x1ff;
+        OPL3S_WriteReg(chip, chip->writebuf[chip->writebuf_cur].reg,
+                       chip->writebuf[chip->writebuf_cur].data);
+        chip->writebuf_cur = (chip->writebuf_cur + 1) % OPL_WRITEBUF_SIZE;
+    }
+    chip->writebuf_samplecnt++;
+}
+
+void OPL3S_GenerateN(opl3s_chip *chip, Bit16s *buf, Bit32u frames)
+{
+    Bit32u i;
+    for (i = 0; i < frames; i++)
+    {
+        OPL3S_Generate(chip, buf);
+        buf += 2;
+    }
+}
+
+void OPL3S_Reset(opl3s_chip *chip)
+{
+    Bit8u lane;
+    Bit8u channum;
+    opl3s_channel *channel;
+
+    memset(chip, 0, sizeof(opl3s_chip));
+    OPL3S_EnvelopeInitShifts(chip);
+    for (lane = 0; lane < OPL3S_LANES; lane++)
+    {
+        chip->mod[lane] = OPL3S_BANK_ZERO;
+        chip->eg_rout[lane] = 0x1ff;
+        chip->eg_out[lane] = 0x1ff << 3;
+        chip->eg_gen[lane] = envelope_gen_num_release;
+        chip->signmask[lane] = 0x200;
+    }
+    for (channum = 0; channum < 18; channum++)
+    {
+        channel = &chip->channel[channum];
+        channel->slotz[0] = slot_lane[ch_slot[channum]];
+        channel->slotz[1] = slot_lane[ch_slot[channum] + 3];
+        chip->lane_channel[channel->slotz[0]] = channum;
+        chip->lane_channel[channel->slotz[1]] = channum;
+        if ((channum % 9) < 3)
+        {
+            channel->pair = channum + 3;
+        }
+        else if ((channum % 9) < 6)
+        {
+            channel->pair = channum - 3;
+        }
+        else
+        {
+            channel->pair = OPL3S_NO_PAIR;
+        }
+        channel->out[0] = OPL3S_BANK_ZERO;
+        channel->out[1] = OPL3S_BANK_ZERO;
+        channel->out[2] = OPL3S_BANK_ZERO;
+        channel->out[3] = OPL3S_BANK_ZERO;
+        channel->chtype = ch_2op;
+        channel->cha = 0xffff;
+        channel->chb = 0xffff;
+        channel->chl = 46340;
+        channel->chr = 46340;
+        channel->ch_num = channum;
+        OPL3S_ChannelSetupAlg(chip, channel);
+    }
+    chip->noise = 1;
+    chip->tremoloshift = 4;
+    chip->vibshift = 1;
+    OPL3S_UpdateOrder(chip);
+}
+
+static void OPL3S_ChannelWritePan(opl3s_channel *channel, Bit8u data)
+{
+    channel->chl = panlawtable[data & 0x7F];
+    channel->chr = panlawtable[0x7F - (data & 0x7F)];
+}
+
+void OPL3S_WritePan(opl3s_chip *chip, Bit16u reg, Bit8u v)
+{
+    Bit8u high = (reg >> 8) & 0x01;
+    Bit8u regm = reg & 0xff;
+    OPL3S_ChannelWritePan(&chip->channel[9 * high + (regm & 0x0f)], v);
+}
+
+void OPL3S_WriteReg(opl3s_chip *chip, Bit16u reg, Bit8u v)
+{
+    Bit8u high = (reg >> 8) & 0x01;
+    Bit8u regm = reg & 0xff;
+    switch (regm & 0xf0)
+    {
+    case 0x00:
+        if (high)
+        {
+            switch (regm & 0x0f)
+            {
+            case 0x04:
+                OPL3S_ChannelSet4Op(chip, v);
+                break;
+            case 0x05:
+                chip->newm = v & 0x01;
+                break;
+            }
+        }
+        else
+        {
+            switch (regm & 0x0f)
+            {
+            case 0x08:
+                chip->nts = (v >> 6) & 0x01;
+                break;
+            }
+        }
+        break;
+    case 0x20:
+    case 0x30:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3S_SlotWrite20(chip, slot_lane[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0x40:
+    case 0x50:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3S_SlotWrite40(chip, slot_lane[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0x60:
+    case 0x70:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3S_SlotWrite60(chip, slot_lane[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0x80:
+    case 0x90:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3S_SlotWrite80(chip, slot_lane[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0xe0:
+    case 0xf0:
+        if (ad_slot[regm & 0x1f] >= 0)
+        {
+            OPL3S_SlotWriteE0(chip, slot_lane[18 * high + ad_slot[regm & 0x1f]], v);
+        }
+        break;
+    case 0xa0:
+        if ((regm & 0x0f) < 9)
+        {
+            OPL3S_ChannelWriteA0(chip, &chip->channel[9 * high + (regm & 0x0f)], v);
+        }
+        break;
+    case 0xb0:
+        if (regm == 0xbd && !high)
+        {
+            chip->tremoloshift = (((v >> 7) ^ 1) << 1) + 2;
+            chip->vibshift = ((v >> 6) & 0x01) ^ 1;
+            OPL3S_UpdateVibrato(chip);
+            OPL3S_ChannelUpdateRhythm(chip, v);
+        }
+        else if ((regm & 0x0f) < 9)
+        {
+            OPL3S_ChannelWriteB0(chip, &chip->channel[9 * high + (regm & 0x0f)], v);
+            OPL3S_ChannelKey(chip, &chip->channel[9 * high + (regm & 0x0f)], (v & 0x20) != 0);
+        }
+        break;
+    case 0xc0:
+        if ((regm & 0x0f) < 9)
+        {
+            OPL3S_ChannelWriteC0(chip, &chip->channel[9 * high + (regm & 0x0f)], v);
+        }
+        break;
+    }
+}
+
+void OPL3S_WriteRegBuffered(opl3s_chip *chip, Bit16u reg, Bit8u v)
+{
+    Bit64u time1, time2;
+
+    if (chip->writebuf[chip->writebuf_last].reg & 0x200)
+    {
+        OPL3S_WriteReg(chip, chip->writebuf[chip->writebuf_last].reg & 0x1ff,
+                       chip->writebuf[chip->writebuf_last].data);
+
+        chip->writebuf_cur = (chip->writebuf_last + 1) % OPL_WRITEBUF_SIZE;
+        chip->writebuf_samplecnt = chip->writebuf[chip->writebuf_last].time;
+    }
+
+    chip->writebuf[chip->writebuf_last].reg = reg | 0x200;
+    chip->writebuf[chip->writebuf_last].data = v;
+    time1 = chip->writebuf_lasttime + OPL_WRITEBUF_DELAY;
+    time2 = chip->writebuf_samplecnt;
+
+    if (time1 < time2)
+    {
+        time1 = time2;
+    }
+
+    chip->writebuf[chip->writebuf_last].time = time1;
+    chip->writebuf_lasttime = time1;
+    chip->writebuf_last = (chip->writebuf_last + 1) % OPL_WRITEBUF_SIZE;
+}
+
+const char *OPL3S_InstructionSet(void)
+{
+#if defined(OPL3S_AVX2)
+    return "AVX2";
+#elif defined(OPL3S_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2013-2018 Alexey Khokholov (Nuke.YKT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ *  Nuked OPL3 emulator, structure-of-arrays variant.
+ *
+ *  Produces the same output as Nuked OPL3 1.8 (nukedopl3.c, built with
+ *  OPL_FAST_WAVEGEN), but keeps the operator state in per-field arrays
+ *  so that the envelope, phase and waveform stages are evaluated for
+ *  several operators at once with SSE2 or AVX2 (scalar otherwise).
+ *
+ * version: 1.8
+ */
+
+#ifndef OPL_OPL3_SIMD_H
+#define OPL_OPL3_SIMD_H
+
+#include "nukedopl3.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Operators are padded to a multiple of the widest vector (8 lanes).
+ * Per-operator arrays are indexed by lane, not by slot number.
+ */
+#define OPL3S_SLOTS     36
+#define OPL3S_LANES     40
+
+/*
+ * Every value an operator can be modulated by, or a channel can mix,
+ * lives in one bank, so that a single index addresses it:
+ * current outputs, feedback values, outputs of the previous sample
+ * and a block of zeroes.
+ */
+#define OPL3S_BANK_OUT  (0 * OPL3S_LANES)
+#define OPL3S_BANK_FB   (1 * OPL3S_LANES)
+#define OPL3S_BANK_PREV (2 * OPL3S_LANES)
+#define OPL3S_BANK_ZERO (3 * OPL3S_LANES)
+#define OPL3S_BANK_SIZE (4 * OPL3S_LANES)
+
+typedef struct _opl3s_channel {
+    Bit8u slotz[2];     /* lanes of the operators */
+    Bit8u pair;
+    Bit8u chtype;
+    Bit16u out[4];      /* bank indices of the outputs */
+    Bit16u f_num;
+    Bit8u block;
+    Bit8u fb;
+    Bit8u con;
+    Bit8u alg;
+    Bit8u ksv;
+    Bit16u cha, chb;
+    Bit16u chl, chr;
+    Bit8u ch_num;
+} opl3s_channel;
+
+typedef struct _opl3s_chip {
+    /* Per-operator state, one 32-bit lane per slot */
+    Bit32s bank[OPL3S_BANK_SIZE];
+    Bit32s mod[OPL3S_LANES];        /* bank index of the modulator */
+    Bit32s wave_level[OPL3S_LANES]; /* modulation depth, see OPL3S_UpdateOrder */
+    Bit32s fb_shift[OPL3S_LANES];
+    Bit32s fb_mask[OPL3S_LANES];
+    Bit32s eg_rout[OPL3S_LANES];
+    Bit32s eg_out[OPL3S_LANES];
+    Bit32s eg_gen[OPL3S_LANES];
+    Bit32s eg_ksl[OPL3S_LANES];
+    Bit32s eg_base[OPL3S_LANES];    /* total level and KSL attenuation */
+    Bit32s eg_rate_att[OPL3S_LANES];/* key scaled rates, see OPL3S_EnvelopeRate */
+    Bit32s eg_rate_dec[OPL3S_LANES];
+    Bit32s eg_rate_sus[OPL3S_LANES];
+    Bit32s eg_rate_rel[OPL3S_LANES];
+    Bit32s trem_mask[OPL3S_LANES];
+    Bit32s key[OPL3S_LANES];
+    Bit32s reg_vib[OPL3S_LANES];
+    Bit32s reg_type[OPL3S_LANES];
+    Bit32s reg_ksr[OPL3S_LANES];
+    Bit32s reg_mult[OPL3S_LANES];
+    Bit32s reg_ksl[OPL3S_LANES];
+    Bit32s reg_tl[OPL3S_LANES];
+    Bit32s reg_ar[OPL3S_LANES];
+    Bit32s reg_dr[OPL3S_LANES];
+    Bit32s reg_sl[OPL3S_LANES];
+    Bit32s reg_rr[OPL3S_LANES];
+    Bit32s reg_wf[OPL3S_LANES];
+    Bit32s pg_reset[OPL3S_LANES];
+    Bit32u pg_phase[OPL3S_LANES];
+    Bit32s pg_phase_out[OPL3S_LANES];
+    Bit32s pg_inc[OPL3S_LANES];     /* phase increment incl. vibrato */
+    Bit32s maskzero[OPL3S_LANES];
+    Bit32s signmask[OPL3S_LANES];
+    Bit32s phaseshift[OPL3S_LANES];
+    Bit8u lane_channel[OPL3S_LANES];
+    Bit32s eg_shift[2][14][4][64];  /* [eg_state][eg_add][timer & 3][rate] */
+
+    opl3s_channel channel[18];
+    Bit8u order_dirty;
+    Bit8u wave_levels;
+    Bit16u mix_l[18][4];            /* bank indices read by the left mix */
+    Bit16u mix_r[18][4];            /* bank indices read by the right mix */
+
+    Bit16u timer;
+    Bit64u eg_timer;
+    Bit8u eg_timerrem;
+    Bit8u eg_state;
+    Bit8u eg_add;
+    Bit8u newm;
+    Bit8u nts;
+    Bit8u rhy;
+    Bit8u vibpos;
+    Bit8u vibshift;
+    Bit8u tremolo;
+    Bit8u tremolopos;
+    Bit8u tremoloshift;
+    Bit32u noise;
+    Bit32s mixbuff[2];
+    Bit8u rm_hh_bit2;
+    Bit8u rm_hh_bit3;
+    Bit8u rm_hh_bit7;
+    Bit8u rm_hh_bit8;
+    Bit8u rm_tc_bit3;
+    Bit8u rm_tc_bit5;
+
+    Bit64u writebuf_samplecnt;
+    Bit32u writebuf_cur;
+    Bit32u writebuf_last;
+    Bit64u writebuf_lasttime;
+    opl3_writebuf writebuf[OPL_WRITEBUF_SIZE];
+} opl3s_chip;
+
+void OPL3S_Generate(opl3s_chip *chip, Bit16s *buf);
+void OPL3S_GenerateN(opl3s_chip *chip, Bit16s *buf, Bit32u frames);
+void OPL3S_Reset(opl3s_chip *chip);
+void OPL3S_WriteReg(opl3s_chip *chip, Bit16u reg, Bit8u v);
+void OPL3S_WriteRegBuffered(opl3s_chip *chip, Bit16u reg, Bit8u v);
+void OPL3S_WritePan(opl3s_chip *chip, Bit16u reg, Bit8u v);
+const char *OPL3S_InstructionSet(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
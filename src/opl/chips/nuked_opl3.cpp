@@ -69,6 +69,78 @@ void NukedOPL3::nativeGenerate(int16_t *frame)
     OPL3_Generate(chip_r, frame);
 }
 
+void NukedOPL3::nativeGenerateN(int16_t *output, size_t frames)
+{
+    opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
+    for(size_t i = 0; i < frames; ++i)
+    {
+        OPL3_Generate(chip_r, output);
+        output += 2;
+    }
+}
+
+bool NukedOPL3::nativeIsIdle() const
+{
+    const opl3_chip *chip_r = reinterpret_cast<const opl3_chip*>(m_chip);
+    return OPL3_IsIdle(chip_r) != 0;
+}
+
+void NukedOPL3::nativeSkip(size_t frames)
+{
+    opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
+    OPL3_Skip(chip_r, (Bit32u)frames);
+}
+
+namespace
+{
+// chip contents and the address they were copied from,
+// to move the internal pointers into the chip restoring them
+struct NukedState
+{
+    const opl3_chip *origin;
+    opl3_chip chip;
+};
+}
+
+size_t NukedOPL3::nativeStateSize() const
+{
+    return sizeof(NukedState);
+}
+
+void NukedOPL3::nativeSaveState(void *state) const
+{
+    const opl3_chip *chip_r = reinterpret_cast<const opl3_chip*>(m_chip);
+    NukedState *state_r = static_cast<NukedState *>(state);
+    state_r->origin = chip_r;
+    std::memcpy(&state_r->chip, chip_r, sizeof(opl3_chip));
+}
+
+void NukedOPL3::nativeRestoreState(const void *state)
+{
+    opl3_chip *chip_r = reinterpret_cast<opl3_chip*>(m_chip);
+    const NukedState *state_r = static_cast<const NukedState *>(state);
+    const opl3_chip *origin = state_r->origin;
+    std::memcpy(chip_r, &state_r->chip, sizeof(opl3_chip));
+    for(size_t i = 0; i < 36; ++i)
+    {
+        opl3_slot &slot = chip_r->slot[i];
+        relocatePointer(slot.channel, origin, chip_r);
+        relocatePointer(slot.chip, origin, chip_r);
+        relocatePointer(slot.mod, origin, chip_r);
+        relocatePointer(slot.trem, origin, chip_r);
+    }
+    for(size_t i = 0; i < 18; ++i)
+    {
+        opl3_channel &channel = chip_r->channel[i];
+        relocatePointer(channel.slotz[0], origin, chip_r);
+        relocatePointer(channel.slotz[1], origin, chip_r);
+        relocatePointer(channel.pair, origin, chip_r);
+        relocatePointer(channel.chip, origin, chip_r);
+        for(size_t j = 0; j < 4; ++j)
+            relocatePointer(channel.out[j], origin, chip_r);
+    }
+}
+
 const char *NukedOPL3::emulatorName()
 {
     return "Nuked OPL3 (v 1.8)";
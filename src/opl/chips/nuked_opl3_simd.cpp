@@ -0,0 +1,102 @@
+/*
+ * Interfaces over Yamaha OPL3 (YMF262) chip emulators
+ *
+ * Copyright (c) 2017-2022 Vitaly Novichkov (Wohlstand)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "nuked_opl3_simd.h"
+#include "nuked/nukedopl3_simd.h"
+#include <string>
+#include <cstring>
+
+NukedOPL3SIMD::NukedOPL3SIMD() :
+    OPLChipBaseT()
+{
+    m_chip = new opl3s_chip;
+    setRate(m_rate);
+}
+
+NukedOPL3SIMD::~NukedOPL3SIMD()
+{
+    opl3s_chip *chip_r = reinterpret_cast<opl3s_chip*>(m_chip);
+    delete chip_r;
+}
+
+void NukedOPL3SIMD::setRate(uint32_t rate)
+{
+    OPLChipBaseT::setRate(rate);
+    opl3s_chip *chip_r = reinterpret_cast<opl3s_chip*>(m_chip);
+    OPL3S_Reset(chip_r);
+}
+
+void NukedOPL3SIMD::reset()
+{
+    OPLChipBaseT::reset();
+    opl3s_chip *chip_r = reinterpret_cast<opl3s_chip*>(m_chip);
+    OPL3S_Reset(chip_r);
+}
+
+void NukedOPL3SIMD::writeReg(uint16_t addr, uint8_t data)
+{
+    opl3s_chip *chip_r = reinterpret_cast<opl3s_chip*>(m_chip);
+    OPL3S_WriteRegBuffered(chip_r, addr, data);
+}
+
+void NukedOPL3SIMD::writePan(uint16_t addr, uint8_t data)
+{
+    opl3s_chip *chip_r = reinterpret_cast<opl3s_chip*>(m_chip);
+    OPL3S_WritePan(chip_r, addr, data);
+}
+
+void NukedOPL3SIMD::nativeGenerate(int16_t *frame)
+{
+    opl3s_chip *chip_r = reinterpret_cast<opl3s_chip*>(m_chip);
+    OPL3S_Generate(chip_r, frame);
+}
+
+void NukedOPL3SIMD::nativeGenerateN(int16_t *output, size_t frames)
+{
+    opl3s_chip *chip_r = reinterpret_cast<opl3s_chip*>(m_chip);
+    OPL3S_GenerateN(chip_r, output, static_cast<uint32_t>(frames));
+}
+
+size_t NukedOPL3SIMD::nativeStateSize() const
+{
+    return sizeof(opl3s_chip);
+}
+
+void NukedOPL3SIMD::nativeSaveState(void *state) const
+{
+    // operators and channels refer to each other by index, a plain copy is enough
+    std::memcpy(state, m_chip, sizeof(opl3s_chip));
+}
+
+void NukedOPL3SIMD::nativeRestoreState(const void *state)
+{
+    std::memcpy(m_chip, state, sizeof(opl3s_chip));
+}
+
+const char *NukedOPL3SIMD::emulatorName()
+{
+    static const std::string name = std::string("Nuked OPL3 SIMD (v 1.8, ") + OPL3S_InstructionSet() + ")";
+    return name.c_str();
+}
+
+OPLChipBase::ChipType NukedOPL3SIMD::chipType()
+{
+    return CHIPTYPE_OPL3;
+}
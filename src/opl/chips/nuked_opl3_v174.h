@@ -38,6 +38,10 @@ public:
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
     void nativeGenerate(int16_t *frame) override;
+    void nativeGenerateN(int16_t *output, size_t frames) override;
+    size_t nativeStateSize() const;
+    void nativeSaveState(void *state) const;
+    void nativeRestoreState(const void *state);
     const char *emulatorName() override;
     ChipType chipType() override;
 };
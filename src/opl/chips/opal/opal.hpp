@@ -48,8 +48,11 @@ class Opal {
                             Operator();
             void            SetMaster(Opal *opal) {  Master = opal;  }
             void            SetChannel(Channel *chan) {  Chan = chan;  }
+            void            Relocate(const Opal *from, Opal *to) {  Rebase(Master, from, to);  Rebase(Chan, from, to);  } /* libADLMIDI */
 
             int16_t         Output(uint16_t keyscalenum, uint32_t phase_step, int16_t vibrato, int16_t mod = 0, int16_t fbshift = 0);
+            bool            IsOff() const {  return EnvelopeStage == EnvOff;  } /* libADLMIDI */
+            void            Skip(uint32_t phase_step, int16_t vibrato, uint32_t ticks); /* libADLMIDI */
 
             void            SetKeyOn(bool on);
             void            SetTremoloEnable(bool on);
@@ -125,8 +128,16 @@ class Opal {
             }
 
             void            Output(int16_t &left, int16_t &right);
+            bool            IsIdle() const; /* libADLMIDI */
+            void            Skip(uint32_t ticks); /* libADLMIDI */
             void            SetEnable(bool on) {  Enable = on;  }
             void            SetChannelPair(Channel *pair) {  ChannelPair = pair;  }
+            void            Relocate(const Opal *from, Opal *to) { /* libADLMIDI */
+                for (int i = 0; i < 4; i++)
+                    Rebase(Op[i], from, to);
+                Rebase(Master, from, to);
+                Rebase(ChannelPair, from, to);
+            }
 
             void            SetFrequencyLow(uint16_t freq);
             void            SetFrequencyHigh(uint16_t freq);
@@ -148,6 +159,7 @@ class Opal {
 
         protected:
             void            ComputePhaseStep();
+            int16_t         ComputeVibrato() const; /* libADLMIDI */
 
             Operator *      Op[4];
 
@@ -172,6 +184,15 @@ class Opal {
         void                Port(uint16_t reg_num, uint8_t val);
         void                Pan(uint16_t reg_num, uint8_t pan);
         void                Sample(int16_t *left, int16_t *right);
+        void                Relocate(const Opal *from); /* libADLMIDI: fix pointers of a copy of another chip */
+        bool                IsIdle() const; /* libADLMIDI */
+        void                Skip(int samples); /* libADLMIDI */
+
+        template <class P>
+        static void         Rebase(P *&ptr, const Opal *from, Opal *to) { /* libADLMIDI */
+            if (ptr)
+                ptr = reinterpret_cast<P *>(reinterpret_cast<char *>(to) + (reinterpret_cast<const char *>(ptr) - reinterpret_cast<const char *>(from)));
+        }
 
     protected:
         void                Init(int sample_rate);
@@ -589,6 +610,20 @@ void Opal::Pan(uint16_t reg_num, uint8_t pan)
 
 
 
+//==================================================================================================
+// Fix up the internal pointers after the object was copied byte by byte from another instance.
+// This is extended functionality.
+//==================================================================================================
+void Opal::Relocate(const Opal *from)
+{
+    for (int i = 0; i < NumChannels; i++)
+        Chan[i].Relocate(from, this);
+    for (int i = 0; i < NumOperators; i++)
+        Op[i].Relocate(from, this);
+}
+
+
+
 //==================================================================================================
 // Generate sample.  Every time you call this you will get two signed 16-bit samples (one for each
 // stereo channel) which will sound correct when played back at the sample rate given when the
@@ -671,6 +706,68 @@ void Opal::Output(int16_t &left, int16_t &right) {
 
 
 
+//==================================================================================================
+// Check whether the chip produces nothing but silence, until the next register write.
+// This is extended functionality.
+//==================================================================================================
+bool Opal::IsIdle() const {
+
+    if (LastOutput[0] || LastOutput[1] || CurrOutput[0] || CurrOutput[1])
+        return false;
+
+    for (int i = 0; i < NumChannels; i++)
+        if (!Chan[i].IsIdle())
+            return false;
+
+    return true;
+}
+
+
+
+//==================================================================================================
+// Advance an idle chip by a number of output samples, as Sample() would, without producing them.
+// This is extended functionality.
+//==================================================================================================
+void Opal::Skip(int samples) {
+
+    // Count the OPL3 samples which Sample() would produce
+    uint32_t ticks = 0;
+    for (int i = 0; i < samples; i++) {
+        while (SampleAccum >= SampleRate) {
+            ticks++;
+            SampleAccum -= SampleRate;
+        }
+        SampleAccum += OPL3SampleRate;
+    }
+
+    // The vibrato only changes each 1,024 samples, advance in spans of a constant vibrato
+    while (ticks > 0) {
+
+        uint32_t span = 1024 - VibratoTick;
+        if (span > ticks)
+            span = ticks;
+
+        for (int i = 0; i < NumChannels; i++)
+            Chan[i].Skip(span);
+
+        Clock += span;
+        TremoloClock = (TremoloClock + span) % 13440;
+        TremoloLevel = ((TremoloClock < 13440 / 2) ? TremoloClock : 13440 - TremoloClock) / 256;
+        if (!TremoloDepth)
+            TremoloLevel >>= 2;
+
+        VibratoTick += span;
+        if (VibratoTick >= 1024) {
+            VibratoTick = 0;
+            VibratoClock = (VibratoClock + 1) & 7;
+        }
+
+        ticks -= span;
+    }
+}
+
+
+
 //==================================================================================================
 // Channel constructor.
 //==================================================================================================
@@ -701,22 +798,7 @@ void Opal::Channel::Output(int16_t &left, int16_t &right) {
         return;
     }
 
-    int16_t vibrato = (Freq >> 7) & 7;
-    if (!Master->VibratoDepth)
-        vibrato >>= 1;
-
-    // 0  3  7  3  0  -3  -7  -3
-    uint16_t clk = Master->VibratoClock;
-    if (!(clk & 3))
-        vibrato = 0;                // Position 0 and 4 is zero
-    else {
-        if (clk & 1)
-            vibrato >>= 1;          // Odd positions are half the magnitude
-        if (clk & 4)
-            vibrato = -vibrato;     // The second half positions are negative
-    }
-
-    vibrato <<= Octave;
+    int16_t vibrato = ComputeVibrato();
 
     // Combine individual operator outputs
     int16_t out, acc;
@@ -791,6 +873,68 @@ void Opal::Channel::Output(int16_t &left, int16_t &right) {
 
 
 
+//==================================================================================================
+// Vibrato offset of the phase step, at the current position of the vibrato clock.
+//==================================================================================================
+int16_t Opal::Channel::ComputeVibrato() const {
+
+    int16_t vibrato = (Freq >> 7) & 7;
+    if (!Master->VibratoDepth)
+        vibrato >>= 1;
+
+    // 0  3  7  3  0  -3  -7  -3
+    uint16_t clk = Master->VibratoClock;
+    if (!(clk & 3))
+        vibrato = 0;                // Position 0 and 4 is zero
+    else {
+        if (clk & 1)
+            vibrato >>= 1;          // Odd positions are half the magnitude
+        if (clk & 4)
+            vibrato = -vibrato;     // The second half positions are negative
+    }
+
+    vibrato <<= Octave;
+    return vibrato;
+}
+
+
+
+//==================================================================================================
+// Check whether all operators used by the channel are off.
+// This is extended functionality.
+//==================================================================================================
+bool Opal::Channel::IsIdle() const {
+
+    if (!Enable)
+        return true;
+
+    int numops = ChannelPair ? 4 : 2;
+    for (int i = 0; i < numops; i++)
+        if (!Op[i]->IsOff())
+            return false;
+
+    return true;
+}
+
+
+
+//==================================================================================================
+// Advance an idle channel by a number of OPL3 samples, with a constant vibrato.
+// This is extended functionality.
+//==================================================================================================
+void Opal::Channel::Skip(uint32_t ticks) {
+
+    if (!Enable)
+        return;
+
+    int16_t vibrato = ComputeVibrato();
+    int numops = ChannelPair ? 4 : 2;
+    for (int i = 0; i < numops; i++)
+        Op[i]->Skip(PhaseStep, vibrato, ticks);
+}
+
+
+
 //==================================================================================================
 // Set phase step for operators using this channel.
 //==================================================================================================
@@ -1156,6 +1300,20 @@ int16_t Opal::Operator::Output(uint16_t /*keyscalenum*/, uint32_t phase_step, in
 
 
 
+//==================================================================================================
+// Advance the phase of an operator which is off, as that many calls of Output() would.
+// This is extended functionality.
+//==================================================================================================
+void Opal::Operator::Skip(uint32_t phase_step, int16_t vibrato, uint32_t ticks) {
+
+    if (VibratoEnable)
+        phase_step += vibrato;
+    Phase += ((phase_step * FreqMultTimes2) / 2) * ticks;
+    Out[0] = Out[1] = 0;
+}
+
+
+
 //==================================================================================================
 // Trigger operator.
 //==================================================================================================
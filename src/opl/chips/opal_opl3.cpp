@@ -75,6 +75,60 @@ void OpalOPL3::nativeGenerate(int16_t *frame)
     chip_r->Sample(&frame[0], &frame[1]);
 }
 
+void OpalOPL3::nativeGenerateN(int16_t *output, size_t frames)
+{
+    Opal *chip_r = reinterpret_cast<Opal *>(m_chip);
+    for(size_t i = 0; i < frames; ++i)
+    {
+        chip_r->Sample(&output[0], &output[1]);
+        output += 2;
+    }
+}
+
+bool OpalOPL3::nativeIsIdle() const
+{
+    const Opal *chip_r = reinterpret_cast<const Opal *>(m_chip);
+    return chip_r->IsIdle();
+}
+
+void OpalOPL3::nativeSkip(size_t frames)
+{
+    Opal *chip_r = reinterpret_cast<Opal *>(m_chip);
+    chip_r->Skip((int)frames);
+}
+
+namespace
+{
+// chip contents and the address they were copied from,
+// to move the internal pointers into the chip restoring them
+struct OpalState
+{
+    const Opal *origin;
+    char chip[sizeof(Opal)];
+};
+}
+
+size_t OpalOPL3::nativeStateSize() const
+{
+    return sizeof(OpalState);
+}
+
+void OpalOPL3::nativeSaveState(void *state) const
+{
+    const Opal *chip_r = reinterpret_cast<const Opal *>(m_chip);
+    OpalState *state_r = static_cast<OpalState *>(state);
+    state_r->origin = chip_r;
+    std::memcpy(state_r->chip, chip_r, sizeof(Opal));
+}
+
+void OpalOPL3::nativeRestoreState(const void *state)
+{
+    Opal *chip_r = reinterpret_cast<Opal *>(m_chip);
+    const OpalState *state_r = static_cast<const OpalState *>(state);
+    std::memcpy(static_cast<void *>(chip_r), state_r->chip, sizeof(Opal));
+    chip_r->Relocate(state_r->origin);
+}
+
 const char *OpalOPL3::emulatorName()
 {
     return "Opal OPL3";
@@ -27,9 +27,7 @@
 #define override
 #endif
 
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-class VResampler;
-#endif
+#include "common/sinc_resampler.hpp"
 
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
 extern void adl_audioTickHandler(void *instance, uint32_t chipId, uint32_t rate);
@@ -43,6 +41,10 @@ public:
     {
         CHIPTYPE_OPL3 = 0, CHIPTYPE_OPL2 = 1
     };
+    enum ResamplerQuality
+    {
+        RESAMPLER_LINEAR = 0, RESAMPLER_SINC16 = 1, RESAMPLER_SINC48 = 2
+    };
 protected:
     uint32_t m_id;
     uint32_t m_rate;
@@ -62,8 +64,15 @@ public:
 
     virtual void setRate(uint32_t rate) = 0;
     virtual uint32_t effectiveRate() const = 0;
+    virtual ResamplerQuality resamplerQuality() const = 0;
+    virtual void setResamplerQuality(ResamplerQuality quality) = 0;
     virtual void reset() = 0;
     virtual void writeReg(uint16_t addr, uint8_t data) = 0;
+    // queues a register write which takes effect at the given output frame,
+    // counted from the start of the next generate call. Writes are applied in
+    // the order they are queued, an offset before the one of the previous
+    // queued write is moved up to it.
+    virtual void writeRegAt(uint16_t addr, uint8_t data, uint32_t sampleOffset) = 0;
 
     // extended
     virtual void writePan(uint16_t addr, uint8_t data) { (void)addr; (void)data; }
@@ -71,21 +80,47 @@ public:
     virtual void nativePreGenerate() = 0;
     virtual void nativePostGenerate() = 0;
     virtual void nativeGenerate(int16_t *frame) = 0;
+    virtual void nativeGenerateN(int16_t *output, size_t frames) = 0;
 
     virtual void generate(int16_t *output, size_t frames) = 0;
     virtual void generateAndMix(int16_t *output, size_t frames) = 0;
     virtual void generate32(int32_t *output, size_t frames) = 0;
     virtual void generateAndMix32(int32_t *output, size_t frames) = 0;
+    // floating point output, unclamped, full scale of 16-bit output is 1.0
+    virtual void generateFloat(float *output, size_t frames) = 0;
+    virtual void generateAndMixFloat(float *output, size_t frames) = 0;
+
+    // true when all voices are idle, and the chip outputs digital silence
+    // until the next register write
+    virtual bool isIdle() = 0;
+
+    // snapshots of the emulator state; a snapshot is restorable into any chip
+    // of the same emulator running at the same rate, within this process.
+    // The buffer has stateSize() bytes, aligned like memory from `new`.
+    virtual size_t stateSize() = 0;
+    virtual bool saveState(void *state) = 0;
+    virtual bool restoreState(const void *state) = 0;
 
     virtual const char* emulatorName() = 0;
     virtual ChipType chipType() = 0;
+protected:
+    // moves a pointer from inside of an object copied from `from` into `to`
+    template <class P>
+    static void relocatePointer(P *&ptr, const void *from, void *to)
+    {
+        if(ptr)
+            ptr = reinterpret_cast<P *>(reinterpret_cast<char *>(to) +
+                  (reinterpret_cast<const char *>(ptr) - reinterpret_cast<const char *>(from)));
+    }
 private:
     OPLChipBase(const OPLChipBase &c);
     OPLChipBase &operator=(const OPLChipBase &c);
 };
 
 // A base class providing F-bounded generic and efficient implementations,
-// supporting resampling of chip outputs
+// supporting resampling of chip outputs.
+// Chip outputs are rendered in blocks with `nativeGenerateN`, and the resampler
+// consumes whole native blocks at once.
 template <class T>
 class OPLChipBaseT : public OPLChipBase
 {
@@ -101,55 +136,85 @@ public:
 
     virtual void setRate(uint32_t rate) override;
     uint32_t effectiveRate() const override;
+    ResamplerQuality resamplerQuality() const override;
+    void setResamplerQuality(ResamplerQuality quality) override;
     virtual void reset() override;
+    void writeRegAt(uint16_t addr, uint8_t data, uint32_t sampleOffset) override;
+    // generic block routine, override it if the emulator has a faster one
+    void nativeGenerateN(int16_t *output, size_t frames) override;
     void generate(int16_t *output, size_t frames) override;
     void generateAndMix(int16_t *output, size_t frames) override;
     void generate32(int32_t *output, size_t frames) override;
     void generateAndMix32(int32_t *output, size_t frames) override;
+    void generateFloat(float *output, size_t frames) override;
+    void generateAndMixFloat(float *output, size_t frames) override;
+    bool isIdle() override;
+    // silence detection, override these if the emulator is able to tell when it
+    // outputs zeroes only, and to move its clocks forward without rendering
+    bool nativeIsIdle() const { return false; }
+    void nativeSkip(size_t frames) { (void)frames; }
+    size_t stateSize() override;
+    bool saveState(void *state) override;
+    bool restoreState(const void *state) override;
+    // emulator part of snapshots, override these if the emulator supports them;
+    // a size of 0 means snapshots are not supported
+    size_t nativeStateSize() const { return 0; }
+    void nativeSaveState(void *state) const { (void)state; }
+    void nativeRestoreState(const void *state) { (void)state; }
 private:
     bool m_runningAtPcmRate;
+    ResamplerQuality m_resamplerQuality;
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
     void *m_audioTickHandlerInstance;
 #endif
-    void nativeTick(int16_t *frame);
+    void nativeTickN(int16_t *output, size_t frames);
+    void applyWrite();
+    void timedGenerateN(int32_t *output, size_t frames);
     void setupResampler(uint32_t rate);
     void resetResampler();
-    void resampledGenerate(int32_t *output);
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    VResampler *m_resampler;
-#else
+    void resampledGenerateN(int32_t *output, size_t frames);
+    void sincResampledGenerateN(int32_t *output, size_t frames);
+    void unresampledGenerateN(int32_t *output, size_t frames);
+    // common part of snapshots, followed by the emulator part
+    struct StateHeader
+    {
+        const char *emulator;
+        uint32_t rate;
+        uint32_t effectiveRate;
+        int32_t samplecnt;
+        int32_t oldsamples[2];
+        int32_t samples[2];
+    };
+    enum { stateHeaderSize = (sizeof(StateHeader) + 15) & ~15 };
+    // maximum sizes of blocks processed at once, in frames
+    enum { nativeBufferFrames = 512, outputBufferFrames = 256 };
+    int16_t m_nativeBuffer[2 * nativeBufferFrames];
+    // windowed sinc resampler, used by the RESAMPLER_SINC* qualities
+    SincResampler m_sincResampler;
+    // linear interpolator, used by RESAMPLER_LINEAR
     int32_t m_oldsamples[2];
     int32_t m_samples[2];
     int32_t m_samplecnt;
     int32_t m_rateratio;
     enum { rsm_frac = 10 };
-#endif
+    // timed register writes, a FIFO in order of the output frame they are due at
+    struct TimedWrite
+    {
+        uint32_t time;
+        uint16_t addr;
+        uint8_t data;
+    };
+    enum { writeQueueSize = 1024 };
+    TimedWrite m_writes[writeQueueSize];
+    uint32_t m_writeHead;
+    uint32_t m_writeCount;
+    // output frames generated so far, the time base of queued writes
+    uint32_t m_outputClock;
     // amplitude scale factors in and out of resampler, varying for chips;
     // values are OK to "redefine", the static polymorphism will accept it.
     enum { resamplerPreAmplify = 1, resamplerPostAttenuate = 1 };
 };
 
-// A base class which provides frame-by-frame interfaces on emulations which
-// don't have a routine for it. It produces outputs in fixed size buffers.
-// Fast register updates will suffer some latency because of buffering.
-template <class T, unsigned Buffer = 256>
-class OPLChipBaseBufferedT : public OPLChipBaseT<T>
-{
-public:
-    OPLChipBaseBufferedT()
-        : OPLChipBaseT<T>(), m_bufferIndex(0) {}
-    virtual ~OPLChipBaseBufferedT()
-        {}
-public:
-    void reset() override;
-    void nativeGenerate(int16_t *frame) override;
-protected:
-    virtual void nativeGenerateN(int16_t *output, size_t frames) = 0;
-private:
-    unsigned m_bufferIndex;
-    int16_t m_buffer[2 * Buffer];
-};
-
 #include "opl_chip_base.tcc"
 
 #endif // ONP_CHIP_BASE_H
@@ -1,9 +1,4 @@
 #include "opl_chip_base.h"
-#include <cmath>
-
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-#include <zita-resampler/vresampler.h>
-#endif
 
 #if !defined(LIKELY) && defined(__GNUC__)
 #define LIKELY(x) __builtin_expect((x), 1)
@@ -34,24 +29,23 @@ inline OPLChipBase::~OPLChipBase()
 template <class T>
 OPLChipBaseT<T>::OPLChipBaseT()
     : OPLChipBase(),
-      m_runningAtPcmRate(false)
+      m_runningAtPcmRate(false),
+      m_resamplerQuality(RESAMPLER_LINEAR)
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
     ,
       m_audioTickHandlerInstance(NULL)
 #endif
+    ,
+      m_writeHead(0),
+      m_writeCount(0),
+      m_outputClock(0)
 {
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    m_resampler = new VResampler;
-#endif
     setupResampler(m_rate);
 }
 
 template <class T>
 OPLChipBaseT<T>::~OPLChipBaseT()
 {
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    delete m_resampler;
-#endif
 }
 
 template <class T>
@@ -98,27 +92,88 @@ uint32_t OPLChipBaseT<T>::effectiveRate() const
     return m_runningAtPcmRate ? m_rate : (uint32_t)nativeRate;
 }
 
+template <class T>
+OPLChipBase::ResamplerQuality OPLChipBaseT<T>::resamplerQuality() const
+{
+    return m_resamplerQuality;
+}
+
+template <class T>
+void OPLChipBaseT<T>::setResamplerQuality(ResamplerQuality quality)
+{
+    if(quality != m_resamplerQuality)
+    {
+        m_resamplerQuality = quality;
+        setupResampler(m_rate);
+    }
+}
+
 template <class T>
 void OPLChipBaseT<T>::reset()
 {
     resetResampler();
+    m_writeHead = 0;
+    m_writeCount = 0;
+    m_outputClock = 0;
+}
+
+template <class T>
+void OPLChipBaseT<T>::writeRegAt(uint16_t addr, uint8_t data, uint32_t sampleOffset)
+{
+    // a full queue gives up the timing of its oldest write
+    if(UNLIKELY(m_writeCount == (uint32_t)writeQueueSize))
+        applyWrite();
+    uint32_t time = m_outputClock + sampleOffset;
+    if(m_writeCount > 0)
+    {
+        const TimedWrite &last = m_writes[(m_writeHead + m_writeCount - 1) & (writeQueueSize - 1)];
+        if((int32_t)(time - last.time) < 0)
+            time = last.time;
+    }
+    TimedWrite &w = m_writes[(m_writeHead + m_writeCount) & (writeQueueSize - 1)];
+    w.time = time;
+    w.addr = addr;
+    w.data = data;
+    ++m_writeCount;
+}
+
+template <class T>
+void OPLChipBaseT<T>::applyWrite()
+{
+    const TimedWrite &w = m_writes[m_writeHead];
+    static_cast<T *>(this)->writeReg(w.addr, w.data);
+    m_writeHead = (m_writeHead + 1) & (writeQueueSize - 1);
+    --m_writeCount;
+}
+
+template <class T>
+void OPLChipBaseT<T>::nativeGenerateN(int16_t *output, size_t frames)
+{
+    for(size_t i = 0; i < frames; ++i)
+    {
+        static_cast<T *>(this)->nativeGenerate(output);
+        output += 2;
+    }
 }
 
 template <class T>
 void OPLChipBaseT<T>::generate(int16_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
-    for(size_t i = 0; i < frames; ++i)
+    int32_t buffer[2 * outputBufferFrames];
+    while(frames > 0)
     {
-        int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
-        for (unsigned c = 0; c < 2; ++c) {
-            int32_t temp = frame[c];
+        size_t count = (frames < (size_t)outputBufferFrames) ? frames : (size_t)outputBufferFrames;
+        timedGenerateN(buffer, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+        {
+            int32_t temp = buffer[i];
             temp = (temp > -32768) ? temp : -32768;
             temp = (temp < 32767) ? temp : 32767;
-            output[c] = (int16_t)temp;
+            output[i] = (int16_t)temp;
         }
-        output += 2;
+        output += 2 * count;
+        frames -= count;
     }
     static_cast<T *>(this)->nativePostGenerate();
 }
@@ -127,17 +182,20 @@ template <class T>
 void OPLChipBaseT<T>::generateAndMix(int16_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
-    for(size_t i = 0; i < frames; ++i)
+    int32_t buffer[2 * outputBufferFrames];
+    while(frames > 0)
     {
-        int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
-        for (unsigned c = 0; c < 2; ++c) {
-            int32_t temp = (int32_t)output[c] + frame[c];
+        size_t count = (frames < (size_t)outputBufferFrames) ? frames : (size_t)outputBufferFrames;
+        timedGenerateN(buffer, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+        {
+            int32_t temp = (int32_t)output[i] + buffer[i];
             temp = (temp > -32768) ? temp : -32768;
             temp = (temp < 32767) ? temp : 32767;
-            output[c] = (int16_t)temp;
+            output[i] = (int16_t)temp;
         }
-        output += 2;
+        output += 2 * count;
+        frames -= count;
     }
     static_cast<T *>(this)->nativePostGenerate();
 }
@@ -146,10 +204,12 @@ template <class T>
 void OPLChipBaseT<T>::generate32(int32_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
-    for(size_t i = 0; i < frames; ++i)
+    while(frames > 0)
     {
-        static_cast<T *>(this)->resampledGenerate(output);
-        output += 2;
+        size_t count = (frames < (size_t)outputBufferFrames) ? frames : (size_t)outputBufferFrames;
+        timedGenerateN(output, count);
+        output += 2 * count;
+        frames -= count;
     }
     static_cast<T *>(this)->nativePostGenerate();
 }
@@ -158,137 +218,270 @@ template <class T>
 void OPLChipBaseT<T>::generateAndMix32(int32_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
-    for(size_t i = 0; i < frames; ++i)
+    int32_t buffer[2 * outputBufferFrames];
+    while(frames > 0)
     {
-        int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
-        output[0] += frame[0];
-        output[1] += frame[1];
-        output += 2;
+        size_t count = (frames < (size_t)outputBufferFrames) ? frames : (size_t)outputBufferFrames;
+        timedGenerateN(buffer, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+            output[i] += buffer[i];
+        output += 2 * count;
+        frames -= count;
     }
     static_cast<T *>(this)->nativePostGenerate();
 }
 
 template <class T>
-void OPLChipBaseT<T>::nativeTick(int16_t *frame)
+void OPLChipBaseT<T>::generateFloat(float *output, size_t frames)
+{
+    static_cast<T *>(this)->nativePreGenerate();
+    int32_t buffer[2 * outputBufferFrames];
+    const float scale = 1.0f / 32768.0f;
+    while(frames > 0)
+    {
+        size_t count = (frames < (size_t)outputBufferFrames) ? frames : (size_t)outputBufferFrames;
+        timedGenerateN(buffer, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+            output[i] = scale * (float)buffer[i];
+        output += 2 * count;
+        frames -= count;
+    }
+    static_cast<T *>(this)->nativePostGenerate();
+}
+
+template <class T>
+void OPLChipBaseT<T>::generateAndMixFloat(float *output, size_t frames)
+{
+    static_cast<T *>(this)->nativePreGenerate();
+    int32_t buffer[2 * outputBufferFrames];
+    const float scale = 1.0f / 32768.0f;
+    while(frames > 0)
+    {
+        size_t count = (frames < (size_t)outputBufferFrames) ? frames : (size_t)outputBufferFrames;
+        timedGenerateN(buffer, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+            output[i] += scale * (float)buffer[i];
+        output += 2 * count;
+        frames -= count;
+    }
+    static_cast<T *>(this)->nativePostGenerate();
+}
+
+template <class T>
+bool OPLChipBaseT<T>::isIdle()
+{
+    return static_cast<T *>(this)->nativeIsIdle();
+}
+
+template <class T>
+size_t OPLChipBaseT<T>::stateSize()
+{
+    size_t size = static_cast<T *>(this)->nativeStateSize();
+    return (size > 0) ? (size_t)stateHeaderSize + size : 0;
+}
+
+template <class T>
+bool OPLChipBaseT<T>::saveState(void *state)
+{
+    if(static_cast<T *>(this)->nativeStateSize() == 0)
+        return false;
+    StateHeader *header = static_cast<StateHeader *>(state);
+    header->emulator = static_cast<T *>(this)->emulatorName();
+    header->rate = m_rate;
+    header->effectiveRate = effectiveRate();
+    header->samplecnt = m_samplecnt;
+    header->oldsamples[0] = m_oldsamples[0];
+    header->oldsamples[1] = m_oldsamples[1];
+    header->samples[0] = m_samples[0];
+    header->samples[1] = m_samples[1];
+    static_cast<T *>(this)->nativeSaveState(static_cast<char *>(state) + stateHeaderSize);
+    return true;
+}
+
+template <class T>
+bool OPLChipBaseT<T>::restoreState(const void *state)
+{
+    if(static_cast<T *>(this)->nativeStateSize() == 0)
+        return false;
+    const StateHeader *header = static_cast<const StateHeader *>(state);
+    if(header->emulator != static_cast<T *>(this)->emulatorName() ||
+       header->rate != m_rate || header->effectiveRate != effectiveRate())
+        return false;
+    static_cast<T *>(this)->nativeRestoreState(static_cast<const char *>(state) + stateHeaderSize);
+    // the sinc history is not part of snapshots, it restarts from silence
+    resetResampler();
+    m_samplecnt = header->samplecnt;
+    m_oldsamples[0] = header->oldsamples[0];
+    m_oldsamples[1] = header->oldsamples[1];
+    m_samples[0] = header->samples[0];
+    m_samples[1] = header->samples[1];
+    return true;
+}
+
+template <class T>
+void OPLChipBaseT<T>::nativeTickN(int16_t *output, size_t frames)
 {
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
-    adl_audioTickHandler(m_audioTickHandlerInstance, m_id, effectiveRate());
+    // the tick handler wants to see every native frame
+    for(size_t i = 0; i < frames; ++i)
+    {
+        adl_audioTickHandler(m_audioTickHandlerInstance, m_id, effectiveRate());
+        static_cast<T *>(this)->nativeGenerate(output);
+        output += 2;
+    }
+#else
+    if(frames == 0)
+        return;
+    if(static_cast<T *>(this)->nativeIsIdle())
+    {
+        // digital silence, only the clocks of the chip have to move on
+        memset(output, 0, 2 * frames * sizeof(int16_t));
+        static_cast<T *>(this)->nativeSkip(frames);
+    }
+    else
+        static_cast<T *>(this)->nativeGenerateN(output, frames);
 #endif
-    static_cast<T *>(this)->nativeGenerate(frame);
+}
+
+template <class T>
+void OPLChipBaseT<T>::timedGenerateN(int32_t *output, size_t frames)
+{
+    while(frames > 0)
+    {
+        // render up to the frame the next queued write is due at
+        size_t count = frames;
+        while(m_writeCount > 0)
+        {
+            int32_t due = (int32_t)(m_writes[m_writeHead].time - m_outputClock);
+            if(due > 0)
+            {
+                count = ((size_t)due < frames) ? (size_t)due : frames;
+                break;
+            }
+            applyWrite();
+        }
+        resampledGenerateN(output, count);
+        output += 2 * count;
+        frames -= count;
+        m_outputClock += (uint32_t)count;
+    }
 }
 
 template <class T>
 void OPLChipBaseT<T>::setupResampler(uint32_t rate)
 {
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    m_resampler->setup(rate * (1.0 / 49716), 2, 48);
-#else
+    if(m_resamplerQuality != RESAMPLER_LINEAR)
+        m_sincResampler.setup(nativeRate, rate, (m_resamplerQuality == RESAMPLER_SINC48) ? 48 : 16);
     m_oldsamples[0] = m_oldsamples[1] = 0;
     m_samples[0] = m_samples[1] = 0;
     m_samplecnt = 0;
     m_rateratio = (int32_t)((rate << rsm_frac) / 49716);
-#endif
 }
 
 template <class T>
 void OPLChipBaseT<T>::resetResampler()
 {
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
-    m_resampler->reset();
-#else
+    if(m_resamplerQuality != RESAMPLER_LINEAR)
+        m_sincResampler.reset();
     m_oldsamples[0] = m_oldsamples[1] = 0;
     m_samples[0] = m_samples[1] = 0;
     m_samplecnt = 0;
-#endif
 }
 
-#if defined(ADLMIDI_ENABLE_HQ_RESAMPLER)
 template <class T>
-void OPLChipBaseT<T>::resampledGenerate(int32_t *output)
+void OPLChipBaseT<T>::unresampledGenerateN(int32_t *output, size_t frames)
 {
-    if(UNLIKELY(m_runningAtPcmRate))
+    int16_t *buffer = m_nativeBuffer;
+    while(frames > 0)
     {
-        int16_t in[2];
-        static_cast<T *>(this)->nativeTick(in);
-        output[0] = (int32_t)in[0] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
-        output[1] = (int32_t)in[1] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
-        return;
+        size_t count = (frames < (size_t)nativeBufferFrames) ? frames : (size_t)nativeBufferFrames;
+        nativeTickN(buffer, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+            output[i] = (int32_t)buffer[i] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+        output += 2 * count;
+        frames -= count;
     }
+}
 
-    VResampler *rsm = m_resampler;
-    float scale = (float)T::resamplerPreAmplify /
-        (float)T::resamplerPostAttenuate;
-    float f_in[2];
-    float f_out[2];
-    rsm->inp_count = 0;
-    rsm->inp_data = f_in;
-    rsm->out_count = 1;
-    rsm->out_data = f_out;
-    while(rsm->process(), rsm->out_count != 0)
+template <class T>
+void OPLChipBaseT<T>::sincResampledGenerateN(int32_t *output, size_t frames)
+{
+    SincResampler &rsm = m_sincResampler;
+    const float scale = (float)T::resamplerPreAmplify / (float)T::resamplerPostAttenuate;
+    int16_t *buffer = m_nativeBuffer;
+
+    while(frames > 0)
     {
-        int16_t in[2];
-        static_cast<T *>(this)->nativeTick(in);
-        f_in[0] = scale * (float)in[0];
-        f_in[1] = scale * (float)in[1];
-        rsm->inp_count = 1;
-        rsm->inp_data = f_in;
-        rsm->out_count = 1;
-        rsm->out_data = f_out;
+        size_t done = rsm.pull(output, frames);
+        output += 2 * done;
+        frames -= done;
+        if(frames == 0)
+            break;
+        // render just the native frames the remaining output depends on
+        size_t count = rsm.inputNeeded(frames);
+        size_t space = rsm.space();
+        count = (count < space) ? count : space;
+        count = (count < (size_t)nativeBufferFrames) ? count : (size_t)nativeBufferFrames;
+        nativeTickN(buffer, count);
+        rsm.push(buffer, count, scale);
     }
-    output[0] = static_cast<int32_t>(lround(f_out[0]));
-    output[1] = static_cast<int32_t>(lround(f_out[1]));
 }
-#else
+
 template <class T>
-void OPLChipBaseT<T>::resampledGenerate(int32_t *output)
+void OPLChipBaseT<T>::resampledGenerateN(int32_t *output, size_t frames)
 {
     if(UNLIKELY(m_runningAtPcmRate))
     {
-        int16_t in[2];
-        static_cast<T *>(this)->nativeTick(in);
-        output[0] = (int32_t)in[0] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
-        output[1] = (int32_t)in[1] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+        unresampledGenerateN(output, frames);
         return;
     }
 
-    int32_t samplecnt = m_samplecnt;
-    const int32_t rateratio = m_rateratio;
-    while(samplecnt >= rateratio)
+    if(m_resamplerQuality != RESAMPLER_LINEAR)
     {
-        m_oldsamples[0] = m_samples[0];
-        m_oldsamples[1] = m_samples[1];
-        int16_t buffer[2];
-        static_cast<T *>(this)->nativeTick(buffer);
-        m_samples[0] = buffer[0] * T::resamplerPreAmplify;
-        m_samples[1] = buffer[1] * T::resamplerPreAmplify;
-        samplecnt -= rateratio;
+        sincResampledGenerateN(output, frames);
+        return;
     }
-    output[0] = (int32_t)(((m_oldsamples[0] * (rateratio - samplecnt)
-                            + m_samples[0] * samplecnt) / rateratio)/T::resamplerPostAttenuate);
-    output[1] = (int32_t)(((m_oldsamples[1] * (rateratio - samplecnt)
-                            + m_samples[1] * samplecnt) / rateratio)/T::resamplerPostAttenuate);
-    m_samplecnt = samplecnt + (1 << rsm_frac);
-}
-#endif
 
-/* OPLChipBaseBufferedT */
+    int16_t *buffer = m_nativeBuffer;
+    const int32_t rateratio = m_rateratio;
+    int32_t samplecnt = m_samplecnt;
+    int32_t oldsamples[2] = {m_oldsamples[0], m_oldsamples[1]};
+    int32_t samples[2] = {m_samples[0], m_samples[1]};
+
+    while(frames > 0)
+    {
+        // how many output frames a single native block is able to serve
+        size_t count = (size_t)((nativeBufferFrames * rateratio - samplecnt) >> rsm_frac) + 1;
+        count = (count < frames) ? count : frames;
+        // how many native frames these output frames will consume
+        size_t needed = (size_t)((samplecnt + (int32_t)(count - 1) * (1 << rsm_frac)) / rateratio);
+        nativeTickN(buffer, needed);
 
-template <class T, unsigned Buffer>
-void OPLChipBaseBufferedT<T, Buffer>::reset()
-{
-    OPLChipBaseT<T>::reset();
-    m_bufferIndex = 0;
-}
+        const int16_t *input = buffer;
+        for(size_t i = 0; i < count; ++i)
+        {
+            while(samplecnt >= rateratio)
+            {
+                oldsamples[0] = samples[0];
+                oldsamples[1] = samples[1];
+                samples[0] = input[0] * T::resamplerPreAmplify;
+                samples[1] = input[1] * T::resamplerPreAmplify;
+                input += 2;
+                samplecnt -= rateratio;
+            }
+            output[0] = (int32_t)(((oldsamples[0] * (rateratio - samplecnt)
+                                    + samples[0] * samplecnt) / rateratio)/T::resamplerPostAttenuate);
+            output[1] = (int32_t)(((oldsamples[1] * (rateratio - samplecnt)
+                                    + samples[1] * samplecnt) / rateratio)/T::resamplerPostAttenuate);
+            output += 2;
+            samplecnt += 1 << rsm_frac;
+        }
+        frames -= count;
+    }
 
-template <class T, unsigned Buffer>
-void OPLChipBaseBufferedT<T, Buffer>::nativeGenerate(int16_t *frame)
-{
-    unsigned bufferIndex = m_bufferIndex;
-    if(bufferIndex == 0)
-        static_cast<T *>(this)->nativeGenerateN(m_buffer, Buffer);
-    frame[0] = m_buffer[2 * bufferIndex];
-    frame[1] = m_buffer[2 * bufferIndex + 1];
-    bufferIndex = (bufferIndex + 1 < Buffer) ? (bufferIndex + 1) : 0;
-    m_bufferIndex = bufferIndex;
+    m_samplecnt = samplecnt;
+    m_oldsamples[0] = oldsamples[0];
+    m_oldsamples[1] = oldsamples[1];
+    m_samples[0] = samples[0];
+    m_samples[1] = samples[1];
 }
@@ -0,0 +1,117 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONSTEXPR_MATH_H
+#define CONSTEXPR_MATH_H
+
+/*
+ * Math functions usable in constant expressions of C++11, and a generator
+ * of lookup tables filled by the compiler.
+ */
+namespace CTMath
+{
+
+constexpr double ln2 = 0.69314718055994530942;
+
+namespace detail
+{
+
+constexpr double expSeries(double x, unsigned n, double term, double sum)
+{
+    return (n > 30) ? sum : expSeries(x, n + 1, term * x / n, sum + term * x / n);
+}
+
+// 2 * atanh(z) = ln((1 + z) / (1 - z))
+constexpr double atanhSeries(double z2, double power, unsigned n, double sum)
+{
+    return (n > 61) ? sum : atanhSeries(z2, power * z2, n + 2, sum + power / n);
+}
+
+constexpr double logMantissa(double m)
+{
+    return 2.0 * atanhSeries(((m - 1.0) / (m + 1.0)) * ((m - 1.0) / (m + 1.0)),
+                             (m - 1.0) / (m + 1.0), 1, 0.0);
+}
+
+constexpr double logReduce(double x, int exponent)
+{
+    return (x >= 2.0) ? logReduce(x / 2.0, exponent + 1) :
+           (x < 1.0) ? logReduce(x * 2.0, exponent - 1) :
+           exponent * ln2 + logMantissa(x);
+}
+
+constexpr double sqrtNewton(double x, double guess, unsigned n)
+{
+    return (n == 0) ? guess : sqrtNewton(x, 0.5 * (guess + x / guess), n - 1);
+}
+
+} // namespace detail
+
+//! e^x, for small x only
+constexpr double exp(double x)
+{
+    return detail::expSeries(x, 1, 1.0, 1.0);
+}
+
+//! Natural logarithm, x must be positive
+constexpr double log(double x)
+{
+    return detail::logReduce(x, 0);
+}
+
+//! Square root, x must be within [0; 2^20]
+constexpr double sqrt(double x)
+{
+    return (x <= 0.0) ? 0.0 : detail::sqrtNewton(x, (x > 1.0) ? x : 1.0, 40);
+}
+
+template<unsigned... I> struct Indices {};
+
+template<class A, class B> struct ConcatIndices;
+template<unsigned... A, unsigned... B> struct ConcatIndices<Indices<A...>, Indices<B...> >
+{
+    typedef Indices<A..., (sizeof...(A) + B)...> type;
+};
+
+//! Indices 0 to N - 1, built in log2(N) steps to keep the template depth low
+template<unsigned N> struct MakeIndices
+{
+    typedef typename ConcatIndices<typename MakeIndices<N / 2>::type,
+                                   typename MakeIndices<N - N / 2>::type>::type type;
+};
+template<> struct MakeIndices<0> { typedef Indices<> type; };
+template<> struct MakeIndices<1> { typedef Indices<0> type; };
+
+template<class T, class Gen, class Idx> struct TableImpl;
+template<class T, class Gen, unsigned... I> struct TableImpl<T, Gen, Indices<I...> >
+{
+    static constexpr T values[sizeof...(I)] = { Gen::entry(I)... };
+};
+template<class T, class Gen, unsigned... I>
+constexpr T TableImpl<T, Gen, Indices<I...> >::values[sizeof...(I)];
+
+/**
+ * @brief Lookup table filled at compile time
+ * Gen has a `static constexpr T entry(unsigned index)` member computing each entry.
+ */
+template<class T, class Gen, unsigned N>
+struct Table : TableImpl<T, Gen, typename MakeIndices<N>::type> {};
+
+} // namespace CTMath
+
+#endif // CONSTEXPR_MATH_H
@@ -17,11 +17,15 @@
  */
 
 #include "generator.h"
+#include "opl_freq.h"
+#include "constexpr_math.h"
 #include <qendian.h>
 #include <cmath>
+#include <vector>
 #include <QtDebug>
 
 #include "chips/nuked_opl3.h"
+#include "chips/nuked_opl3_simd.h"
 #include "chips/dosbox_opl3.h"
 #include "chips/opal_opl3.h"
 #include "chips/java_opl3.h"
@@ -34,6 +38,14 @@
 #include "chips/opl_serial_port.h"
 #endif
 
+// MinGW builds without POSIX threads have no std::thread, chips get rendered in turn there
+#if !defined(_WIN32) || defined(_MSC_VER) || defined(_GLIBCXX_HAS_GTHREADS)
+#define ENABLE_CHIP_RENDER_THREADS
+#include <thread>
+#include <atomic>
+#include <chrono>
+#endif
+
 #define BYTE_TO_BINARY_PATTERN "%c%c%c%c%c%c%c%c"
 #define BYTE_TO_BINARY(byte)  \
       (byte & 0x80 ? '1' : '0'), \
@@ -45,8 +57,6 @@
       (byte & 0x02 ? '1' : '0'), \
       (byte & 0x01 ? '1' : '0')
 
-#define BEND_COEFFICIENT 172.4387
-
 #define OPL3_CHANNELS_MELODIC_BASE      0
 #define OPL3_CHANNELS_RHYTHM_BASE       18
 
@@ -207,16 +217,50 @@ static const uint_fast32_t s_hmi_volume_table[64] =
 
 
 
+/***************************************************************
+ *        Lookup tables computed at compile time               *
+ ***************************************************************/
 
+// The generic volume model: SOLVE(V=127^3 * 2^( (A-63.49999) / 8), A)
+// gives A = c1 * ln(V) - c2, with V = velocity * volume * expression * 127
+static constexpr double s_generic_c1 = 11.541560327111707;
+static constexpr double s_generic_c2 = 1.601379199767093e+02;
 
-/***************************************************************
- *               Standard frequency formula                    *
- * *************************************************************/
+//! c1 * ln(x) of every MIDI value, in 32.32 fixed-point
+struct GenericLogEntry
+{
+    static constexpr int64_t entry(unsigned x)
+    {
+        return (x == 0) ? 0 : static_cast<int64_t>(s_generic_c1 * CTMath::log(x) * 4294967296.0 + 0.5);
+    }
+};
+typedef CTMath::Table<int64_t, GenericLogEntry, 128> s_generic_log;
 
-static inline double s_commonFreq(double tone)
+//! c1 * ln(127) - c2 in 32.32 fixed-point, the constant part of the sum (negative, rounded to nearest)
+static constexpr int64_t s_generic_offset =
+    static_cast<int64_t>((s_generic_c1 * CTMath::log(127.0) - s_generic_c2) * 4294967296.0 - 0.5);
+
+//! Total level scaled by a volume: 63 - volume + volume * tl / 63, indexed by volume << 6 | tl
+struct TLScaleEntry
 {
-    return BEND_COEFFICIENT * std::exp(0.057762265 * tone);
-}
+    static constexpr uint8_t entry(unsigned i)
+    {
+        return static_cast<uint8_t>(63 - (i >> 6) + ((i >> 6) * (i & 63)) / 63);
+    }
+};
+typedef CTMath::Table<uint8_t, TLScaleEntry, 64 * 64> s_tl_scale;
+
+//! Brightness controller to the level of the unscaled operators
+struct BrightnessEntry
+{
+    static constexpr uint8_t entry(unsigned b)
+    {
+        return static_cast<uint8_t>(static_cast<unsigned>(127.0 * CTMath::sqrt(b / 127.0) + 0.5) / 2);
+    }
+};
+typedef CTMath::Table<uint8_t, BrightnessEntry, 128> s_brightness_to_opl;
+
+
 
 
 
@@ -781,20 +825,186 @@ static inline double s_ailFreq(double tone)
 
 
 
+/**
+   Renders several chips at once: every chip but the first one has
+   a worker thread, the first one is rendered by the calling thread.
+
+   Nothing is locked: a block is announced by a new generation number,
+   and each chip of it is claimed once, by its worker or by the calling
+   thread. Once done with the first chip, the calling thread renders
+   itself the chips no worker has picked up yet, so a worker asleep or
+   preempted only makes the block render one chip after another. It
+   still waits for the chips a worker has started.
+ */
+class ChipRenderThreads
+{
+public:
+    typedef void (*Job)(void *context, uint32_t index);
+
+    explicit ChipRenderThreads(uint32_t count);
+    ~ChipRenderThreads();
+
+    uint32_t count() const
+        { return m_count; }
+
+    /**
+     * @brief Runs the job for every index and waits for all of them to finish
+     * @param job Job to run, called with indices 0 to count() - 1
+     * @param context Argument passed to the job
+     */
+    void run(Job job, void *context);
+
+private:
+    uint32_t m_count;
+#ifdef ENABLE_CHIP_RENDER_THREADS
+    void threadMain(uint32_t index);
+    //! Claims the chip for the current block, true if nobody did before
+    bool claim(uint32_t index, uint64_t generation);
+
+    std::vector<std::thread> m_threads;
+    //! Last block each chip was claimed for
+    std::unique_ptr<std::atomic<uint64_t>[]> m_claimed;
+    std::atomic<uint64_t> m_generation;
+    std::atomic<uint32_t> m_pending;
+    std::atomic<bool> m_quit;
+    //! Set before the generation is published, stable until the block is done
+    Job m_job = nullptr;
+    void *m_context = nullptr;
+#endif
+};
+
+ChipRenderThreads::ChipRenderThreads(uint32_t count)
+    : m_count(count)
+{
+#ifdef ENABLE_CHIP_RENDER_THREADS
+    m_claimed.reset(new std::atomic<uint64_t>[count]);
+    for(uint32_t i = 0; i < count; ++i)
+        m_claimed[i].store(0);
+    m_generation.store(0);
+    m_pending.store(0);
+    m_quit.store(false);
+    m_threads.reserve(count - 1);
+    for(uint32_t i = 1; i < count; ++i)
+        m_threads.push_back(std::thread(&ChipRenderThreads::threadMain, this, i));
+#endif
+}
+
+ChipRenderThreads::~ChipRenderThreads()
+{
+#ifdef ENABLE_CHIP_RENDER_THREADS
+    m_quit.store(true);
+    for(std::thread &thread : m_threads)
+        thread.join();
+#endif
+}
+
+void ChipRenderThreads::run(Job job, void *context)
+{
+#ifdef ENABLE_CHIP_RENDER_THREADS
+    const uint64_t generation = m_generation.load(std::memory_order_relaxed) + 1;
+    m_job = job;
+    m_context = context;
+    m_pending.store(m_count - 1, std::memory_order_relaxed);
+    m_generation.store(generation, std::memory_order_release);
+
+    job(context, 0);
+
+    // The workers too late for this block leave their chips to this thread
+    for(uint32_t i = 1; i < m_count; ++i)
+    {
+        if(claim(i, generation))
+        {
+            job(context, i);
+            m_pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    while(m_pending.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+#else
+    for(uint32_t i = 0; i < m_count; ++i)
+        job(context, i);
+#endif
+}
+
+#ifdef ENABLE_CHIP_RENDER_THREADS
+bool ChipRenderThreads::claim(uint32_t index, uint64_t generation)
+{
+    // every chip of the previous blocks has been claimed by now
+    uint64_t previous = generation - 1;
+    return m_claimed[index].compare_exchange_strong(previous, generation, std::memory_order_acq_rel);
+}
+
+void ChipRenderThreads::threadMain(uint32_t index)
+{
+    typedef std::chrono::steady_clock Clock;
+    // Between blocks of a running stream the worker only yields, after
+    // a longer pause it polls with short sleeps
+    const Clock::duration spinTime = std::chrono::milliseconds(50);
+    const std::chrono::microseconds pollTime(100);
+
+    uint64_t seen = 0;
+    Clock::time_point lastJob = Clock::now();
+    while(!m_quit.load(std::memory_order_relaxed))
+    {
+        const uint64_t generation = m_generation.load(std::memory_order_acquire);
+        if(generation == seen)
+        {
+            if(Clock::now() - lastJob < spinTime)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(pollTime);
+            continue;
+        }
+        seen = generation;
+
+        if(claim(index, generation))
+        {
+            m_job(m_context, index);
+            m_pending.fetch_sub(1, std::memory_order_release);
+        }
+        lastJob = Clock::now();
+    }
+}
+#endif
+
 QString GeneratorDebugInfo::toStr()
 {
     return QObject::tr(
         "Channels:\n"
         "2-op: %1, Ps-4op: %2\n"
-        "4-op: %3")
+        "4-op: %3\n"
+        "Register writes:\n"
+        "sent: %4, skipped: %5\n"
+        "Queues:\n"
+        "stalls: %6, MIDI drops: %7\n"
+        "peak: %8 B control, %9 B MIDI")
         .arg(this->chan2op)
         .arg(this->chanPs4op)
-        .arg(this->chan4op);
+        .arg(this->chan4op)
+        .arg(static_cast<qulonglong>(this->regWritesForwarded))
+        .arg(static_cast<qulonglong>(this->regWritesSuppressed))
+        .arg(static_cast<qulonglong>(this->ctlStalls))
+        .arg(static_cast<qulonglong>(this->midiDrops))
+        .arg(this->ctlQueuedPeak)
+        .arg(this->midiQueuedPeak)
+        + QObject::tr(
+        "\nAudio:\n"
+        "block: %1 frames, load: %2%\n"
+        "peak: %3%, %4 us, %5 msgs\n"
+        "underflows: %6")
+        .arg(this->blockFrames)
+        .arg(static_cast<int>(this->load * 100))
+        .arg(static_cast<int>(this->loadPeak * 100))
+        .arg(this->renderUsPeak)
+        .arg(this->messagesPeak)
+        .arg(static_cast<qulonglong>(this->underflows));
 }
 
-Generator::Generator(uint32_t sampleRate, OPL_Chips initialChip)
+Generator::Generator(uint32_t sampleRate, OPL_Chips initialChip, uint32_t chipCount)
 {
     m_rate = sampleRate;
+    m_chipCount = (chipCount < 1) ? 1 : (chipCount > MAX_OPLGEN_CHIPS) ? MAX_OPLGEN_CHIPS : chipCount;
     note = 60;
     m_patch =
     {
@@ -814,9 +1024,11 @@ Generator::Generator(uint32_t sampleRate, OPL_Chips initialChip)
         OPL_PatchSetup::Flag_Pseudo4op,
         -0.125000 // Fine tuning
     };
-    m_regBD = 0;
-    memset(m_ins, 0, sizeof(uint16_t) * NUM_OF_CHANNELS);
-    memset(m_keyBlockFNumCache, 0, sizeof(uint8_t) * NUM_OF_CHANNELS);
+    memset(m_regBD, 0, sizeof(m_regBD));
+    memset(m_ins, 0, sizeof(m_ins));
+    memset(m_keyBlockFNumCache, 0, sizeof(m_keyBlockFNumCache));
+    memset(m_regShadow, 0, sizeof(m_regShadow));
+    memset(m_regShadowKnown, 0, sizeof(m_regShadowKnown));
     memset(m_four_op_category, 0, NUM_OF_CHANNELS * 2);
 
     uint32_t p = 0;
@@ -870,13 +1082,21 @@ void Generator::initChip()
     };
     uint32_t maxChans = 18;
 
-    m_chipType = chip->chipType();
+    m_chipType = m_chips[0]->chipType();
 
     if(m_chipType == OPLChipBase::CHIPTYPE_OPL2)
         maxChans = 9;
 
-    chip->setChipId(0);
-    chip->setRate(m_rate);
+    // The state of the chips is unknown until they get written again
+    resetRegShadow();
+
+    for(uint32_t i = 0; i < m_activeChips; ++i)
+    {
+        OPLChipBase *chip = m_chips[i].get();
+        chip->setChipId(i);
+        chip->setResamplerQuality(OPLChipBase::RESAMPLER_SINC48);
+        chip->setRate(m_rate);
+    }
 
     for(uint32_t a = 0; a < maxChans; ++a)
         WriteReg(0xB0 + g_Channels[a], 0x00);
@@ -915,34 +1135,80 @@ OPL_SerialPort &Generator::serialPortOpl()
 }
 #endif
 
+QMutex &Generator::hardwareMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+bool Generator::usesHardware() const
+{
+    const OPLChipBase *chip = m_chips[0].get();
+    (void)chip;
+#ifdef ENABLE_HW_OPL_PROXY
+    if(chip == &oplProxy())
+        return true;
+#endif
+#ifdef ENABLE_HW_OPL_SERIAL_PORT
+    if(chip == &serialPortOpl())
+        return true;
+#endif
+    return false;
+}
+
 void Generator::switchChip(Generator::OPL_Chips chipId)
 {
-    switch(chipId)
+    uint32_t chips = m_chipCount;
+
+    for(uint32_t i = 0; i < MAX_OPLGEN_CHIPS; ++i)
+        m_chips[i].reset();
+
+    for(uint32_t i = 0; i < chips; ++i)
     {
+        OPLChipBase *chip = nullptr;
+        switch(chipId)
+        {
 #ifdef ENABLE_HW_OPL_PROXY
-    case CHIP_Win9xProxy:
-        oplProxy().startChip();
-        chip.reset(&oplProxy());
-        break;
+        case CHIP_Win9xProxy:
+            oplProxy().startChip();
+            chip = &oplProxy();
+            chips = 1;
+            break;
 #endif
 #ifdef ENABLE_HW_OPL_SERIAL_PORT
-    case CHIP_SerialPort:
-        chip.reset(&serialPortOpl());
-        break;
+        case CHIP_SerialPort:
+            chip = &serialPortOpl();
+            chips = 1;
+            break;
 #endif
-    case CHIP_DosBox:
-        chip.reset(new DosBoxOPL3());
-        break;
-    default:
-    case CHIP_Nuked:
-        chip.reset(new NukedOPL3());
-        break;
-    case CHIP_Opal:
-        chip.reset(new OpalOPL3());
-        break;
-    case CHIP_Java:
-        chip.reset(new JavaOPL3());
-        break;
+        case CHIP_DosBox:
+            chip = new DosBoxOPL3();
+            break;
+        default:
+        case CHIP_Nuked:
+            chip = new NukedOPL3();
+            break;
+        case CHIP_Opal:
+            chip = new OpalOPL3();
+            break;
+        case CHIP_Java:
+            chip = new JavaOPL3();
+            break;
+        case CHIP_NukedSIMD:
+            chip = new NukedOPL3SIMD();
+            break;
+        }
+        m_chips[i].reset(chip);
+    }
+
+    if(m_activeChips != chips)
+    {
+        m_activeChips = chips;
+        m_renderThreads.reset();
+        if(chips > 1)
+            m_renderThreads.reset(new ChipRenderThreads(chips));
+        for(uint32_t i = 0; i < MAX_OPLGEN_CHIPS; ++i)
+            m_mixBuffers[i].reset((i < chips) ? new float[2 * MAX_OPLGEN_BUFFER_SIZE] : nullptr);
     }
 
     initChip();
@@ -950,78 +1216,97 @@ void Generator::switchChip(Generator::OPL_Chips chipId)
 
 void Generator::WriteReg(uint16_t address, uint8_t byte)
 {
-    chip->writeReg(address, byte);
+    for(uint32_t i = 0; i < m_activeChips; ++i)
+        WriteReg(i, address, byte);
+}
+
+void Generator::WriteReg(uint32_t chipId, uint16_t address, uint8_t byte)
+{
+    const uint16_t reg = address & 0x1FF;
+    uint32_t &known = m_regShadowKnown[chipId][reg >> 5];
+    const uint32_t bit = 1u << (reg & 31);
+
+    // Rewriting a value changes nothing on the chip, key-on included: notes
+    // only start on a 0 to 1 edge of the KON and rhythm bits. The timer
+    // registers act on every write, they are always sent.
+    const bool timer = (reg >= 0x002 && reg <= 0x004);
+    if(!timer && (known & bit) && m_regShadow[chipId][reg] == byte)
+    {
+        ++m_debug.regWritesSuppressed;
+        return;
+    }
+
+    m_regShadow[chipId][reg] = byte;
+    known |= bit;
+    ++m_debug.regWritesForwarded;
+    m_chips[chipId]->writeReg(address, byte);
+}
+
+void Generator::resetRegShadow()
+{
+    memset(m_regShadowKnown, 0, sizeof(m_regShadowKnown));
+}
+
+uint32_t Generator::mapChannel(const uint16_t *map, int voice) const
+{
+    return (voice % m_activeChips) * NUM_OF_CHANNELS + map[voice / m_activeChips];
 }
 
 void Generator::NoteOff(uint32_t c)
 {
+    uint32_t card = c / 23;
     uint8_t cc = static_cast<uint8_t>(c % 23);
 
     if(cc >= 18)
     {
-        m_regBD &= ~(0x10 >> (cc - 18));
-        WriteReg(0xBD, m_regBD);
+        m_regBD[card] &= ~(0x10 >> (cc - 18));
+        WriteReg(card, 0xBD, m_regBD[card]);
         return;
     }
 
-    WriteReg(0xB0 + g_Channels[cc], m_keyBlockFNumCache[c] & 0xDF);
+    WriteReg(card, 0xB0 + g_Channels[cc], m_keyBlockFNumCache[c] & 0xDF);
 }
 
 void Generator::NoteOn(uint32_t c1, uint32_t c2, double tone, bool voice2ps4op) // Hertz range: 0..131071
 {
+    uint32_t card = c1 / 23;
     uint32_t cc1 = c1 % 23;
     uint32_t cc2 = c2 % 23;
-    uint32_t octave = 0, ftone = 0, mul_offset = 0;
-
-    double hertz;
+    OPLFreq::BlockFNum freq;
 
     // Use different frequency formulas in depend on a volume model
     switch(m_volumeScale)
     {
     case VOLUME_DMX:
     case VOLUME_DMX_FIXED:
-        hertz = s_dmxFreq(tone);
+        freq = OPLFreq::fromHertz(s_dmxFreq(tone));
         break;
 
     case VOLUME_APOGEE:
     case VOLUME_APOGEE_FIXED:
-        hertz = s_apogeeFreq(tone);
+        freq = OPLFreq::fromHertz(s_apogeeFreq(tone));
         break;
 
     case VOLUME_9X:
     case VOLUME_9X_GENERIC_FM:
-        hertz = s_9xFreq(tone);
+        freq = OPLFreq::fromHertz(s_9xFreq(tone));
         break;
 
     case VOLUME_HMI:
     case VOLUME_HMI_OLD:
-        hertz = s_hmiFreq(tone);
+        freq = OPLFreq::fromHertz(s_hmiFreq(tone));
         break;
 
     case VOLUME_AIL:
-        hertz = s_ailFreq(tone);
+        freq = OPLFreq::fromHertz(s_ailFreq(tone));
         break;
 
     default:
-        hertz = s_commonFreq(tone);
+        freq = OPLFreq::fromTone(tone);
     }
 
-    if(hertz < 0)
-        return;
-
-    //Basic range until max of octaves reaching
-    while((hertz >= 1023.5) && (octave < 0x1C00))
-    {
-        hertz /= 2.0;    // Calculate octave
-        octave += 0x400;
-    }
-    //Extended range, rely on frequency multiplication increment
-    while(hertz >= 1022.75)
-    {
-        hertz /= 2.0;    // Calculate octave
-        mul_offset++;
-    }
-    ftone = octave + static_cast<uint32_t>(hertz + 0.5);
+    uint32_t ftone = freq.value;
+    uint32_t mul_offset = freq.mulOffset;
     uint16_t chn = g_Channels[cc1];
 
     if(cc1 < OPL3_CHANNELS_RHYTHM_BASE)
@@ -1056,35 +1341,33 @@ void Generator::NoteOn(uint32_t c1, uint32_t c2, double tone, bool voice2ps4op)
                     mul_offset = 0;
                     mul = 0x0F;
                 }
-                WriteReg(0x20 + op_addr[op],  uint8_t(dt | (mul + mul_offset)) & 0xFF);
+                WriteReg(card, 0x20 + op_addr[op],  uint8_t(dt | (mul + mul_offset)) & 0xFF);
             }
             else
             {
-                WriteReg(0x20 + op_addr[op],  ops[op] & 0xFF);
+                WriteReg(card, 0x20 + op_addr[op],  ops[op] & 0xFF);
             }
         }
     }
 
     if(chn != 0xFFF)
     {
-        WriteReg(0xA0 + chn, (ftone & 0xFF));
-        WriteReg(0xB0 + chn, (ftone >> 8));
+        WriteReg(card, 0xA0 + chn, (ftone & 0xFF));
+        WriteReg(card, 0xB0 + chn, (ftone >> 8));
         m_keyBlockFNumCache[c1] = static_cast<uint8_t>(ftone >> 8);
     }
 
     if(cc1 >= OPL3_CHANNELS_RHYTHM_BASE)
     {
-        m_regBD |= (0x10 >> (cc1 - OPL3_CHANNELS_RHYTHM_BASE));
-        WriteReg(0x0BD, m_regBD);
+        m_regBD[card] |= (0x10 >> (cc1 - OPL3_CHANNELS_RHYTHM_BASE));
+        WriteReg(card, 0x0BD, m_regBD[card]);
         //x |= 0x800; // for test
     }
 }
 
 static inline uint_fast32_t brightnessToOPL(uint_fast32_t brightness)
 {
-    double b = static_cast<double>(brightness);
-    double ret = ::round(127.0 * ::sqrt(b * (1.0 / 127.0))) / 2.0;
-    return static_cast<uint_fast32_t>(ret);
+    return s_brightness_to_opl::values[(brightness < 127) ? brightness : 127];
 }
 
 void Generator::touchNote(uint32_t c,
@@ -1093,7 +1376,7 @@ void Generator::touchNote(uint32_t c,
                           uint8_t ccexpr,
                           uint32_t brightness, bool isDrum)
 {
-    uint16_t /*card = c/23,*/ cc = c % 23;
+    uint16_t card = c / 23, cc = c % 23;
     uint16_t i = m_ins[c],
             o1 = g_Operators[cc * 2 + 0],
             o2 = g_Operators[cc * 2 + 1];
@@ -1136,16 +1419,13 @@ void Generator::touchNote(uint32_t c,
     default:
     case VOLUME_Generic:
     {
-        // The formula below: SOLVE(V=127^3 * 2^( (A-63.49999) / 8), A)
-        volume = velocity * ccvolume * ccexpr * 127;
-        const double c1 = 11.541560327111707;
-        const double c2 = 1.601379199767093e+02;
-        uint_fast32_t minVolume = 8725 * 127;
-
-        if(volume > minVolume)
+        // c1 * ln(velocity * ccvolume * ccexpr * 127) - c2, as a sum of logarithms
+        if(velocity > 127)
+            velocity = 127;
+        if(velocity * ccvolume * ccexpr > 8725)
         {
-            double lv = std::log(static_cast<double>(volume));
-            volume = static_cast<uint_fast32_t>(lv * c1 - c2);
+            const int64_t *lv = s_generic_log::values;
+            volume = static_cast<uint32_t>((lv[velocity] + lv[ccvolume] + lv[ccexpr] + s_generic_offset) >> 32);
         }
         else
             volume = 0;
@@ -1227,16 +1507,16 @@ void Generator::touchNote(uint32_t c,
     if(midiVolume > 127)
         midiVolume = 127;
 
-    if(m_four_op_category[c] == ChanCat_Regular ||
-       m_four_op_category[c] == ChanCat_Rhythm_Bass)
+    if(m_four_op_category[cc] == ChanCat_Regular ||
+       m_four_op_category[cc] == ChanCat_Rhythm_Bass)
     {
         mode = m_patch.OPS[i].feedconn & 1; // 2-op FM or 2-op AM
     }
-    else if(m_four_op_category[c] == ChanCat_4op_Master ||
-            m_four_op_category[c] == ChanCat_4op_Slave)
+    else if(m_four_op_category[cc] == ChanCat_4op_Master ||
+            m_four_op_category[cc] == ChanCat_4op_Slave)
     {
         uint32_t i0, i1;
-        if(m_four_op_category[c] == ChanCat_4op_Master)
+        if(m_four_op_category[cc] == ChanCat_4op_Master)
         {
             i0 = i;
             i1 = m_ins[c + 3];
@@ -1378,27 +1658,27 @@ void Generator::touchNote(uint32_t c,
     else
     {
         if(do_modulator)
-            tlMod = 63 - volume + (volume * tlMod) / 63;
+            tlMod = s_tl_scale::values[(volume << 6) | tlMod];
         if(do_carrier)
-            tlCar = 63 - volume + (volume * tlCar) / 63;
+            tlCar = s_tl_scale::values[(volume << 6) | tlCar];
     }
 
     if(brightness != 127)
     {
         brightness = brightnessToOPL(brightness);
         if(!do_modulator)
-            tlMod = 63 - brightness + (brightness * tlMod) / 63;
+            tlMod = s_tl_scale::values[(brightness << 6) | (tlMod & 63)];
         if(!do_carrier)
-            tlCar = 63 - brightness + (brightness * tlCar) / 63;
+            tlCar = s_tl_scale::values[(brightness << 6) | (tlCar & 63)];
     }
 
     modulator = (kslMod & 0xC0) | (tlMod & 63);
     carrier = (kslCar & 0xC0) | (tlCar & 63);
 
     if(o1 != 0xFFF)
-        WriteReg(0x40 + o1, static_cast<uint8_t>(modulator));
+        WriteReg(card, 0x40 + o1, static_cast<uint8_t>(modulator));
     if(o2 != 0xFFF)
-        WriteReg(0x40 + o2, static_cast<uint8_t>(carrier));
+        WriteReg(card, 0x40 + o2, static_cast<uint8_t>(carrier));
 
     // Correct formula (ST3, AdPlug):
     //   63-((63-(instrvol))/63)*chanvol
@@ -1410,7 +1690,7 @@ void Generator::touchNote(uint32_t c,
 
 void Generator::Patch(uint32_t c, uint32_t i)
 {
-    uint32_t cc = c % 23;
+    uint32_t card = c / 23, cc = c % 23;
     static const uint16_t data[4] = {0x20, 0x60, 0x80, 0xE0};
     m_ins[c] = static_cast<uint16_t>(i);
     uint16_t o1 = g_Operators[cc * 2 + 0],
@@ -1420,17 +1700,18 @@ void Generator::Patch(uint32_t c, uint32_t i)
     for(uint32_t a = 0; a < 4; ++a, x >>= 8, y >>= 8)
     {
         if(o1 != 0xFFF)
-            WriteReg(data[a] + o1, x & 0xFF);
+            WriteReg(card, data[a] + o1, x & 0xFF);
         if(o2 != 0xFFF)
-            WriteReg(data[a] + o2, y & 0xFF);
+            WriteReg(card, data[a] + o2, y & 0xFF);
     }
 }
 
 void Generator::Pan(uint32_t c, uint32_t value)
 {
+    uint32_t card = c / 23;
     uint8_t cc = c % 23;
     if(g_Channels_pan[cc] != 0xFFF)
-        WriteReg(0xC0 + g_Channels_pan[cc], static_cast<uint8_t>(m_patch.OPS[m_ins[c]].feedconn | value));
+        WriteReg(card, 0xC0 + g_Channels_pan[cc], static_cast<uint8_t>(m_patch.OPS[m_ins[c]].feedconn | value));
 }
 
 void Generator::PlayNoteF(int noteID, uint32_t volume, uint8_t ccvolume, uint8_t ccexpr)
@@ -1439,7 +1720,9 @@ void Generator::PlayNoteF(int noteID, uint32_t volume, uint8_t ccvolume, uint8_t
         return;//Deny playing notes without instrument loaded
 
     bool replace;
-    int ch = m_noteManager.noteOn(noteID, volume, ccvolume, ccexpr, &replace);
+    int ch = m_voices.noteOn(noteID, volume, ccvolume, ccexpr, &replace);
+    if(ch == -1)
+        return;
 
     if(replace)
     {
@@ -1449,17 +1732,17 @@ void Generator::PlayNoteF(int noteID, uint32_t volume, uint8_t ccvolume, uint8_t
         bool natural_4op = (m_patch.flags & OPL_PatchSetup::Flag_True4op) != 0;
         if(natural_4op)
         {
-            NoteOff(g_channelsMap1_4op[ch]);
+            NoteOff(mapChannel(g_channelsMap1_4op, ch));
         }
         else
         {
             if(pseudo_4op)
             {
-                NoteOff(g_channelsMap1_p4op[ch]);
-                NoteOff(g_channelsMap2_p4op[ch]);
+                NoteOff(mapChannel(g_channelsMap1_p4op, ch));
+                NoteOff(mapChannel(g_channelsMap2_p4op, ch));
             }
             else
-                NoteOff(g_channels2Map_2op[ch]);
+                NoteOff(mapChannel(g_channels2Map_2op, ch));
         }
     }
 
@@ -1472,7 +1755,7 @@ void Generator::PlayNoteCh(int ch)
         return;//Deny playing notes without instrument loaded
 
     int tone;
-    const NotesManager::Note &channel = m_noteManager.channel(ch);
+    const VoiceAllocator::Voice &channel = m_voices.voice(ch);
 
     if(m_patch.tone)
     {
@@ -1494,21 +1777,21 @@ void Generator::PlayNoteCh(int ch)
     {
         if(pseudo_4op)
         {
-            adlchannel[0] = g_channelsMap1_p4op[ch];
-            adlchannel[1] = g_channelsMap2_p4op[ch];
+            adlchannel[0] = mapChannel(g_channelsMap1_p4op, ch);
+            adlchannel[1] = mapChannel(g_channelsMap2_p4op, ch);
             m_debug.chanPs4op = ch;
         }
         else
         {
-            adlchannel[0] = g_channels2Map_2op[ch];
-            adlchannel[1] = g_channels2Map_2op[ch];
+            adlchannel[0] = mapChannel(g_channels2Map_2op, ch);
+            adlchannel[1] = mapChannel(g_channels2Map_2op, ch);
             m_debug.chan2op = ch;
         }
     }
     else if(natural_4op)
     {
-        adlchannel[0] = g_channelsMap1_4op[ch];
-        adlchannel[1] = g_channelsMap2_4op[ch];
+        adlchannel[0] = mapChannel(g_channelsMap1_4op, ch);
+        adlchannel[1] = mapChannel(g_channelsMap2_4op, ch);
         m_debug.chan4op = ch;
     }
 
@@ -1553,7 +1836,7 @@ void Generator::StopNoteF(int noteID)
         return;
     }
 
-    int ch = m_noteManager.findNoteOffChannel(noteID);
+    int ch = m_voices.findNoteOff(noteID);
     if(ch == -1)
         return;
 
@@ -1567,27 +1850,27 @@ void Generator::StopNoteCh(int ch)
 
     if(m_hold)
     {
-        m_noteManager.hold(ch, true);  // stop later after hold is over
+        m_voices.setHeld(ch, true);  // stop later after hold is over
         return;
     }
 
-    m_noteManager.channelOff(ch);
+    m_voices.release(ch);
 
     bool pseudo_4op  = (m_patch.flags & OPL_PatchSetup::Flag_Pseudo4op) != 0;
     bool natural_4op = (m_patch.flags & OPL_PatchSetup::Flag_True4op) != 0;
     if(natural_4op)
     {
-        NoteOff(g_channelsMap1_4op[ch]);
+        NoteOff(mapChannel(g_channelsMap1_4op, ch));
     }
     else
     {
         if(pseudo_4op)
         {
-            NoteOff(g_channelsMap1_p4op[ch]);
-            NoteOff(g_channelsMap2_p4op[ch]);
+            NoteOff(mapChannel(g_channelsMap1_p4op, ch));
+            NoteOff(mapChannel(g_channelsMap2_p4op, ch));
         }
         else
-            NoteOff(g_channels2Map_2op[ch]);
+            NoteOff(mapChannel(g_channels2Map_2op, ch));
     }
 }
 
@@ -1619,12 +1902,15 @@ void Generator::switch4op(bool enabled, bool patchCleanUp)
 {
     m_4op_last_state = enabled;
     //Shut up currently playing stuff
-    for(uint32_t b = 0; b < NUM_OF_CHANNELS; ++b)
+    for(uint32_t card = 0; card < m_activeChips; ++card)
     {
-        if(m_chipType == OPLChipBase::CHIPTYPE_OPL2 && (b == 9))
-            b = 18;
-        NoteOff(b);
-        touchNote(b, 0, 0, 0);
+        for(uint32_t b = 0; b < NUM_OF_CHANNELS; ++b)
+        {
+            if(m_chipType == OPLChipBase::CHIPTYPE_OPL2 && (b == 9))
+                b = 18;
+            NoteOff(card * NUM_OF_CHANNELS + b);
+            touchNote(card * NUM_OF_CHANNELS + b, 0, 0, 0);
+        }
     }
 
     updateRegBD();
@@ -1701,26 +1987,30 @@ void Generator::switch4op(bool enabled, bool patchCleanUp)
     }
 
     //Clear all operator registers from crap left from previous patches
-    for(uint32_t b = 0; b < NUM_OF_CHANNELS; ++b)
+    for(uint32_t card = 0; card < m_activeChips; ++card)
     {
-        if(m_chipType == OPLChipBase::CHIPTYPE_OPL2 && (b == 9))
-            b = 18;
-        Patch(b, 0);
-        Pan(b, (rythmModePercussionMode == 0) ? 0x00 : 0x30);
-        touchNote(b, 0, 0, 0);
+        for(uint32_t b = 0; b < NUM_OF_CHANNELS; ++b)
+        {
+            if(m_chipType == OPLChipBase::CHIPTYPE_OPL2 && (b == 9))
+                b = 18;
+            uint32_t c = card * NUM_OF_CHANNELS + b;
+            Patch(c, 0);
+            Pan(c, (rythmModePercussionMode == 0) ? 0x00 : 0x30);
+            touchNote(c, 0, 0, 0);
+        }
     }
 }
 
 void Generator::Silence()
 {
     //Shutup!
-    for(uint32_t c = 0; c < NUM_OF_CHANNELS; ++c)
+    for(uint32_t c = 0; c < NUM_OF_CHANNELS * m_activeChips; ++c)
     {
         NoteOff(c);
         touchNote(c, 0, 0, 0);
     }
 
-    m_noteManager.clearNotes();
+    m_voices.clear();
 }
 
 void Generator::NoteOffAllChans()
@@ -1734,13 +2024,8 @@ void Generator::NoteOffAllChans()
     if(m_hold)
     {
         // mark all channels held for later key-off
-        int channels = m_noteManager.channelCount();
-        for(int ch = 0; ch < channels; ++ch)
-        {
-            const NotesManager::Note &channel = m_noteManager.channel(ch);
-            if(channel.note != -1)
-                m_noteManager.hold(ch, true);
-        }
+        for(int ch = m_voices.firstActive(); ch != -1; ch = m_voices.nextActive(ch))
+            m_voices.setHeld(ch, true);
         return;
     }
 
@@ -1748,16 +2033,16 @@ void Generator::NoteOffAllChans()
     bool natural_4op = (m_patch.flags & OPL_PatchSetup::Flag_True4op) != 0;
     if(natural_4op)
     {
-        for(uint32_t c = 0; c < USED_CHANNELS_4OP; ++c)
-            NoteOff(g_channelsMap1_4op[c]);
+        for(uint32_t c = 0; c < USED_CHANNELS_4OP * m_activeChips; ++c)
+            NoteOff(mapChannel(g_channelsMap1_4op, c));
     }
     else
     {
-        for(uint32_t c = 0; c < USED_CHANNELS_2OP; ++c)
-            NoteOff(g_channels2Map_2op[c]);
+        for(uint32_t c = 0; c < USED_CHANNELS_2OP * m_activeChips; ++c)
+            NoteOff(mapChannel(g_channels2Map_2op, c));
     }
 
-    m_noteManager.clearNotes();
+    m_voices.clear();
 }
 
 
@@ -1835,13 +2120,8 @@ void Generator::PitchBend(int bend)
 
     m_bend = bend * m_bendsense;
 
-    int channels = m_noteManager.channelCount();
-    for(int ch = 0; ch < channels; ++ch)
-    {
-        const NotesManager::Note &channel = m_noteManager.channel(ch);
-        if(channel.note != -1)
-            PlayNoteCh(ch);  // updates frequency
-    }
+    for(int ch = m_voices.firstActive(); ch != -1; ch = m_voices.nextActive(ch))
+        PlayNoteCh(ch);  // updates frequency
 }
 
 void Generator::PitchBendSensitivity(int cents)
@@ -1861,83 +2141,116 @@ void Generator::Hold(bool held)
     if (!held)
     {
         // key-off all held notes now
-        int channels = m_noteManager.channelCount();
-        for(int ch = 0; ch < channels; ++ch)
+        int ch = m_voices.firstActive();
+        while(ch != -1)
         {
-            const NotesManager::Note &channel = m_noteManager.channel(ch);
-            if(channel.note != -1 && channel.held)
+            int next = m_voices.nextActive(ch);
+            if(m_voices.voice(ch).held)
                 StopNoteCh(ch);
+            ch = next;
         }
     }
 }
 
 void Generator::changePatch(const FmBank::Instrument &instrument, bool isDrum)
 {
+    OPL_PreparedPatch patch;
+    preparePatch(instrument, isDrum, patch);
+    changePatch(patch);
+}
+
+bool Generator::canUpdatePatch(const OPL_PreparedPatch &patch) const
+{
+    return m_isInstrumentLoaded &&
+           !patch.rhythmMode && !rythmModePercussionMode &&
+           patch.natural4op == m_4op_last_state &&
+           patch.setup.flags == m_patch.flags;
+}
+
+void Generator::changePatch(const OPL_PreparedPatch &patch)
+{
+    if(canUpdatePatch(patch))
+    {
+        // Edit of the loaded instrument: the playing voices are set up again
+        // in place. The register shadow drops the writes of what did not
+        // change, and a key-on bit which stays set doesn't retrigger a note.
+        m_patch = patch.setup;
+        for(int ch = m_voices.firstActive(); ch != -1; ch = m_voices.nextActive(ch))
+            PlayNoteCh(ch);
+        return;
+    }
+
     //Shutup everything
     Silence();
     m_bend = 0.0;
     m_bendsense = 2.0 / 8192;
     //m_hold = false;
-    bool isRhythmMode = isDrum && (instrument.adlib_drum_number >= 6);
-
-    changeRhythmMode(isRhythmMode);
-    switch4op(instrument.en_4op && !instrument.en_pseudo4op && (instrument.adlib_drum_number == 0));
-
-    m_patch.OPS[0].modulator_E862   = instrument.getDataE862(MODULATOR1);
-    m_patch.OPS[0].modulator_20     = instrument.getAVEKM(MODULATOR1);
-    m_patch.OPS[0].modulator_40     = instrument.getKSLL(MODULATOR1);
-    m_patch.OPS[0].carrier_E862     = instrument.getDataE862(CARRIER1);
-    m_patch.OPS[0].carrier_20       = instrument.getAVEKM(CARRIER1);
-    m_patch.OPS[0].carrier_40       = instrument.getKSLL(CARRIER1);
-    m_patch.OPS[0].feedconn         = instrument.getFBConn1();
-
-    m_patch.OPS[1].modulator_E862   = instrument.getDataE862(MODULATOR2);
-    m_patch.OPS[1].modulator_20     = instrument.getAVEKM(MODULATOR2);
-    m_patch.OPS[1].modulator_40     = instrument.getKSLL(MODULATOR2);
-    m_patch.OPS[1].carrier_E862     = instrument.getDataE862(CARRIER2);
-    m_patch.OPS[1].carrier_20       = instrument.getAVEKM(CARRIER2);
-    m_patch.OPS[1].carrier_40       = instrument.getKSLL(CARRIER2);
-    m_patch.OPS[1].feedconn         = instrument.getFBConn2();
-
-    m_patch.flags   = 0;
-    m_patch.tone    = 0;
-    m_patch.voice2_fine_tune = 0.0;
 
-    if(isDrum || instrument.is_fixed_note)
-        m_patch.tone = instrument.percNoteNum;
+    changeRhythmMode(patch.rhythmMode);
+    switch4op(patch.natural4op);
 
-    if(isRhythmMode)// Rhythm-mode percussion instrument
+    m_patch = patch.setup;
+
+    if(patch.rhythmMode)// Rhythm-mode percussion instrument
     {
-        testDrum = instrument.adlib_drum_number - 6;
+        testDrum = patch.drum;
         Patch(OPL3_CHANNELS_RHYTHM_BASE + testDrum, 0);
     }
     else // Melodic or Generic percussion instrument
-    {
-        if(instrument.en_4op && instrument.en_pseudo4op)
-        {
-            m_patch.voice2_fine_tune = (double)((((int)instrument.fine_tune + 128) >> 1) - 64) / 32.0;
-            m_patch.OPS[0].finetune = static_cast<int8_t>(instrument.note_offset1);
-            m_patch.OPS[1].finetune = static_cast<int8_t>(instrument.note_offset2);
-        }
-        else
-        {
-            m_patch.OPS[0].finetune = static_cast<int8_t>(instrument.note_offset1);
-            m_patch.OPS[1].finetune = static_cast<int8_t>(instrument.note_offset1);
-        }
-
-        if(instrument.en_4op)
-        {
-            if(instrument.en_pseudo4op)
-                m_patch.flags |= OPL_PatchSetup::Flag_Pseudo4op;
-            else
-                m_patch.flags |= OPL_PatchSetup::Flag_True4op;
-        }
         updateChannelManager();
-    }
 
     m_isInstrumentLoaded = true;//Mark instrument as loaded
 }
 
+void Generator::preparePatch(const FmBank::Instrument &instrument, bool isDrum, OPL_PreparedPatch &patch)
+{
+    patch = OPL_PreparedPatch();
+    patch.rhythmMode = isDrum && (instrument.adlib_drum_number >= 6);
+    patch.natural4op = instrument.en_4op && !instrument.en_pseudo4op && (instrument.adlib_drum_number == 0);
+    if(patch.rhythmMode)
+        patch.drum = static_cast<uint8_t>(instrument.adlib_drum_number - 6);
+
+    OPL_PatchSetup &setup = patch.setup;
+    setup.OPS[0].modulator_E862   = instrument.getDataE862(MODULATOR1);
+    setup.OPS[0].modulator_20     = instrument.getAVEKM(MODULATOR1);
+    setup.OPS[0].modulator_40     = instrument.getKSLL(MODULATOR1);
+    setup.OPS[0].carrier_E862     = instrument.getDataE862(CARRIER1);
+    setup.OPS[0].carrier_20       = instrument.getAVEKM(CARRIER1);
+    setup.OPS[0].carrier_40       = instrument.getKSLL(CARRIER1);
+    setup.OPS[0].feedconn         = instrument.getFBConn1();
+
+    setup.OPS[1].modulator_E862   = instrument.getDataE862(MODULATOR2);
+    setup.OPS[1].modulator_20     = instrument.getAVEKM(MODULATOR2);
+    setup.OPS[1].modulator_40     = instrument.getKSLL(MODULATOR2);
+    setup.OPS[1].carrier_E862     = instrument.getDataE862(CARRIER2);
+    setup.OPS[1].carrier_20       = instrument.getAVEKM(CARRIER2);
+    setup.OPS[1].carrier_40       = instrument.getKSLL(CARRIER2);
+    setup.OPS[1].feedconn         = instrument.getFBConn2();
+
+    if(isDrum || instrument.is_fixed_note)
+        setup.tone = instrument.percNoteNum;
+
+    setup.OPS[0].finetune = static_cast<int8_t>(instrument.note_offset1);
+    setup.OPS[1].finetune = static_cast<int8_t>(instrument.note_offset1);
+
+    if(patch.rhythmMode)
+        return;
+
+    if(instrument.en_4op && instrument.en_pseudo4op)
+    {
+        setup.voice2_fine_tune = (double)((((int)instrument.fine_tune + 128) >> 1) - 64) / 32.0;
+        setup.OPS[1].finetune = static_cast<int8_t>(instrument.note_offset2);
+    }
+
+    if(instrument.en_4op)
+    {
+        if(instrument.en_pseudo4op)
+            setup.flags |= OPL_PatchSetup::Flag_Pseudo4op;
+        else
+            setup.flags |= OPL_PatchSetup::Flag_True4op;
+    }
+}
+
 void Generator::changeNote(int newnote)
 {
     note = int32_t(newnote);
@@ -1960,6 +2273,13 @@ void Generator::changeVolumeModel(int volmodel)
     m_volumeScale = volmodel;
 }
 
+void Generator::changeStealPolicy(int policy)
+{
+    if(policy < VoiceAllocator::STEAL_OLDEST || policy >= VoiceAllocator::STEAL_END)
+        policy = VoiceAllocator::STEAL_OLDEST;
+    m_voices.setStealPolicy(static_cast<VoiceAllocator::StealPolicy>(policy));
+}
+
 void Generator::changeRhythmMode(bool enabled)
 {
     rythmModePercussionMode = uint8_t(enabled);
@@ -1968,8 +2288,10 @@ void Generator::changeRhythmMode(bool enabled)
 
 void Generator::updateRegBD()
 {
-    m_regBD = (deepTremoloMode * 0x80) + (deepVibratoMode * 0x40) + (rythmModePercussionMode * 0x20);
-    WriteReg(0x0BD, m_regBD);
+    uint8_t regBD = (deepTremoloMode * 0x80) + (deepVibratoMode * 0x40) + (rythmModePercussionMode * 0x20);
+    for(uint32_t i = 0; i < m_activeChips; ++i)
+        m_regBD[i] = regBD;
+    WriteReg(0x0BD, regBD);
 }
 
 void Generator::updateChannelManager()
@@ -1986,134 +2308,68 @@ void Generator::updateChannelManager()
     }
 
     if(pseudo_4op)
-        m_noteManager.allocateChannels(chanPs4ops);
+        m_voices.allocate(chanPs4ops * m_activeChips);
     else if(natural_4op)
-        m_noteManager.allocateChannels(USED_CHANNELS_4OP);
+        m_voices.allocate(USED_CHANNELS_4OP * m_activeChips);
     else
-        m_noteManager.allocateChannels(chan2ops);
-}
-
-void Generator::generate(int16_t *frames, unsigned nframes)
-{
-    chip->generate(frames, nframes);
-    // 2x Gain by default
-    for(size_t i = 0; i < nframes * 2; ++i)
-        frames[i] *= 2;
+        m_voices.allocate(chan2ops * m_activeChips);
 }
 
-Generator::NotesManager::NotesManager()
+void Generator::renderChip(void *self, uint32_t chipId)
 {
-    channels.reserve(USED_CHANNELS_2OP);
+    Generator *gen = static_cast<Generator *>(self);
+    gen->m_chips[chipId]->generateFloat(gen->m_mixBuffers[chipId].get(), gen->m_renderFrames);
 }
 
-Generator::NotesManager::~NotesManager()
-{}
-
-void Generator::NotesManager::allocateChannels(int count)
+void Generator::mixChips(unsigned nframes)
 {
-    channels.clear();
-    channels.resize(count);
-    cycle = 0;
-}
-
-uint8_t Generator::NotesManager::noteOn(int note, uint32_t volume, uint8_t ccvolume, uint8_t ccexpr, bool *r)
-{
-    uint8_t beganAt = cycle;
-    uint8_t chan = 0;
+    m_renderFrames = nframes;
+    if(m_renderThreads)
+        m_renderThreads->run(&renderChip, this);
+    else
+        renderChip(this, 0);
 
-    // Increase age of all working notes;
-    for(Note &ch : channels)
+    float *mix = m_mixBuffers[0].get();
+    for(uint32_t c = 1; c < m_activeChips; ++c)
     {
-        if(note >= 0)
-            ch.age++;
+        const float *src = m_mixBuffers[c].get();
+        for(size_t i = 0; i < nframes * 2; ++i)
+            mix[i] += src[i];
     }
+}
 
-    bool replace = true;
-
-    do
+void Generator::generate(int16_t *frames, unsigned nframes)
+{
+    while(nframes > 0)
     {
-        chan = cycle++;
-        // Rotate cycles
-        if(cycle == channels.size())
-            cycle = 0;
-
-        if(channels[chan].note == -1)
-        {
-            channels[chan].note = note;
-            channels[chan].volume = volume;
-            channels[chan].ccvolume = ccvolume;
-            channels[chan].ccexpr = ccexpr;
-            channels[chan].held = false;
-            channels[chan].age = 0;
-            replace = false;
-            break;
-        }
-
-        if (cycle == beganAt) // If no free channels found
+        unsigned count = (nframes < MAX_OPLGEN_BUFFER_SIZE) ? nframes : MAX_OPLGEN_BUFFER_SIZE;
+        mixChips(count);
+        const float *mix = m_mixBuffers[0].get();
+        // 2x Gain by default, saturated; the gain used to be applied to
+        // the clipped 16-bit output of the chip, where loud passages wrapped
+        for(size_t i = 0; i < count * 2; ++i)
         {
-            int age = -1;
-            int oldest = -1;
-            // Find oldest note
-            for(uint8_t c = 0; c < channels.size(); c++)
-            {
-                if((channels[c].note >= 0) && ((age == -1) || (channels[c].age > age)))
-                {
-                    oldest = c;
-                    age = channels[c].age;
-                }
-            }
-
-            if(age >= 0)
-            {
-                chan = (uint8_t)oldest;
-                channels[chan].note = note;
-                channels[chan].volume = volume;
-                channels[chan].ccvolume = ccvolume;
-                channels[chan].ccexpr = ccexpr;
-                channels[chan].held = false;
-                channels[chan].age = 0;
-            }
-            break;
+            float sample = mix[i] * (2.0f * 32768.0f);
+            sample = (sample > -32768.0f) ? sample : -32768.0f;
+            sample = (sample < 32767.0f) ? sample : 32767.0f;
+            frames[i] = static_cast<int16_t>(sample);
         }
-    } while(1);
-
-    if(r)
-        *r = replace;
-
-    return chan;
-}
-
-int8_t Generator::NotesManager::noteOff(int note)
-{
-    int8_t chan = findNoteOffChannel(note);
-    if(chan != -1)
-        channelOff(chan);
-    return chan;
-}
-
-void Generator::NotesManager::channelOff(int ch)
-{
-    channels[ch].note = -1;
+        frames += count * 2;
+        nframes -= count;
+    }
 }
 
-int8_t Generator::NotesManager::findNoteOffChannel(int note)
+void Generator::generateFloat(float *frames, unsigned nframes)
 {
-    // find the first active note not in held state (delayed noteoff)
-    for(uint8_t chan = 0; chan < channels.size(); chan++)
+    while(nframes > 0)
     {
-        if(channels[chan].note == note && !channels[chan].held)
-            return (int8_t)chan;
+        unsigned count = (nframes < MAX_OPLGEN_BUFFER_SIZE) ? nframes : MAX_OPLGEN_BUFFER_SIZE;
+        mixChips(count);
+        const float *mix = m_mixBuffers[0].get();
+        // 2x Gain by default
+        for(size_t i = 0; i < count * 2; ++i)
+            frames[i] = 2.0f * mix[i];
+        frames += count * 2;
+        nframes -= count;
     }
-    return -1;
-}
-
-void Generator::NotesManager::hold(int ch, bool h)
-{
-    channels[ch].held = h;
-}
-
-void Generator::NotesManager::clearNotes()
-{
-    for(uint8_t chan = 0; chan < channels.size(); chan++)
-        channels[chan].note = -1;
 }
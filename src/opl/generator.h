@@ -22,9 +22,11 @@
 #include <stdint.h>
 #include <memory>
 #include <QIODevice>
+#include <QMutex>
 #include <QObject>
 
 #include "chips/opl_chip_base.h"
+#include "voice_allocator.h"
 #include "../bank.h"
 
 #ifdef ENABLE_HW_OPL_PROXY
@@ -37,6 +39,7 @@ class OPL_SerialPort;
 
 #define NUM_OF_CHANNELS         23
 #define MAX_OPLGEN_BUFFER_SIZE  4096
+#define MAX_OPLGEN_CHIPS        8
 
 struct OPL_Operator
 {
@@ -70,11 +73,47 @@ struct OPL_PatchSetup
     double         voice2_fine_tune;
 };
 
+/**
+ * @brief Instrument converted to chip settings, ready to be loaded
+ * It needs no generator to be made, so it can be prepared away from the
+ * audio thread, which only copies it in.
+ */
+struct OPL_PreparedPatch
+{
+    OPL_PatchSetup setup;
+    //! Drum of the rhythm mode of the chip
+    bool rhythmMode;
+    //! Needs the 4-operator channels of the chip
+    bool natural4op;
+    //! Rhythm-mode drum, from 0 (bass drum) to 4 (hi-hat)
+    uint8_t drum;
+};
+
+class ChipRenderThreads;
+
 struct GeneratorDebugInfo
 {
     int chan2op = -1;
     int chanPs4op = -1;
     int chan4op = -1;
+    //! Register writes sent to the chips
+    uint64_t regWritesForwarded = 0;
+    //! Register writes dropped because the register already holds the value
+    uint64_t regWritesSuppressed = 0;
+    //! Times the control thread waited for room in the realtime queue
+    uint64_t ctlStalls = 0;
+    //! MIDI input messages dropped, the realtime queue being full
+    uint64_t midiDrops = 0;
+    //! Audio thread: frames of the last block, render time over block duration
+    uint32_t blockFrames = 0;
+    float load = 0;
+    float loadPeak = 0;
+    uint32_t renderUsPeak = 0;
+    uint64_t underflows = 0;
+    //! Audio thread: most messages in a block, most bytes waiting in the queues
+    uint32_t messagesPeak = 0;
+    uint32_t ctlQueuedPeak = 0;
+    uint32_t midiQueuedPeak = 0;
     QString toStr();
 };
 
@@ -90,15 +129,28 @@ public:
         CHIP_Java,
         CHIP_Win9xProxy,
         CHIP_SerialPort,
+        CHIP_NukedSIMD,
         CHIP_END
     };
-    Generator(uint32_t sampleRate, OPL_Chips initialChip);
+    Generator(uint32_t sampleRate, OPL_Chips initialChip, uint32_t chipCount = 1);
     ~Generator();
 
     void initChip();
     void switchChip(OPL_Chips chipId);
+    /**
+     * @brief Number of chips the voices are spread across
+     * Hardware chips are always used alone.
+     */
+    uint32_t chipCount() const
+        { return m_activeChips; }
+    //! Number of chips asked for at the construction
+    uint32_t chipCountSetting() const
+        { return m_chipCount; }
+    uint32_t sampleRate() const
+        { return m_rate; }
 
     void generate(int16_t *frames, unsigned nframes);
+    void generateFloat(float *frames, unsigned nframes);
 
     /**
      * @brief Set the tone frequency on the chip channel and turn note on
@@ -163,10 +215,13 @@ public:
     void Hold(bool held);
 
     void changePatch(const FmBank::Instrument &instrument, bool isDrum = false);
+    void changePatch(const OPL_PreparedPatch &patch);
+    static void preparePatch(const FmBank::Instrument &instrument, bool isDrum, OPL_PreparedPatch &patch);
     void changeNote(int newnote);
     void changeDeepTremolo(bool enabled);
     void changeDeepVibrato(bool enabled);
     void changeVolumeModel(int volmodel);
+    void changeStealPolicy(int policy);
     void changeRhythmMode(bool enabled);
     void updateRegBD();
     void updateChannelManager();
@@ -182,50 +237,41 @@ public:
     static OPL_SerialPort &serialPortOpl();
 #endif
 
+    /**
+     * @brief Serializes the access to the hardware chips
+     * The hardware chips are shared by all generators: hold it to set up or
+     * configure them, and while playing on them.
+     */
+    static QMutex &hardwareMutex();
+    static bool isHardwareChip(OPL_Chips chip)
+        { return chip == CHIP_Win9xProxy || chip == CHIP_SerialPort; }
+    //! The generator plays on a hardware chip
+    bool usesHardware() const;
+
 private:
     GeneratorDebugInfo m_debug;
 
 private:
+    //! Writes a register of every chip
     void WriteReg(uint16_t address, uint8_t byte);
+    //! Writes a register of one chip, unless it already holds the value
+    void WriteReg(uint32_t chipId, uint16_t address, uint8_t byte);
+    //! Forgets the register values of the chips, the next writes are all sent
+    void resetRegShadow();
+    //! Chip channel of a voice; voices alternate between chips
+    uint32_t mapChannel(const uint16_t *map, int voice) const;
+    /**
+     * @brief Whether the patch can replace the loaded one under the playing
+     * notes: same rhythm mode and same layout of the channels
+     */
+    bool canUpdatePatch(const OPL_PreparedPatch &patch) const;
+    //! Renders the chip of the given index into its mixing buffer
+    static void renderChip(void *self, uint32_t chipId);
+    //! Renders all chips and sums them into the first mixing buffer
+    void mixChips(unsigned nframes);
 
-    class NotesManager
-    {
-    public:
-        struct Note
-        {
-            //! Currently pressed key. -1 means channel is free
-            int note    = -1;
-            //! Note volume determined by velocity
-            uint32_t volume = 0;
-            //! Channel volume determined by controller
-            uint8_t ccvolume = 0;
-            //! Channel expression determined by controller
-            uint8_t ccexpr = 0;
-            //! Age in count of noteOn requests
-            int age = 0;
-            //! Whether it has a pending noteOff being delayed while held
-            bool held = false;
-        };
-    private:
-        //! Channels range, contains entries count equal to chip channels
-        QVector<Note> channels;
-        //! Round-Robin cycler. Looks for any free channel that is not busy. Otherwise, oldest busy note will be replaced
-        uint8_t cycle = 0;
-    public:
-        NotesManager();
-        ~NotesManager();
-        void allocateChannels(int count);
-        uint8_t noteOn(int note, uint32_t volume, uint8_t ccvolume, uint8_t ccexpr, bool *replace = nullptr);
-        int8_t  noteOff(int note);
-        void    channelOff(int ch);
-        int8_t  findNoteOffChannel(int note);
-        void hold(int ch, bool h);
-        void clearNotes();
-        const Note &channel(int ch) const
-            { return channels.at(ch); }
-        int channelCount() const
-            { return static_cast<int>(channels.size()); }
-    } m_noteManager;
+    //! Voices of the melodic notes
+    VoiceAllocator m_voices;
 
     int32_t     note;
     double      m_bend = 0.0;
@@ -242,11 +288,22 @@ private:
     uint32_t    m_rate = 44100;
 
     struct OPLChipDelete { void operator()(OPLChipBase *); };
-    std::unique_ptr<OPLChipBase, OPLChipDelete> chip;
+    std::unique_ptr<OPLChipBase, OPLChipDelete> m_chips[MAX_OPLGEN_CHIPS];
+    //! Number of emulated chips to use
+    uint32_t    m_chipCount = 1;
+    //! Number of chips in use, one for hardware chips
+    uint32_t    m_activeChips = 0;
     OPLChipBase::ChipType m_chipType = OPLChipBase::CHIPTYPE_OPL3;
 
+    //! Renders chips other than the first one in parallel
+    std::unique_ptr<ChipRenderThreads> m_renderThreads;
+    //! Output of every chip, mixed together after rendering
+    std::unique_ptr<float[]> m_mixBuffers[MAX_OPLGEN_CHIPS];
+    //! Frames count of the block being rendered
+    unsigned    m_renderFrames = 0;
+
     OPL_PatchSetup m_patch;
-    uint8_t     m_regBD;
+    uint8_t     m_regBD[MAX_OPLGEN_CHIPS];
 
     /**
      * @brief Channel categiry enumeration
@@ -283,9 +340,14 @@ private:
     // 8 = percussion slave
 
     //! index of operators pair, cached, needed by Touch()
-    uint16_t    m_ins[NUM_OF_CHANNELS];
+    uint16_t    m_ins[NUM_OF_CHANNELS * MAX_OPLGEN_CHIPS];
     //! value poked to B0, cached, needed by NoteOff)(
-    uint8_t     m_keyBlockFNumCache[NUM_OF_CHANNELS];
+    uint8_t     m_keyBlockFNumCache[NUM_OF_CHANNELS * MAX_OPLGEN_CHIPS];
+
+    //! Last value written to every register of every chip
+    uint8_t     m_regShadow[MAX_OPLGEN_CHIPS][512];
+    //! Bit set for every register of which the value in m_regShadow is known
+    uint32_t    m_regShadowKnown[MAX_OPLGEN_CHIPS][512 / 32];
 };
 
 #endif // GENERATOR_H
@@ -0,0 +1,104 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2018-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generator_midi.h"
+#include "generator.h"
+
+void GeneratorMidi::reset()
+{
+    for(unsigned i = 0; i < 16; ++i)
+        m_channels[i] = ChannelInfo();
+}
+
+void GeneratorMidi::event(Generator &gen, const uint8_t *data, unsigned len)
+{
+    if(len == 3)
+    {
+        unsigned msg = data[0] >> 4;
+        unsigned chan = data[0] & 0x0f;
+        unsigned note = data[1] & 0x7f;
+        unsigned vel = data[2] & 0x7f;
+
+        ChannelInfo &ch = m_channels[chan];
+
+        if(msg == 0x9 && vel == 0)
+            msg = 0x8;
+
+        switch(msg) {
+        case 0x8:
+            gen.changeNote((int)note);
+            gen.StopNote();
+            break;
+        case 0x9:
+            gen.changeNote((int)note);
+            gen.PlayNote(vel, ch.volume, ch.expression);
+            break;
+        case 0xb:
+            switch (note) {
+            case 120:  // all sound off
+                gen.Silence();
+                break;
+            case 123:  // all notes off
+                gen.NoteOffAllChans();
+                break;
+            case 7:  // volume
+                ch.volume = vel;
+                break;
+            case 11:  // expression
+                ch.expression = vel;
+                break;
+            case 64:  // hold pedal
+                gen.Hold(vel >= 64);
+                break;
+            case 98:  // NRPN LSB
+                ch.lastlrpn = vel, ch.nrpn = true;
+                break;
+            case 99:  // NRPN MSB
+                ch.lastmrpn = vel, ch.nrpn = true;
+                break;
+            case 100:  // RPN LSB
+                ch.lastlrpn = vel, ch.nrpn = false;
+                break;
+            case 101:  // RPN MSB
+                ch.lastmrpn = vel, ch.nrpn = false;
+                break;
+            case 6: {  // data entry MSB
+                unsigned addr = ch.lastmrpn * 0x100 + ch.lastlrpn;
+                if (!ch.nrpn && addr == 0) {
+                    ch.bendsensemsb = vel;
+                    int cents = ch.bendsensemsb * 100 + ch.bendsenselsb;
+                    gen.PitchBendSensitivity(cents);
+                }
+                break;
+            }
+            case 38:  // data entry LSB
+                unsigned addr = ch.lastmrpn * 0x100 + ch.lastlrpn;
+                if (!ch.nrpn && addr == 0) {
+                    ch.bendsenselsb = vel;
+                    int cents = ch.bendsensemsb * 100 + ch.bendsenselsb;
+                    gen.PitchBendSensitivity(cents);
+                }
+                break;
+            }
+            break;
+        case 0xe:
+            gen.PitchBend((int)((vel << 7) | note) - 8192);
+            break;
+        }
+    }
+}
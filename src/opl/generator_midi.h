@@ -0,0 +1,58 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2018-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERATOR_MIDI_H
+#define GENERATOR_MIDI_H
+
+#include <stdint.h>
+
+class Generator;
+
+/**
+ * @brief Plays MIDI channel messages with a generator
+ *
+ * The generator has a single patch, every channel plays it; program
+ * changes are ignored. The controllers are kept per channel.
+ */
+class GeneratorMidi
+{
+public:
+    struct ChannelInfo
+    {
+        unsigned lastmrpn = 0;
+        unsigned lastlrpn = 0;
+        bool nrpn = false;
+        unsigned bendsensemsb = 2;
+        unsigned bendsenselsb = 0;
+        unsigned volume = 100;
+        unsigned expression = 127;
+    };
+
+    //! Puts all channels back to their initial state
+    void reset();
+
+    void event(Generator &gen, const uint8_t *data, unsigned len);
+
+    ChannelInfo &channel(unsigned chan)
+        { return m_channels[chan & 15]; }
+
+private:
+    ChannelInfo m_channels[16];
+};
+
+#endif // GENERATOR_MIDI_H
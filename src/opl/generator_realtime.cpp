@@ -18,6 +18,8 @@
 
 #include "generator_realtime.h"
 #include "generator.h"
+#include "midi_sequencer.h"
+#include <algorithm>
 #include <chrono>
 #include <string.h>
 
@@ -37,6 +39,7 @@ enum MessageTag
     MSG_CtlDeepTremolo,
     MSG_CtlVolumeModel,
     MSG_CtlVolume,
+    MSG_CtlStealPolicy,
 };
 
 struct MessageHeader
@@ -45,6 +48,13 @@ struct MessageHeader
     unsigned size;
 };
 
+struct MidiEventHeader
+{
+    MessageHeader hdr;
+    //! Time the event was received, by the MIDI clock
+    int64_t time;
+};
+
 // Begin Messages
 enum class ChordType
 {
@@ -59,25 +69,13 @@ struct ChordMessage
     unsigned note;
 };
 
-struct PatchChangeMessage
-{
-    FmBank::Instrument instrument;
-    bool isDrum;
-};
 // End Messages
 
-enum { fifo_capacity = 8192 };
-
-static void wait_for_fifo_write_space(Ring_Buffer &rb, unsigned size)
-{
-    while(rb.size_free() < sizeof(MessageHeader) + size) {
-#if defined(_WIN32)
-        Sleep(1);
-#else
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-#endif
-    }
-}
+//! Room for the objects retired by the audio thread, before they get freed
+enum { retired_capacity = 64 * sizeof(void *) };
+enum { midi_msglen_max = 64 };
+//! Set in m_patchShared when the audio thread has not taken the patch yet
+enum { patch_fresh = 4, patch_index_mask = 3 };
 
 IRealtimeControl::IRealtimeControl(QObject *parent)
     : QObject(parent)
@@ -90,35 +88,110 @@ IRealtimeControl::IRealtimeControl(QObject *parent)
 
 void IRealtimeControl::debugInfoUpdate()
 {
+    ctl_reclaim();
+    ctl_collectStats();
     GeneratorDebugInfo info = generatorDebugInfo();
     emit debugInfo(info.toStr());
 }
 
-RealtimeGenerator::RealtimeGenerator(const std::shared_ptr<Generator> &gen, QObject *parent)
+RealtimeGenerator::RealtimeGenerator(std::unique_ptr<Generator> gen, QObject *parent)
+    : RealtimeGenerator(std::move(gen), Setup(), parent)
+{
+}
+
+RealtimeGenerator::RealtimeGenerator(std::unique_ptr<Generator> gen, const Setup &setup, QObject *parent)
     : IRealtimeControl(parent),
-      m_gen(gen),
-      m_rb_ctl(new Ring_Buffer(fifo_capacity)),
-      m_rb_midi(new Ring_Buffer(fifo_capacity)),
-      m_body(new uint8_t[fifo_capacity])
+      m_rtGen(gen.release()),
+      m_nextGen(nullptr),
+      m_nextSong(nullptr),
+      m_stopSong(false),
+      m_rb_retired(new Ring_Buffer(retired_capacity)),
+      m_patches(new OPL_PreparedPatch[3]),
+      m_patchShared(1),
+      m_ctlWaiting(false),
+      m_midiDrops(0),
+      m_rtBlock()
 {
+    // Each queue must hold its largest message, or a writer would wait forever
+    const size_t ctlCapacity = std::max<size_t>(
+        setup.controlCapacity, sizeof(MessageHeader) + sizeof(ChordMessage));
+    const size_t midiCapacity = std::max<size_t>(
+        setup.midiCapacity, sizeof(MidiEventHeader) + midi_msglen_max);
+    m_rb_ctl.reset(new Ring_Buffer(ctlCapacity));
+    m_rb_midi.reset(new Ring_Buffer(midiCapacity));
+    m_body.reset(new uint8_t[std::max(ctlCapacity, midiCapacity)]);
+    m_ctlGen = m_rtGen;
 }
 
 RealtimeGenerator::~RealtimeGenerator()
-{}
+{
+    // The audio is stopped already, nothing is in use anymore
+    ctl_reclaim();
+    delete m_nextGen.exchange(nullptr);
+    delete m_nextSong.exchange(nullptr);
+    delete m_rtSong;
+    delete m_rtGen;
+}
+
+void RealtimeGenerator::ctl_reclaim()
+{
+    Ring_Buffer &rb = *m_rb_retired;
+    RetiredObject obj;
+    while(rb.size_used() >= sizeof(obj) && rb.get(obj))
+    {
+        delete obj.gen;
+        delete obj.song;
+    }
+}
+
+void RealtimeGenerator::ctl_wait_for_space(unsigned size)
+{
+    Ring_Buffer &rb = *m_rb_ctl;
+    const size_t needed = sizeof(MessageHeader) + size;
+    if(rb.size_free() >= needed)
+        return;
+
+    ++m_ctlStalls;
+    std::unique_lock<std::mutex> lock(m_ctlSpaceMutex);
+    m_ctlWaiting.store(true);
+    while(rb.size_free() < needed)
+        m_ctlSpaceFreed.wait_for(lock, std::chrono::milliseconds(10));
+    m_ctlWaiting.store(false);
+}
 
 /* Control */
 void RealtimeGenerator::ctl_switchChip(int chipId)
 {
-    // non-RT, hence lock and processing in control thread
-    std::unique_lock<mutex_type> lock(m_generator_mutex);
-    m_gen->switchChip((Generator::OPL_Chips)chipId);
+    ctl_reclaim();
+
+    // A hardware chip is set up as the generator is made; the audio thread
+    // may still be playing on it, it leaves it alone until this is done
+    QMutexLocker hardwareLock(Generator::isHardwareChip((Generator::OPL_Chips)chipId) ?
+                              &Generator::hardwareMutex() : nullptr);
+
+    // Made in the control thread while the audio goes on with the current
+    // one, then given the settings the current one has received so far
+    Generator *gen = new Generator(m_ctlGen->sampleRate(), (Generator::OPL_Chips)chipId,
+                                   m_ctlGen->chipCountSetting());
+    const ControlState &st = m_ctlState;
+    gen->changeDeepVibrato(st.deepVibrato);
+    gen->changeDeepTremolo(st.deepTremolo);
+    gen->changeVolumeModel(st.volumeModel);
+    if(st.stealPolicy >= 0)
+        gen->changeStealPolicy(st.stealPolicy);
+    if(st.hasPatch)
+        gen->changePatch(st.patch, st.isDrum);
+
+    m_ctlGen = gen;
+    // A generator published before, not taken yet, was never used
+    delete m_nextGen.exchange(gen, std::memory_order_acq_rel);
 }
 
 void RealtimeGenerator::ctl_initChip()
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlInitChip, 0};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
 }
 
@@ -126,7 +199,7 @@ void RealtimeGenerator::ctl_silence()
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlSilence, 0};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
 }
 
@@ -134,7 +207,7 @@ void RealtimeGenerator::ctl_noteOffAllChans()
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlNoteOffAllChans, 0};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
 }
 
@@ -142,7 +215,7 @@ void RealtimeGenerator::ctl_playNote()
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlPlayNote, sizeof(uint)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(m_note);
 }
@@ -151,7 +224,7 @@ void RealtimeGenerator::ctl_stopNote()
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlStopNote, sizeof(uint)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(m_note);
 }
@@ -160,7 +233,7 @@ void RealtimeGenerator::ctl_pitchBend(int bend)
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlPitchBend, sizeof(int)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(bend);
 }
@@ -169,7 +242,7 @@ void RealtimeGenerator::ctl_hold(bool held)
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlHold, sizeof(bool)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(held);
 }
@@ -178,7 +251,7 @@ void RealtimeGenerator::ctl_playChord(int chord)
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlPlayChord, sizeof(ChordMessage)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     ChordMessage ch;
     ch.chord = (ChordType)chord;
@@ -201,107 +274,327 @@ void IRealtimeControl::ctl_playMinor7Chord()
 
 void RealtimeGenerator::ctl_changePatch(FmBank::Instrument &instrument, bool isDrum)
 {
-    Ring_Buffer &rb = *m_rb_ctl;
-    MessageHeader hdr = {MSG_CtlPatchChange, sizeof(PatchChangeMessage)};
-    wait_for_fifo_write_space(rb, hdr.size);
-    rb.put(hdr);
-    PatchChangeMessage pc;
-    pc.instrument = instrument;
-    pc.isDrum = isDrum;
-    rb.put(pc);
+    Generator::preparePatch(instrument, isDrum, m_patches[m_patchWrite]);
+    const unsigned previous = m_patchShared.exchange(m_patchWrite | patch_fresh, std::memory_order_acq_rel);
+    m_patchWrite = previous & patch_index_mask;
+
+    // The message only tells when to load the patch, in order with the
+    // other messages; if the previous patch is still waiting, its message
+    // will load this one instead
+    if(!(previous & patch_fresh))
+    {
+        Ring_Buffer &rb = *m_rb_ctl;
+        MessageHeader hdr = {MSG_CtlPatchChange, 0};
+        ctl_wait_for_space(hdr.size);
+        rb.put(hdr);
+    }
+
+    m_ctlState.patch = instrument;
+    m_ctlState.isDrum = isDrum;
+    m_ctlState.hasPatch = true;
 }
 
 void RealtimeGenerator::ctl_changeDeepVibrato(bool enabled)
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlDeepVibrato, sizeof(bool)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(enabled);
+    m_ctlState.deepVibrato = enabled;
 }
 
 void RealtimeGenerator::ctl_changeDeepTremolo(bool enabled)
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlDeepTremolo, sizeof(bool)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(enabled);
+    m_ctlState.deepTremolo = enabled;
 }
 
 void RealtimeGenerator::ctl_changeVolumeModel(int model)
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlVolumeModel, sizeof(int)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(model);
+    m_ctlState.volumeModel = model;
 }
 
 void RealtimeGenerator::ctl_changeVolume(unsigned vol)
 {
     Ring_Buffer &rb = *m_rb_ctl;
     MessageHeader hdr = {MSG_CtlVolume, sizeof(unsigned)};
-    wait_for_fifo_write_space(rb, hdr.size);
+    ctl_wait_for_space(hdr.size);
     rb.put(hdr);
     rb.put(vol);
 }
 
-/* MIDI */
-void RealtimeGenerator::midi_event(const uint8_t *msg, unsigned msglen)
+void RealtimeGenerator::ctl_changeStealPolicy(int policy)
 {
-    enum { midi_msglen_max = 64 };
+    Ring_Buffer &rb = *m_rb_ctl;
+    MessageHeader hdr = {MSG_CtlStealPolicy, sizeof(int)};
+    ctl_wait_for_space(hdr.size);
+    rb.put(hdr);
+    rb.put(policy);
+    m_ctlState.stealPolicy = policy;
+}
 
+/* MIDI */
+void RealtimeGenerator::midi_event(const uint8_t *msg, unsigned msglen, int64_t time)
+{
     if(msglen > midi_msglen_max)
+    {
+        m_midiDrops.fetch_add(1, std::memory_order_relaxed);
         return;
+    }
 
+    // The MIDI input can't wait, what doesn't fit is lost
     Ring_Buffer &rb = *m_rb_midi;
-    MessageHeader hdr = {MSG_MidiEvent, msglen};
-    if (rb.size_free() >= sizeof(hdr) + hdr.size) {
-        rb.put(hdr);
-        rb.put(msg, msglen);
+    MidiEventHeader hdr = {{MSG_MidiEvent, msglen}, time};
+    Ring_Buffer::Write_Span span;
+    if (rb.acquire_write(sizeof(hdr) + msglen, span)) {
+        span.copy_in(0, &hdr, sizeof(hdr));
+        span.copy_in(sizeof(hdr), msg, msglen);
+        rb.commit_write(sizeof(hdr) + msglen);
     }
+    else
+        m_midiDrops.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Song */
+void RealtimeGenerator::ctl_playSong(std::unique_ptr<MidiSequencer> song)
+{
+    ctl_reclaim();
+    delete m_nextSong.exchange(song.release(), std::memory_order_acq_rel);
+}
+
+void RealtimeGenerator::ctl_stopSong()
+{
+    ctl_reclaim();
+    delete m_nextSong.exchange(nullptr, std::memory_order_acq_rel);
+    m_stopSong.store(true, std::memory_order_release);
 }
 
 /* Realtime */
 void RealtimeGenerator::rt_generate(int16_t *frames, unsigned nframes)
 {
-    std::unique_lock<mutex_type> lock(m_generator_mutex, std::try_to_lock);
-    if(!lock.owns_lock()) {
-        memset(frames, 0, 2 * nframes * sizeof(*frames));
+    int64_t now;
+    if(!rt_block_begin(now))
+    {
+        std::fill(frames, frames + 2 * nframes, 0);
+        rt_block_end(now, nframes);
+        return;
+    }
+
+    // The MIDI events received during the previous block are played at the
+    // same offsets in this one: a constant delay of one block, no jitter
+    const uint32_t rate = m_rtGen->sampleRate();
+    const int64_t blockStart = now - int64_t(nframes) * 1000000000 / rate;
+
+    for(unsigned done = 0; done < nframes;)
+    {
+        const unsigned n = rt_process_midi(blockStart, done, nframes);
+        if(m_rtSong && !m_rtSong->atEnd())
+            m_rtSong->generate(m_midi, *m_rtGen, frames + 2 * done, n);
+        else
+            m_rtGen->generate(frames + 2 * done, n);
+        done += n;
+    }
+
+    rt_block_end(now, nframes);
+}
+
+void RealtimeGenerator::rt_generateFloat(float *frames, unsigned nframes)
+{
+    int64_t now;
+    if(!rt_block_begin(now))
+    {
+        std::fill(frames, frames + 2 * nframes, 0.0f);
+        rt_block_end(now, nframes);
+        return;
+    }
+
+    const uint32_t rate = m_rtGen->sampleRate();
+    const int64_t blockStart = now - int64_t(nframes) * 1000000000 / rate;
+
+    for(unsigned done = 0; done < nframes;)
+    {
+        const unsigned n = rt_process_midi(blockStart, done, nframes);
+        if(m_rtSong && !m_rtSong->atEnd())
+            m_rtSong->generateFloat(m_midi, *m_rtGen, frames + 2 * done, n);
+        else
+            m_rtGen->generateFloat(frames + 2 * done, n);
+        done += n;
+    }
+
+    rt_block_end(now, nframes);
+}
+
+void RealtimeGenerator::rt_underflow()
+{
+    m_stats.rt_underflow();
+}
+
+bool RealtimeGenerator::rt_block_begin(int64_t &now)
+{
+    now = midi_clock();
+    if(m_rtFirstBlock < 0)
+        m_rtFirstBlock = now;
+
+    RealtimeBlockStats &block = m_rtBlock;
+    block.time = static_cast<uint64_t>(now - m_rtFirstBlock) / 1000;
+    block.messages = 0;
+    block.ctlQueued = static_cast<uint32_t>(m_rb_ctl->size_used());
+    block.midiQueued = static_cast<uint32_t>(m_rb_midi->size_used());
+
+    rt_swap_pending();
+
+    // The hardware is being set up by the control thread, the messages
+    // wait for the next block
+    if(m_rtGen->usesHardware())
+    {
+        if(!Generator::hardwareMutex().tryLock())
+            return false;
+        m_rtHardwareLocked = true;
+    }
+
+    rt_process_messages();
+    return true;
+}
+
+void RealtimeGenerator::rt_block_end(int64_t start, unsigned nframes)
+{
+    if(m_rtHardwareLocked)
+    {
+        Generator::hardwareMutex().unlock();
+        m_rtHardwareLocked = false;
+    }
+
+    const int64_t elapsed = midi_clock() - start;
+    const double duration = double(nframes) * 1e9 / m_rtGen->sampleRate();
+
+    RealtimeBlockStats &block = m_rtBlock;
+    block.frames = nframes;
+    block.renderUs = static_cast<uint32_t>(elapsed / 1000);
+    block.load = static_cast<float>(elapsed / duration);
+    m_stats.rt_record(block);
+}
+
+void RealtimeGenerator::rt_swap_pending()
+{
+    // Every swap retires at most one generator and one song; without room
+    // to send them back, the swaps wait for the next block
+    Ring_Buffer &retired = *m_rb_retired;
+    if(retired.size_free() < 2 * sizeof(RetiredObject))
         return;
+
+    if(Generator *gen = m_nextGen.exchange(nullptr, std::memory_order_acq_rel))
+    {
+        RetiredObject obj = {m_rtGen, nullptr};
+        retired.put(obj);
+        m_rtGen = gen;
     }
 
+    const bool stop = m_stopSong.exchange(false, std::memory_order_acq_rel);
+    MidiSequencer *song = m_nextSong.exchange(nullptr, std::memory_order_acq_rel);
+    if((stop || song) && m_rtSong)
+    {
+        RetiredObject obj = {nullptr, m_rtSong};
+        retired.put(obj);
+        m_rtSong = nullptr;
+        rt_reset_song_state();
+    }
+    if(song)
+        m_rtSong = song;
+}
+
+void RealtimeGenerator::rt_reset_song_state()
+{
+    Generator &gen = *m_rtGen;
+    // Held notes would not stop on note off
+    gen.Hold(false);
+    gen.PitchBendSensitivity(200);
+    gen.PitchBend(0);
+
+    m_midi.reset();
+    for(unsigned i = 0; i < 16; ++i)
+        m_midi.channel(i).volume = m_rtVolume;
+
+    gen.NoteOffAllChans();
+}
+
+void RealtimeGenerator::rt_process_messages()
+{
     MessageHeader header;
+    Ring_Buffer::Read_Span span;
 
     /* handle Control messages */
+    bool consumed = false;
     for(Ring_Buffer &rb = *m_rb_ctl;
-         rb.peek(header) && rb.size_used() >= sizeof(header) + header.size;)
+         rb.acquire_read(sizeof(header), span);)
     {
-        rb.discard(sizeof(header));
-        rb.get(m_body.get(), header.size);
+        span.copy_out(0, &header, sizeof(header));
+        const size_t len = sizeof(header) + header.size;
+        if(!rb.acquire_read(len, span))
+            break;
+        // The bodies are read as their types, copy them to be aligned
+        span.copy_out(sizeof(header), m_body.get(), header.size);
+        rb.commit_read(len);
         rt_message_process(header.tag, m_body.get(), header.size);
+        ++m_rtBlock.messages;
+        consumed = true;
     }
 
-    /* handle MIDI messages */
+    if(consumed && m_ctlWaiting.load())
+        m_ctlSpaceFreed.notify_one();
+}
+
+unsigned RealtimeGenerator::rt_process_midi(int64_t blockStart, unsigned offset, unsigned nframes)
+{
+    const uint32_t rate = m_rtGen->sampleRate();
+    MidiEventHeader header;
+    Ring_Buffer::Read_Span span;
+
     for(Ring_Buffer &rb = *m_rb_midi;
-         rb.peek(header) && rb.size_used() >= sizeof(header) + header.size;)
+         rb.acquire_read(sizeof(header), span);)
     {
-        rb.discard(sizeof(header));
-        rb.get(m_body.get(), header.size);
-        rt_message_process(header.tag, m_body.get(), header.size);
+        span.copy_out(0, &header, sizeof(header));
+        const size_t len = sizeof(header) + header.hdr.size;
+        if(!rb.acquire_read(len, span))
+            break;
+
+        // Late events play at once, the ones of the next block wait for it
+        const int64_t delay = header.time - blockStart;
+        const uint64_t frame = (delay > 0) ? uint64_t(delay) * rate / 1000000000 : 0;
+        if(frame > offset)
+            return unsigned(std::min<uint64_t>(frame, nframes) - offset);
+
+        // MIDI is bytes, read it in place unless it wraps around the end
+        const uint8_t *body = span.contiguous(sizeof(header), header.hdr.size);
+        if(!body)
+        {
+            span.copy_out(sizeof(header), m_body.get(), header.hdr.size);
+            body = m_body.get();
+        }
+        rt_message_process(header.hdr.tag, body, header.hdr.size);
+        rb.commit_read(len);
+        ++m_rtBlock.messages;
     }
 
-    m_gen->generate(frames, nframes);
+    return nframes - offset;
 }
 
 void RealtimeGenerator::rt_message_process(int tag, const uint8_t *data, unsigned len)
 {
-    Generator &gen = *m_gen;
+    Generator &gen = *m_rtGen;
 
     switch(tag) {
     case MSG_MidiEvent:
-        rt_midi_process(data, len);
+        m_midi.event(gen, data, len);
         break;
     case MSG_CtlInitChip:
         gen.initChip();
@@ -316,7 +609,7 @@ void RealtimeGenerator::rt_message_process(int tag, const uint8_t *data, unsigne
     {
         // use constant velocity, and controls from MIDI channel 1.
         // if UI supports changing these later, modify this. (TODO)
-        const MidiChannelInfo &ch = m_midichan[0];
+        const GeneratorMidi::ChannelInfo &ch = m_midi.channel(0);
         const uint8_t vel = 127;
         gen.changeNote(*(unsigned *)data);
         gen.PlayNote(vel, ch.volume, ch.expression);
@@ -334,7 +627,7 @@ void RealtimeGenerator::rt_message_process(int tag, const uint8_t *data, unsigne
         break;
     case MSG_CtlPlayChord:
     {
-        const MidiChannelInfo &ch = m_midichan[0];
+        const GeneratorMidi::ChannelInfo &ch = m_midi.channel(0);
         const uint8_t vel = 127;
         ChordMessage msg = *(ChordMessage *)data;
         gen.changeNote(msg.note);
@@ -348,11 +641,13 @@ void RealtimeGenerator::rt_message_process(int tag, const uint8_t *data, unsigne
         }
         break;
     }
-    case MSG_CtlPatchChange: {
-        const PatchChangeMessage &pc = *(PatchChangeMessage *)data;
-        gen.changePatch(pc.instrument, pc.isDrum);
+    case MSG_CtlPatchChange:
+        if(m_patchShared.load(std::memory_order_acquire) & patch_fresh)
+        {
+            m_patchRead = m_patchShared.exchange(m_patchRead, std::memory_order_acq_rel) & patch_index_mask;
+            gen.changePatch(m_patches[m_patchRead]);
+        }
         break;
-    }
     case MSG_CtlDeepVibrato:
         gen.changeDeepVibrato(*(bool *)data);
         break;
@@ -366,94 +661,46 @@ void RealtimeGenerator::rt_message_process(int tag, const uint8_t *data, unsigne
     {
         unsigned vol = *(unsigned *)data;
         vol = (vol < 128) ? vol : 127;
+        m_rtVolume = vol;
         for (unsigned i = 0; i < 16; ++i)
-            m_midichan[i].volume = vol;
+            m_midi.channel(i).volume = vol;
         break;
     }
+    case MSG_CtlStealPolicy:
+        gen.changeStealPolicy(*(int *)data);
+        break;
     }
 }
 
-void RealtimeGenerator::rt_midi_process(const uint8_t *data, unsigned len)
+GeneratorDebugInfo RealtimeGenerator::generatorDebugInfo() const
 {
-    Generator &gen = *m_gen;
-
-    if(len == 3)
-    {
-        unsigned msg = data[0] >> 4;
-        unsigned chan = data[0] & 0x0f;
-        unsigned note = data[1] & 0x7f;
-        unsigned vel = data[2] & 0x7f;
-
-        MidiChannelInfo &ch = m_midichan[chan];
+    GeneratorDebugInfo info = m_ctlGen->debugInfo();
+    info.ctlStalls = m_ctlStalls;
+    info.midiDrops = m_midiDrops.load(std::memory_order_relaxed);
+
+    const RealtimeStats::Summary audio = m_stats.summary();
+    info.blockFrames = audio.frames;
+    info.load = audio.load;
+    info.loadPeak = audio.loadPeak;
+    info.renderUsPeak = audio.renderUsPeak;
+    info.underflows = audio.underflows;
+    info.messagesPeak = audio.messagesPeak;
+    info.ctlQueuedPeak = audio.ctlQueuedPeak;
+    info.midiQueuedPeak = audio.midiQueuedPeak;
+    return info;
+}
 
-        if(msg == 0x9 && vel == 0)
-            msg = 0x8;
+void RealtimeGenerator::ctl_collectStats()
+{
+    m_stats.ctl_collect();
+}
 
-        switch(msg) {
-        case 0x8:
-            gen.changeNote((int)note);
-            gen.StopNote();
-            break;
-        case 0x9:
-            gen.changeNote((int)note);
-            gen.PlayNote(vel, ch.volume, ch.expression);
-            break;
-        case 0xb:
-            switch (note) {
-            case 120:  // all sound off
-                gen.Silence();
-                break;
-            case 123:  // all notes off
-                gen.NoteOffAllChans();
-                break;
-            case 7:  // volume
-                ch.volume = vel;
-                break;
-            case 11:  // expression
-                ch.expression = vel;
-                break;
-            case 64:  // hold pedal
-                gen.Hold(vel >= 64);
-                break;
-            case 98:  // NRPN LSB
-                ch.lastlrpn = vel, ch.nrpn = true;
-                break;
-            case 99:  // NRPN MSB
-                ch.lastmrpn = vel, ch.nrpn = true;
-                break;
-            case 100:  // RPN LSB
-                ch.lastlrpn = vel, ch.nrpn = false;
-                break;
-            case 101:  // RPN MSB
-                ch.lastmrpn = vel, ch.nrpn = false;
-                break;
-            case 6: {  // data entry MSB
-                unsigned addr = ch.lastmrpn * 0x100 + ch.lastlrpn;
-                if (!ch.nrpn && addr == 0) {
-                    ch.bendsensemsb = vel;
-                    int cents = ch.bendsensemsb * 100 + ch.bendsenselsb;
-                    gen.PitchBendSensitivity(cents);
-                }
-                break;
-            }
-            case 38:  // data entry LSB
-                unsigned addr = ch.lastmrpn * 0x100 + ch.lastlrpn;
-                if (!ch.nrpn && addr == 0) {
-                    ch.bendsenselsb = vel;
-                    int cents = ch.bendsensemsb * 100 + ch.bendsenselsb;
-                    gen.PitchBendSensitivity(cents);
-                }
-                break;
-            }
-            break;
-        case 0xe:
-            gen.PitchBend((int)((vel << 7) | note) - 8192);
-            break;
-        }
-    }
+void RealtimeGenerator::ctl_resetStats()
+{
+    m_stats.ctl_reset();
 }
 
-const GeneratorDebugInfo &RealtimeGenerator::generatorDebugInfo() const
+bool RealtimeGenerator::ctl_saveStats(const QString &path, QString *error)
 {
-    return m_gen->debugInfo();
+    return m_stats.saveCsv(path, error);
 }
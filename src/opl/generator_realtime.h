@@ -20,21 +20,22 @@
 #define GENERATOR_REALTIME_H
 
 #include "realtime/ring_buffer.h"
+#include "generator_midi.h"
+#include "realtime_stats.h"
 #include "../bank.h"
 #include <QObject>
 #include <QTimer>
-#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <QMutex>
-#include <system_error>
 #include <stdint.h>
-#if defined(_WIN32)
-#include <windows.h>
-#endif
 
 class Generator;
+class MidiSequencer;
 struct GeneratorDebugInfo;
+struct OPL_PreparedPatch;
 
 /**
    A control interface which drives a generator from a user interface.
@@ -47,6 +48,13 @@ public:
     virtual ~IRealtimeControl() {}
     virtual void ctl_switchChip(int chipId) = 0;
     virtual void ctl_initChip() = 0;
+    /**
+     * @brief Starts playing a song, in place of the one playing
+     * The sequencer is driven by the audio thread, split at its events.
+     */
+    virtual void ctl_playSong(std::unique_ptr<MidiSequencer> song) = 0;
+    //! Saves the statistics of the audio blocks as CSV
+    virtual bool ctl_saveStats(const QString &path, QString *error = nullptr) = 0;
 
 public slots:
     void changeNote(int note) { m_note = note; }
@@ -71,6 +79,9 @@ public slots:
     virtual void ctl_changeDeepTremolo(bool enabled) = 0;
     virtual void ctl_changeVolumeModel(int model) = 0;
     virtual void ctl_changeVolume(unsigned vol) = 0;
+    virtual void ctl_changeStealPolicy(int policy) = 0;
+    virtual void ctl_stopSong() = 0;
+    virtual void ctl_resetStats() = 0;
 
 signals:
     void debugInfo(QString);
@@ -79,7 +90,11 @@ private slots:
     void debugInfoUpdate();
 
 protected:
-    virtual const GeneratorDebugInfo &generatorDebugInfo() const = 0;
+    virtual GeneratorDebugInfo generatorDebugInfo() const = 0;
+    //! Frees what the audio thread has stopped using
+    virtual void ctl_reclaim() = 0;
+    //! Takes the statistics recorded by the audio thread
+    virtual void ctl_collectStats() = 0;
 
 protected:
     unsigned m_note = 0;
@@ -93,7 +108,22 @@ class IRealtimeMIDI
 {
 public:
     virtual ~IRealtimeMIDI() {}
-    virtual void midi_event(const uint8_t *msg, unsigned msglen) = 0;
+
+    //! Steady clock of the MIDI events, in nanoseconds
+    static int64_t midi_clock()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void midi_event(const uint8_t *msg, unsigned msglen)
+        { midi_event(msg, msglen, midi_clock()); }
+    /**
+     * @brief Queues an event received at the given time of the MIDI clock
+     * The event plays one audio block later than that time, at the same
+     * position within the block, so the spacing of the events is kept.
+     */
+    virtual void midi_event(const uint8_t *msg, unsigned msglen, int64_t time) = 0;
 };
 
 /**
@@ -104,13 +134,25 @@ class IRealtimeProcess
 public:
     virtual ~IRealtimeProcess() {}
     virtual void rt_generate(int16_t *frames, unsigned nframes) = 0;
+    virtual void rt_generateFloat(float *frames, unsigned nframes) = 0;
+    //! The audio device ran out of frames before the coming block
+    virtual void rt_underflow() = 0;
 };
 
 class RealtimeGenerator :
     public IRealtimeControl, public IRealtimeMIDI, public IRealtimeProcess
 {
 public:
-    explicit RealtimeGenerator(const std::shared_ptr<Generator> &gen, QObject *parent = nullptr);
+    struct Setup
+    {
+        //! Bytes of the queue of the control messages
+        unsigned controlCapacity = 8192;
+        //! Bytes of the queue of the MIDI input
+        unsigned midiCapacity = 8192;
+    };
+
+    explicit RealtimeGenerator(std::unique_ptr<Generator> gen, QObject *parent = nullptr);
+    RealtimeGenerator(std::unique_ptr<Generator> gen, const Setup &setup, QObject *parent = nullptr);
     ~RealtimeGenerator();
 
 private:
@@ -133,73 +175,128 @@ public:
     void ctl_changeDeepTremolo(bool enabled) override;
     void ctl_changeVolumeModel(int model) override;
     void ctl_changeVolume(unsigned vol) override;
+    void ctl_changeStealPolicy(int policy) override;
     /* MIDI */
-    void midi_event(const uint8_t *msg, unsigned msglen) override;
+    using IRealtimeMIDI::midi_event;
+    void midi_event(const uint8_t *msg, unsigned msglen, int64_t time) override;
+    /* Song */
+    void ctl_playSong(std::unique_ptr<MidiSequencer> song) override;
+    void ctl_stopSong() override;
+    /* Statistics */
+    bool ctl_saveStats(const QString &path, QString *error = nullptr) override;
+    void ctl_resetStats() override;
     /* Realtime */
     void rt_generate(int16_t *frames, unsigned nframes) override;
+    void rt_generateFloat(float *frames, unsigned nframes) override;
+    void rt_underflow() override;
 
 private:
+    /**
+     * @brief Handles the messages and starts measuring
+     * @param now Receives the MIDI clock
+     * @return False when the hardware is busy, the block is to be silent
+     */
+    bool rt_block_begin(int64_t &now);
+    void rt_block_end(int64_t start, unsigned nframes);
+    void rt_swap_pending();
+    //! Releases what a stopped song left playing, and its MIDI controllers
+    void rt_reset_song_state();
+    void rt_process_messages();
+    /**
+     * @brief Plays the MIDI events due at the offset in the block
+     * @return Frames to generate before the next event, up to the block end
+     */
+    unsigned rt_process_midi(int64_t blockStart, unsigned offset, unsigned nframes);
     void rt_message_process(int tag, const uint8_t *data, unsigned len);
-    void rt_midi_process(const uint8_t *data, unsigned len);
+    //! Waits until the control queue has room for a message of this size
+    void ctl_wait_for_space(unsigned size);
 
 protected:
-    const GeneratorDebugInfo &generatorDebugInfo() const override;
+    GeneratorDebugInfo generatorDebugInfo() const override;
+    void ctl_reclaim() override;
+    void ctl_collectStats() override;
 
 private:
-    std::shared_ptr<Generator> m_gen;
-    std::unique_ptr<Ring_Buffer> m_rb_ctl;
-    std::unique_ptr<Ring_Buffer> m_rb_midi;
-    std::unique_ptr<uint8_t[]> m_body;
+    /*
+     * The audio thread never waits for the control thread. Heavy changes,
+     * like a new chip or a song, are prepared by the control thread and
+     * published through the atomic pointers below. The audio thread takes
+     * them at the start of a block, and sends what they replace back
+     * through m_rb_retired, to be freed by the control thread.
+     */
 
-    struct MidiChannelInfo
-    {
-        unsigned lastmrpn = 0;
-        unsigned lastlrpn = 0;
-        bool nrpn = false;
-        unsigned bendsensemsb = 2;
-        unsigned bendsenselsb = 0;
-        unsigned volume = 100;
-        unsigned expression = 127;
-    };
-    MidiChannelInfo m_midichan[16];
+    //! Generator in use by the audio thread
+    Generator *m_rtGen = nullptr;
+    //! Song in use by the audio thread
+    MidiSequencer *m_rtSong = nullptr;
 
-#if defined(ENABLE_HW_OPL_PROXY)
-    class QStdMutex
+    std::atomic<Generator *> m_nextGen;
+    std::atomic<MidiSequencer *> m_nextSong;
+    std::atomic<bool> m_stopSong;
+
+    struct RetiredObject
     {
-    public:
-        QStdMutex()
-        {}
-        ~QStdMutex() {}
-        void lock() { m.lock(); }
-        void unlock() { m.unlock(); }
-        bool try_lock() { return m.tryLock(); }
-    private:
-        QMutex m;
+        Generator *gen;
+        MidiSequencer *song;
     };
-    QStdMutex m_generator_mutex;
-    typedef QStdMutex mutex_type;
-#elif !defined(_WIN32)
-    std::mutex m_generator_mutex;
-    typedef std::mutex mutex_type;
-#else
-    class WindowsMutex
+    std::unique_ptr<Ring_Buffer> m_rb_retired;
+
+    //! Newest generator, the one the debug info is read from
+    Generator *m_ctlGen = nullptr;
+
+    //! Settings sent so far, applied to a new generator
+    struct ControlState
     {
-    public:
-        WindowsMutex()
-        {
-            if (!(hMutex = CreateMutex(nullptr, false, nullptr)))
-                throw std::system_error(GetLastError(), std::system_category());
-        }
-        ~WindowsMutex() { CloseHandle(hMutex); }
-        void lock() { WaitForSingleObject(hMutex, INFINITE); }
-        void unlock() { ReleaseMutex(hMutex); }
-        bool try_lock() { return WaitForSingleObject(hMutex, 0) == WAIT_OBJECT_0; }
-    private:
-        HANDLE hMutex;
+        FmBank::Instrument patch;
+        bool hasPatch = false;
+        bool isDrum = false;
+        bool deepVibrato = false;
+        bool deepTremolo = false;
+        int volumeModel = 0;
+        int stealPolicy = -1;
     };
-    WindowsMutex m_generator_mutex;
-    typedef WindowsMutex mutex_type;
-#endif
+    ControlState m_ctlState;
+
+    /*
+     * Patches are prepared by the control thread and handed over through
+     * a triple buffer: the control thread fills m_patchWrite, then swaps
+     * it with m_patchShared marked as fresh; the audio thread swaps its
+     * m_patchRead with the shared one when it is fresh. Patches replaced
+     * before the audio thread took them are never loaded.
+     */
+    std::unique_ptr<OPL_PreparedPatch[]> m_patches;
+    unsigned m_patchWrite = 0;
+    std::atomic<unsigned> m_patchShared;
+    unsigned m_patchRead = 2;
+
+    std::unique_ptr<Ring_Buffer> m_rb_ctl;
+    std::unique_ptr<Ring_Buffer> m_rb_midi;
+    std::unique_ptr<uint8_t[]> m_body;
+
+    /*
+     * When the control queue is full, the control thread sleeps on
+     * m_ctlSpaceFreed until the audio thread has read from the queue. The
+     * audio thread never takes the mutex, it only notifies if m_ctlWaiting
+     * is set; a wakeup lost in between is caught by the timeout of the wait.
+     */
+    std::mutex m_ctlSpaceMutex;
+    std::condition_variable m_ctlSpaceFreed;
+    std::atomic<bool> m_ctlWaiting;
+    //! Times the control thread had to wait for the queue
+    uint64_t m_ctlStalls = 0;
+    //! MIDI messages lost, the queue being full
+    std::atomic<uint64_t> m_midiDrops;
+
+    GeneratorMidi m_midi;
+    //! Volume set from the UI, applied again after a song resets the channels
+    unsigned m_rtVolume = GeneratorMidi::ChannelInfo().volume;
+
+    RealtimeStats m_stats;
+    //! Block being measured, audio thread only
+    RealtimeBlockStats m_rtBlock;
+    int64_t m_rtFirstBlock = -1;
+    //! The hardware mutex is held for the current block
+    bool m_rtHardwareLocked = false;
 };
 
 
@@ -0,0 +1,82 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latency_tuner.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+double LatencyTuner::measureFrameCost(const Setup &setup)
+{
+    if(setup.chip == Generator::CHIP_Win9xProxy || setup.chip == Generator::CHIP_SerialPort)
+        return 0.0;
+
+    Generator gen(setup.rate, setup.chip, setup.chipCount);
+
+    // A sustained sound, so the voices stay busy whatever the emulator skips
+    FmBank::Instrument ins = FmBank::emptyInst();
+    ins.setFBConn1(0x0E);
+    for(int op = 0; op < 4; ++op)
+    {
+        ins.OP[op].attack = 15;
+        ins.OP[op].sustain = 0;
+        ins.OP[op].fmult = 1;
+        ins.OP[op].eg = true;
+    }
+    gen.changePatch(ins, false);
+
+    // Enough notes to take all 2-op voices of all chips
+    const int notes = 18 * static_cast<int>(gen.chipCountSetting());
+    for(int i = 0; i < notes; ++i)
+    {
+        gen.changeNote(36 + i % 60);
+        gen.PlayNote();
+    }
+
+    enum { block = 512 };
+    std::vector<float> buffer(2 * block);
+    gen.generateFloat(buffer.data(), block);
+
+    // The slowest of a few passes, the others may have been helped by caches
+    const unsigned framesPerPass = setup.rate / 10;
+    double slowest = 0.0;
+    for(int pass = 0; pass < 3; ++pass)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(unsigned done = 0; done < framesPerPass; done += block)
+            gen.generateFloat(buffer.data(), block);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        slowest = std::max(slowest, elapsed.count());
+    }
+
+    const unsigned blocks = (framesPerPass + block - 1) / block;
+    return slowest / (blocks * block);
+}
+
+double LatencyTuner::pickLatency(const Setup &setup, double frameCost)
+{
+    // A block of n frames takes n * frameCost to render, and the thread may
+    // start it wakeupDelay late; both must fit in margin * n / rate
+    const double slack = setup.margin / setup.rate - frameCost;
+    if(slack <= 0.0)
+        return setup.maxLatency;
+
+    const double frames = setup.wakeupDelay / slack;
+    const double latency = frames / setup.rate;
+    return std::min(setup.maxLatency, std::max(setup.minLatency, latency));
+}
@@ -0,0 +1,62 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCY_TUNER_H
+#define LATENCY_TUNER_H
+
+#include "generator.h"
+
+/**
+ * @brief Picks the audio latency from the measured cost of an emulator
+ *
+ * The cost is measured offline, rendering with every voice of every chip
+ * playing, which is the worst case of the realtime generator. The buffer
+ * picked is the smallest one whose render time, plus the time the audio
+ * thread may be late to wake up, fits within a margin of its duration.
+ */
+class LatencyTuner
+{
+public:
+    struct Setup
+    {
+        uint32_t rate = 44100;
+        Generator::OPL_Chips chip = Generator::CHIP_Nuked;
+        uint32_t chipCount = 1;
+        //! Part of the duration of a block its rendering may take
+        double margin = 0.5;
+        //! Time the audio thread may wake up late, in seconds
+        double wakeupDelay = 0.002;
+        //! Bounds of the latency, in seconds
+        double minLatency = 0.001;
+        double maxLatency = 0.1;
+    };
+
+    /**
+     * @brief Seconds to render one frame with all voices playing
+     * Hardware chips are not measured, they cost nothing to render.
+     */
+    static double measureFrameCost(const Setup &setup);
+
+    //! Latency in seconds for the given cost of a frame
+    static double pickLatency(const Setup &setup, double frameCost);
+
+    static double tune(const Setup &setup)
+        { return pickLatency(setup, measureFrameCost(setup)); }
+};
+
+#endif // LATENCY_TUNER_H
@@ -33,6 +33,8 @@
 #include <limits>
 
 #include "measurer.h"
+#include "chip_snapshot.h"
+#include "opl_freq.h"
 
 #ifndef M_PI
 #define M_PI    3.14159265358979323846
@@ -42,6 +44,7 @@
 #include "chips/opl_chip_base.h"
 #include "chips/nuked_opl3.h"
 #include "chips/nuked_opl3_v174.h"
+#include "chips/nuked_opl3_simd.h"
 #include "chips/dosbox_opl3.h"
 #include "chips/opal_opl3.h"
 #include "chips/java_opl3.h"
@@ -191,6 +194,8 @@ static const unsigned g_outputRate = 49716;
 struct TinySynth
 {
     OPLChipBase *m_chip;
+    // Post-init state of the emulator, if known
+    const ChipSnapshot *m_initState;
     unsigned m_notesNum;
     int m_notenum;
     int8_t m_fineTune;
@@ -199,17 +204,7 @@ struct TinySynth
 
     void resetChip()
     {
-        static const short initdata[(2 + 3 + 2 + 2) * 2] =
-        {
-            0x004, 96, 0x004, 128,      // Pulse timer
-            0x105, 0, 0x105, 1, 0x105, 0, // Pulse OPL3 enable, leave disabled
-            0x001, 32, 0x0BD, 0         // Enable wave & melodic
-        };
-
-        m_chip->setRate(g_outputRate);
-
-        for(unsigned a = 0; a < 18; a += 2)
-            m_chip->writeReg((uint16_t)initdata[a], (uint8_t)initdata[a + 1]);
+        ResetChipForMeasure(m_chip, m_initState, g_outputRate);
     }
 
     void setInstrument(const FmBank::Instrument *in_p)
@@ -272,20 +267,9 @@ struct TinySynth
         std::memset(m_x, 0, sizeof(m_x));
         for(unsigned n = 0; n < m_notesNum; ++n)
         {
-            double hertz = 172.00093 * std::exp(0.057762265 * (m_notenum + m_noteOffsets[n]));
-            if(hertz > 131071)
-            {
-                std::fprintf(stderr, "MEASURER WARNING: Why does note %d + note-offset %d produce hertz %g?          \n",
-                             m_notenum, m_noteOffsets[n], hertz);
-                hertz = 131071;
-            }
-            m_x[n] = 0x2000;
-            while(hertz >= 1023.5)
-            {
-                hertz /= 2.0;    // Calculate octave
-                m_x[n] += 0x400;
-            }
-            m_x[n] += (unsigned int)(hertz + 0.5);
+            // Tones above the range of block 7 are played an octave lower
+            OPLFreq::BlockFNum freq = OPLFreq::fromTone((double)(m_notenum + m_noteOffsets[n]), OPLFreq::measurerTuning);
+            m_x[n] = 0x2000 + freq.value;
 
             // Keyon the note
             m_chip->writeReg(0xA0 + n * 3, m_x[n] & 0xFF);
@@ -306,10 +290,11 @@ struct TinySynth
     }
 };
 
-static void BenchmarkChip(FmBank::Instrument *in_p, OPLChipBase *chip)
+static void BenchmarkChip(FmBank::Instrument *in_p, OPLChipBase *chip, const ChipSnapshot *initState)
 {
     TinySynth synth;
     synth.m_chip = chip;
+    synth.m_initState = initState;
     synth.resetChip();
     synth.setInstrument(in_p);
 
@@ -350,7 +335,8 @@ static void BenchmarkChip(FmBank::Instrument *in_p, OPLChipBase *chip)
     }
 }
 
-static void ComputeDurations(const FmBank::Instrument *in_p, DurationInfo *result_p, OPLChipBase *chip)
+static void ComputeDurations(const FmBank::Instrument *in_p, DurationInfo *result_p, OPLChipBase *chip,
+                             const ChipSnapshot *initState)
 {
     const FmBank::Instrument &in = *in_p;
     DurationInfo &result = *result_p;
@@ -376,10 +362,14 @@ static void ComputeDurations(const FmBank::Instrument *in_p, DurationInfo *resul
 
     TinySynth synth;
     synth.m_chip = chip;
+    synth.m_initState = initState;
     synth.resetChip();
     synth.setInstrument(&in);
     synth.noteOn();
 
+    ChipSnapshot noteOnState;
+    noteOnState.save(chip);
+
     /* For capturing */
     const unsigned max_silent = 6;
     const unsigned max_on  = 40;
@@ -533,10 +523,13 @@ static void ComputeDurations(const FmBank::Instrument *in_p, DurationInfo *resul
     }
     else
     {
-        // Reset the emulator and re-run the "ON" simulation until reaching the peak time
-        synth.resetChip();
-        synth.setInstrument(&in);
-        synth.noteOn();
+        // Rewind the emulator and re-run the "ON" simulation until reaching the peak time
+        if(!noteOnState.restore(chip))
+        {
+            synth.resetChip();
+            synth.setInstrument(&in);
+            synth.noteOn();
+        }
 
         audioHistory.reset(std::ceil(historyLength * g_outputRate));
         for(unsigned period = 0;
@@ -641,20 +634,43 @@ static void ComputeDurations(const FmBank::Instrument *in_p, DurationInfo *resul
     result.nosound = (peak_amplitude_value < 0.5) || ((sound_min >= -1) && (sound_max <= 1));
 }
 
+static ChipSnapshot MakeInitState(OPLChipBase *chip)
+{
+    TinySynth synth;
+    synth.m_chip = chip;
+    synth.m_initState = nullptr;
+    synth.resetChip();
+
+    ChipSnapshot state;
+    state.save(chip);
+    return state;
+}
+
+// Post-init state of the default emulator, shared by all measurements
+static const ChipSnapshot &DefaultInitState()
+{
+    static const ChipSnapshot state = []()
+    {
+        DefaultOPL3 chip;
+        return MakeInitState(&chip);
+    }();
+    return state;
+}
+
 static void ComputeDurationsDefault(const FmBank::Instrument *in, DurationInfo *result)
 {
     DefaultOPL3 chip;
-    ComputeDurations(in, result, &chip);
+    ComputeDurations(in, result, &chip, &DefaultInitState());
 }
 
-static void MeasureDurations(FmBank::Instrument *in_p, OPLChipBase *chip)
+static void MeasureDurations(FmBank::Instrument *in_p, OPLChipBase *chip, const ChipSnapshot *initState)
 {
     FmBank::Instrument &in = *in_p;
     DurationInfo result;
 
     if(in_p->adlib_drum_number == 0)
     {
-        ComputeDurations(&in, &result, chip);
+        ComputeDurations(&in, &result, chip, initState);
         in.ms_sound_kon = (uint16_t)result.ms_sound_kon;
         in.ms_sound_koff = (uint16_t)result.ms_sound_koff;
         in.is_blank = result.nosound;
@@ -670,15 +686,17 @@ static void MeasureDurations(FmBank::Instrument *in_p, OPLChipBase *chip)
 static void MeasureDurationsDefault(FmBank::Instrument *in_p)
 {
     DefaultOPL3 chip;
-    MeasureDurations(in_p, &chip);
+    MeasureDurations(in_p, &chip, &DefaultInitState());
 }
 
 static void MeasureDurationsBenchmark(FmBank::Instrument *in_p, OPLChipBase *chip, QVector<Measurer::BenchmarkResult> *result)
 {
     std::chrono::steady_clock::time_point start, stop;
     Measurer::BenchmarkResult res;
+    // Keep the emulator setup out of the timing
+    ChipSnapshot initState = MakeInitState(chip);
     start = std::chrono::steady_clock::now();
-    BenchmarkChip(in_p, chip);
+    BenchmarkChip(in_p, chip, &initState);
     stop  = std::chrono::steady_clock::now();
     res.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
     res.name = QString::fromUtf8(chip->emulatorName());
@@ -691,6 +709,7 @@ static void MeasureDurationsBenchmarkRunner(FmBank::Instrument *in_p, QVector<Me
     {
         std::shared_ptr<OPLChipBase>(new NukedOPL3v174),
         std::shared_ptr<OPLChipBase>(new NukedOPL3),
+        std::shared_ptr<OPLChipBase>(new NukedOPL3SIMD),
         std::shared_ptr<OPLChipBase>(new DosBoxOPL3),
         std::shared_ptr<OPLChipBase>(new OpalOPL3),
         std::shared_ptr<OPLChipBase>(new JavaOPL3)
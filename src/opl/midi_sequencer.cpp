@@ -0,0 +1,103 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "midi_sequencer.h"
+#include "generator.h"
+#include "generator_midi.h"
+#include "../midi/midi_file.h"
+#include <algorithm>
+
+MidiSequencer::MidiSequencer(const MidiFile &song, uint32_t sampleRate)
+{
+    const std::vector<MidiFile::Event> &events = song.events();
+    m_events.reserve(events.size());
+    for(const MidiFile::Event &e : events)
+    {
+        Event out;
+        out.frame = e.time * sampleRate / 1000000;
+        std::copy(e.data, e.data + 3, out.data);
+        out.size = e.size;
+        m_events.push_back(out);
+    }
+
+    m_length = song.duration() * sampleRate / 1000000;
+    if(!m_events.empty())
+        m_length = std::max(m_length, m_events.back().frame);
+}
+
+void MidiSequencer::rewind()
+{
+    m_next = 0;
+    m_position = 0;
+}
+
+bool MidiSequencer::accepts(const Event &e) const
+{
+    const unsigned channel = e.data[0] & 0x0f;
+    if(!(m_channelMask & (1u << channel)))
+        return false;
+
+    const unsigned msg = e.data[0] >> 4;
+    if(m_keyFilter >= 0 && (msg == 0x8 || msg == 0x9))
+        return e.data[1] == m_keyFilter;
+
+    return true;
+}
+
+unsigned MidiSequencer::advance(GeneratorMidi &midi, Generator &gen, unsigned maxFrames)
+{
+    const size_t count = m_events.size();
+    while(m_next < count && m_events[m_next].frame <= m_position)
+    {
+        const Event &e = m_events[m_next++];
+        if(accepts(e))
+            midi.event(gen, e.data, e.size);
+    }
+
+    uint64_t frames = maxFrames;
+    if(m_next < count)
+        frames = m_events[m_next].frame - m_position;
+    else if(m_position < m_length)
+        frames = m_length - m_position;
+
+    const unsigned n = (frames < maxFrames) ? static_cast<unsigned>(frames) : maxFrames;
+    m_position += n;
+    return n;
+}
+
+void MidiSequencer::generate(GeneratorMidi &midi, Generator &gen, int16_t *frames, unsigned nframes)
+{
+    while(nframes > 0)
+    {
+        const unsigned n = advance(midi, gen, nframes);
+        gen.generate(frames, n);
+        frames += 2 * n;
+        nframes -= n;
+    }
+}
+
+void MidiSequencer::generateFloat(GeneratorMidi &midi, Generator &gen, float *frames, unsigned nframes)
+{
+    while(nframes > 0)
+    {
+        const unsigned n = advance(midi, gen, nframes);
+        gen.generateFloat(frames, n);
+        frames += 2 * n;
+        nframes -= n;
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDI_SEQUENCER_H
+#define MIDI_SEQUENCER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class Generator;
+class GeneratorMidi;
+class MidiFile;
+
+/**
+ * @brief Plays a MIDI file into a generator with sample-accurate timing
+ *
+ * The times of the events are converted into frames of the output once,
+ * then the generation of every block is split at the events, so each one
+ * lands on its exact frame whatever the block size. The sequencer does no
+ * locking or allocation while generating, it may run in the audio thread.
+ */
+class MidiSequencer
+{
+public:
+    enum
+    {
+        //! MIDI channel 10, the percussion
+        DrumChannels = 1 << 9,
+        AllChannels = 0xFFFF,
+        MelodicChannels = AllChannels & ~DrumChannels
+    };
+
+    MidiSequencer(const MidiFile &song, uint32_t sampleRate);
+
+    /**
+     * @brief Bit mask of the MIDI channels to play, the melodic ones by default
+     */
+    void setChannelMask(unsigned mask)
+        { m_channelMask = mask; }
+
+    /**
+     * @brief Plays the notes of this key only, -1 plays all keys
+     */
+    void setKeyFilter(int key)
+        { m_keyFilter = key; }
+
+    void rewind();
+
+    //! Current frame from the start
+    uint64_t position() const
+        { return m_position; }
+    //! Frame of the end of the song
+    uint64_t length() const
+        { return m_length; }
+    bool atEnd() const
+        { return m_next >= m_events.size() && m_position >= m_length; }
+
+    /**
+     * @brief Sends the events due at the current position to the generator
+     * @return Frames to generate before the next event or the end of the
+     * song, at most maxFrames; the position moves forward by that count
+     */
+    unsigned advance(GeneratorMidi &midi, Generator &gen, unsigned maxFrames);
+
+    /**
+     * @brief Generates the frames of the song, split at the events
+     * After the end, the generator keeps playing what is left sounding.
+     */
+    void generate(GeneratorMidi &midi, Generator &gen, int16_t *frames, unsigned nframes);
+    void generateFloat(GeneratorMidi &midi, Generator &gen, float *frames, unsigned nframes);
+
+private:
+    struct Event
+    {
+        uint64_t frame;
+        uint8_t data[3];
+        uint8_t size;
+    };
+
+    bool accepts(const Event &e) const;
+
+    std::vector<Event> m_events;
+    size_t m_next = 0;
+    uint64_t m_position = 0;
+    uint64_t m_length = 0;
+    unsigned m_channelMask = MelodicChannels;
+    int m_keyFilter = -1;
+};
+
+#endif // MIDI_SEQUENCER_H
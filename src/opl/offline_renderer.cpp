@@ -0,0 +1,316 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "offline_renderer.h"
+#include "midi_sequencer.h"
+#include "../audio/audio_file_writer.h"
+#include <QObject>
+#include <QStringList>
+#include <algorithm>
+
+static bool eventEarlier(const OfflineRenderer::Event &a, const OfflineRenderer::Event &b)
+{
+    return a.time < b.time;
+}
+
+bool OfflineRenderer::parseScript(const QString &text, Script &script, QString *error)
+{
+    static const char *const chordNames[] =
+    {
+        "major", "minor", "augmented", "diminished", "major7", "minor7"
+    };
+
+    script.clear();
+    const QStringList lines = text.split('\n');
+    for(int l = 0; l < lines.size(); ++l)
+    {
+        QString line = lines[l];
+        int comment = line.indexOf('#');
+        if(comment >= 0)
+            line.truncate(comment);
+        line = line.simplified();
+        if(line.isEmpty())
+            continue;
+        const QStringList f = line.split(' ');
+
+        bool ok = (f.size() >= 2);
+        Event e;
+        if(ok)
+            e.time = f[0].toUInt(&ok);
+        const QString cmd = ok ? f[1].toLower() : QString();
+        bool okArg = true;
+
+        if(cmd == "on" && (f.size() == 3 || f.size() == 4))
+        {
+            e.type = Event::NOTE_ON;
+            e.note = f[2].toInt(&ok);
+            e.value = (f.size() == 4) ? f[3].toInt(&okArg) : 127;
+            ok = ok && okArg && e.note >= 0 && e.note < 128 && e.value >= 0 && e.value < 128;
+        }
+        else if(cmd == "off" && f.size() == 3)
+        {
+            e.type = Event::NOTE_OFF;
+            e.note = f[2].toInt(&ok);
+            ok = ok && e.note >= 0 && e.note < 128;
+        }
+        else if(cmd == "chord" && (f.size() == 4 || f.size() == 5))
+        {
+            e.type = Event::CHORD;
+            e.value = -1;
+            for(int c = 0; c < 6; ++c)
+            {
+                if(f[2].toLower() == chordNames[c])
+                    e.value = c;
+            }
+            e.note = f[3].toInt(&ok);
+            e.velocity = (f.size() == 5) ? f[4].toInt(&okArg) : 127;
+            ok = ok && okArg && e.value >= 0 && e.note >= 0 && e.note < 128 &&
+                 e.velocity >= 0 && e.velocity < 128;
+        }
+        else if(cmd == "release" && f.size() == 2)
+            e.type = Event::ALL_NOTES_OFF;
+        else if(cmd == "bend" && f.size() == 3)
+        {
+            e.type = Event::PITCH_BEND;
+            e.value = f[2].toInt(&ok);
+            ok = ok && e.value >= -8192 && e.value < 8192;
+        }
+        else if(cmd == "hold" && f.size() == 3)
+        {
+            e.type = Event::HOLD;
+            e.value = (f[2].toLower() == "on") ? 1 : 0;
+            ok = (f[2].toLower() == "on" || f[2].toLower() == "off");
+        }
+        else if(cmd == "end" && f.size() == 2)
+            e.type = Event::END;
+        else
+            ok = false;
+
+        if(!ok)
+        {
+            if(error)
+                *error = QObject::tr("Invalid event at line %1: %2").arg(l + 1).arg(lines[l].trimmed());
+            script.clear();
+            return false;
+        }
+        script.push_back(e);
+    }
+
+    std::stable_sort(script.begin(), script.end(), eventEarlier);
+    for(size_t i = 0; i < script.size(); ++i)
+    {
+        if(script[i].type == Event::END)
+        {
+            script.resize(i + 1);
+            break;
+        }
+    }
+    if(script.empty() || script.back().type != Event::END)
+    {
+        // Let the last event ring for one second
+        Event e;
+        e.time = script.empty() ? 0 : script.back().time + 1000;
+        e.type = Event::END;
+        script.push_back(e);
+    }
+    return true;
+}
+
+OfflineRenderer::Script OfflineRenderer::noteScript(int note, uint32_t holdMs, uint32_t releaseMs, int velocity)
+{
+    Script script(3);
+    script[0].time = 0;
+    script[0].type = Event::NOTE_ON;
+    script[0].note = note;
+    script[0].value = velocity;
+    script[1].time = holdMs;
+    script[1].type = Event::NOTE_OFF;
+    script[1].note = note;
+    script[2].time = holdMs + releaseMs;
+    script[2].type = Event::END;
+    return script;
+}
+
+OfflineRenderer::OfflineRenderer(uint32_t sampleRate, Generator::OPL_Chips chip) :
+    m_rate(sampleRate),
+    m_chip(chip),
+    m_buffer(2 * blockFrames)
+{
+    if(m_chip == Generator::CHIP_Win9xProxy || m_chip == Generator::CHIP_SerialPort)
+        m_chip = Generator::CHIP_Nuked;
+}
+
+OfflineRenderer::~OfflineRenderer()
+{}
+
+void OfflineRenderer::setBankSetup(const FmBank &bank)
+{
+    setBankSetup(bank.deep_tremolo, bank.deep_vibrato, bank.volume_model);
+}
+
+void OfflineRenderer::setBankSetup(bool deepTremolo, bool deepVibrato, int volumeModel)
+{
+    m_deepTremolo = deepTremolo;
+    m_deepVibrato = deepVibrato;
+    m_volumeModel = volumeModel;
+}
+
+void OfflineRenderer::playEvent(const Event &e)
+{
+    Generator &gen = *m_gen;
+    switch(e.type)
+    {
+    case Event::NOTE_ON:
+        gen.changeNote(e.note);
+        gen.PlayNote(static_cast<uint32_t>(e.value));
+        break;
+    case Event::NOTE_OFF:
+        gen.changeNote(e.note);
+        gen.StopNote();
+        break;
+    case Event::CHORD:
+        switch(e.value)
+        {
+        case Event::CHORD_MAJOR:
+            gen.PlayMajorChord(e.note, e.velocity, 100, 127);
+            break;
+        case Event::CHORD_MINOR:
+            gen.PlayMinorChord(e.note, e.velocity, 100, 127);
+            break;
+        case Event::CHORD_AUGMENTED:
+            gen.PlayAugmentedChord(e.note, e.velocity, 100, 127);
+            break;
+        case Event::CHORD_DIMINISHED:
+            gen.PlayDiminishedChord(e.note, e.velocity, 100, 127);
+            break;
+        case Event::CHORD_MAJOR7:
+            gen.PlayMajor7Chord(e.note, e.velocity, 100, 127);
+            break;
+        case Event::CHORD_MINOR7:
+            gen.PlayMinor7Chord(e.note, e.velocity, 100, 127);
+            break;
+        }
+        break;
+    case Event::ALL_NOTES_OFF:
+        gen.NoteOffAllChans();
+        break;
+    case Event::PITCH_BEND:
+        gen.PitchBend(e.value);
+        break;
+    case Event::HOLD:
+        gen.Hold(e.value != 0);
+        break;
+    case Event::END:
+        break;
+    }
+}
+
+void OfflineRenderer::startGenerator(const FmBank::Instrument &instrument, bool isDrum)
+{
+    // The generator keeps the state of the channels between the notes,
+    // a new one makes the output independent of the previous renders.
+    // A single chip: no render threads get started.
+    m_gen.reset(new Generator(m_rate, m_chip, 1));
+    m_gen->changeDeepTremolo(m_deepTremolo);
+    m_gen->changeDeepVibrato(m_deepVibrato);
+    m_gen->changeVolumeModel(m_volumeModel);
+    m_gen->changePatch(instrument, isDrum);
+    m_midi.reset();
+}
+
+bool OfflineRenderer::render(const FmBank::Instrument &instrument, bool isDrum, const Script &script, AudioFileWriter &out)
+{
+    startGenerator(instrument, isDrum);
+
+    uint64_t frame = 0;
+    for(const Event &e : script)
+    {
+        const uint64_t eventFrame = static_cast<uint64_t>(e.time) * m_rate / 1000;
+        while(frame < eventFrame)
+        {
+            const uint64_t left = eventFrame - frame;
+            const unsigned count = (left < blockFrames) ? static_cast<unsigned>(left) : blockFrames;
+            m_gen->generate(m_buffer.data(), count);
+            if(!out.write(m_buffer.data(), count))
+                return false;
+            frame += count;
+        }
+        if(e.type == Event::END)
+            break;
+        playEvent(e);
+    }
+
+    return true;
+}
+
+bool OfflineRenderer::renderSong(const FmBank::Instrument &instrument, bool isDrum, MidiSequencer &song, AudioFileWriter &out)
+{
+    startGenerator(instrument, isDrum);
+    song.rewind();
+
+    const uint64_t total = song.length() + m_rate;
+    uint64_t frame = 0;
+    while(frame < total)
+    {
+        const uint64_t left = total - frame;
+        const unsigned count = (left < blockFrames) ? static_cast<unsigned>(left) : blockFrames;
+        song.generate(m_midi, *m_gen, m_buffer.data(), count);
+        if(!out.write(m_buffer.data(), count))
+            return false;
+        frame += count;
+    }
+
+    return true;
+}
+
+bool OfflineRenderer::renderToFile(const FmBank::Instrument &instrument, bool isDrum, const Script &script,
+                                   const QString &path, QString *error)
+{
+    return renderToFile(path, error, [&](AudioFileWriter &out)
+    {
+        return render(instrument, isDrum, script, out);
+    });
+}
+
+bool OfflineRenderer::renderSongToFile(const FmBank::Instrument &instrument, bool isDrum, MidiSequencer &song,
+                                       const QString &path, QString *error)
+{
+    return renderToFile(path, error, [&](AudioFileWriter &out)
+    {
+        return renderSong(instrument, isDrum, song, out);
+    });
+}
+
+bool OfflineRenderer::renderToFile(const QString &path, QString *error,
+                                   const std::function<bool(AudioFileWriter &)> &render)
+{
+    AudioFileWriter::Format format;
+    if(!AudioFileWriter::formatFromFileName(path, format))
+    {
+        if(error)
+            *error = QObject::tr("Unknown audio file format: %1").arg(path);
+        return false;
+    }
+
+    std::unique_ptr<AudioFileWriter> out = AudioFileWriter::create(format);
+    bool ok = out->open(path, m_rate) && render(*out);
+    ok = out->close() && ok;
+    if(!ok && error)
+        *error = out->errorString();
+    return ok;
+}
@@ -0,0 +1,156 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OFFLINE_RENDERER_H
+#define OFFLINE_RENDERER_H
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <QString>
+
+#include "generator.h"
+#include "generator_midi.h"
+
+class AudioFileWriter;
+class MidiSequencer;
+
+/**
+ * @brief Renders a timed script of notes into a file, as fast as the CPU allows
+ *
+ * The generator is driven directly from the calling thread, without the
+ * realtime ring buffer and locks, in large blocks between the events.
+ * Hardware chips can't be rendered, they are replaced by Nuked OPL3.
+ */
+class OfflineRenderer
+{
+public:
+    struct Event
+    {
+        enum Type
+        {
+            NOTE_ON,
+            NOTE_OFF,
+            CHORD,
+            ALL_NOTES_OFF,
+            PITCH_BEND,
+            HOLD,
+            END
+        };
+        enum Chord
+        {
+            CHORD_MAJOR,
+            CHORD_MINOR,
+            CHORD_AUGMENTED,
+            CHORD_DIMINISHED,
+            CHORD_MAJOR7,
+            CHORD_MINOR7
+        };
+        //! Time from the start, in milliseconds
+        uint32_t time = 0;
+        Type type = END;
+        int note = 60;
+        //! Velocity, bend value, pedal state, or kind of chord
+        int value = 0;
+        //! Velocity of a chord
+        int velocity = 127;
+    };
+    typedef std::vector<Event> Script;
+
+    /**
+     * @brief Reads a script, one event per line
+     *
+     *     # comment
+     *     <ms> on <note> [velocity]
+     *     <ms> off <note>
+     *     <ms> chord major|minor|augmented|diminished|major7|minor7 <note> [velocity]
+     *     <ms> release
+     *     <ms> bend <-8192..8191>
+     *     <ms> hold on|off
+     *     <ms> end
+     *
+     * The events are sorted by time and end with the first `end`; without one,
+     * the last event is followed by one second of sound.
+     */
+    static bool parseScript(const QString &text, Script &script, QString *error = nullptr);
+
+    /**
+     * @brief Script of a single note, held then released
+     */
+    static Script noteScript(int note, uint32_t holdMs, uint32_t releaseMs, int velocity = 127);
+
+    OfflineRenderer(uint32_t sampleRate, Generator::OPL_Chips chip);
+    ~OfflineRenderer();
+
+    /**
+     * @brief Takes the global parameters of the bank: deep tremolo, vibrato and the volume model
+     */
+    void setBankSetup(const FmBank &bank);
+    void setBankSetup(bool deepTremolo, bool deepVibrato, int volumeModel);
+
+    /**
+     * @brief Renders the script played with the instrument
+     * Every render starts with a fresh generator, so the output only
+     * depends on the instrument, the script and the bank setup.
+     * @param out Writer opened already, left open
+     */
+    bool render(const FmBank::Instrument &instrument, bool isDrum, const Script &script, AudioFileWriter &out);
+
+    /**
+     * @brief Renders into a new file of the format given by the extension
+     */
+    bool renderToFile(const FmBank::Instrument &instrument, bool isDrum, const Script &script,
+                      const QString &path, QString *error = nullptr);
+
+    /**
+     * @brief Renders a MIDI song played with the instrument, from its start
+     * Every channel accepted by the sequencer plays the instrument.
+     * The end of the song is followed by one second of sound.
+     */
+    bool renderSong(const FmBank::Instrument &instrument, bool isDrum, MidiSequencer &song, AudioFileWriter &out);
+    bool renderSongToFile(const FmBank::Instrument &instrument, bool isDrum, MidiSequencer &song,
+                          const QString &path, QString *error = nullptr);
+
+    uint32_t sampleRate() const
+        { return m_rate; }
+
+private:
+    enum
+    {
+        //! Frames generated between the writes to the file
+        blockFrames = 16384
+    };
+
+    //! Makes a fresh generator with the bank setup and the instrument
+    void startGenerator(const FmBank::Instrument &instrument, bool isDrum);
+    void playEvent(const Event &e);
+    bool renderToFile(const QString &path, QString *error,
+                      const std::function<bool(AudioFileWriter &)> &render);
+
+    uint32_t m_rate;
+    Generator::OPL_Chips m_chip;
+    bool m_deepTremolo = false;
+    bool m_deepVibrato = false;
+    int m_volumeModel = Generator::VOLUME_Generic;
+    std::unique_ptr<Generator> m_gen;
+    GeneratorMidi m_midi;
+    std::vector<int16_t> m_buffer;
+};
+
+#endif // OFFLINE_RENDERER_H
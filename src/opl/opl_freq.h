@@ -0,0 +1,166 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPL_FREQ_H
+#define OPL_FREQ_H
+
+#include <stdint.h>
+#include "constexpr_math.h"
+
+/*
+ * Conversion of tones into the block and F-number of the A0/B0 registers.
+ *
+ * A tone is a MIDI key with a fraction of semitone, the frequency model is
+ * `tuning * 2^(tone / 12)`, where the tuning is the F-number of the key 0
+ * at block 0. The powers of two within an octave are computed at compile
+ * time in steps of 1/16 semitone, and interpolated between the steps, so
+ * a note or a pitch bend costs no transcendental math.
+ */
+namespace OPLFreq
+{
+
+enum
+{
+    //! Bits of the fraction of a fixed-point tone
+    toneFractionBits = 16,
+    //! Table steps per semitone
+    stepsPerSemitone = 16,
+    //! Entries of the table, the last one is the start of the next octave
+    tableSize = 12 * stepsPerSemitone + 1
+};
+
+//! Tuning as a 16.16 fixed-point number
+constexpr uint32_t tuning(double fnum)
+{
+    return static_cast<uint32_t>(fnum * 65536.0 + 0.5);
+}
+
+//! Tuning of the generator
+constexpr uint32_t genericTuning = tuning(172.4387);
+//! Tuning of the measurer, kept for the stability of the measured timings
+constexpr uint32_t measurerTuning = tuning(172.00093);
+
+namespace detail
+{
+
+//! 2^(step / (12 * stepsPerSemitone)) in 2.30 fixed-point
+struct OctaveStep
+{
+    static constexpr uint32_t entry(unsigned step)
+    {
+        return static_cast<uint32_t>(CTMath::exp(CTMath::ln2 * step / (12 * stepsPerSemitone)) * 1073741824.0 + 0.5);
+    }
+};
+
+//! Powers of two for every step of an octave
+typedef CTMath::Table<uint32_t, OctaveStep, tableSize> OctaveTable;
+
+static_assert(OctaveTable::values[0] == 0x40000000u, "2^0 must be 1");
+static_assert(OctaveTable::values[tableSize - 1] == 0x80000000u, "2^1 must be 2");
+
+} // namespace detail
+
+struct BlockFNum
+{
+    //! Block and F-number as in bits 0-12 of the A0/B0 register pair
+    uint16_t value;
+    //! Frequency multiplier increment for the tones above the range of block 7
+    uint8_t mulOffset;
+};
+
+/**
+ * @brief Block and F-number of a frequency expressed as F-number at block 0
+ * @param total F-number at block 0, with `shift` bits of fraction
+ */
+inline BlockFNum fromFixed(uint64_t total, int shift)
+{
+    BlockFNum out = {0, 0};
+    uint32_t block = 0;
+    // Basic range until max of octaves reaching: stop under 1023.5
+    while(block < 7 && total >= (2047ull << (shift - 1)))
+    {
+        ++shift;
+        ++block;
+    }
+    // Extended range, rely on frequency multiplication increment: stop under 1022.75
+    while(total >= (4091ull << (shift - 2)))
+    {
+        ++shift;
+        ++out.mulOffset;
+    }
+    out.value = static_cast<uint16_t>((block << 10) + ((total + (1ull << (shift - 1))) >> shift));
+    return out;
+}
+
+/**
+ * @brief Block and F-number of a tone
+ * @param tone Key with a fraction, in 16.16 fixed-point
+ * @param tune Tuning, see tuning()
+ */
+inline BlockFNum fromTone(int32_t tone, uint32_t tune = genericTuning)
+{
+    const int32_t octaveSize = 12 << toneFractionBits;
+    int32_t octave = (tone >= 0) ? (tone / octaveSize) : -((octaveSize - 1 - tone) / octaveSize);
+    const uint32_t rem = static_cast<uint32_t>(tone - octave * octaveSize);
+
+    // Position within the table, 12 bits of fraction between the steps
+    const unsigned fracBits = toneFractionBits - 4;
+    const uint32_t idx = rem >> fracBits;
+    const uint32_t frac = rem & ((1u << fracBits) - 1);
+    const uint32_t *table = detail::OctaveTable::values;
+    const uint32_t pow2 = table[idx] + static_cast<uint32_t>(
+        (static_cast<uint64_t>(table[idx + 1] - table[idx]) * frac) >> fracBits);
+
+    // 16.16 tuning by 2.30 power, 46 bits of fraction
+    const uint64_t total = static_cast<uint64_t>(tune) * pow2;
+    if(octave < -7)
+        octave = -7;
+    else if(octave > 20)
+        octave = 20;
+    return fromFixed(total, 46 - octave);
+}
+
+/**
+ * @brief Block and F-number of a tone with a fraction of semitone
+ */
+inline BlockFNum fromTone(double tone, uint32_t tune = genericTuning)
+{
+    if(tone > 2400.0)
+        tone = 2400.0;
+    else if(tone < -2400.0)
+        tone = -2400.0;
+    const double fixed = tone * (1 << toneFractionBits);
+    return fromTone(static_cast<int32_t>(fixed + ((fixed >= 0.0) ? 0.5 : -0.5)), tune);
+}
+
+/**
+ * @brief Block and F-number of a frequency expressed as F-number at block 0
+ * For the frequency models having their own tables.
+ */
+inline BlockFNum fromHertz(double hertz)
+{
+    if(hertz < 0.0)
+        hertz = 0.0;
+    else if(hertz > 4194303.0)
+        hertz = 4194303.0;
+    return fromFixed(static_cast<uint64_t>(hertz * 1024.0 + 0.5), 10);
+}
+
+} // namespace OPLFreq
+
+#endif // OPL_FREQ_H
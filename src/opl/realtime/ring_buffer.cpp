@@ -7,12 +7,6 @@
 #include <algorithm>
 #include <cassert>
 
-#if defined(__cpp_if_constexpr)
-#    define if_constexpr if constexpr
-#else
-#    define if_constexpr if
-#endif
-
 template <bool Atomic>
 Ring_Buffer_Ex<Atomic>::Ring_Buffer_Ex(size_t capacity)
     : cap_(capacity + 1),
@@ -25,10 +19,34 @@ Ring_Buffer_Ex<Atomic>::~Ring_Buffer_Ex()
 {
 }
 
+namespace {
+inline size_t load_index(const std::atomic<size_t> &i, std::memory_order order)
+{
+    return i.load(order);
+}
+
+inline size_t load_index(const size_t &i, std::memory_order)
+{
+    return i;
+}
+
+inline void store_index(std::atomic<size_t> &i, size_t value, std::memory_order order)
+{
+    i.store(value, order);
+}
+
+inline void store_index(size_t &i, size_t value, std::memory_order)
+{
+    i = value;
+}
+}
+
 template <bool Atomic>
 size_t Ring_Buffer_Ex<Atomic>::size_used() const
 {
-    const size_t rp = rp_, wp = wp_, cap = cap_;
+    const size_t rp = load_index(read_.pos, std::memory_order_relaxed);
+    const size_t wp = load_index(write_.pos, std::memory_order_acquire);
+    const size_t cap = cap_;
     return wp + ((wp < rp) ? cap : 0) - rp;
 }
 
@@ -41,10 +59,70 @@ bool Ring_Buffer_Ex<Atomic>::discard(size_t len)
 template <bool Atomic>
 size_t Ring_Buffer_Ex<Atomic>::size_free() const
 {
-    const size_t rp = rp_, wp = wp_, cap = cap_;
+    const size_t rp = load_index(read_.pos, std::memory_order_acquire);
+    const size_t wp = load_index(write_.pos, std::memory_order_relaxed);
+    const size_t cap = cap_;
     return rp + ((rp <= wp) ? cap : 0) - wp - 1;
 }
 
+template <bool Atomic>
+bool Ring_Buffer_Ex<Atomic>::acquire_read(size_t len, Read_Span &span)
+{
+    const size_t rp = load_index(read_.pos, std::memory_order_relaxed), cap = cap_;
+
+    size_t wp = read_.seen;
+    if (wp + ((wp < rp) ? cap : 0) - rp < len) {
+        wp = read_.seen = load_index(write_.pos, std::memory_order_acquire);
+        if (wp + ((wp < rp) ? cap : 0) - rp < len)
+            return false;
+    }
+
+    const uint8_t *data = rbdata_.get();
+    const size_t taillen = std::min(len, cap - rp);
+    span.data[0] = &data[rp];
+    span.size[0] = taillen;
+    span.data[1] = data;
+    span.size[1] = len - taillen;
+    return true;
+}
+
+template <bool Atomic>
+void Ring_Buffer_Ex<Atomic>::commit_read(size_t len)
+{
+    const size_t rp = load_index(read_.pos, std::memory_order_relaxed), cap = cap_;
+    assert(len <= size_used());
+    store_index(read_.pos, (rp + len < cap) ? (rp + len) : (rp + len - cap), std::memory_order_release);
+}
+
+template <bool Atomic>
+bool Ring_Buffer_Ex<Atomic>::acquire_write(size_t len, Write_Span &span)
+{
+    const size_t wp = load_index(write_.pos, std::memory_order_relaxed), cap = cap_;
+
+    size_t rp = write_.seen;
+    if (rp + ((rp <= wp) ? cap : 0) - wp - 1 < len) {
+        rp = write_.seen = load_index(read_.pos, std::memory_order_acquire);
+        if (rp + ((rp <= wp) ? cap : 0) - wp - 1 < len)
+            return false;
+    }
+
+    uint8_t *data = rbdata_.get();
+    const size_t taillen = std::min(len, cap - wp);
+    span.data[0] = &data[wp];
+    span.size[0] = taillen;
+    span.data[1] = data;
+    span.size[1] = len - taillen;
+    return true;
+}
+
+template <bool Atomic>
+void Ring_Buffer_Ex<Atomic>::commit_write(size_t len)
+{
+    const size_t wp = load_index(write_.pos, std::memory_order_relaxed), cap = cap_;
+    assert(len <= size_free());
+    store_index(write_.pos, (wp + len < cap) ? (wp + len) : (wp + len - cap), std::memory_order_release);
+}
+
 template <bool Atomic>
 bool Ring_Buffer_Ex<Atomic>::getbytes_(void *data, size_t len)
 {
@@ -61,43 +139,27 @@ bool Ring_Buffer_Ex<Atomic>::peekbytes_(void *data, size_t len) const
 template <bool Atomic>
 bool Ring_Buffer_Ex<Atomic>::getbytes_ex_(void *data, size_t len, bool advp)
 {
-    if (size_used() < len)
+    Read_Span span;
+    if (!acquire_read(len, span))
         return false;
 
-    const size_t rp = rp_, cap = cap_;
-    const uint8_t *src = rbdata_.get();
-    uint8_t *dst = (uint8_t *)data;
-
-    if (data) {
-        const size_t taillen = std::min(len, cap - rp);
-        if_constexpr (Atomic)
-            std::atomic_thread_fence(std::memory_order_acquire);
-        std::copy_n(&src[rp], taillen, dst);
-        std::copy_n(src, len - taillen, dst + taillen);
-    }
+    if (data)
+        span.copy_out(0, data, len);
 
     if (advp)
-        rp_ = (rp + len < cap) ? (rp + len) : (rp + len - cap);
+        commit_read(len);
     return true;
 }
 
 template <bool Atomic>
 bool Ring_Buffer_Ex<Atomic>::putbytes_(const void *data, size_t len)
 {
-    if (size_free() < len)
+    Write_Span span;
+    if (!acquire_write(len, span))
         return false;
 
-    const size_t wp = wp_, cap = cap_;
-    const uint8_t *src = (const uint8_t *)data;
-    uint8_t *dst = rbdata_.get();
-
-    const size_t taillen = std::min(len, cap - wp);
-    std::copy_n(src, taillen, &dst[wp]);
-    std::copy_n(src + taillen, len - taillen, dst);
-    if_constexpr (Atomic)
-        std::atomic_thread_fence(std::memory_order_release);
-
-    wp_ = (wp + len < cap) ? (wp + len) : (wp + len - cap);
+    span.copy_in(0, data, len);
+    commit_write(len);
     return true;
 }
 
@@ -19,6 +19,20 @@ static_assert(
 template <bool> class Ring_Buffer_Ex;
 typedef Ring_Buffer_Ex<true> Ring_Buffer;
 
+//------------------------------------------------------------------------------
+// a region of the buffer, in two parts when it wraps around the end
+template <class T>
+struct Ring_Buffer_Span {
+    T *data[2] {};
+    size_t size[2] {};
+    size_t total() const { return size[0] + size[1]; }
+    // the bytes at the offset, if they do not wrap, otherwise null
+    T *contiguous(size_t offset, size_t len) const;
+    // copies across the wrap
+    void copy_out(size_t offset, void *dst, size_t len) const;
+    void copy_in(size_t offset, const void *src, size_t len) const;
+};
+
 //------------------------------------------------------------------------------
 template <class RB>
 class Basic_Ring_Buffer {
@@ -53,11 +67,31 @@ public:
     // write operations
     size_t size_free() const;
     using Base::put;
+    // in-place operations: acquire the next len bytes, read or write them
+    // where they are, then commit to release them to the other side
+    typedef Ring_Buffer_Span<const uint8_t> Read_Span;
+    typedef Ring_Buffer_Span<uint8_t> Write_Span;
+    bool acquire_read(size_t len, Read_Span &span);
+    void commit_read(size_t len);
+    bool acquire_write(size_t len, Write_Span &span);
+    void commit_write(size_t len);
 
 private:
+    enum { cache_line = 64 };
+    typedef typename std::conditional<Atomic, std::atomic<size_t>, size_t>::type index_t;
+    // set at construction
     size_t cap_{0};
-    typename std::conditional<Atomic, std::atomic<size_t>, size_t>::type rp_{0}, wp_{0};
     std::unique_ptr<uint8_t[]> rbdata_ {};
+    // each side writes its own index and keeps a copy of the other one,
+    // reloaded only when the copy says the buffer is empty or full; the
+    // padding keeps the two sides off each other's cache line
+    struct side_t {
+        char pad_before[cache_line];
+        index_t pos{0};
+        size_t seen{0};
+        char pad_after[cache_line];
+    };
+    side_t read_, write_;
     friend Base;
     bool getbytes_(void *data, size_t len);
     bool peekbytes_(void *data, size_t len) const;
@@ -4,7 +4,51 @@
 //          http://www.boost.org/LICENSE_1_0.txt)
 
 #include "ring_buffer.h"
+#include <algorithm>
 
+template <class T>
+inline T *Ring_Buffer_Span<T>::contiguous(size_t offset, size_t len) const
+{
+    if (offset + len <= size[0])
+        return data[0] + offset;
+    if (offset >= size[0])
+        return data[1] + (offset - size[0]);
+    return nullptr;
+}
+
+template <class T>
+inline void Ring_Buffer_Span<T>::copy_out(size_t offset, void *dst, size_t len) const
+{
+    uint8_t *d = (uint8_t *)dst;
+    if (offset < size[0]) {
+        const size_t headlen = std::min(len, size[0] - offset);
+        std::copy_n(data[0] + offset, headlen, d);
+        d += headlen;
+        len -= headlen;
+        offset = 0;
+    }
+    else
+        offset -= size[0];
+    std::copy_n(data[1] + offset, len, d);
+}
+
+template <class T>
+inline void Ring_Buffer_Span<T>::copy_in(size_t offset, const void *src, size_t len) const
+{
+    const uint8_t *s = (const uint8_t *)src;
+    if (offset < size[0]) {
+        const size_t headlen = std::min(len, size[0] - offset);
+        std::copy_n(s, headlen, data[0] + offset);
+        s += headlen;
+        len -= headlen;
+        offset = 0;
+    }
+    else
+        offset -= size[0];
+    std::copy_n(s, len, data[1] + offset);
+}
+
+//------------------------------------------------------------------------------
 template <bool Atomic>
 inline size_t Ring_Buffer_Ex<Atomic>::capacity() const
 {
@@ -0,0 +1,149 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "realtime_stats.h"
+#include <QFile>
+#include <QObject>
+#include <algorithm>
+
+//! Blocks the audio thread may record between two collections
+enum { blocks_capacity = 1024 };
+
+RealtimeStats::RealtimeStats(size_t historyLimit)
+    : m_rb_blocks(new Ring_Buffer(blocks_capacity * sizeof(RealtimeBlockStats))),
+      m_resetRequest(false),
+      m_blocks(0),
+      m_underflows(0),
+      m_lostBlocks(0),
+      m_frames(0),
+      m_load(0),
+      m_loadPeak(0),
+      m_renderUsPeak(0),
+      m_messagesPeak(0),
+      m_ctlQueuedPeak(0),
+      m_midiQueuedPeak(0),
+      m_historyLimit(historyLimit)
+{
+}
+
+void RealtimeStats::rt_record(RealtimeBlockStats block)
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+
+    if(m_resetRequest.exchange(false, std::memory_order_acquire))
+    {
+        m_loadPeak.store(0, relaxed);
+        m_renderUsPeak.store(0, relaxed);
+        m_messagesPeak.store(0, relaxed);
+        m_ctlQueuedPeak.store(0, relaxed);
+        m_midiQueuedPeak.store(0, relaxed);
+    }
+
+    block.underflow = m_rtUnderflow;
+    m_rtUnderflow = false;
+
+    // The audio thread is the only writer, the peaks need no compare-exchange
+    m_blocks.store(m_blocks.load(relaxed) + 1, relaxed);
+    if(block.underflow)
+        m_underflows.store(m_underflows.load(relaxed) + 1, relaxed);
+    m_frames.store(block.frames, relaxed);
+    m_load.store(block.load, relaxed);
+    m_loadPeak.store(std::max(m_loadPeak.load(relaxed), block.load), relaxed);
+    m_renderUsPeak.store(std::max(m_renderUsPeak.load(relaxed), block.renderUs), relaxed);
+    m_messagesPeak.store(std::max(m_messagesPeak.load(relaxed), block.messages), relaxed);
+    m_ctlQueuedPeak.store(std::max(m_ctlQueuedPeak.load(relaxed), block.ctlQueued), relaxed);
+    m_midiQueuedPeak.store(std::max(m_midiQueuedPeak.load(relaxed), block.midiQueued), relaxed);
+
+    Ring_Buffer &rb = *m_rb_blocks;
+    if(rb.size_free() >= sizeof(block))
+        rb.put(block);
+    else
+        m_lostBlocks.store(m_lostBlocks.load(relaxed) + 1, relaxed);
+}
+
+RealtimeStats::Summary RealtimeStats::summary() const
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    Summary s;
+    s.blocks = m_blocks.load(relaxed);
+    s.underflows = m_underflows.load(relaxed);
+    s.lostBlocks = m_lostBlocks.load(relaxed);
+    s.frames = m_frames.load(relaxed);
+    s.load = m_load.load(relaxed);
+    s.loadPeak = m_loadPeak.load(relaxed);
+    s.renderUsPeak = m_renderUsPeak.load(relaxed);
+    s.messagesPeak = m_messagesPeak.load(relaxed);
+    s.ctlQueuedPeak = m_ctlQueuedPeak.load(relaxed);
+    s.midiQueuedPeak = m_midiQueuedPeak.load(relaxed);
+    return s;
+}
+
+void RealtimeStats::ctl_collect()
+{
+    Ring_Buffer &rb = *m_rb_blocks;
+    RealtimeBlockStats block;
+    while(rb.size_used() >= sizeof(block) && rb.get(block))
+    {
+        if(m_history.size() >= m_historyLimit)
+            m_history.pop_front();
+        m_history.push_back(block);
+    }
+}
+
+void RealtimeStats::ctl_reset()
+{
+    ctl_collect();
+    m_history.clear();
+    m_resetRequest.store(true, std::memory_order_release);
+}
+
+bool RealtimeStats::saveCsv(const QString &path, QString *error)
+{
+    ctl_collect();
+
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        if(error)
+            *error = QObject::tr("Could not open the file: %1").arg(file.errorString());
+        return false;
+    }
+
+    QByteArray csv("time_us,frames,render_us,load,messages,ctl_queued,midi_queued,underflow\n");
+    for(const RealtimeBlockStats &b : m_history)
+    {
+        csv += QString("%1,%2,%3,%4,%5,%6,%7,%8\n")
+               .arg(static_cast<qulonglong>(b.time))
+               .arg(b.frames)
+               .arg(b.renderUs)
+               .arg(static_cast<double>(b.load), 0, 'f', 4)
+               .arg(b.messages)
+               .arg(b.ctlQueued)
+               .arg(b.midiQueued)
+               .arg(b.underflow ? 1 : 0)
+               .toLatin1();
+    }
+
+    if(file.write(csv) != csv.size())
+    {
+        if(error)
+            *error = QObject::tr("Could not write the file: %1").arg(file.errorString());
+        return false;
+    }
+    return true;
+}
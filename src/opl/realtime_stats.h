@@ -0,0 +1,115 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIME_STATS_H
+#define REALTIME_STATS_H
+
+#include "realtime/ring_buffer.h"
+#include <QString>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdint.h>
+
+/**
+ * @brief Measures of one block generated by the audio thread
+ */
+struct RealtimeBlockStats
+{
+    //! Start of the block from the first one, in microseconds
+    uint64_t time;
+    uint32_t frames;
+    //! Time spent generating, in microseconds
+    uint32_t renderUs;
+    //! Render time over the duration of the block; 1 or more misses the deadline
+    float load;
+    //! Control and MIDI messages processed
+    uint32_t messages;
+    //! Bytes waiting in the control and MIDI queues at the start of the block
+    uint32_t ctlQueued;
+    uint32_t midiQueued;
+    //! The device ran out of frames before this block
+    bool underflow;
+};
+
+/**
+ * @brief Timing statistics of the audio thread
+ *
+ * The audio thread records every block without locking: the peaks are kept
+ * in atomics, the blocks go through a ring buffer. The control thread reads
+ * the peaks at any time and collects the blocks into a history, which can
+ * be saved as CSV. Blocks are lost when the ring buffer is not collected in
+ * time, they are counted.
+ */
+class RealtimeStats
+{
+public:
+    struct Summary
+    {
+        uint64_t blocks = 0;
+        uint64_t underflows = 0;
+        uint64_t lostBlocks = 0;
+        uint32_t frames = 0;
+        float load = 0;
+        float loadPeak = 0;
+        uint32_t renderUsPeak = 0;
+        uint32_t messagesPeak = 0;
+        uint32_t ctlQueuedPeak = 0;
+        uint32_t midiQueuedPeak = 0;
+    };
+
+    explicit RealtimeStats(size_t historyLimit = 65536);
+
+    /* Audio thread */
+    //! Marks the next block as following an underflow of the device
+    void rt_underflow()
+        { m_rtUnderflow = true; }
+    void rt_record(RealtimeBlockStats block);
+
+    /* Control thread */
+    Summary summary() const;
+    //! Moves the recorded blocks into the history, call it regularly
+    void ctl_collect();
+    //! Forgets the history and the peaks
+    void ctl_reset();
+    bool saveCsv(const QString &path, QString *error = nullptr);
+
+private:
+    std::unique_ptr<Ring_Buffer> m_rb_blocks;
+    //! Set by the control thread, the audio thread clears the peaks
+    std::atomic<bool> m_resetRequest;
+
+    std::atomic<uint64_t> m_blocks;
+    std::atomic<uint64_t> m_underflows;
+    std::atomic<uint64_t> m_lostBlocks;
+    std::atomic<uint32_t> m_frames;
+    std::atomic<float> m_load;
+    std::atomic<float> m_loadPeak;
+    std::atomic<uint32_t> m_renderUsPeak;
+    std::atomic<uint32_t> m_messagesPeak;
+    std::atomic<uint32_t> m_ctlQueuedPeak;
+    std::atomic<uint32_t> m_midiQueuedPeak;
+
+    //! Audio thread only
+    bool m_rtUnderflow = false;
+
+    std::deque<RealtimeBlockStats> m_history;
+    size_t m_historyLimit;
+};
+
+#endif // REALTIME_STATS_H
@@ -0,0 +1,224 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "voice_allocator.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+VoiceAllocator::VoiceAllocator()
+{}
+
+void VoiceAllocator::allocate(int count)
+{
+    if(count < 0)
+        count = 0;
+    m_voices.assign((size_t)count, Voice());
+    m_order.assign((size_t)count, Link());
+    m_keyLinks.assign((size_t)count, Link());
+    m_levelLinks.assign((size_t)count, Link());
+    m_level.assign((size_t)count, 0);
+    clear();
+}
+
+int VoiceAllocator::noteOn(int note, uint32_t volume, uint8_t ccvolume, uint8_t ccexpr, bool *replace)
+{
+    int v = -1;
+
+    if(m_policy == STEAL_SAME_NOTE)
+    {
+        const List &key = m_keys[keyIndex(note)];
+        for(int k = key.head; k != -1 && v == -1; k = m_keyLinks[(size_t)k].next)
+        {
+            if(m_voices[(size_t)k].note == note)
+                v = k;
+        }
+    }
+
+    if(v == -1)
+        v = (m_free.head != -1) ? m_free.head : victim();
+
+    if(replace)
+        *replace = (v != -1) && (m_voices[(size_t)v].note != -1);
+
+    if(v == -1)
+        return -1;
+
+    if(m_voices[(size_t)v].note != -1)
+        makeFree(v);
+    unlink(m_order, m_free, v);
+
+    Voice &voice = m_voices[(size_t)v];
+    voice.note = note;
+    voice.volume = volume;
+    voice.ccvolume = ccvolume;
+    voice.ccexpr = ccexpr;
+    voice.held = false;
+    makeBusy(v);
+
+    return v;
+}
+
+int VoiceAllocator::findNoteOff(int note) const
+{
+    const List &key = m_keys[keyIndex(note)];
+    for(int v = key.head; v != -1; v = m_keyLinks[(size_t)v].next)
+    {
+        const Voice &voice = m_voices[(size_t)v];
+        if(voice.note == note && !voice.held)
+            return v;
+    }
+    return -1;
+}
+
+void VoiceAllocator::release(int voice)
+{
+    if(m_voices[(size_t)voice].note != -1)
+        makeFree(voice);
+}
+
+void VoiceAllocator::setHeld(int voice, bool held)
+{
+    Voice &v = m_voices[(size_t)voice];
+    v.held = held;
+    if(v.note != -1)
+        setLevel(voice, levelOf(v));
+}
+
+void VoiceAllocator::clear()
+{
+    m_free = List();
+    m_busy = List();
+    for(unsigned i = 0; i < keyLists; ++i)
+        m_keys[i] = List();
+    for(unsigned i = 0; i < levelLists; ++i)
+        m_levels[i] = List();
+    m_levelMask = 0;
+    m_activeCount = 0;
+
+    const int count = voiceCount();
+    for(int v = 0; v < count; ++v)
+    {
+        m_voices[(size_t)v].note = -1;
+        m_voices[(size_t)v].held = false;
+        m_keyLinks[(size_t)v] = Link();
+        m_levelLinks[(size_t)v] = Link();
+        append(m_order, m_free, v);
+    }
+}
+
+void VoiceAllocator::append(std::vector<Link> &links, List &list, int v)
+{
+    Link &link = links[(size_t)v];
+    link.prev = list.tail;
+    link.next = -1;
+    if(list.tail != -1)
+        links[(size_t)list.tail].next = v;
+    else
+        list.head = v;
+    list.tail = v;
+}
+
+void VoiceAllocator::unlink(std::vector<Link> &links, List &list, int v)
+{
+    Link &link = links[(size_t)v];
+    if(link.prev != -1)
+        links[(size_t)link.prev].next = link.next;
+    else
+        list.head = link.next;
+    if(link.next != -1)
+        links[(size_t)link.next].prev = link.prev;
+    else
+        list.tail = link.prev;
+    link.prev = link.next = -1;
+}
+
+unsigned VoiceAllocator::levelOf(const Voice &voice)
+{
+    if(voice.held)
+        return 0;
+    // Loudness by the generic volume model: product of velocity and controllers
+    const uint32_t velocity = (voice.volume < 127) ? voice.volume : 127;
+    const uint32_t product = velocity * voice.ccvolume * voice.ccexpr;
+    return 1 + (unsigned)((uint64_t)product * (levelLists - 2) / (127 * 127 * 127));
+}
+
+unsigned VoiceAllocator::lowestLevel() const
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(m_levelMask);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, m_levelMask);
+    return (unsigned)index;
+#else
+    unsigned level = 0;
+    while(!(m_levelMask & ((uint64_t)1 << level)))
+        ++level;
+    return level;
+#endif
+}
+
+void VoiceAllocator::makeBusy(int v)
+{
+    append(m_order, m_busy, v);
+    append(m_keyLinks, m_keys[keyIndex(m_voices[(size_t)v].note)], v);
+    const unsigned level = levelOf(m_voices[(size_t)v]);
+    m_level[(size_t)v] = (uint8_t)level;
+    append(m_levelLinks, m_levels[level], v);
+    m_levelMask |= (uint64_t)1 << level;
+    ++m_activeCount;
+}
+
+void VoiceAllocator::makeFree(int v)
+{
+    Voice &voice = m_voices[(size_t)v];
+    unlink(m_order, m_busy, v);
+    unlink(m_keyLinks, m_keys[keyIndex(voice.note)], v);
+    const unsigned level = m_level[(size_t)v];
+    unlink(m_levelLinks, m_levels[level], v);
+    if(m_levels[level].head == -1)
+        m_levelMask &= ~((uint64_t)1 << level);
+    append(m_order, m_free, v);
+    voice.note = -1;
+    voice.held = false;
+    --m_activeCount;
+}
+
+void VoiceAllocator::setLevel(int v, unsigned level)
+{
+    const unsigned old = m_level[(size_t)v];
+    if(old == level)
+        return;
+    unlink(m_levelLinks, m_levels[old], v);
+    if(m_levels[old].head == -1)
+        m_levelMask &= ~((uint64_t)1 << old);
+    m_level[(size_t)v] = (uint8_t)level;
+    append(m_levelLinks, m_levels[level], v);
+    m_levelMask |= (uint64_t)1 << level;
+}
+
+int VoiceAllocator::victim() const
+{
+    if(m_busy.head == -1)
+        return -1;
+    if(m_policy == STEAL_QUIETEST)
+        return m_levels[lowestLevel()].head;
+    return m_busy.head;
+}
@@ -0,0 +1,179 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2016-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VOICE_ALLOCATOR_H
+#define VOICE_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * @brief Assigns the played notes to voices
+ *
+ * A voice is whatever the generator plays one note with: a 2-op channel,
+ * a pair of channels of a pseudo-4op instrument, or a 4-op channel pair,
+ * on any of the chips. The allocator only deals with voice indices, the
+ * generator maps them to the chip channels.
+ *
+ * Taking, releasing and stealing a voice run in constant time; the search
+ * of the voice to release walks the voices of the same key only. Free voices are
+ * kept in a FIFO, so the voice released last is reused last and its release
+ * tail is not cut short. Busy voices are kept in the order of their noteOn,
+ * per key, and per estimated loudness.
+ */
+class VoiceAllocator
+{
+public:
+    enum StealPolicy
+    {
+        //! The oldest note is replaced when all voices are busy
+        STEAL_OLDEST = 0,
+        //! Notes held by the pedal are replaced first, then the quietest note
+        STEAL_QUIETEST,
+        //! A repeated key retriggers its voice; otherwise as STEAL_OLDEST
+        STEAL_SAME_NOTE,
+        STEAL_END
+    };
+
+    struct Voice
+    {
+        //! Currently pressed key. -1 means the voice is free
+        int note = -1;
+        //! Note volume determined by velocity
+        uint32_t volume = 0;
+        //! Channel volume determined by controller
+        uint8_t ccvolume = 0;
+        //! Channel expression determined by controller
+        uint8_t ccexpr = 0;
+        //! Whether it has a pending noteOff being delayed while held
+        bool held = false;
+    };
+
+    VoiceAllocator();
+
+    /**
+     * @brief Sets the count of voices, all of them free
+     */
+    void allocate(int count);
+
+    /**
+     * @brief Finds a voice for the note and marks it busy
+     * @param replace Set when the voice was playing another note before
+     * @return Voice index, or -1 when there are no voices
+     */
+    int noteOn(int note, uint32_t volume, uint8_t ccvolume, uint8_t ccexpr, bool *replace = nullptr);
+
+    /**
+     * @brief Oldest voice playing the note which is not held already
+     * @return Voice index, or -1 if none
+     */
+    int findNoteOff(int note) const;
+
+    /**
+     * @brief Marks the voice free
+     */
+    void release(int voice);
+
+    /**
+     * @brief Marks the voice as kept on by the sustain pedal
+     */
+    void setHeld(int voice, bool held);
+
+    /**
+     * @brief Marks all voices free
+     */
+    void clear();
+
+    void setStealPolicy(StealPolicy policy)
+        { m_policy = policy; }
+    StealPolicy stealPolicy() const
+        { return m_policy; }
+
+    const Voice &voice(int v) const
+        { return m_voices[(size_t)v]; }
+    int voiceCount() const
+        { return static_cast<int>(m_voices.size()); }
+    int activeCount() const
+        { return m_activeCount; }
+
+    /**
+     * @brief Busy voices, from the oldest note to the newest one
+     * Take the next voice before releasing the current one.
+     */
+    int firstActive() const
+        { return m_busy.head; }
+    int nextActive(int v) const
+        { return m_order[(size_t)v].next; }
+
+private:
+    enum
+    {
+        //! Keys are hashed into this count of lists
+        keyLists = 128,
+        //! Levels of loudness, the first one is for held voices
+        levelLists = 64
+    };
+
+    struct Link
+    {
+        int prev = -1;
+        int next = -1;
+    };
+
+    struct List
+    {
+        int head = -1;
+        int tail = -1;
+    };
+
+    static void append(std::vector<Link> &links, List &list, int v);
+    static void unlink(std::vector<Link> &links, List &list, int v);
+
+    static unsigned keyIndex(int note)
+        { return static_cast<unsigned>(note) % keyLists; }
+    static unsigned levelOf(const Voice &voice);
+    //! Index of the lowest level having voices, m_levelMask must not be empty
+    unsigned lowestLevel() const;
+
+    void makeBusy(int v);
+    void makeFree(int v);
+    void setLevel(int v, unsigned level);
+    //! Busy voice to replace when no voice is free
+    int victim() const;
+
+    std::vector<Voice> m_voices;
+    //! Links in the free list or in the busy list, in order of use
+    std::vector<Link> m_order;
+    //! Links between the busy voices of the same key list
+    std::vector<Link> m_keyLinks;
+    //! Links between the busy voices of the same level
+    std::vector<Link> m_levelLinks;
+    std::vector<uint8_t> m_level;
+
+    List m_free;
+    List m_busy;
+    List m_keys[keyLists];
+    List m_levels[levelLists];
+    //! Bit set for every level having voices
+    uint64_t m_levelMask = 0;
+    int m_activeCount = 0;
+    StealPolicy m_policy = STEAL_OLDEST;
+};
+
+#endif // VOICE_ALLOCATOR_H
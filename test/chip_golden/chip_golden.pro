@@ -0,0 +1,48 @@
+#-------------------------------------------------
+#
+# Golden output of the chip emulators
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = tst_chip_goldentest
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+DEFINES += GOLDEN_DIR=\\\"$$PWD/golden\\\"
+DEFINES += BANK_EXAMPLES_DIR=\\\"$$PWD/../../Bank_Examples\\\"
+
+INCLUDEPATH += $$PWD/../../src
+
+SOURCES += \
+        tst_chip_goldentest.cpp \
+    ../../src/FileFormats/wopl/wopl_file.c \
+    ../../src/opl/chips/dosbox_opl3.cpp \
+    ../../src/opl/chips/dosbox/dbopl.cpp \
+    ../../src/opl/chips/java_opl3.cpp \
+    ../../src/opl/chips/nuked_opl3.cpp \
+    ../../src/opl/chips/nuked/nukedopl3.c \
+    ../../src/opl/chips/nuked_opl3_v174.cpp \
+    ../../src/opl/chips/nuked/nukedopl3_174.c \
+    ../../src/opl/chips/nuked_opl3_simd.cpp \
+    ../../src/opl/chips/nuked/nukedopl3_simd.c \
+    ../../src/opl/chips/opal_opl3.cpp
+
+HEADERS += \
+    golden_render.h \
+    ../../src/opl/chip_snapshot.h \
+    ../../src/FileFormats/wopl/wopl_file.h \
+    ../../src/opl/chips/opl_chip_base.h \
+    ../../src/opl/chips/dosbox_opl3.h \
+    ../../src/opl/chips/java_opl3.h \
+    ../../src/opl/chips/nuked_opl3.h \
+    ../../src/opl/chips/nuked_opl3_v174.h \
+    ../../src/opl/chips/nuked_opl3_simd.h \
+    ../../src/opl/chips/opal_opl3.h
@@ -0,0 +1,227 @@
+#ifndef GOLDEN_RENDER_H
+#define GOLDEN_RENDER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include <opl/chips/opl_chip_base.h>
+#include <FileFormats/wopl/wopl_file.h>
+
+/*
+ * Fixed rendering of a single instrument: the instrument is set up on the
+ * first channel(s) of a freshly reset chip, one note is held, then released.
+ * The resulting samples are reduced to a hash and a signal level.
+ */
+namespace GoldenRender
+{
+
+enum
+{
+    noteOnMs = 200,
+    noteOffMs = 100,
+    blockFrames = 512
+};
+
+//! Output routine of the chip the samples are taken from
+enum Output
+{
+    OUTPUT_INT16,
+    //! Path of the audio output, hashed as the bits of the floats
+    OUTPUT_FLOAT
+};
+
+struct Result
+{
+    uint64_t hash;
+    double rms;
+};
+
+static inline uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Identity of the sound of an instrument, names excluded
+ */
+static inline uint64_t instrumentKey(const WOPLInstrument &ins, bool percussion)
+{
+    uint8_t raw[32];
+    size_t n = 0;
+    raw[n++] = percussion ? 1 : 0;
+    raw[n++] = (uint8_t)(ins.note_offset1 & 0xFF);
+    raw[n++] = (uint8_t)(ins.note_offset1 >> 8);
+    raw[n++] = (uint8_t)(ins.note_offset2 & 0xFF);
+    raw[n++] = (uint8_t)(ins.note_offset2 >> 8);
+    raw[n++] = (uint8_t)ins.second_voice_detune;
+    raw[n++] = ins.percussion_key_number;
+    raw[n++] = ins.inst_flags;
+    raw[n++] = ins.fb_conn1_C0;
+    raw[n++] = ins.fb_conn2_C0;
+    for(int op = 0; op < 4; ++op)
+    {
+        raw[n++] = ins.operators[op].avekf_20;
+        raw[n++] = ins.operators[op].ksl_l_40;
+        raw[n++] = ins.operators[op].atdec_60;
+        raw[n++] = ins.operators[op].susrel_80;
+        raw[n++] = ins.operators[op].waveform_E0;
+    }
+    return fnv1a(0xCBF29CE484222325ull, raw, n);
+}
+
+static inline void writeOperator(OPLChipBase &chip, unsigned slot, const WOPLOperator &op)
+{
+    chip.writeReg((uint16_t)(0x20 + slot), op.avekf_20);
+    chip.writeReg((uint16_t)(0x40 + slot), op.ksl_l_40);
+    chip.writeReg((uint16_t)(0x60 + slot), op.atdec_60);
+    chip.writeReg((uint16_t)(0x80 + slot), op.susrel_80);
+    chip.writeReg((uint16_t)(0xE0 + slot), op.waveform_E0);
+}
+
+// key-on value of the B0 register for a MIDI key, without a floating point
+static inline uint16_t keyBlockFNum(int key)
+{
+    static const uint16_t fnums[12] =
+    {
+        0x157, 0x16B, 0x181, 0x198, 0x1B0, 0x1CA, 0x1E5, 0x202, 0x220, 0x241, 0x263, 0x287
+    };
+    key = (key < 12) ? 12 : ((key > 107) ? 107 : key);
+    int block = key / 12 - 1;
+    return (uint16_t)((block << 10) | fnums[key % 12]);
+}
+
+static inline void setupVoice(OPLChipBase &chip, unsigned channel,
+                              const WOPLOperator &modulator, const WOPLOperator &carrier,
+                              uint8_t fbConn)
+{
+    static const unsigned slots[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0A, 0x10, 0x11, 0x12};
+    writeOperator(chip, slots[channel], modulator);
+    writeOperator(chip, slots[channel] + 3, carrier);
+    chip.writeReg((uint16_t)(0xC0 + channel), (uint8_t)(fbConn | 0x30));
+}
+
+static inline void keyOn(OPLChipBase &chip, unsigned channel, int key, bool on)
+{
+    uint16_t kbf = keyBlockFNum(key);
+    chip.writeReg((uint16_t)(0xA0 + channel), (uint8_t)(kbf & 0xFF));
+    chip.writeReg((uint16_t)(0xB0 + channel), (uint8_t)((kbf >> 8) | (on ? 0x20 : 0x00)));
+}
+
+static inline void generate(OPLChipBase &chip, int16_t *buffer, size_t frames)
+{
+    chip.generate(buffer, frames);
+}
+
+static inline void generate(OPLChipBase &chip, float *buffer, size_t frames)
+{
+    chip.generateFloat(buffer, frames);
+}
+
+template <class Sample>
+static inline void renderFrames(OPLChipBase &chip, size_t frames, std::vector<Sample> &out)
+{
+    Sample buffer[2 * blockFrames];
+    while(frames > 0)
+    {
+        size_t count = (frames < (size_t)blockFrames) ? frames : (size_t)blockFrames;
+        generate(chip, buffer, count);
+        out.insert(out.end(), buffer, buffer + 2 * count);
+        frames -= count;
+    }
+}
+
+// little-endian bytes of a sample, and its value on the 16-bit scale
+static inline double sampleBytes(int16_t sample, uint8_t *le, size_t &size)
+{
+    le[0] = (uint8_t)(sample & 0xFF);
+    le[1] = (uint8_t)((uint16_t)sample >> 8);
+    size = 2;
+    return sample;
+}
+
+static inline double sampleBytes(float sample, uint8_t *le, size_t &size)
+{
+    uint32_t bits;
+    memcpy(&bits, &sample, sizeof(bits));
+    for(size = 0; size < 4; ++size)
+        le[size] = (uint8_t)(bits >> (8 * size));
+    return sample * 32768.0;
+}
+
+template <class Sample>
+static inline Result renderNote(OPLChipBase &chip, const WOPLInstrument &ins, bool percussion, uint32_t rate)
+{
+    const bool fourOp = (ins.inst_flags & WOPL_Ins_4op) && !(ins.inst_flags & WOPL_Ins_Pseudo4op);
+    const bool pseudoFourOp = (ins.inst_flags & WOPL_Ins_4op) && (ins.inst_flags & WOPL_Ins_Pseudo4op);
+
+    chip.reset();
+    chip.writeReg(0x105, 0x01);
+    chip.writeReg(0x104, fourOp ? 0x01 : 0x00);
+    chip.writeReg(0x001, 0x20);
+    chip.writeReg(0x0BD, 0x00);
+
+    int key = (percussion && ins.percussion_key_number) ? ins.percussion_key_number : 60;
+    int key1 = key + ins.note_offset1;
+    int key2 = key + ins.note_offset2;
+
+    setupVoice(chip, 0, ins.operators[WOPL_OP_MODULATOR1], ins.operators[WOPL_OP_CARRIER1], ins.fb_conn1_C0);
+    if(fourOp)
+        setupVoice(chip, 3, ins.operators[WOPL_OP_MODULATOR2], ins.operators[WOPL_OP_CARRIER2], ins.fb_conn2_C0);
+    else if(pseudoFourOp)
+        setupVoice(chip, 1, ins.operators[WOPL_OP_MODULATOR2], ins.operators[WOPL_OP_CARRIER2], ins.fb_conn2_C0);
+
+    std::vector<Sample> samples;
+    samples.reserve(2 * (size_t)rate * (noteOnMs + noteOffMs) / 1000);
+
+    keyOn(chip, 0, key1, true);
+    if(pseudoFourOp)
+        keyOn(chip, 1, key2, true);
+    renderFrames(chip, (size_t)rate * noteOnMs / 1000, samples);
+    keyOn(chip, 0, key1, false);
+    if(pseudoFourOp)
+        keyOn(chip, 1, key2, false);
+    renderFrames(chip, (size_t)rate * noteOffMs / 1000, samples);
+
+    Result result;
+    uint64_t hash = 0xCBF29CE484222325ull;
+    double energy = 0.0;
+    for(size_t i = 0; i < samples.size(); ++i)
+    {
+        uint8_t le[4];
+        size_t size;
+        double value = sampleBytes(samples[i], le, size);
+        hash = fnv1a(hash, le, size);
+        energy += value * value;
+    }
+    result.hash = hash;
+    result.rms = samples.empty() ? 0.0 : sqrt(energy / samples.size());
+    return result;
+}
+
+/**
+ * @brief Renders one note of the instrument
+ * @param chip Chip, set up for the wanted sample rate; it gets reset
+ * @param ins Instrument
+ * @param percussion Instrument is a drum, played at its percussion key
+ * @param rate Sample rate the chip is set up with
+ * @param output Output routine the samples are taken from
+ */
+static inline Result renderInstrument(OPLChipBase &chip, const WOPLInstrument &ins, bool percussion, uint32_t rate,
+                                      Output output = OUTPUT_INT16)
+{
+    if(output == OUTPUT_FLOAT)
+        return renderNote<float>(chip, ins, percussion, rate);
+    return renderNote<int16_t>(chip, ins, percussion, rate);
+}
+
+} // namespace GoldenRender
+
+#endif // GOLDEN_RENDER_H
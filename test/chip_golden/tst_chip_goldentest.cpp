@@ -0,0 +1,399 @@
+#include <QString>
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <opl/chips/nuked_opl3.h>
+#include <opl/chips/nuked_opl3_v174.h>
+#include <opl/chips/nuked_opl3_simd.h>
+#include <opl/chips/dosbox_opl3.h>
+#include <opl/chips/opal_opl3.h>
+#include <opl/chips/java_opl3.h>
+#include <opl/chip_snapshot.h>
+#include <FileFormats/wopl/wopl_file.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "golden_render.h"
+
+/*
+ * Renders every instrument of the WOPL banks in Bank_Examples through each
+ * emulator and compares the hashes of the output with the golden files.
+ * The emulators are rendered through the linear resampler into 16-bit
+ * samples, and through the path of the audio output: the 48-tap sinc
+ * resampler into floats.
+ * Then a stream of timed writes is rendered in blocks of different sizes,
+ * which must not change the output.
+ * Set OPL3_GOLDEN_UPDATE=1 in the environment to rewrite the golden files.
+ */
+class Chip_goldenTest : public QObject
+{
+    Q_OBJECT
+
+    struct CorpusEntry
+    {
+        QString origin;
+        WOPLInstrument ins;
+        bool percussion;
+    };
+
+    struct Golden
+    {
+        quint64 hash;
+        double rms;
+    };
+
+    // unique instruments by sound, in order of the key
+    QMap<quint64, CorpusEntry> m_corpus;
+
+    static OPLChipBase *createChip(const QString &id)
+    {
+        if(id == "nuked")
+            return new NukedOPL3;
+        if(id == "nuked174")
+            return new NukedOPL3v174;
+        if(id == "nukedsimd")
+            return new NukedOPL3SIMD;
+        if(id == "dosbox")
+            return new DosBoxOPL3;
+        if(id == "opal")
+            return new OpalOPL3;
+        if(id == "java")
+            return new JavaOPL3;
+        return nullptr;
+    }
+
+    static QString goldenPath(const QString &emulator, uint rate, bool audioPath)
+    {
+        return QString("%1/%2_%3%4.txt").arg(GOLDEN_DIR).arg(emulator).arg(rate)
+               .arg(audioPath ? "_sinc48_float" : "");
+    }
+
+    static bool loadGolden(const QString &path, QHash<quint64, Golden> &golden)
+    {
+        QFile f(path);
+        if(!f.open(QIODevice::ReadOnly | QIODevice::Text))
+            return false;
+        QTextStream in(&f);
+        while(!in.atEnd())
+        {
+            QStringList fields = in.readLine().split(' ');
+            if(fields.size() != 3)
+                continue;
+            Golden g;
+            g.hash = fields[1].toULongLong(nullptr, 16);
+            g.rms = fields[2].toDouble();
+            golden.insert(fields[0].toULongLong(nullptr, 16), g);
+        }
+        return true;
+    }
+
+    struct ScheduledWrite
+    {
+        size_t frame;
+        uint16_t addr;
+        uint8_t data;
+    };
+
+    /**
+     * @brief Notes of the first instruments of the corpus, one per channel,
+     * starting and stopping at uneven frames
+     */
+    std::vector<ScheduledWrite> noteSchedule(uint32_t rate) const
+    {
+        static const unsigned slots[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0A, 0x10, 0x11, 0x12};
+        std::vector<ScheduledWrite> writes;
+        const ScheduledWrite init[] = {{0, 0x105, 0x01}, {0, 0x104, 0x00}, {0, 0x001, 0x20}, {0, 0x0BD, 0x00}};
+        writes.insert(writes.end(), init, init + 4);
+
+        QMap<quint64, CorpusEntry>::const_iterator it = m_corpus.begin();
+        for(unsigned c = 0; c < 9 && it != m_corpus.end(); ++c, ++it)
+        {
+            const WOPLOperator *ops[2] = {&it->ins.operators[WOPL_OP_MODULATOR1], &it->ins.operators[WOPL_OP_CARRIER1]};
+            for(unsigned o = 0; o < 2; ++o)
+            {
+                const unsigned slot = slots[c] + 3 * o;
+                const ScheduledWrite op[] =
+                {
+                    {0, (uint16_t)(0x20 + slot), ops[o]->avekf_20},
+                    {0, (uint16_t)(0x40 + slot), ops[o]->ksl_l_40},
+                    {0, (uint16_t)(0x60 + slot), ops[o]->atdec_60},
+                    {0, (uint16_t)(0x80 + slot), ops[o]->susrel_80},
+                    {0, (uint16_t)(0xE0 + slot), ops[o]->waveform_E0}
+                };
+                writes.insert(writes.end(), op, op + 5);
+            }
+            const ScheduledWrite fbConn = {0, (uint16_t)(0xC0 + c), (uint8_t)(it->ins.fb_conn1_C0 | 0x30)};
+            writes.push_back(fbConn);
+        }
+
+        uint32_t seed = 1;
+        size_t frame = 0;
+        for(int n = 0; n < 60; ++n)
+        {
+            seed = seed * 1103515245u + 12345u;
+            frame += (seed >> 8) % (rate / 40);
+            const unsigned channel = (seed >> 4) % 9;
+            const uint16_t kbf = GoldenRender::keyBlockFNum(48 + (int)((seed >> 16) % 24));
+            const size_t length = rate / 50 + (seed >> 12) % (rate / 8);
+            const ScheduledWrite note[] =
+            {
+                {frame, (uint16_t)(0xA0 + channel), (uint8_t)(kbf & 0xFF)},
+                {frame, (uint16_t)(0xB0 + channel), (uint8_t)((kbf >> 8) | 0x20)},
+                {frame + length, (uint16_t)(0xB0 + channel), (uint8_t)(kbf >> 8)}
+            };
+            writes.insert(writes.end(), note, note + 3);
+        }
+
+        std::stable_sort(writes.begin(), writes.end(),
+                         [](const ScheduledWrite &a, const ScheduledWrite &b) { return a.frame < b.frame; });
+        return writes;
+    }
+
+    //! Renders the writes on a new chip, queued at their frame within blocks of the given size
+    static std::vector<int16_t> renderSchedule(const QString &emulator, bool sinc, uint32_t rate,
+                                               const std::vector<ScheduledWrite> &writes,
+                                               size_t frames, size_t blockFrames)
+    {
+        std::vector<int16_t> out(2 * frames);
+        std::unique_ptr<OPLChipBase> chip(createChip(emulator));
+        if(!chip)
+            return out;
+        chip->setRate(rate);
+        if(sinc)
+            chip->setResamplerQuality(OPLChipBase::RESAMPLER_SINC48);
+
+        size_t next = 0;
+        for(size_t pos = 0; pos < frames; pos += blockFrames)
+        {
+            const size_t count = (frames - pos < blockFrames) ? frames - pos : blockFrames;
+            for(; next < writes.size() && writes[next].frame < pos + count; ++next)
+                chip->writeRegAt(writes[next].addr, writes[next].data, (uint32_t)(writes[next].frame - pos));
+            chip->generate(&out[2 * pos], count);
+        }
+        return out;
+    }
+
+    void addBank(const QString &path)
+    {
+        QFile f(path);
+        QVERIFY2(f.open(QIODevice::ReadOnly), qPrintable("Can't open " + path));
+        QByteArray data = f.readAll();
+        f.close();
+
+        int err = 0;
+        WOPLFile *file = WOPL_LoadBankFromMem(data.data(), (size_t)data.size(), &err);
+        QVERIFY2(file != nullptr, qPrintable("Can't load " + path));
+
+        const QString name = QFileInfo(path).fileName();
+        for(int percussion = 0; percussion < 2; ++percussion)
+        {
+            const WOPLBank *banks = percussion ? file->banks_percussive : file->banks_melodic;
+            uint16_t count = percussion ? file->banks_count_percussion : file->banks_count_melodic;
+            for(uint16_t b = 0; b < count; ++b)
+            {
+                for(int i = 0; i < 128; ++i)
+                {
+                    const WOPLInstrument &ins = banks[b].ins[i];
+                    if(ins.inst_flags & WOPL_Ins_IsBlank)
+                        continue;
+                    quint64 key = GoldenRender::instrumentKey(ins, percussion != 0);
+                    if(m_corpus.contains(key))
+                        continue;
+                    CorpusEntry entry;
+                    entry.origin = QString("%1 %2 bank %3 #%4").arg(name)
+                                   .arg(percussion ? "percussion" : "melodic").arg(b).arg(i);
+                    entry.ins = ins;
+                    entry.percussion = (percussion != 0);
+                    m_corpus.insert(key, entry);
+                }
+            }
+        }
+
+        WOPL_Free(file);
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QDir dir(BANK_EXAMPLES_DIR);
+        const QStringList banks = dir.entryList(QStringList() << "*.wopl", QDir::Files, QDir::Name);
+        for(const QString &bank : banks)
+            addBank(dir.filePath(bank));
+        QVERIFY2(!m_corpus.isEmpty(), "No instruments found in Bank_Examples");
+    }
+
+    void render_data()
+    {
+        QTest::addColumn<QString>("emulator");
+        QTest::addColumn<uint>("rate");
+        QTest::addColumn<bool>("audioPath");
+
+        const char *emulators[] = {"nuked", "nuked174", "nukedsimd", "dosbox", "opal", "java"};
+        const uint rates[] = {44100, 49716};
+        const uint audioRates[] = {44100, 48000};
+        for(const char *emulator : emulators)
+        {
+            for(uint rate : rates)
+                QTest::newRow(qPrintable(QString("%1 %2").arg(emulator).arg(rate))) << QString(emulator) << rate << false;
+            for(uint rate : audioRates)
+                QTest::newRow(qPrintable(QString("%1 %2 sinc48 float").arg(emulator).arg(rate))) << QString(emulator) << rate << true;
+        }
+    }
+
+    void render()
+    {
+        QFETCH(QString, emulator);
+        QFETCH(uint, rate);
+        QFETCH(bool, audioPath);
+
+        std::unique_ptr<OPLChipBase> chip(createChip(emulator));
+        QVERIFY(chip.get() != nullptr);
+        chip->setRate(rate);
+        if(audioPath)
+            chip->setResamplerQuality(OPLChipBase::RESAMPLER_SINC48);
+        const GoldenRender::Output output = audioPath ? GoldenRender::OUTPUT_FLOAT : GoldenRender::OUTPUT_INT16;
+
+        const bool update = qEnvironmentVariableIntValue("OPL3_GOLDEN_UPDATE") != 0;
+        const QString path = goldenPath(emulator, rate, audioPath);
+        QHash<quint64, Golden> golden;
+        if(!update)
+            QVERIFY2(loadGolden(path, golden), qPrintable("Can't open " + path));
+
+        QFile out(path);
+        QTextStream outStream(&out);
+        if(update)
+            QVERIFY2(out.open(QIODevice::WriteOnly | QIODevice::Text), qPrintable("Can't write " + path));
+
+        QStringList failures;
+        QElapsedTimer timer;
+        qint64 elapsed = 0;
+
+        for(QMap<quint64, CorpusEntry>::const_iterator it = m_corpus.begin(); it != m_corpus.end(); ++it)
+        {
+            timer.start();
+            GoldenRender::Result result = GoldenRender::renderInstrument(*chip, it->ins, it->percussion, rate, output);
+            elapsed += timer.nsecsElapsed();
+
+            if(update)
+            {
+                outStream << QString("%1 %2 %3\n").arg(it.key(), 16, 16, QChar('0'))
+                             .arg(result.hash, 16, 16, QChar('0')).arg(result.rms, 0, 'f', 1);
+                continue;
+            }
+
+            QHash<quint64, Golden>::const_iterator g = golden.find(it.key());
+            if(g == golden.end())
+                failures << QString("%1: no golden output").arg(it->origin);
+            else if(g->hash != result.hash)
+            {
+                failures << QString("%1: output differs, RMS %2 instead of %3")
+                            .arg(it->origin).arg(result.rms, 0, 'f', 1).arg(g->rms, 0, 'f', 1);
+            }
+        }
+
+        const double frames = (double)m_corpus.size() * rate *
+                              (GoldenRender::noteOnMs + GoldenRender::noteOffMs) / 1000.0;
+        qInfo("%s at %u Hz%s: %d instruments, %.0f frames/s, %.1fx realtime",
+              qPrintable(emulator), rate, audioPath ? " (sinc48, float)" : "", m_corpus.size(),
+              frames * 1e9 / elapsed, frames * 1e9 / elapsed / rate);
+
+        if(update)
+            QSKIP("Golden output updated");
+
+        for(int i = 0; i < failures.size() && i < 10; ++i)
+            qWarning("%s", qPrintable(failures[i]));
+        QVERIFY2(failures.isEmpty(),
+                 qPrintable(QString("%1 of %2 instruments don't match the golden output")
+                            .arg(failures.size()).arg(m_corpus.size())));
+    }
+
+    void blockSize_data()
+    {
+        QTest::addColumn<QString>("emulator");
+        QTest::addColumn<bool>("sinc");
+
+        const char *emulators[] = {"nuked", "nuked174", "nukedsimd", "dosbox", "opal", "java"};
+        for(const char *emulator : emulators)
+        {
+            QTest::newRow(qPrintable(QString("%1 linear").arg(emulator))) << QString(emulator) << false;
+            QTest::newRow(qPrintable(QString("%1 sinc48").arg(emulator))) << QString(emulator) << true;
+        }
+    }
+
+    void blockSize()
+    {
+        QFETCH(QString, emulator);
+        QFETCH(bool, sinc);
+        const uint32_t rate = 44100;
+
+        // Long enough for the last notes to be released
+        const std::vector<ScheduledWrite> writes = noteSchedule(rate);
+        const size_t frames = writes.back().frame + rate / 2;
+
+        const std::vector<int16_t> small = renderSchedule(emulator, sinc, rate, writes, frames, 64);
+        const std::vector<int16_t> large = renderSchedule(emulator, sinc, rate, writes, frames, 1000);
+        const std::vector<int16_t> odd = renderSchedule(emulator, sinc, rate, writes, frames, 37);
+
+        size_t differs = 0;
+        for(size_t i = 0; i < small.size(); ++i)
+        {
+            if(small[i] != large[i] || small[i] != odd[i])
+                ++differs;
+        }
+        QVERIFY2(differs == 0, qPrintable(QString("%1 of %2 samples depend on the block size")
+                                          .arg(differs).arg(small.size())));
+
+        // and the schedule does make a sound
+        QVERIFY(std::count(small.begin(), small.end(), 0) < (ptrdiff_t)small.size() / 2);
+    }
+
+    void snapshotReset_data()
+    {
+        QTest::addColumn<QString>("emulator");
+
+        const char *emulators[] = {"nuked", "nuked174", "nukedsimd", "dosbox", "opal", "java"};
+        for(const char *emulator : emulators)
+            QTest::newRow(emulator) << QString(emulator);
+    }
+
+    void snapshotReset()
+    {
+        QFETCH(QString, emulator);
+        const uint32_t rate = 49716;
+
+        // Post-init state, made the way the measurer makes it
+        std::unique_ptr<OPLChipBase> source(createChip(emulator));
+        QVERIFY(!ResetChipForMeasure(source.get(), nullptr, rate));
+        ChipSnapshot initState;
+        initState.save(source.get());
+        QVERIFY(initState.m_valid);
+
+        // A fresh chip takes the snapshot instead of writing the registers
+        std::unique_ptr<OPLChipBase> restored(createChip(emulator));
+        QVERIFY(ResetChipForMeasure(restored.get(), &initState, rate));
+
+        // and then sounds like the chip it was saved from
+        const WOPLInstrument &ins = m_corpus.first().ins;
+        std::vector<int16_t> expected, actual;
+        OPLChipBase *chips[2] = {source.get(), restored.get()};
+        std::vector<int16_t> *outputs[2] = {&expected, &actual};
+        for(int i = 0; i < 2; ++i)
+        {
+            GoldenRender::setupVoice(*chips[i], 0, ins.operators[WOPL_OP_MODULATOR1],
+                                     ins.operators[WOPL_OP_CARRIER1], ins.fb_conn1_C0);
+            GoldenRender::keyOn(*chips[i], 0, 60, true);
+            GoldenRender::renderFrames(*chips[i], rate / 10, *outputs[i]);
+        }
+        QVERIFY(expected == actual);
+    }
+};
+
+QTEST_APPLESS_MAIN(Chip_goldenTest)
+
+#include <tst_chip_goldentest.moc>
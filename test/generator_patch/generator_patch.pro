@@ -0,0 +1,44 @@
+#-------------------------------------------------
+#
+# Register writes of a patch change under playing notes
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = tst_generator_patchtest
+CONFIG   += console c++11 thread
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/../../src
+
+SOURCES += \
+        tst_generator_patchtest.cpp \
+    ../../src/bank.cpp \
+    ../../src/opl/generator.cpp \
+    ../../src/opl/voice_allocator.cpp \
+    ../../src/opl/chips/dosbox_opl3.cpp \
+    ../../src/opl/chips/dosbox/dbopl.cpp \
+    ../../src/opl/chips/java_opl3.cpp \
+    ../../src/opl/chips/nuked_opl3.cpp \
+    ../../src/opl/chips/nuked/nukedopl3.c \
+    ../../src/opl/chips/nuked_opl3_simd.cpp \
+    ../../src/opl/chips/nuked/nukedopl3_simd.c \
+    ../../src/opl/chips/opal_opl3.cpp
+
+HEADERS += \
+    ../../src/bank.h \
+    ../../src/opl/generator.h \
+    ../../src/opl/voice_allocator.h \
+    ../../src/opl/chips/opl_chip_base.h \
+    ../../src/opl/chips/dosbox_opl3.h \
+    ../../src/opl/chips/java_opl3.h \
+    ../../src/opl/chips/nuked_opl3.h \
+    ../../src/opl/chips/nuked_opl3_simd.h \
+    ../../src/opl/chips/opal_opl3.h
@@ -0,0 +1,152 @@
+#include <QString>
+#include <QtTest>
+
+#include <opl/generator.h>
+#include <bank.h>
+
+/*
+ * Counts the register writes of Generator::changePatch() while notes are
+ * playing: an edit of the loaded instrument only sends what differs, a
+ * change of the channel layout reloads everything.
+ */
+class Generator_patchTest : public QObject
+{
+    Q_OBJECT
+
+    static FmBank::Instrument instrument()
+    {
+        FmBank::Instrument ins = FmBank::emptyInst();
+        for(int op = 0; op < 4; ++op)
+        {
+            FmBank::Operator &o = ins.OP[op];
+            o.attack = 15;
+            o.decay = 2;
+            o.sustain = 4;
+            o.release = 6;
+            o.fmult = 1;
+            o.level = (op == CARRIER1 || op == CARRIER2) ? 0 : 20;
+            o.eg = true;
+        }
+        ins.feedback1 = 3;
+        ins.feedback2 = 3;
+        return ins;
+    }
+
+    struct Writes
+    {
+        uint64_t forwarded;
+        uint64_t suppressed;
+    };
+
+    //! Register writes made by a change of patch
+    static Writes changePatch(Generator &gen, const FmBank::Instrument &ins, bool isDrum = false)
+    {
+        const GeneratorDebugInfo before = gen.debugInfo();
+        gen.changePatch(ins, isDrum);
+        const GeneratorDebugInfo &after = gen.debugInfo();
+        Writes w = {after.regWritesForwarded - before.regWritesForwarded,
+                    after.regWritesSuppressed - before.regWritesSuppressed};
+        return w;
+    }
+
+    /**
+     * @brief Whether notes are still playing: loading the same patch again
+     * sets up the playing voices with nothing to send
+     */
+    static bool notesKept(Generator &gen, const FmBank::Instrument &ins)
+    {
+        Writes w = changePatch(gen, ins);
+        return w.forwarded == 0 && w.suppressed > 0;
+    }
+
+private Q_SLOTS:
+    void inPlaceUpdate()
+    {
+        Generator gen(44100, Generator::CHIP_Nuked, 1);
+        FmBank::Instrument ins = instrument();
+        gen.changePatch(ins, false);
+        gen.PlayNoteF(60);
+        gen.PlayNoteF(64);
+
+        // One level of one operator: one register of each playing voice
+        ins.OP[CARRIER1].level = 5;
+        Writes w = changePatch(gen, ins);
+        QCOMPARE(w.forwarded, uint64_t(2));
+        QVERIFY(w.suppressed > 0);
+        QVERIFY(notesKept(gen, ins));
+
+        // Feedback and waveform: two more registers per voice
+        ins.feedback1 = 5;
+        ins.OP[MODULATOR1].waveform = 1;
+        w = changePatch(gen, ins);
+        QCOMPARE(w.forwarded, uint64_t(4));
+        QVERIFY(notesKept(gen, ins));
+    }
+
+    void reloadOnLayoutChange_data()
+    {
+        QTest::addColumn<bool>("en4op");
+        QTest::addColumn<bool>("pseudo4op");
+
+        QTest::newRow("4-op") << true << false;
+        QTest::newRow("pseudo 4-op") << true << true;
+    }
+
+    void reloadOnLayoutChange()
+    {
+        QFETCH(bool, en4op);
+        QFETCH(bool, pseudo4op);
+
+        Generator gen(44100, Generator::CHIP_Nuked, 1);
+        FmBank::Instrument ins = instrument();
+        gen.changePatch(ins, false);
+        gen.PlayNoteF(60);
+        gen.PlayNoteF(64);
+        QVERIFY(notesKept(gen, ins));
+
+        // Other channels or other flags: the notes are stopped and the
+        // channels set up again
+        ins.en_4op = en4op;
+        ins.en_pseudo4op = pseudo4op;
+        Writes w = changePatch(gen, ins);
+        QVERIFY(w.forwarded > 2);
+        QVERIFY(!notesKept(gen, ins));
+
+        // Back to 2-op the same way
+        gen.PlayNoteF(60);
+        ins.en_4op = false;
+        ins.en_pseudo4op = false;
+        w = changePatch(gen, ins);
+        QVERIFY(w.forwarded > 2);
+        QVERIFY(!notesKept(gen, ins));
+    }
+
+    void reloadInRhythmMode()
+    {
+        Generator gen(44100, Generator::CHIP_Nuked, 1);
+        FmBank::Instrument drum = instrument();
+        drum.adlib_drum_number = 6;
+        gen.changePatch(drum, true);
+        gen.PlayNote();
+
+        // A rhythm-mode drum is always loaded again, even unchanged
+        Writes w = changePatch(gen, drum, true);
+        QVERIFY(w.forwarded + w.suppressed > 2);
+
+        // Leaving the rhythm mode reloads as well
+        FmBank::Instrument ins = instrument();
+        w = changePatch(gen, ins);
+        QVERIFY(w.forwarded > 2);
+
+        // Then melodic edits are in place again
+        gen.PlayNoteF(60);
+        ins.OP[CARRIER1].level = 5;
+        w = changePatch(gen, ins);
+        QCOMPARE(w.forwarded, uint64_t(1));
+        QVERIFY(notesKept(gen, ins));
+    }
+};
+
+QTEST_APPLESS_MAIN(Generator_patchTest)
+
+#include <tst_generator_patchtest.moc>
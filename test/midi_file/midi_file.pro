@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Parser of Standard MIDI Files
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = tst_midi_filetest
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/../../src
+
+SOURCES += \
+        tst_midi_filetest.cpp \
+    ../../src/midi/midi_file.cpp
+
+HEADERS += \
+    ../../src/midi/midi_file.h
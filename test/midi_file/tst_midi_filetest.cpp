@@ -0,0 +1,204 @@
+#include <QString>
+#include <QtTest>
+
+#include <midi/midi_file.h>
+
+#include <initializer_list>
+#include <string>
+
+/*
+ * Parses Standard MIDI Files built in memory, checking the merged events
+ * and their times in microseconds.
+ */
+class Midi_fileTest : public QObject
+{
+    Q_OBJECT
+
+    static std::string be(uint32_t value, int bytes)
+    {
+        std::string out;
+        for(int i = bytes - 1; i >= 0; --i)
+            out += static_cast<char>((value >> (8 * i)) & 0xFF);
+        return out;
+    }
+
+    static std::string vlq(uint32_t value)
+    {
+        std::string out(1, static_cast<char>(value & 0x7F));
+        while(value >>= 7)
+            out.insert(out.begin(), static_cast<char>(0x80 | (value & 0x7F)));
+        return out;
+    }
+
+    //! Delta time followed by the bytes of an event
+    static std::string ev(uint32_t delta, std::initializer_list<int> bytes)
+    {
+        std::string out = vlq(delta);
+        for(int b : bytes)
+            out += static_cast<char>(b);
+        return out;
+    }
+
+    static std::string tempo(uint32_t delta, uint32_t usPerQuarter)
+    {
+        return vlq(delta) + std::string("\xFF\x51\x03", 3) + be(usPerQuarter, 3);
+    }
+
+    static std::string endOfTrack()
+    {
+        return std::string("\x00\xFF\x2F\x00", 4);
+    }
+
+    static std::string header(int format, int tracks, uint32_t division)
+    {
+        return std::string("MThd") + be(6, 4) + be(format, 2) + be(tracks, 2) + be(division, 2);
+    }
+
+    static std::string track(const std::string &events)
+    {
+        return std::string("MTrk") + be(static_cast<uint32_t>(events.size()), 4) + events;
+    }
+
+    static QByteArray bytes(const std::string &data)
+    {
+        return QByteArray(data.data(), static_cast<int>(data.size()));
+    }
+
+    static bool isEvent(const MidiFile::Event &e, uint64_t time, int status, int data1, int data2)
+    {
+        return e.time == time && e.size == 3 &&
+               e.data[0] == status && e.data[1] == data1 && e.data[2] == data2;
+    }
+
+private Q_SLOTS:
+    void format0()
+    {
+        // 96 ticks per quarter note at the default 120 BPM: a quarter is 500 ms
+        std::string events = ev(0, {0x90, 60, 100}) + ev(96, {0x80, 60, 0}) +
+                             ev(0, {0xC0, 5}) + endOfTrack();
+        MidiFile file;
+        QString error;
+        QVERIFY2(file.parse(bytes(header(0, 1, 96) + track(events)), &error), qPrintable(error));
+        QCOMPARE(file.format(), 0);
+        QCOMPARE(file.trackCount(), 1);
+        QCOMPARE(file.events().size(), size_t(3));
+        QVERIFY(isEvent(file.events()[0], 0, 0x90, 60, 100));
+        QVERIFY(isEvent(file.events()[1], 500000, 0x80, 60, 0));
+        QCOMPARE(int(file.events()[2].size), 2);
+        QCOMPARE(int(file.events()[2].data[1]), 5);
+        QCOMPARE(file.duration(), uint64_t(500000));
+    }
+
+    void format1Merge()
+    {
+        // The tempo track comes first, the notes of both tracks interleave
+        std::string conductor = tempo(0, 250000) + endOfTrack();
+        std::string first = ev(0, {0x90, 60, 100}) + ev(192, {0x80, 60, 0}) + endOfTrack();
+        std::string second = ev(96, {0x91, 64, 90}) + ev(96, {0x81, 64, 0}) + endOfTrack();
+        MidiFile file;
+        QString error;
+        QVERIFY2(file.parse(bytes(header(1, 3, 96) + track(conductor) + track(first) + track(second)), &error),
+                 qPrintable(error));
+        QCOMPARE(file.format(), 1);
+        QCOMPARE(file.trackCount(), 3);
+        QCOMPARE(file.events().size(), size_t(4));
+        QVERIFY(isEvent(file.events()[0], 0, 0x90, 60, 100));
+        QVERIFY(isEvent(file.events()[1], 250000, 0x91, 64, 90));
+        // Same tick in two tracks: the order of the tracks is kept
+        QVERIFY(isEvent(file.events()[2], 500000, 0x80, 60, 0));
+        QVERIFY(isEvent(file.events()[3], 500000, 0x81, 64, 0));
+        QCOMPARE(file.duration(), uint64_t(500000));
+    }
+
+    void runningStatus()
+    {
+        std::string events = ev(0, {0x90, 60, 100}) + ev(0, {64, 100}) + ev(48, {60, 0}) +
+                             ev(0, {0xB0, 7, 90}) + ev(0, {10, 64}) + endOfTrack();
+        MidiFile file;
+        QString error;
+        QVERIFY2(file.parse(bytes(header(0, 1, 96) + track(events)), &error), qPrintable(error));
+        QCOMPARE(file.events().size(), size_t(5));
+        QVERIFY(isEvent(file.events()[0], 0, 0x90, 60, 100));
+        QVERIFY(isEvent(file.events()[1], 0, 0x90, 64, 100));
+        QVERIFY(isEvent(file.events()[2], 250000, 0x90, 60, 0));
+        QVERIFY(isEvent(file.events()[3], 250000, 0xB0, 7, 90));
+        QVERIFY(isEvent(file.events()[4], 250000, 0xB0, 10, 64));
+
+        // Data bytes without a status before them
+        MidiFile damaged;
+        QVERIFY(!damaged.parse(bytes(header(0, 1, 96) + track(ev(0, {60, 100}) + endOfTrack()))));
+    }
+
+    void tempoMap()
+    {
+        // A quarter at 120 BPM, then a quarter at 240 BPM, then 60 BPM
+        std::string events = ev(0, {0x90, 60, 100}) + tempo(96, 250000) +
+                             ev(0, {0x90, 62, 100}) + tempo(96, 1000000) +
+                             ev(0, {0x90, 64, 100}) + ev(48, {0x80, 64, 0}) + endOfTrack();
+        MidiFile file;
+        QString error;
+        QVERIFY2(file.parse(bytes(header(0, 1, 96) + track(events)), &error), qPrintable(error));
+        QCOMPARE(file.events().size(), size_t(4));
+        QVERIFY(isEvent(file.events()[0], 0, 0x90, 60, 100));
+        QVERIFY(isEvent(file.events()[1], 500000, 0x90, 62, 100));
+        QVERIFY(isEvent(file.events()[2], 750000, 0x90, 64, 100));
+        QVERIFY(isEvent(file.events()[3], 1250000, 0x80, 64, 0));
+        QCOMPARE(file.duration(), uint64_t(1250000));
+    }
+
+    void smpteDivision()
+    {
+        // 25 frames per second of 40 ticks: a tick is 1 ms, the tempo is ignored
+        std::string events = tempo(0, 250000) + ev(100, {0x90, 60, 100}) +
+                             ev(400, {0x80, 60, 0}) + endOfTrack();
+        MidiFile file;
+        QString error;
+        QVERIFY2(file.parse(bytes(header(0, 1, 0xE728) + track(events)), &error), qPrintable(error));
+        QCOMPARE(file.events().size(), size_t(2));
+        QVERIFY(isEvent(file.events()[0], 100000, 0x90, 60, 100));
+        QVERIFY(isEvent(file.events()[1], 500000, 0x80, 60, 0));
+        QCOMPARE(file.duration(), uint64_t(500000));
+
+        // No ticks per frame
+        MidiFile invalid;
+        QVERIFY(!invalid.parse(bytes(header(0, 1, 0xE700) + track(events))));
+    }
+
+    void truncatedChunks()
+    {
+        const std::string events = ev(0, {0x90, 60, 100}) + ev(96, {0x80, 60, 0}) + endOfTrack();
+
+        // The length of the last chunk is larger than the file: what is there is read
+        std::string longChunk = header(0, 1, 96) + "MTrk" + be(1000, 4) + events;
+        MidiFile file;
+        QString error;
+        QVERIFY2(file.parse(bytes(longChunk), &error), qPrintable(error));
+        QCOMPARE(file.events().size(), size_t(2));
+
+        // The file ends in the middle of an event
+        std::string cut = header(0, 1, 96) + "MTrk" + be(static_cast<uint32_t>(events.size()), 4) +
+                          events.substr(0, 6);
+        MidiFile damaged;
+        QVERIFY(!damaged.parse(bytes(cut), &error));
+        QVERIFY(!error.isEmpty());
+
+        // The file ends in the middle of a chunk header
+        MidiFile noTracks;
+        QVERIFY(!noTracks.parse(bytes(header(0, 1, 96) + "MTr")));
+
+        // The file ends in its header
+        MidiFile noHeader;
+        QVERIFY(!noHeader.parse(bytes(header(0, 1, 96).substr(0, 10))));
+    }
+
+    void unsupported()
+    {
+        MidiFile file;
+        QVERIFY(!file.parse(bytes(header(2, 1, 96) + track(endOfTrack()))));
+        QVERIFY(!file.parse(QByteArray("RIFF\0\0\0\0", 8)));
+    }
+};
+
+QTEST_APPLESS_MAIN(Midi_fileTest)
+
+#include <tst_midi_filetest.moc>
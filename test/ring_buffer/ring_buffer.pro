@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# Lock-free ring buffer of the realtime generator
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = tst_ring_buffertest
+CONFIG   += console c++11 thread
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/../../src
+
+SOURCES += \
+        tst_ring_buffertest.cpp \
+    ../../src/opl/realtime/ring_buffer.cpp
+
+HEADERS += \
+    ../../src/opl/realtime/ring_buffer.h \
+    ../../src/opl/realtime/ring_buffer.tcc
@@ -0,0 +1,202 @@
+#include <QString>
+#include <QtTest>
+
+#include <opl/realtime/ring_buffer.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/*
+ * Checks the lock-free ring buffer used between the control and the audio
+ * threads: spans across the end of the storage, the limits seen through
+ * the cached indices, and a producer and a consumer running together.
+ */
+class Ring_bufferTest : public QObject
+{
+    Q_OBJECT
+
+    //! Moves both indices to pos, the buffer staying empty
+    static void advance(Ring_Buffer &rb, size_t pos)
+    {
+        std::vector<uint8_t> tmp(pos);
+        QVERIFY(rb.put(tmp.data(), pos));
+        QVERIFY(rb.discard(pos));
+    }
+
+private Q_SLOTS:
+    void straddle()
+    {
+        // 10 bytes of room in 11 of storage: 7 from the end, it wraps after 4
+        Ring_Buffer rb(10);
+        advance(rb, 7);
+
+        const uint8_t in[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        Ring_Buffer::Write_Span ws;
+        QVERIFY(rb.acquire_write(8, ws));
+        QCOMPARE(ws.size[0], size_t(4));
+        QCOMPARE(ws.size[1], size_t(4));
+        QCOMPARE(ws.total(), size_t(8));
+        ws.copy_in(0, in, 8);
+        rb.commit_write(8);
+        QCOMPARE(rb.size_used(), size_t(8));
+
+        Ring_Buffer::Read_Span rs;
+        QVERIFY(rb.acquire_read(8, rs));
+        QCOMPARE(rs.size[0], size_t(4));
+        QCOMPARE(rs.size[1], size_t(4));
+
+        // Copies starting before, at and after the wrap
+        uint8_t out[8] = {};
+        rs.copy_out(0, out, 8);
+        QVERIFY(std::memcmp(in, out, 8) == 0);
+        std::memset(out, 0, sizeof(out));
+        rs.copy_out(2, out, 5);
+        QVERIFY(std::memcmp(in + 2, out, 5) == 0);
+        rs.copy_out(4, out, 4);
+        QVERIFY(std::memcmp(in + 4, out, 4) == 0);
+        rs.copy_out(6, out, 2);
+        QVERIFY(std::memcmp(in + 6, out, 2) == 0);
+
+        // Partial writes over the wrap, into a second span
+        rb.commit_read(8);
+        QVERIFY(rb.acquire_write(6, ws));
+        const uint8_t more[6] = {11, 12, 13, 14, 15, 16};
+        ws.copy_in(0, more, 2);
+        ws.copy_in(2, more + 2, 4);
+        rb.commit_write(6);
+        uint8_t got[6] = {};
+        QVERIFY(rb.get(got, 6));
+        QVERIFY(std::memcmp(more, got, 6) == 0);
+        QCOMPARE(rb.size_used(), size_t(0));
+    }
+
+    void contiguous()
+    {
+        Ring_Buffer rb(10);
+        advance(rb, 7);
+
+        const uint8_t in[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        QVERIFY(rb.put(in, 8));
+        Ring_Buffer::Read_Span rs;
+        QVERIFY(rb.acquire_read(8, rs));
+
+        // Within the first part, at its end, then across and after the wrap
+        QVERIFY(rs.contiguous(0, 4) == rs.data[0]);
+        QVERIFY(rs.contiguous(2, 2) == rs.data[0] + 2);
+        QVERIFY(rs.contiguous(3, 2) == nullptr);
+        QVERIFY(rs.contiguous(0, 8) == nullptr);
+        QVERIFY(rs.contiguous(4, 4) == rs.data[1]);
+        QVERIFY(rs.contiguous(5, 2) == rs.data[1] + 1);
+        QCOMPARE(int(*rs.contiguous(5, 2)), 6);
+
+        // Without a wrap, everything is in the first part
+        rb.commit_read(8);
+        QVERIFY(rb.put(in, 3));
+        QVERIFY(rb.acquire_read(3, rs));
+        QCOMPARE(rs.size[1], size_t(0));
+        QVERIFY(rs.contiguous(0, 3) == rs.data[0]);
+    }
+
+    void limits()
+    {
+        Ring_Buffer rb(10);
+        QCOMPARE(rb.capacity(), size_t(10));
+        QCOMPARE(rb.size_free(), size_t(10));
+
+        uint8_t byte = 0;
+        Ring_Buffer::Read_Span rs;
+        QVERIFY(!rb.acquire_read(1, rs));
+        QVERIFY(!rb.get(byte));
+
+        // Full: the writer has seen the reader at the start
+        std::vector<uint8_t> block(10, 0x55);
+        QVERIFY(rb.put(block.data(), 10));
+        QCOMPARE(rb.size_free(), size_t(0));
+        QVERIFY(!rb.put(byte));
+
+        // The reader empties it, the copy kept by the writer is stale and
+        // only reloaded once it says the room is missing
+        QVERIFY(rb.get(block.data(), 10));
+        QVERIFY(rb.put(block.data(), 10));
+        QVERIFY(!rb.put(byte));
+
+        // A stale copy never lets the writer over the unread bytes
+        QVERIFY(rb.discard(3));
+        Ring_Buffer::Write_Span ws;
+        QVERIFY(!rb.acquire_write(4, ws));
+        QVERIFY(rb.acquire_write(3, ws));
+        rb.commit_write(3);
+        QCOMPARE(rb.size_used(), size_t(10));
+
+        // Empty: the copy of the reader is stale the other way
+        QVERIFY(rb.discard(10));
+        QVERIFY(!rb.acquire_read(1, rs));
+        QVERIFY(rb.put(byte));
+        QVERIFY(rb.acquire_read(1, rs));
+        QVERIFY(!rb.acquire_read(2, rs));
+        rb.commit_read(1);
+        QCOMPARE(rb.size_used(), size_t(0));
+        QCOMPARE(rb.size_free(), size_t(10));
+    }
+
+    void spscStress()
+    {
+        // Records of a length byte then a counter repeated, in a buffer
+        // of an odd size so that they straddle the end in every place
+        const unsigned count = 200000;
+        Ring_Buffer rb(61);
+        std::atomic<bool> failed(false);
+        std::atomic<bool> produced(false);
+
+        std::thread producer([&rb, &produced, count]()
+        {
+            for(unsigned i = 0; i < count; ++i)
+            {
+                const size_t len = 1 + i % 23;
+                Ring_Buffer::Write_Span ws;
+                while(!rb.acquire_write(len + 1, ws))
+                    std::this_thread::yield();
+                const uint8_t header = (uint8_t)len;
+                ws.copy_in(0, &header, 1);
+                std::vector<uint8_t> body(len, (uint8_t)i);
+                ws.copy_in(1, body.data(), len);
+                rb.commit_write(len + 1);
+            }
+            produced = true;
+        });
+
+        std::vector<uint8_t> body;
+        for(unsigned i = 0; i < count && !failed; ++i)
+        {
+            uint8_t len = 0;
+            while(!rb.peek(len))
+                std::this_thread::yield();
+            Ring_Buffer::Read_Span rs;
+            while(!rb.acquire_read(size_t(len) + 1, rs))
+                std::this_thread::yield();
+            body.resize(len);
+            rs.copy_out(1, body.data(), len);
+            rb.commit_read(size_t(len) + 1);
+            if(len != 1 + i % 23)
+                failed = true;
+            for(uint8_t b : body)
+            {
+                if(b != (uint8_t)i)
+                    failed = true;
+            }
+        }
+
+        // Let the producer finish before failing
+        while(failed && !produced)
+            rb.discard(rb.size_used());
+        producer.join();
+        QVERIFY(!failed);
+        QCOMPARE(rb.size_used(), size_t(0));
+    }
+};
+
+QTEST_APPLESS_MAIN(Ring_bufferTest)
+
+#include <tst_ring_buffertest.moc>
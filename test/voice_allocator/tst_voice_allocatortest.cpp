@@ -0,0 +1,208 @@
+#include <QString>
+#include <QtTest>
+
+#include <opl/voice_allocator.h>
+
+#include <vector>
+
+/*
+ * Checks the order in which VoiceAllocator hands out and replaces voices
+ * under each steal policy, and its handling of held notes.
+ */
+class Voice_allocatorTest : public QObject
+{
+    Q_OBJECT
+
+    static int play(VoiceAllocator &va, int note, uint32_t volume = 100, bool *replace = nullptr)
+    {
+        return va.noteOn(note, volume, 127, 127, replace);
+    }
+
+    static std::vector<int> active(const VoiceAllocator &va)
+    {
+        std::vector<int> voices;
+        for(int v = va.firstActive(); v != -1; v = va.nextActive(v))
+            voices.push_back(v);
+        return voices;
+    }
+
+private Q_SLOTS:
+    void freeOrder()
+    {
+        VoiceAllocator va;
+        va.allocate(3);
+        QCOMPARE(va.voiceCount(), 3);
+        QCOMPARE(va.activeCount(), 0);
+
+        bool replace = true;
+        QCOMPARE(play(va, 60, 100, &replace), 0);
+        QVERIFY(!replace);
+        QCOMPARE(play(va, 61), 1);
+        QCOMPARE(play(va, 62), 2);
+        QCOMPARE(va.activeCount(), 3);
+        QVERIFY(active(va) == std::vector<int>({0, 1, 2}));
+
+        // The voice released first is reused first, the last one keeps
+        // its release tail the longest
+        va.release(1);
+        va.release(0);
+        QCOMPARE(va.activeCount(), 1);
+        QCOMPARE(va.voice(1).note, -1);
+        QCOMPARE(play(va, 63), 1);
+        QCOMPARE(play(va, 64), 0);
+        QVERIFY(active(va) == std::vector<int>({2, 1, 0}));
+
+        // Releasing a free voice changes nothing
+        va.release(2);
+        va.release(2);
+        QCOMPARE(va.activeCount(), 2);
+
+        // No voices at all
+        VoiceAllocator none;
+        none.allocate(0);
+        QCOMPARE(play(none, 60, 100, &replace), -1);
+        QVERIFY(!replace);
+    }
+
+    void stealOldest()
+    {
+        VoiceAllocator va;
+        va.allocate(3);
+        QCOMPARE(va.stealPolicy(), VoiceAllocator::STEAL_OLDEST);
+        play(va, 60);
+        play(va, 61);
+        play(va, 62);
+
+        bool replace = false;
+        QCOMPARE(play(va, 63, 100, &replace), 0);
+        QVERIFY(replace);
+        QCOMPARE(va.voice(0).note, 63);
+        QCOMPARE(va.findNoteOff(60), -1);
+        QCOMPARE(play(va, 64), 1);
+        QCOMPARE(va.activeCount(), 3);
+        QVERIFY(active(va) == std::vector<int>({2, 0, 1}));
+
+        // A repeated key takes another voice
+        QCOMPARE(play(va, 64), 2);
+        QVERIFY(active(va) == std::vector<int>({0, 1, 2}));
+    }
+
+    void stealQuietest()
+    {
+        VoiceAllocator va;
+        va.allocate(3);
+        va.setStealPolicy(VoiceAllocator::STEAL_QUIETEST);
+        play(va, 60, 100);
+        play(va, 61, 20);
+        play(va, 62, 127);
+
+        bool replace = false;
+        QCOMPARE(play(va, 63, 90, &replace), 1);
+        QVERIFY(replace);
+
+        // A note kept by the pedal goes before any louder or quieter one
+        va.setHeld(2, true);
+        QCOMPARE(play(va, 64, 10), 2);
+
+        // Then the quietest again
+        QCOMPARE(play(va, 65, 50), 2);
+
+        // Same loudness: the oldest of them
+        VoiceAllocator same;
+        same.allocate(2);
+        same.setStealPolicy(VoiceAllocator::STEAL_QUIETEST);
+        play(same, 60);
+        play(same, 61);
+        QCOMPARE(play(same, 62), 0);
+        QCOMPARE(play(same, 63), 1);
+
+        // Controllers count in the loudness
+        VoiceAllocator cc;
+        cc.allocate(2);
+        cc.setStealPolicy(VoiceAllocator::STEAL_QUIETEST);
+        cc.noteOn(60, 100, 127, 127);
+        cc.noteOn(61, 100, 127, 30);
+        QCOMPARE(cc.noteOn(62, 100, 127, 127), 1);
+    }
+
+    void stealSameNote()
+    {
+        VoiceAllocator va;
+        va.allocate(3);
+        va.setStealPolicy(VoiceAllocator::STEAL_SAME_NOTE);
+        play(va, 60);
+        play(va, 61);
+
+        // The key retriggers its voice even when another one is free
+        bool replace = false;
+        QCOMPARE(play(va, 60, 100, &replace), 0);
+        QVERIFY(replace);
+        QCOMPARE(va.activeCount(), 2);
+        QVERIFY(active(va) == std::vector<int>({1, 0}));
+
+        // A key of the same list is not the same note
+        QCOMPARE(play(va, 60 + 128, 100, &replace), 2);
+        QVERIFY(!replace);
+
+        // Otherwise the oldest note is replaced
+        QCOMPARE(play(va, 70, 100, &replace), 1);
+        QVERIFY(replace);
+    }
+
+    void held()
+    {
+        VoiceAllocator va;
+        va.allocate(4);
+        QCOMPARE(play(va, 60), 0);
+        QCOMPARE(play(va, 60), 1);
+        QCOMPARE(play(va, 60 + 128), 2);
+
+        QCOMPARE(va.findNoteOff(60), 0);
+        va.setHeld(0, true);
+        QVERIFY(va.voice(0).held);
+        QCOMPARE(va.findNoteOff(60), 1);
+        va.setHeld(1, true);
+        QCOMPARE(va.findNoteOff(60), -1);
+        QCOMPARE(va.findNoteOff(60 + 128), 2);
+        QCOMPARE(va.findNoteOff(61), -1);
+
+        va.setHeld(0, false);
+        QCOMPARE(va.findNoteOff(60), 0);
+
+        // A released voice forgets it was held
+        va.release(1);
+        QVERIFY(!va.voice(1).held);
+        QCOMPARE(va.activeCount(), 2);
+    }
+
+    void clear()
+    {
+        VoiceAllocator va;
+        va.allocate(3);
+        va.setStealPolicy(VoiceAllocator::STEAL_QUIETEST);
+        play(va, 60);
+        play(va, 61);
+        va.setHeld(1, true);
+        va.release(0);
+
+        va.clear();
+        QCOMPARE(va.activeCount(), 0);
+        QCOMPARE(va.firstActive(), -1);
+        QCOMPARE(va.findNoteOff(60), -1);
+        for(int v = 0; v < va.voiceCount(); ++v)
+        {
+            QCOMPARE(va.voice(v).note, -1);
+            QVERIFY(!va.voice(v).held);
+        }
+
+        // Back to the order of allocate(), the policy is kept
+        QCOMPARE(play(va, 62), 0);
+        QCOMPARE(play(va, 63), 1);
+        QCOMPARE(play(va, 64), 2);
+        QCOMPARE(va.stealPolicy(), VoiceAllocator::STEAL_QUIETEST);
+    }
+};
+
+QTEST_APPLESS_MAIN(Voice_allocatorTest)
+
+#include <tst_voice_allocatortest.moc>
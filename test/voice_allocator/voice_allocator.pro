@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Voice allocator of the generator
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = tst_voice_allocatortest
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/../../src
+
+SOURCES += \
+        tst_voice_allocatortest.cpp \
+    ../../src/opl/voice_allocator.cpp
+
+HEADERS += \
+    ../../src/opl/voice_allocator.h
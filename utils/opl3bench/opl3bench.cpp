@@ -0,0 +1,436 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2018-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Headless benchmark of the chip emulators: replays the register log of
+ * VGM/VGZ or DRO files into every emulator and reports the cost as JSON.
+ */
+
+#include <FileFormats/format_vgm_import.h>
+#include <FileFormats/format_dro_importer.h>
+#include <FileFormats/opl_reg_stream.h>
+#include <opl/chips/nuked_opl3.h>
+#include <opl/chips/nuked_opl3_v174.h>
+#include <opl/chips/nuked_opl3_simd.h>
+#include <opl/chips/dosbox_opl3.h>
+#include <opl/chips/opal_opl3.h>
+#include <opl/chips/java_opl3.h>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct RegEvent
+{
+    double time;
+    unsigned chip;
+    uint16_t addr;
+    uint8_t val;
+};
+
+/**
+ * @brief Register log of a file, with the time of every write
+ */
+class RegLog : public OplRegStreamSink
+{
+public:
+    std::vector<RegEvent> events;
+    double duration = 0.0;
+    //! Chips written by the log, by their number in it
+    std::vector<bool> chipsUsed;
+
+    void passReg(unsigned chip, uint16_t addr, uint8_t val) override
+    {
+        RegEvent e = {duration, chip, addr, val};
+        events.push_back(e);
+        if(chip >= chipsUsed.size())
+            chipsUsed.resize(chip + 1, false);
+        chipsUsed[chip] = true;
+    }
+
+    void passDelay(uint32_t amount, uint32_t rate) override
+    {
+        duration += (double)amount / rate;
+    }
+};
+
+struct BenchOptions
+{
+    uint32_t rate = 44100;
+    OPLChipBase::ResamplerQuality quality = OPLChipBase::RESAMPLER_LINEAR;
+    unsigned block = 512;
+    unsigned runs = 5;
+    unsigned threads = 1;
+};
+
+/**
+ * @brief Register writes converted to frames of the output rate
+ */
+struct Replay
+{
+    struct Write
+    {
+        size_t frame;
+        unsigned chip;
+        uint16_t addr;
+        uint8_t val;
+    };
+    std::vector<Write> writes;
+    size_t frames = 0;
+    unsigned chips = 0;
+
+    Replay(const RegLog &log, uint32_t rate)
+    {
+        // number the chips in use from 0
+        std::vector<unsigned> index(log.chipsUsed.size(), 0);
+        for(size_t c = 0; c < log.chipsUsed.size(); ++c)
+        {
+            if(log.chipsUsed[c])
+                index[c] = chips++;
+        }
+        writes.reserve(log.events.size());
+        for(const RegEvent &e : log.events)
+        {
+            Write w = {(size_t)(e.time * rate), index[e.chip], e.addr, e.val};
+            writes.push_back(w);
+        }
+        frames = (size_t)std::ceil(log.duration * rate);
+    }
+};
+
+static const char *const g_emulatorIds[] =
+{
+    "nuked", "nuked174", "nukedsimd", "dosbox", "opal", "java"
+};
+
+static OPLChipBase *createChip(const QString &id)
+{
+    if(id == "nuked")
+        return new NukedOPL3;
+    if(id == "nuked174")
+        return new NukedOPL3v174;
+    if(id == "nukedsimd")
+        return new NukedOPL3SIMD;
+    if(id == "dosbox")
+        return new DosBoxOPL3;
+    if(id == "opal")
+        return new OpalOPL3;
+    if(id == "java")
+        return new JavaOPL3;
+    return nullptr;
+}
+
+typedef std::vector<std::unique_ptr<OPLChipBase>> ChipSet;
+
+/**
+ * @brief Creates and initializes the chips of the log, outside of the timing
+ */
+static void prepareChips(ChipSet &chips, const Replay &replay, const QString &emulator, const BenchOptions &opts)
+{
+    chips.resize(replay.chips);
+    for(unsigned c = 0; c < replay.chips; ++c)
+    {
+        chips[c].reset(createChip(emulator));
+        chips[c]->setRate(opts.rate);
+        chips[c]->setResamplerQuality(opts.quality);
+        chips[c]->reset();
+    }
+}
+
+/**
+ * @brief Renders the whole log once, mixing all chips into one stream
+ */
+static void runReplay(const Replay &replay, ChipSet &chips, const BenchOptions &opts)
+{
+    std::vector<int16_t> buffer(2 * opts.block);
+    std::vector<Replay::Write>::const_iterator write = replay.writes.begin();
+    const std::vector<Replay::Write>::const_iterator end = replay.writes.end();
+
+    for(size_t pos = 0; pos < replay.frames; pos += opts.block)
+    {
+        size_t count = std::min((size_t)opts.block, replay.frames - pos);
+        for(; write != end && write->frame < pos + count; ++write)
+            chips[write->chip]->writeRegAt(write->addr, write->val, (uint32_t)(write->frame - pos));
+        std::memset(buffer.data(), 0, buffer.size() * sizeof(int16_t));
+        for(unsigned c = 0; c < replay.chips; ++c)
+            chips[c]->generateAndMix(buffer.data(), count);
+    }
+}
+
+/**
+ * @brief Wall time of replaying the log in several threads at once, in ns
+ * The chips are created and initialized before the time starts.
+ */
+static double timeReplay(const Replay &replay, const QString &emulator, const BenchOptions &opts, unsigned threads)
+{
+    std::vector<ChipSet> sets(threads);
+    for(ChipSet &chips : sets)
+        prepareChips(chips, replay, emulator, opts);
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    if(threads == 1)
+        runReplay(replay, sets[0], opts);
+    else
+    {
+        std::vector<std::thread> workers;
+        for(unsigned t = 0; t < threads; ++t)
+            workers.emplace_back(runReplay, std::cref(replay), std::ref(sets[t]), std::cref(opts));
+        for(std::thread &worker : workers)
+            worker.join();
+    }
+    clock::time_point stop = clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+}
+
+static QJsonObject benchEmulator(const Replay &replay, const QString &emulator, const BenchOptions &opts)
+{
+    QJsonObject result;
+    std::unique_ptr<OPLChipBase> chip(createChip(emulator));
+    result["id"] = emulator;
+    result["name"] = QString::fromUtf8(chip->emulatorName());
+
+    // warm up the caches and the clock of the CPU
+    timeReplay(replay, emulator, opts, 1);
+
+    std::vector<double> nsPerSample;
+    QJsonArray runs;
+    for(unsigned r = 0; r < opts.runs; ++r)
+    {
+        double ns = timeReplay(replay, emulator, opts, 1) / (double)replay.frames;
+        nsPerSample.push_back(ns);
+        runs.append(ns);
+    }
+
+    double mean = 0.0;
+    for(double ns : nsPerSample)
+        mean += ns;
+    mean /= nsPerSample.size();
+    double variance = 0.0;
+    for(double ns : nsPerSample)
+        variance += (ns - mean) * (ns - mean);
+    variance = (nsPerSample.size() > 1) ? variance / (nsPerSample.size() - 1) : 0.0;
+
+    QJsonObject stats;
+    stats["mean"] = mean;
+    stats["variance"] = variance;
+    stats["stddev"] = std::sqrt(variance);
+    stats["min"] = *std::min_element(nsPerSample.begin(), nsPerSample.end());
+    stats["max"] = *std::max_element(nsPerSample.begin(), nsPerSample.end());
+    result["ns_per_sample"] = stats;
+    result["runs"] = runs;
+    result["realtime_factor"] = 1e9 / (mean * opts.rate);
+
+    // throughput of independent replays, one per thread, best of the runs
+    std::vector<unsigned> levels;
+    for(unsigned threads = 1; threads < opts.threads; threads *= 2)
+        levels.push_back(threads);
+    levels.push_back(opts.threads);
+
+    QJsonArray scaling;
+    double single = 0.0;
+    for(unsigned threads : levels)
+    {
+        double best = 0.0;
+        for(unsigned r = 0; r < opts.runs; ++r)
+        {
+            double ns = timeReplay(replay, emulator, opts, threads);
+            best = (r == 0 || ns < best) ? ns : best;
+        }
+        double throughput = 1e9 * (double)replay.frames * threads / best;
+        if(single == 0.0)
+            single = throughput;
+        QJsonObject level;
+        level["threads"] = (int)threads;
+        level["samples_per_second"] = throughput;
+        level["speedup"] = throughput / single;
+        level["efficiency"] = throughput / (single * threads);
+        scaling.append(level);
+    }
+    result["scaling"] = scaling;
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("opl3bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays VGM and DRO register logs into the OPL3 emulators and reports their cost as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "VGM, VGZ or DRO files to replay.", "<files...>");
+    QCommandLineOption emulatorOption(QStringList() << "e" << "emulator",
+        "Emulator to measure, repeatable: nuked, nuked174, nukedsimd, dosbox, opal, java. All of them by default.", "id");
+    QCommandLineOption rateOption(QStringList() << "r" << "rate", "Output sample rate, 44100 by default.", "hz", "44100");
+    QCommandLineOption resamplerOption("resampler", "Resampler: linear, sinc16 or sinc48, linear by default.", "quality", "linear");
+    QCommandLineOption blockOption(QStringList() << "b" << "block", "Frames rendered per call, 512 by default.", "frames", "512");
+    QCommandLineOption runsOption(QStringList() << "n" << "runs", "Repeated runs per measurement, 5 by default.", "count", "5");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads",
+        "Highest thread count of the scaling test, the count of CPU threads by default.", "count");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the report into a file instead of the standard output.", "file");
+    parser.addOption(emulatorOption);
+    parser.addOption(rateOption);
+    parser.addOption(resamplerOption);
+    parser.addOption(blockOption);
+    parser.addOption(runsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    const QStringList files = parser.positionalArguments();
+    if(files.isEmpty())
+        parser.showHelp(1);
+
+    BenchOptions opts;
+    opts.rate = parser.value(rateOption).toUInt();
+    opts.block = parser.value(blockOption).toUInt();
+    opts.runs = parser.value(runsOption).toUInt();
+    opts.threads = parser.isSet(threadsOption) ? parser.value(threadsOption).toUInt() : std::thread::hardware_concurrency();
+    opts.threads = (opts.threads > 0) ? opts.threads : 1;
+    if(opts.rate == 0 || opts.block == 0 || opts.runs == 0)
+    {
+        fprintf(stderr, "The rate, the block size and the count of runs must be positive.\n");
+        return 1;
+    }
+
+    const QString resampler = parser.value(resamplerOption);
+    if(resampler == "linear")
+        opts.quality = OPLChipBase::RESAMPLER_LINEAR;
+    else if(resampler == "sinc16")
+        opts.quality = OPLChipBase::RESAMPLER_SINC16;
+    else if(resampler == "sinc48")
+        opts.quality = OPLChipBase::RESAMPLER_SINC48;
+    else
+    {
+        fprintf(stderr, "Unknown resampler: %s\n", qPrintable(resampler));
+        return 1;
+    }
+
+    QStringList emulators = parser.values(emulatorOption);
+    if(emulators.isEmpty())
+    {
+        for(const char *id : g_emulatorIds)
+            emulators << id;
+    }
+    for(const QString &id : emulators)
+    {
+        std::unique_ptr<OPLChipBase> chip(createChip(id));
+        if(!chip)
+        {
+            fprintf(stderr, "Unknown emulator: %s\n", qPrintable(id));
+            return 1;
+        }
+    }
+
+    QJsonArray reports;
+    for(const QString &path : files)
+    {
+        RegLog log;
+        char magic[8] = {0};
+        QFile file(path);
+        if(file.open(QIODevice::ReadOnly))
+            file.read(magic, 8);
+        file.close();
+
+        FfmtErrCode err;
+        QString format;
+        if(std::memcmp(magic, "DBRAWOPL", 8) == 0)
+        {
+            format = "dro";
+            err = DRO_Importer::loadRegisters(path, log);
+        }
+        else
+        {
+            format = "vgm";
+            err = VGM_Importer::loadRegisters(path, log);
+        }
+
+        if(err != FfmtErrCode::ERR_OK)
+        {
+            fprintf(stderr, "Could not load the register log of %s.\n", qPrintable(path));
+            return 1;
+        }
+
+        Replay replay(log, opts.rate);
+        if(replay.frames == 0 || replay.chips == 0)
+        {
+            fprintf(stderr, "The register log of %s is empty.\n", qPrintable(path));
+            return 1;
+        }
+
+        fprintf(stderr, "%s: %u chip(s), %u writes, %.1f s\n", qPrintable(path),
+                replay.chips, (unsigned)replay.writes.size(), log.duration);
+
+        QJsonObject report;
+        report["file"] = QFileInfo(path).fileName();
+        report["format"] = format;
+        report["chips"] = (int)replay.chips;
+        report["writes"] = (double)replay.writes.size();
+        report["duration"] = log.duration;
+        report["samples"] = (double)replay.frames;
+
+        QJsonArray results;
+        for(const QString &id : emulators)
+        {
+            fprintf(stderr, "  %s...\n", qPrintable(id));
+            results.append(benchEmulator(replay, id, opts));
+        }
+        report["emulators"] = results;
+        reports.append(report);
+    }
+
+    QJsonObject settings;
+    settings["rate"] = (int)opts.rate;
+    settings["resampler"] = resampler;
+    settings["block"] = (int)opts.block;
+    settings["runs"] = (int)opts.runs;
+    settings["threads"] = (int)opts.threads;
+
+    QJsonObject root;
+    root["settings"] = settings;
+    root["files"] = reports;
+    QByteArray json = QJsonDocument(root).toJson();
+
+    if(parser.isSet(outputOption))
+    {
+        QFile out(parser.value(outputOption));
+        if(!out.open(QIODevice::WriteOnly) || out.write(json) != json.size())
+        {
+            fprintf(stderr, "Could not write the report.\n");
+            return 1;
+        }
+    }
+    else
+        fwrite(json.constData(), 1, (size_t)json.size(), stdout);
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+/*
+ * OPL Bank Editor by Wohlstand, a free tool for music bank editing
+ * Copyright (c) 2018-2022 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Headless renderer of instruments: plays a note, a script of notes or a
+ * MIDI file with an instrument of a bank and writes the result into a WAV
+ * or FLAC file, faster than realtime. With --all, every instrument of the
+ * bank gets rendered into a directory, in parallel.
+ */
+
+#include <FileFormats/ffmt_factory.h>
+#include <opl/offline_renderer.h>
+#include <opl/bank_renderer.h>
+#include <opl/midi_sequencer.h>
+#include <midi/midi_file.h>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <csignal>
+#include <cstdio>
+
+static volatile sig_atomic_t g_interrupted = 0;
+
+static void onInterrupt(int)
+{
+    g_interrupted = 1;
+}
+
+static bool chipFromName(const QString &id, Generator::OPL_Chips &chip)
+{
+    if(id == "nuked")
+        chip = Generator::CHIP_Nuked;
+    else if(id == "nukedsimd")
+        chip = Generator::CHIP_NukedSIMD;
+    else if(id == "dosbox")
+        chip = Generator::CHIP_DosBox;
+    else if(id == "opal")
+        chip = Generator::CHIP_Opal;
+    else if(id == "java")
+        chip = Generator::CHIP_Java;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Renders all instruments, Ctrl+C cancels the ones not started yet
+ */
+static int renderBank(const FmBank &bank, const QString &directory, const BankRenderer::Setup &setup)
+{
+    if(!QDir().mkpath(directory))
+    {
+        fprintf(stderr, "Could not create the directory: %s\n", qPrintable(directory));
+        return 1;
+    }
+
+    QVector<BankRenderer::Task> tasks = BankRenderer::makeTasks(bank, directory, setup);
+    if(tasks.isEmpty())
+    {
+        fprintf(stderr, "All instruments of the bank are blank.\n");
+        return 1;
+    }
+
+    signal(SIGINT, onInterrupt);
+
+    QElapsedTimer timer;
+    timer.start();
+    QFuture<void> future = BankRenderer::start(tasks);
+    int shown = -1;
+    while(!future.isFinished())
+    {
+        if(g_interrupted && !future.isCanceled())
+        {
+            future.cancel();
+            fprintf(stderr, "\nCanceling...\n");
+        }
+        const int done = future.progressValue();
+        if(done != shown)
+        {
+            fprintf(stderr, "\rRendered %d of %d instruments", done, tasks.size());
+            shown = done;
+        }
+        QThread::msleep(50);
+    }
+    future.waitForFinished();
+    fprintf(stderr, "\rRendered %d of %d instruments\n", future.progressValue(), tasks.size());
+
+    signal(SIGINT, SIG_DFL);
+
+    int failed = 0;
+    for(const BankRenderer::Task &task : tasks)
+    {
+        if(!task.ok && !task.error.isEmpty())
+        {
+            fprintf(stderr, "Could not render %s: %s\n", qPrintable(task.path), qPrintable(task.error));
+            ++failed;
+        }
+    }
+
+    const double taskSeconds = setup.song ? setup.song->duration() * 1e-6 + 1.0 : (setup.holdMs + setup.releaseMs) / 1000.0;
+    const double seconds = tasks.size() * taskSeconds;
+    const double elapsed = timer.nsecsElapsed() * 1e-9;
+    fprintf(stderr, "%.1f s of audio in %.3f s with %d threads, %.0fx realtime.\n",
+            seconds, elapsed, QThreadPool::globalInstance()->maxThreadCount(),
+            (elapsed > 0.0) ? seconds / elapsed : 0.0);
+
+    if(future.isCanceled())
+    {
+        fprintf(stderr, "Canceled.\n");
+        return 1;
+    }
+    return (failed > 0) ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("opl3render");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders an instrument of a bank into a WAV or FLAC file.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("bank", "Bank file of any supported format.", "<bank>");
+    parser.addPositionalArgument("output", "Output file, the format is given by the extension: .wav or .flac. "
+                                 "The output directory with --all.", "<output>");
+    QCommandLineOption melodicOption(QStringList() << "m" << "melodic", "Index of the melodic instrument, 0 by default.", "index");
+    QCommandLineOption drumOption(QStringList() << "d" << "drum", "Index of the percussion instrument to render instead.", "index");
+    QCommandLineOption scriptOption(QStringList() << "s" << "script",
+        "Script of the notes to play, one event per line: \"<ms> on <note> [velocity]\", \"<ms> off <note>\", "
+        "\"<ms> chord <major|minor|augmented|diminished|major7|minor7> <note> [velocity]\", "
+        "\"<ms> release\", \"<ms> bend <value>\", \"<ms> hold <on|off>\", \"<ms> end\".", "file");
+    QCommandLineOption midiOption("midi",
+        "MIDI file of type 0 or 1 to play instead of a note, every channel plays the instrument but the 10th. "
+        "Percussion plays the notes of its key on the 10th channel.", "file");
+    QCommandLineOption noteOption(QStringList() << "n" << "note", "Key of the note without a script, 60 by default.", "key", "60");
+    QCommandLineOption velocityOption("velocity", "Velocity of the note without a script, 127 by default.", "value", "127");
+    QCommandLineOption holdOption("hold", "Time the note is held without a script, 1000 by default.", "ms", "1000");
+    QCommandLineOption releaseOption("release", "Time rendered after the release without a script, 1000 by default.", "ms", "1000");
+    QCommandLineOption rateOption(QStringList() << "r" << "rate", "Output sample rate, 44100 by default.", "hz", "44100");
+    QCommandLineOption emulatorOption(QStringList() << "e" << "emulator",
+        "Emulator: nuked, nukedsimd, dosbox, opal or java, nuked by default.", "id", "nuked");
+    QCommandLineOption allOption(QStringList() << "a" << "all",
+        "Render every melodic and percussion instrument into its own file, the percussion plays its own key.");
+    QCommandLineOption formatOption(QStringList() << "f" << "format", "Format of the files with --all: wav or flac, wav by default.", "format", "wav");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Instruments rendered at once with --all, the count of CPU threads by default.", "count");
+    parser.addOption(melodicOption);
+    parser.addOption(drumOption);
+    parser.addOption(scriptOption);
+    parser.addOption(midiOption);
+    parser.addOption(noteOption);
+    parser.addOption(velocityOption);
+    parser.addOption(holdOption);
+    parser.addOption(releaseOption);
+    parser.addOption(rateOption);
+    parser.addOption(emulatorOption);
+    parser.addOption(allOption);
+    parser.addOption(formatOption);
+    parser.addOption(jobsOption);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if(args.size() != 2)
+        parser.showHelp(1);
+
+    Generator::OPL_Chips chip;
+    if(!chipFromName(parser.value(emulatorOption), chip))
+    {
+        fprintf(stderr, "Unknown emulator: %s\n", qPrintable(parser.value(emulatorOption)));
+        return 1;
+    }
+
+    const uint32_t rate = parser.value(rateOption).toUInt();
+    if(rate == 0)
+    {
+        fprintf(stderr, "The rate must be positive.\n");
+        return 1;
+    }
+
+    FmBankFormatFactory::registerAllFormats();
+    FmBank bank;
+    if(FmBankFormatFactory::OpenBankFile(args[0], bank) != FfmtErrCode::ERR_OK)
+    {
+        fprintf(stderr, "Could not load the bank: %s\n", qPrintable(args[0]));
+        return 1;
+    }
+
+    MidiFile midi;
+    if(parser.isSet(midiOption))
+    {
+        QString error;
+        if(!midi.load(parser.value(midiOption), &error))
+        {
+            fprintf(stderr, "Could not load the MIDI file %s: %s\n",
+                    qPrintable(parser.value(midiOption)), qPrintable(error));
+            return 1;
+        }
+    }
+
+    if(parser.isSet(allOption))
+    {
+        BankRenderer::Setup setup;
+        setup.rate = rate;
+        setup.chip = chip;
+        if(!AudioFileWriter::formatFromFileName("." + parser.value(formatOption), setup.format))
+        {
+            fprintf(stderr, "Unknown format: %s\n", qPrintable(parser.value(formatOption)));
+            return 1;
+        }
+        setup.note = parser.value(noteOption).toInt();
+        setup.velocity = parser.value(velocityOption).toInt();
+        setup.holdMs = parser.value(holdOption).toUInt();
+        setup.releaseMs = parser.value(releaseOption).toUInt();
+        BankRenderer::applyBankSetup(bank, setup);
+        if(parser.isSet(midiOption))
+            setup.song = &midi;
+        if(parser.isSet(jobsOption) && parser.value(jobsOption).toInt() > 0)
+            QThreadPool::globalInstance()->setMaxThreadCount(parser.value(jobsOption).toInt());
+        return renderBank(bank, args[1], setup);
+    }
+
+    const bool isDrum = parser.isSet(drumOption);
+    const int index = isDrum ? parser.value(drumOption).toInt() : parser.value(melodicOption).toInt();
+    const QVector<FmBank::Instrument> &box = isDrum ? bank.Ins_Percussion_box : bank.Ins_Melodic_box;
+    if(index < 0 || index >= box.size())
+    {
+        fprintf(stderr, "The bank has no %s instrument %d.\n", isDrum ? "percussion" : "melodic", index);
+        return 1;
+    }
+
+    OfflineRenderer renderer(rate, chip);
+    renderer.setBankSetup(bank);
+
+    if(parser.isSet(midiOption))
+    {
+        MidiSequencer song(midi, rate);
+        if(isDrum)
+        {
+            song.setChannelMask(MidiSequencer::DrumChannels);
+            song.setKeyFilter(index % 128);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QString error;
+        if(!renderer.renderSongToFile(box[index], isDrum, song, args[1], &error))
+        {
+            fprintf(stderr, "Could not render %s: %s\n", qPrintable(args[1]), qPrintable(error));
+            return 1;
+        }
+
+        const double seconds = static_cast<double>(song.length()) / rate + 1.0;
+        const double elapsed = timer.nsecsElapsed() * 1e-9;
+        fprintf(stderr, "Rendered %.1f s of audio in %.3f s, %.0fx realtime.\n",
+                seconds, elapsed, (elapsed > 0.0) ? seconds / elapsed : 0.0);
+        return 0;
+    }
+
+    OfflineRenderer::Script script;
+    if(parser.isSet(scriptOption))
+    {
+        QFile file(parser.value(scriptOption));
+        if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            fprintf(stderr, "Could not open the script: %s\n", qPrintable(file.fileName()));
+            return 1;
+        }
+        QString error;
+        if(!OfflineRenderer::parseScript(QString::fromUtf8(file.readAll()), script, &error))
+        {
+            fprintf(stderr, "%s\n", qPrintable(error));
+            return 1;
+        }
+    }
+    else
+    {
+        script = OfflineRenderer::noteScript(parser.value(noteOption).toInt(),
+                                             parser.value(holdOption).toUInt(),
+                                             parser.value(releaseOption).toUInt(),
+                                             parser.value(velocityOption).toInt());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QString error;
+    if(!renderer.renderToFile(box[index], isDrum, script, args[1], &error))
+    {
+        fprintf(stderr, "Could not render %s: %s\n", qPrintable(args[1]), qPrintable(error));
+        return 1;
+    }
+
+    const double seconds = script.back().time / 1000.0;
+    const double elapsed = timer.nsecsElapsed() * 1e-9;
+    fprintf(stderr, "Rendered %.1f s of audio in %.3f s, %.0fx realtime.\n",
+            seconds, elapsed, (elapsed > 0.0) ? seconds / elapsed : 0.0);
+
+    return 0;
+}